@@ -0,0 +1,66 @@
+/* 
+  
+  The main file of the benchmark firmware of "The Incredible State Machine". Runs a standardized set of benchmarks
+  (see BenchmarkController.c) and prints the results over USB stdio, after which the system is stopped.
+
+  Copyright (c) 2024 Maarten Klarenbeek (https://github.com/mjklaren)
+  Distributed under the GPLv3 license
+
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "pico/stdlib.h"
+#include "pico/multicore.h"
+#include "hardware/gpio.h"
+#include "TISM.h"
+
+#define BENCHMARK_LOAD_TASKS 16     // Number of load tasks for the scheduler overhead benchmark.
+
+// The benchmark tasks. BenchmarkEcho.c defines the message types used by BenchmarkController.c.
+#include "BenchmarkEcho.c"
+#include "BenchmarkLoad.c"
+#include "BenchmarkController.c"
+
+
+// Start the 2nd scheduler on the 2nd core of the RP2040.
+void StartCore2()
+{
+  if (TISM_Scheduler(CORE1))
+    fprintf(STDERR, "TISM: TISM Scheduler for CORE1 exited with error.\n");
+}
+
+
+void main(void)
+{
+  // Initialize the TISM system.
+  System.SystemDebug=DEBUG_NONE;
+  TISM_InitializeSystem();
+ 
+  // Register the benchmark tasks; the controller, two echo tasks (one for each core) and the load tasks.
+  char LoadTaskName[MAX_TASK_NAME_LENGTH+1];
+  int Result=TISM_RegisterTask(&BenchmarkController,"BenchmarkController",PRIORITY_HIGH)+
+             TISM_RegisterTaskWithQueueSize(&BenchmarkEcho,"BenchmarkEchoLocal",PRIORITY_HIGH,64)+
+             TISM_RegisterTaskWithQueueSize(&BenchmarkEcho,"BenchmarkEchoRemote",PRIORITY_HIGH,64);
+  for(uint8_t TaskCounter=0;TaskCounter<BENCHMARK_LOAD_TASKS;TaskCounter++)
+  {
+    sprintf(LoadTaskName,"BenchmarkLoad%d",TaskCounter+1);
+    Result+=TISM_RegisterTaskWithQueueSize(&BenchmarkLoad,LoadTaskName,PRIORITY_HIGH,4);
+  }
+  if(Result!=0)
+  {
+     // An error occured during registering of the tasks. Abort.
+     fprintf(STDERR, "TISM: Error occured when registering a tasks. Stopping...\n");
+     return;
+  };  
+ 
+  // Start up the 2nd core and fire up a 2nd TISM_Scheduler.
+  multicore_launch_core1(StartCore2);
+
+  // All tasks registered and 2nd core running. Now start up the scheduler for Core 0.
+  if (TISM_Scheduler(CORE0))
+    fprintf(STDERR, "TISM: TISM Scheduler for CORE0 exited with error.\n");
+  
+  printf("TISM: Benchmark completed.\n");
+  sleep_ms(SHUTDOWN_DELAY);
+}
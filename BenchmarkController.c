@@ -0,0 +1,362 @@
+/*
+
+  Benchmark controller; runs a standardized set of benchmarks and prints the results to STDOUT in a machine-readable
+  format, one line per benchmark:
+
+    BENCH,<benchmark>,<samples>,<min>,<avg>,<max>,<unit>
+
+  The benchmarks are run one after another:
+  - roundtrip_local   Message round trip to BenchmarkEcho on the same core (request and reply).
+  - roundtrip_remote  Message round trip to BenchmarkEcho on the other core.
+  - irq_latency       Time between a GPIO edge and the arrival of the message from TISM_IRQHandler. The GPIO
+                      (BENCHMARK_GPIO) is driven by this task; no external wiring is required.
+  - timer_msec        Deviation of the interval of a repetitive software timer from the requested interval.
+  - timer_usec        Same, for a precision timer.
+  - throughput        Messages per second delivered to BenchmarkEcho on the other core; the sender throttles when
+                      the inbound queue of the recipient is full (TISM_PostmanSendMessage).
+  - throughput_batch  Same, sending batches of BENCHMARK_BATCH_SIZE messages (TISM_PostmanSendMessages).
+  - sched_overhead    Time spent in the scheduler per task run, with BENCHMARK_LOAD_TASKS load tasks awake (nsec).
+  A benchmark that doesn't complete within BENCHMARK_PHASE_TIMEOUT_USEC is reported with the samples collected so far.
+  When all benchmarks are done the system is stopped.
+
+  Copyright (c) 2024 Maarten Klarenbeek (https://github.com/mjklaren)
+  Distributed under the GPLv3 license
+
+*/
+
+#include "TISM.h"
+
+#define BENCHMARK_GPIO               16       // GPIO used for the IRQ latency benchmark; configured as output, don't connect anything.
+#define BENCHMARK_SETTLE_USEC        1000000  // Wait after startup before starting the first benchmark.
+#define BENCHMARK_PHASE_TIMEOUT_USEC 10000000 // Maximum duration of a single benchmark.
+#define BENCHMARK_ROUNDTRIPS         1000     // Number of round trips per round-trip benchmark.
+#define BENCHMARK_IRQ_EVENTS         200      // Number of GPIO edges for the IRQ latency benchmark.
+#define BENCHMARK_TIMER_TICKS        100      // Number of intervals measured for the regular software timer.
+#define BENCHMARK_TIMER_MSEC         10       // Interval of the regular software timer.
+#define BENCHMARK_PRECISION_TICKS    1000     // Number of intervals measured for the precision timer.
+#define BENCHMARK_PRECISION_USEC     1000     // Interval of the precision timer.
+#define BENCHMARK_THROUGHPUT_USEC    1000000  // Duration of the throughput benchmarks.
+#define BENCHMARK_BATCH_SIZE         16       // Number of messages per batch for the batched throughput benchmark.
+#define BENCHMARK_OVERHEAD_USEC      1000000  // Duration of the scheduler overhead benchmark.
+#define BENCHMARK_RETRY_USEC         50       // Time before the next attempt when the sender is throttled.
+#define BENCHMARK_TIMER_ID           110      // Timer IDs for the timer benchmarks.
+#define BENCHMARK_PRECISION_TIMER_ID 111
+#define BENCHMARK_DEADLINE_TIMER_ID  112      // Wakes the sleeping controller when a benchmark times out.
+
+// The benchmarks, in order of execution.
+#define BENCHMARK_PHASE_SETTLE       0
+#define BENCHMARK_PHASE_RT_LOCAL     1
+#define BENCHMARK_PHASE_RT_REMOTE    2
+#define BENCHMARK_PHASE_IRQ          3
+#define BENCHMARK_PHASE_TIMER_MSEC   4
+#define BENCHMARK_PHASE_TIMER_USEC   5
+#define BENCHMARK_PHASE_THROUGHPUT   6
+#define BENCHMARK_PHASE_THROUGHPUT_BATCH 7
+#define BENCHMARK_PHASE_OVERHEAD     8
+#define BENCHMARK_PHASE_DONE         9
+
+
+// The results of a single benchmark.
+struct BenchmarkResult
+{
+  uint32_t Samples, Min, Max;
+  uint64_t Total;
+};
+
+
+// The structure containing all data for this task to run.
+struct BenchmarkControllerData
+{
+  uint8_t Phase, EchoLocalID, EchoRemoteID, FirstLoadID, LastLoadID;
+  bool PhaseStarted, GPIOLevel;
+  uint64_t PhaseDeadline, PhaseEnd, Timestamp;
+  uint32_t Sent;
+  TISM_CoreStatistics CoreStatistics[MAX_CORES];
+  struct BenchmarkResult Result[BENCHMARK_PHASE_DONE];
+} BenchmarkControllerData;
+
+
+// Internal function - add a sample to the results of a benchmark.
+void BenchmarkControllerAddSample(uint8_t Phase, uint32_t Value)
+{
+  struct BenchmarkResult *Result=&BenchmarkControllerData.Result[Phase];
+  if((Result->Samples==0) || (Value<Result->Min))
+    Result->Min=Value;
+  if(Value>Result->Max)
+    Result->Max=Value;
+  Result->Total+=Value;
+  Result->Samples++;
+}
+
+
+// Internal function - add the deviation of a timer interval from the requested interval as a sample.
+void BenchmarkControllerAddTimerSample(uint8_t Phase, uint64_t Now, uint32_t IntervalUsec)
+{
+  if(BenchmarkControllerData.Timestamp>0)
+  {
+    uint64_t Interval=Now-BenchmarkControllerData.Timestamp;
+    BenchmarkControllerAddSample(Phase, (uint32_t)(Interval>IntervalUsec?Interval-IntervalUsec:IntervalUsec-Interval));
+  }
+  BenchmarkControllerData.Timestamp=Now;
+}
+
+
+// Internal function - print the results of a benchmark.
+void BenchmarkControllerPrintResult(const char *Name, uint8_t Phase, const char *Unit)
+{
+  struct BenchmarkResult *Result=&BenchmarkControllerData.Result[Phase];
+  fprintf(STDOUT, "BENCH,%s,%lu,%lu,%llu,%lu,%s\n", Name, Result->Samples, Result->Min, (Result->Samples>0?Result->Total/Result->Samples:0), Result->Max, Unit);
+}
+
+
+// Internal function - move to the next benchmark.
+void BenchmarkControllerNextPhase()
+{
+  BenchmarkControllerData.Phase++;
+  BenchmarkControllerData.PhaseStarted=false;
+}
+
+
+/*
+  Description:
+  Benchmark controller; runs the benchmarks one by one (see above). Each run the controller processes the messages
+  received for the current benchmark and starts the next benchmark when the current one is completed.
+
+  Parameters:
+  TISM_Task *ThisTask - Pointer to struct containing all relevant information for this task to run. This is provided by the scheduler.
+
+  Return value:
+  <non-zero value>        - Task returned an error when executing. A non-zero value will stop the system.
+  OK                      - Run succesfully completed.
+*/
+uint8_t BenchmarkController (TISM_Task *ThisTask)
+{
+  // The scheduler maintains the state of the task and the system.
+  switch(ThisTask->TaskState)
+  {
+    case INIT:  // Find our partners, pin the tasks to their cores and set up the GPIO for the IRQ benchmark.
+                if (ThisTask->TaskDebug) TISM_EventLoggerLogEvent (ThisTask, TISM_LOG_EVENT_NOTIFY, "Initializing with priority %d.", ThisTask->TaskPriority);
+
+                memset(&BenchmarkControllerData, 0, sizeof(BenchmarkControllerData));
+                BenchmarkControllerData.EchoLocalID=TISM_GetTaskID("BenchmarkEchoLocal");
+                BenchmarkControllerData.EchoRemoteID=TISM_GetTaskID("BenchmarkEchoRemote");
+                BenchmarkControllerData.FirstLoadID=TISM_GetTaskID("BenchmarkLoad1");
+                BenchmarkControllerData.LastLoadID=BenchmarkControllerData.FirstLoadID+BENCHMARK_LOAD_TASKS-1;
+                TISM_TaskManagerSetMyTaskAttribute(ThisTask,TISM_SET_TASK_AFFINITY,CORE0);
+                TISM_TaskManagerSetTaskAttribute(ThisTask,BenchmarkControllerData.EchoLocalID,TISM_SET_TASK_AFFINITY,CORE0);
+                TISM_TaskManagerSetTaskAttribute(ThisTask,BenchmarkControllerData.EchoRemoteID,TISM_SET_TASK_AFFINITY,CORE1);
+                TISM_IRQHandlerSubscribe(ThisTask,BENCHMARK_GPIO,GPIO_IRQ_EDGE_RISE|GPIO_IRQ_EDGE_FALL,true,0);
+				        break;
+	  case RUN:   // Process the incoming messages for the current benchmark.
+		      	    if (ThisTask->TaskDebug==DEBUG_HIGH) TISM_EventLoggerLogEvent (ThisTask, TISM_LOG_EVENT_NOTIFY, "Doing work with priority %d on core %d.", ThisTask->TaskPriority, ThisTask->RunningOnCoreID);
+
+                uint8_t Phase=BenchmarkControllerData.Phase;
+                uint64_t Now;
+                TISM_Message *MessageToProcess;
+                while(TISM_PostmanMessagesWaiting(ThisTask)>0)
+                {
+                  MessageToProcess=TISM_PostmanReadMessage(ThisTask);
+                  Now=time_us_64();
+                  switch(MessageToProcess->MessageType)
+                  {
+                    case TISM_PING:                    // Check if this process is still alive. Reply with a ECHO message type; return same message payload.
+                                                       TISM_PostmanWriteMessage(ThisTask,MessageToProcess->SenderTaskID,TISM_ECHO,MessageToProcess->Message,0);
+                                                       break;
+                    case BENCHMARK_REPLY:              // Round trip completed; send the next request.
+                                                       if((Phase==BENCHMARK_PHASE_RT_LOCAL) || (Phase==BENCHMARK_PHASE_RT_REMOTE))
+                                                       {
+                                                         BenchmarkControllerAddSample(Phase, (uint32_t)(Now-BenchmarkControllerData.Timestamp));
+                                                         if(BenchmarkControllerData.Result[Phase].Samples<BENCHMARK_ROUNDTRIPS)
+                                                         {
+                                                           BenchmarkControllerData.Timestamp=time_us_64();
+                                                           TISM_PostmanWriteMessage(ThisTask,MessageToProcess->SenderTaskID,BENCHMARK_REQUEST,BenchmarkControllerData.Result[Phase].Samples,0);
+                                                         }
+                                                         else
+                                                           BenchmarkControllerNextPhase();
+                                                       }
+                                                       break;
+                    case BENCHMARK_GPIO:               // GPIO edge received via TISM_IRQHandler.
+                                                       if(Phase==BENCHMARK_PHASE_IRQ)
+                                                       {
+                                                         BenchmarkControllerAddSample(Phase, (uint32_t)(Now-BenchmarkControllerData.Timestamp));
+                                                         if(BenchmarkControllerData.Result[Phase].Samples<BENCHMARK_IRQ_EVENTS)
+                                                         {
+                                                           BenchmarkControllerData.GPIOLevel=!BenchmarkControllerData.GPIOLevel;
+                                                           BenchmarkControllerData.Timestamp=time_us_64();
+                                                           gpio_put(BENCHMARK_GPIO,BenchmarkControllerData.GPIOLevel);
+                                                         }
+                                                         else
+                                                           BenchmarkControllerNextPhase();
+                                                       }
+                                                       break;
+                    case BENCHMARK_TIMER_ID:           if(Phase==BENCHMARK_PHASE_TIMER_MSEC)
+                                                       {
+                                                         BenchmarkControllerAddTimerSample(Phase, Now, BENCHMARK_TIMER_MSEC*1000);
+                                                         if(BenchmarkControllerData.Result[Phase].Samples>=BENCHMARK_TIMER_TICKS)
+                                                           BenchmarkControllerNextPhase();
+                                                       }
+                                                       break;
+                    case BENCHMARK_PRECISION_TIMER_ID: if(Phase==BENCHMARK_PHASE_TIMER_USEC)
+                                                       {
+                                                         BenchmarkControllerAddTimerSample(Phase, Now, BENCHMARK_PRECISION_USEC);
+                                                         if(BenchmarkControllerData.Result[Phase].Samples>=BENCHMARK_PRECISION_TICKS)
+                                                           BenchmarkControllerNextPhase();
+                                                       }
+                                                       break;
+                    case BENCHMARK_RESULT:             // Number of messages received by BenchmarkEchoRemote; calculate the messages per second.
+                                                       if((Phase==BENCHMARK_PHASE_THROUGHPUT) || (Phase==BENCHMARK_PHASE_THROUGHPUT_BATCH))
+                                                       {
+                                                         BenchmarkControllerAddSample(Phase, (uint32_t)(((uint64_t)MessageToProcess->Message*1000000)/BENCHMARK_THROUGHPUT_USEC));
+                                                         BenchmarkControllerNextPhase();
+                                                       }
+                                                       break;
+                    default:                           // Unknown message type - ignore.
+                                                       break;
+                  }
+                  TISM_PostmanDeleteMessage(ThisTask);
+                }
+
+                // Benchmark completed or timed out? Clean up and start the next one.
+                Now=time_us_64();
+                if((BenchmarkControllerData.PhaseStarted) && (Now>BenchmarkControllerData.PhaseDeadline) && (BenchmarkControllerData.Phase==Phase))
+                {
+                  TISM_EventLoggerLogEvent (ThisTask, TISM_LOG_EVENT_ERROR, "Benchmark %d timed out.", Phase);
+                  BenchmarkControllerNextPhase();
+                }
+                if(BenchmarkControllerData.Phase!=Phase)
+                {
+                  TISM_SoftwareTimerCancel(ThisTask,BENCHMARK_DEADLINE_TIMER_ID);
+                  if(Phase==BENCHMARK_PHASE_TIMER_MSEC)
+                    TISM_SoftwareTimerCancel(ThisTask,BENCHMARK_TIMER_ID);
+                  if(Phase==BENCHMARK_PHASE_TIMER_USEC)
+                    TISM_SoftwareTimerCancel(ThisTask,BENCHMARK_PRECISION_TIMER_ID);
+                  Phase=BenchmarkControllerData.Phase;
+                }
+
+                // Start the current benchmark, or do the work for the benchmarks that aren't driven by messages.
+                if(!BenchmarkControllerData.PhaseStarted)
+                {
+                  BenchmarkControllerData.PhaseStarted=true;
+                  BenchmarkControllerData.PhaseDeadline=Now+BENCHMARK_PHASE_TIMEOUT_USEC;
+                  BenchmarkControllerData.Timestamp=Now;
+                  TISM_SoftwareTimerSet(ThisTask,BENCHMARK_DEADLINE_TIMER_ID,false,BENCHMARK_PHASE_TIMEOUT_USEC/1000+1);
+                  switch(Phase)
+                  {
+                    case BENCHMARK_PHASE_SETTLE:     // Tasks start STARTUP_DELAY after INIT; give the system tasks time to process our requests.
+                                                     BenchmarkControllerData.PhaseEnd=Now+BENCHMARK_SETTLE_USEC;
+                                                     break;
+                    case BENCHMARK_PHASE_RT_LOCAL:   TISM_PostmanWriteMessage(ThisTask,BenchmarkControllerData.EchoLocalID,BENCHMARK_REQUEST,0,0);
+                                                     break;
+                    case BENCHMARK_PHASE_RT_REMOTE:  TISM_PostmanWriteMessage(ThisTask,BenchmarkControllerData.EchoRemoteID,BENCHMARK_REQUEST,0,0);
+                                                     break;
+                    case BENCHMARK_PHASE_IRQ:        // Drive the (input) GPIO ourselves; the input still sees the level of the output.
+                                                     BenchmarkControllerData.GPIOLevel=true;
+                                                     gpio_put(BENCHMARK_GPIO,false);
+                                                     gpio_set_dir(BENCHMARK_GPIO,GPIO_OUT);
+                                                     BenchmarkControllerData.Timestamp=time_us_64();
+                                                     gpio_put(BENCHMARK_GPIO,true);
+                                                     break;
+                    case BENCHMARK_PHASE_TIMER_MSEC: BenchmarkControllerData.Timestamp=0;
+                                                     TISM_SoftwareTimerSet(ThisTask,BENCHMARK_TIMER_ID,true,BENCHMARK_TIMER_MSEC);
+                                                     break;
+                    case BENCHMARK_PHASE_TIMER_USEC: BenchmarkControllerData.Timestamp=0;
+                                                     TISM_SoftwareTimerSetWithPrecision(ThisTask,BENCHMARK_PRECISION_TIMER_ID,true,BENCHMARK_PRECISION_USEC,TISM_TIMER_PRECISION_USEC);
+                                                     break;
+                    case BENCHMARK_PHASE_THROUGHPUT:
+                    case BENCHMARK_PHASE_THROUGHPUT_BATCH:
+                                                     BenchmarkControllerData.PhaseEnd=Now+BENCHMARK_THROUGHPUT_USEC;
+                                                     BenchmarkControllerData.Sent=0;
+                                                     break;
+                    case BENCHMARK_PHASE_OVERHEAD:   // Wake the load tasks and take a snapshot of the statistics of the cores.
+                                                     for(uint8_t TaskID=BenchmarkControllerData.FirstLoadID;TaskID<=BenchmarkControllerData.LastLoadID;TaskID++)
+                                                       TISM_TaskManagerSetTaskAttribute(ThisTask,TaskID,TISM_SET_TASK_SLEEP,false);
+                                                     memcpy(BenchmarkControllerData.CoreStatistics, System.CoreStatistics, sizeof(BenchmarkControllerData.CoreStatistics));
+                                                     BenchmarkControllerData.PhaseEnd=Now+BENCHMARK_OVERHEAD_USEC;
+                                                     ThisTask->TaskWakeUpTimer=BenchmarkControllerData.PhaseEnd;
+                                                     break;
+                    case BENCHMARK_PHASE_DONE:       // Print the results and stop the system.
+                                                     fprintf(STDOUT, "BENCH,benchmark,samples,min,avg,max,unit\n");
+                                                     BenchmarkControllerPrintResult("roundtrip_local", BENCHMARK_PHASE_RT_LOCAL, "usec");
+                                                     BenchmarkControllerPrintResult("roundtrip_remote", BENCHMARK_PHASE_RT_REMOTE, "usec");
+                                                     BenchmarkControllerPrintResult("irq_latency", BENCHMARK_PHASE_IRQ, "usec");
+                                                     BenchmarkControllerPrintResult("timer_msec", BENCHMARK_PHASE_TIMER_MSEC, "usec");
+                                                     BenchmarkControllerPrintResult("timer_usec", BENCHMARK_PHASE_TIMER_USEC, "usec");
+                                                     BenchmarkControllerPrintResult("throughput", BENCHMARK_PHASE_THROUGHPUT, "msg/s");
+                                                     BenchmarkControllerPrintResult("throughput_batch", BENCHMARK_PHASE_THROUGHPUT_BATCH, "msg/s");
+                                                     BenchmarkControllerPrintResult("sched_overhead", BENCHMARK_PHASE_OVERHEAD, "nsec");
+                                                     fprintf(STDOUT, "BENCH,end\n");
+                                                     TISM_TaskManagerSetSystemState(ThisTask,STOP);
+                                                     break;
+                  }
+                }
+                switch(Phase)
+                {
+                  case BENCHMARK_PHASE_SETTLE:     if(Now>BenchmarkControllerData.PhaseEnd)
+                                                   {
+                                                     BenchmarkControllerNextPhase();
+                                                     ThisTask->TaskWakeUpTimer=time_us_64()+BENCHMARK_RETRY_USEC;
+                                                   }
+                                                   else
+                                                     ThisTask->TaskWakeUpTimer=BenchmarkControllerData.PhaseEnd;
+                                                   break;
+                  case BENCHMARK_PHASE_THROUGHPUT: // Send until the inbound queue of the recipient is full, then try again a little later.
+                                                   if(BenchmarkControllerData.PhaseEnd>0)
+                                                   {
+                                                     while((time_us_64()<BenchmarkControllerData.PhaseEnd) && (TISM_PostmanSendMessage(ThisTask,BenchmarkControllerData.EchoRemoteID,BENCHMARK_BULK,BenchmarkControllerData.Sent,0)==OK))
+                                                       BenchmarkControllerData.Sent++;
+                                                     if((time_us_64()>=BenchmarkControllerData.PhaseEnd) && (TISM_PostmanSendMessage(ThisTask,BenchmarkControllerData.EchoRemoteID,BENCHMARK_DONE,0,0)==OK))
+                                                       BenchmarkControllerData.PhaseEnd=0;
+                                                   }
+                                                   ThisTask->TaskWakeUpTimer=time_us_64()+BENCHMARK_RETRY_USEC;
+                                                   break;
+                  case BENCHMARK_PHASE_THROUGHPUT_BATCH: // Same, in batches.
+                                                   if(BenchmarkControllerData.PhaseEnd>0)
+                                                   {
+                                                     uint32_t Batch[BENCHMARK_BATCH_SIZE];
+                                                     while(time_us_64()<BenchmarkControllerData.PhaseEnd)
+                                                     {
+                                                       for(uint8_t counter=0;counter<BENCHMARK_BATCH_SIZE;counter++)
+                                                         Batch[counter]=BenchmarkControllerData.Sent+counter;
+                                                       if(TISM_PostmanSendMessages(ThisTask,BenchmarkControllerData.EchoRemoteID,BENCHMARK_BULK,Batch,0,BENCHMARK_BATCH_SIZE)!=OK)
+                                                         break;
+                                                       BenchmarkControllerData.Sent+=BENCHMARK_BATCH_SIZE;
+                                                     }
+                                                     if((time_us_64()>=BenchmarkControllerData.PhaseEnd) && (TISM_PostmanSendMessage(ThisTask,BenchmarkControllerData.EchoRemoteID,BENCHMARK_DONE,0,0)==OK))
+                                                       BenchmarkControllerData.PhaseEnd=0;
+                                                   }
+                                                   ThisTask->TaskWakeUpTimer=time_us_64()+BENCHMARK_RETRY_USEC;
+                                                   break;
+                  case BENCHMARK_PHASE_OVERHEAD:   // Time's up? Overhead is the time not spent in tasks or sleeping, per task run.
+                                                   if(Now>=BenchmarkControllerData.PhaseEnd)
+                                                   {
+                                                     int64_t Overhead=0;
+                                                     uint32_t Runs=0;
+                                                     for(uint8_t CoreCounter=0;CoreCounter<MAX_CORES;CoreCounter++)
+                                                     {
+                                                       Overhead+=Now-BenchmarkControllerData.Timestamp;
+                                                       Overhead-=System.CoreStatistics[CoreCounter].BusyTime-BenchmarkControllerData.CoreStatistics[CoreCounter].BusyTime;
+                                                       Overhead-=System.CoreStatistics[CoreCounter].IdleTime-BenchmarkControllerData.CoreStatistics[CoreCounter].IdleTime;
+                                                       Runs+=System.CoreStatistics[CoreCounter].Runs-BenchmarkControllerData.CoreStatistics[CoreCounter].Runs;
+                                                     }
+                                                     if(SCHEDULER_STATISTICS && (Runs>0))
+                                                       BenchmarkControllerAddSample(Phase, (uint32_t)(Overhead>0?(Overhead*1000)/Runs:0));
+                                                     for(uint8_t TaskID=BenchmarkControllerData.FirstLoadID;TaskID<=BenchmarkControllerData.LastLoadID;TaskID++)
+                                                       TISM_TaskManagerSetTaskAttribute(ThisTask,TaskID,TISM_SET_TASK_SLEEP,true);
+                                                     BenchmarkControllerNextPhase();
+                                                     ThisTask->TaskWakeUpTimer=time_us_64()+BENCHMARK_RETRY_USEC;
+                                                   }
+                                                   break;
+                  case BENCHMARK_PHASE_DONE:       break;
+                  default:                         // Driven by messages; sleep until these arrive (or the deadline timer expires).
+                                                   TISM_TaskManagerSetMyTaskAttribute(ThisTask,TISM_SET_TASK_SLEEP,true);
+                                                   break;
+                }
+				        break;
+	  case STOP:  // Task required to stop this task.
+		            if (ThisTask->TaskDebug) TISM_EventLoggerLogEvent (ThisTask, TISM_LOG_EVENT_NOTIFY, "Stopping.");
+
+                TISM_TaskManagerSetMyTaskAttribute(ThisTask,TISM_SET_TASK_STATE,DOWN);
+		            break;
+  }
+  return (OK);
+}
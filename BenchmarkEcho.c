@@ -0,0 +1,89 @@
+/*
+
+  Benchmark echo task; the partner of BenchmarkController for the messaging benchmarks. Two instances are registered
+  by Benchmark.c; one runs on the same core as BenchmarkController, the other on the other core.
+
+  Copyright (c) 2024 Maarten Klarenbeek (https://github.com/mjklaren)
+  Distributed under the GPLv3 license
+
+*/
+
+#include "TISM.h"
+
+#define BENCHMARK_REQUEST  100   // Round-trip request; reply with BENCHMARK_REPLY and the same payload.
+#define BENCHMARK_REPLY    101
+#define BENCHMARK_BULK     102   // Throughput message; only counted.
+#define BENCHMARK_DONE     103   // End of the throughput benchmark; reply with BENCHMARK_RESULT and the number of BENCHMARK_BULK messages.
+#define BENCHMARK_RESULT   104
+
+
+// The structure containing all data for this task to run; one counter per instance.
+struct BenchmarkEchoData
+{
+  uint32_t BulkCounter[MAX_TASKS];
+} BenchmarkEchoData;
+
+
+/*
+  Description:
+  Benchmark echo task; replies to round-trip requests and counts throughput messages. The task sleeps until it receives
+  a message.
+
+  Parameters:
+  TISM_Task *ThisTask - Pointer to struct containing all relevant information for this task to run. This is provided by the scheduler.
+
+  Return value:
+  <non-zero value>        - Task returned an error when executing. A non-zero value will stop the system.
+  OK                      - Run succesfully completed.
+*/
+uint8_t BenchmarkEcho (TISM_Task *ThisTask)
+{
+  // The scheduler maintains the state of the task and the system.
+  switch(ThisTask->TaskState)
+  {
+    case INIT:  // Sleep until we receive messages.
+                BenchmarkEchoData.BulkCounter[ThisTask->TaskID]=0;
+                TISM_TaskManagerSetMyTaskAttribute(ThisTask,TISM_SET_TASK_SLEEP,true);
+				        break;
+	  case RUN:   // Process the incoming messages.
+		      	    if (ThisTask->TaskDebug==DEBUG_HIGH) TISM_EventLoggerLogEvent (ThisTask, TISM_LOG_EVENT_NOTIFY, "Doing work with priority %d on core %d.", ThisTask->TaskPriority, ThisTask->RunningOnCoreID);
+
+                // Process the messages in spans, to benefit from the batch functions of the Postman.
+                uint16_t MessageCounter=0, SpanLength;
+                TISM_Message *Messages;
+                while((MessageCounter<MAX_MESSAGES) && ((SpanLength=TISM_PostmanReadMessages(ThisTask,&Messages))>0))
+                {
+                  for(uint16_t SpanCounter=0;SpanCounter<SpanLength;SpanCounter++)
+                  {
+                    TISM_Message *MessageToProcess=&Messages[SpanCounter];
+                    switch(MessageToProcess->MessageType)
+                    {
+                      case TISM_PING:         // Check if this process is still alive. Reply with a ECHO message type; return same message payload.
+                                              TISM_PostmanWriteMessage(ThisTask,MessageToProcess->SenderTaskID,TISM_ECHO,MessageToProcess->Message,0);
+                                              break;
+                      case BENCHMARK_REQUEST: // Reply right away.
+                                              TISM_PostmanWriteMessage(ThisTask,MessageToProcess->SenderTaskID,BENCHMARK_REPLY,MessageToProcess->Message,0);
+                                              break;
+                      case BENCHMARK_BULK:    BenchmarkEchoData.BulkCounter[ThisTask->TaskID]++;
+                                              break;
+                      case BENCHMARK_DONE:    // Report the number of messages received and start over.
+                                              TISM_PostmanWriteMessage(ThisTask,MessageToProcess->SenderTaskID,BENCHMARK_RESULT,BenchmarkEchoData.BulkCounter[ThisTask->TaskID],0);
+                                              BenchmarkEchoData.BulkCounter[ThisTask->TaskID]=0;
+                                              break;
+                      default:                // Unknown message type - ignore.
+                                              break;
+                    }
+                  }
+                  TISM_PostmanDeleteMessages(ThisTask,SpanLength);
+                  MessageCounter+=SpanLength;
+                }
+
+                // Go back to sleep; we're woken up when new messages arrive.
+                TISM_TaskManagerSetMyTaskAttribute(ThisTask,TISM_SET_TASK_SLEEP,true);
+				        break;
+	  case STOP:  // Task required to stop this task.
+                TISM_TaskManagerSetMyTaskAttribute(ThisTask,TISM_SET_TASK_STATE,DOWN);
+		            break;
+  }
+  return (OK);
+}
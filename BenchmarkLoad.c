@@ -0,0 +1,53 @@
+/*
+
+  Benchmark load task; a task that does nothing but run as often as possible, to measure the overhead of the scheduler.
+  Multiple instances of this task are registered by Benchmark.c (BENCHMARK_LOAD_TASKS); BenchmarkController wakes
+  them for the scheduler overhead benchmark and puts them to sleep again afterwards.
+
+  Copyright (c) 2024 Maarten Klarenbeek (https://github.com/mjklaren)
+  Distributed under the GPLv3 license
+
+*/
+
+#include "TISM.h"
+
+#define BENCHMARK_LOAD_INTERVAL_USEC 1000  // Time between the runs of each load task.
+
+
+/*
+  Description:
+  Benchmark load task; when awake the task runs every BENCHMARK_LOAD_INTERVAL_USEC without doing any work.
+
+  Parameters:
+  TISM_Task *ThisTask - Pointer to struct containing all relevant information for this task to run. This is provided by the scheduler.
+
+  Return value:
+  <non-zero value>        - Task returned an error when executing. A non-zero value will stop the system.
+  OK                      - Run succesfully completed.
+*/
+uint8_t BenchmarkLoad (TISM_Task *ThisTask)
+{
+  // The scheduler maintains the state of the task and the system.
+  switch(ThisTask->TaskState)
+  {
+    case INIT:  // Sleep until BenchmarkController needs us.
+                TISM_TaskManagerSetMyTaskAttribute(ThisTask,TISM_SET_TASK_SLEEP,true);
+				        break;
+	  case RUN:   // Only respond to pings; no actual work.
+                while(TISM_PostmanMessagesWaiting(ThisTask)>0)
+                {
+                  TISM_Message *MessageToProcess=TISM_PostmanReadMessage(ThisTask);
+                  if(MessageToProcess->MessageType==TISM_PING)
+                    TISM_PostmanWriteMessage(ThisTask,MessageToProcess->SenderTaskID,TISM_ECHO,MessageToProcess->Message,0);
+                  TISM_PostmanDeleteMessage(ThisTask);
+                }
+
+                // Run again as soon as the interval expires, regardless of our priority.
+                ThisTask->TaskWakeUpTimer=time_us_64()+BENCHMARK_LOAD_INTERVAL_USEC;
+				        break;
+	  case STOP:  // Task required to stop this task.
+                TISM_TaskManagerSetMyTaskAttribute(ThisTask,TISM_SET_TASK_STATE,DOWN);
+		            break;
+  }
+  return (OK);
+}
@@ -35,21 +35,21 @@ struct ExampleTask3Data
   the time between runs (basically slowing things down).
 
   Parameters:
-  TISM_Task ThisTask - Struct containing all relevant information for this task to run. This is provided by the scheduler.
+  TISM_Task *ThisTask - Pointer to struct containing all relevant information for this task to run. This is provided by the scheduler.
   
   Return value:
   <non-zero value>        - Task returned an error when executing. A non-zero value will stop the system.
   OK                      - Run succesfully completed.
 */
-uint8_t ExampleTask3 (TISM_Task ThisTask)
+uint8_t ExampleTask3 (TISM_Task *ThisTask)
 {
-  if (ThisTask.TaskDebug==DEBUG_HIGH) TISM_EventLoggerLogEvent (ThisTask, TISM_LOG_EVENT_NOTIFY, "Run starting.");
+  if (ThisTask->TaskDebug==DEBUG_HIGH) TISM_EventLoggerLogEvent (ThisTask, TISM_LOG_EVENT_NOTIFY, "Run starting.");
   
   // The scheduler maintains the state of the task and the system.
-  switch(ThisTask.TaskState)   
+  switch(ThisTask->TaskState)   
   {
     case INIT:  // Activities to initialize this task (e.g. initialize ports or peripherals).
-                if (ThisTask.TaskDebug) TISM_EventLoggerLogEvent (ThisTask, TISM_LOG_EVENT_NOTIFY, "Initializing with priority %d.", ThisTask.TaskPriority);
+                if (ThisTask->TaskDebug) TISM_EventLoggerLogEvent (ThisTask, TISM_LOG_EVENT_NOTIFY, "Initializing with priority %d.", ThisTask->TaskPriority);
 				        
                 // Set a repetitive timer to wake up this task
                 TISM_SoftwareTimerSet(ThisTask,EVENTID,true,EXAMPLETASK3_TIMERINTERVAL);
@@ -59,7 +59,7 @@ uint8_t ExampleTask3 (TISM_Task ThisTask)
                 // TISM_TaskManagerSetMyTaskAttribute(ThisTask,TISM_SET_TASK_SLEEP,true);
 				        break;
 	  case RUN:   // Do the work.						
-		      	    if (ThisTask.TaskDebug==DEBUG_HIGH) TISM_EventLoggerLogEvent (ThisTask, TISM_LOG_EVENT_NOTIFY, "Doing work with priority %d on core %d.", ThisTask.TaskPriority, ThisTask.RunningOnCoreID);
+		      	    if (ThisTask->TaskDebug==DEBUG_HIGH) TISM_EventLoggerLogEvent (ThisTask, TISM_LOG_EVENT_NOTIFY, "Doing work with priority %d on core %d.", ThisTask->TaskPriority, ThisTask->RunningOnCoreID);
 
                 // First check for incoming messages and process them.
                 uint8_t MessageCounter=0;
@@ -68,7 +68,7 @@ uint8_t ExampleTask3 (TISM_Task ThisTask)
                 {
                   MessageToProcess=TISM_PostmanReadMessage(ThisTask);
 
-                  if (ThisTask.TaskDebug) TISM_EventLoggerLogEvent (ThisTask, TISM_LOG_EVENT_NOTIFY, "Message '%ld' type %d from TaskID %d (%s) received.", MessageToProcess->Message, MessageToProcess->MessageType, MessageToProcess->SenderTaskID, System.Task[MessageToProcess->SenderTaskID].TaskName);
+                  if (ThisTask->TaskDebug) TISM_EventLoggerLogEvent (ThisTask, TISM_LOG_EVENT_NOTIFY, "Message '%ld' type %d from TaskID %d (%s) received.", MessageToProcess->Message, MessageToProcess->MessageType, MessageToProcess->SenderTaskID, System.Task[MessageToProcess->SenderTaskID].TaskName);
 
                   // Processed the message; delete it.
                   switch(MessageToProcess->MessageType)
@@ -81,12 +81,12 @@ uint8_t ExampleTask3 (TISM_Task ThisTask)
                                              ExampleTask3Data.NumberOfRunsCounter=0;
                                              break;
                     case GPIO_IRQ_EDGE_FALL: // Button is pressed (message from ExampleTask1). Increase this task's priority.
-                            		             if (ThisTask.TaskDebug) TISM_EventLoggerLogEvent (ThisTask, TISM_LOG_EVENT_NOTIFY, "Message received; button pressed.");
+                            		             if (ThisTask->TaskDebug) TISM_EventLoggerLogEvent (ThisTask, TISM_LOG_EVENT_NOTIFY, "Message received; button pressed.");
 
                                              TISM_TaskManagerSetMyTaskAttribute(ThisTask,TISM_SET_TASK_PRIORITY,PRIORITY_HIGH);
                                              break;   
                     case GPIO_IRQ_EDGE_RISE: // Button is released (message from ExampleTask1). Set this task's priority to normal.
-                                             if (ThisTask.TaskDebug) TISM_EventLoggerLogEvent (ThisTask, TISM_LOG_EVENT_NOTIFY, "Message received; button released.");
+                                             if (ThisTask->TaskDebug) TISM_EventLoggerLogEvent (ThisTask, TISM_LOG_EVENT_NOTIFY, "Message received; button released.");
 
                                              TISM_TaskManagerSetMyTaskAttribute(ThisTask,TISM_SET_TASK_PRIORITY,PRIORITY_NORMAL);
                                              break;
@@ -98,7 +98,7 @@ uint8_t ExampleTask3 (TISM_Task ThisTask)
                 }
 				        break;
 	  case STOP:  // Task required to stop this task.
-		            if (ThisTask.TaskDebug) TISM_EventLoggerLogEvent (ThisTask, TISM_LOG_EVENT_NOTIFY, "Stopping.");
+		            if (ThisTask->TaskDebug) TISM_EventLoggerLogEvent (ThisTask, TISM_LOG_EVENT_NOTIFY, "Stopping.");
 		          
                 // Set the task state to DOWN. 
                 TISM_TaskManagerSetMyTaskAttribute(ThisTask,TISM_SET_TASK_STATE,DOWN);
@@ -107,7 +107,7 @@ uint8_t ExampleTask3 (TISM_Task ThisTask)
 		
   // Increase the counter of total runs in this interval with 1.
   ExampleTask3Data.NumberOfRunsCounter++;
-  if (ThisTask.TaskDebug==DEBUG_HIGH) TISM_EventLoggerLogEvent (ThisTask, TISM_LOG_EVENT_NOTIFY, "Run completed.");
+  if (ThisTask->TaskDebug==DEBUG_HIGH) TISM_EventLoggerLogEvent (ThisTask, TISM_LOG_EVENT_NOTIFY, "Run completed.");
 
   return (OK);
 }
@@ -9,7 +9,11 @@
 
 #include <string.h>
 #include <stdio.h>
+#include "hardware/watchdog.h"
 #include "TISM.h"
+#if LIB_PICO_STDIO_USB
+#include "pico/stdio_usb.h"
+#endif
 
 
 /*
@@ -73,35 +77,40 @@ bool TISM_IsTaskAwake(int TaskID)
 
 /*
   Description
-  Check if the specified Task is a system task by checking first 5 characters for "TISM_".
+  Check if the specified Task is a system task (name starting with "TISM_"; determined when the task is registered).
 
   Parameters:
   int TaskID   - The number of the task to check.
 
   Return value:
   true         - Specified task is a system task.
-  false        - Specified task is not a system task.
+  false        - Specified task is not a system task, or invalid task ID.
 */
 bool TISM_IsSystemTask(int TaskID)
 {
-  return(strncmp(System.Task[TaskID].TaskName,"TISM_",5)==0?true:false);
+  if((TaskID>=0) && (TaskID<System.NumberOfTasks))
+    return(System.Task[TaskID].TaskIsSystemTask);
+  return(false);
 }
 
 
 /*
   Description
-  Register a new task in the global System struct.
+  Register a new task in the global System struct, with an inbound queue that can hold QueueSize messages. The slots
+  for the queue are taken from the shared message pool (MESSAGE_POOL_SIZE).
 
   Parameters:
   int *Function           - Pointer to the function for this task; function returns int and takes no variables.
   char *Name              - Pointer to text buffer with name of this process.
   int TaskDefaultPriority - Priority for this task (PRIORITY_HIGH, PRIORITY_NORMAL, PRIORITY_LOW or other value in msec).
+  uint16_t QueueSize      - Number of messages the inbound queue of this task can hold. 0 for a task that doesn't receive messages.
 
   Return value:
   ERR_TOO_MANY_TASKS      - Attempt was made to register > MAX_TASKS.
+  ERR_QUEUE_ALLOCATION    - Not enough free slots in the message pool for the inbound queue.
   OK                      - Succes
 */
-int TISM_RegisterTask(uint8_t (*Function)(TISM_Task), char *Name, uint32_t TaskPriority)
+int TISM_RegisterTaskWithQueueSize(uint8_t (*Function)(TISM_Task *), char *Name, uint32_t TaskPriority, uint16_t QueueSize)
 {
   // Register the task-related data in the struct. Default values will be placed when initializing the System.
   // Check if not too many tasks are registered.
@@ -116,26 +125,178 @@ int TISM_RegisterTask(uint8_t (*Function)(TISM_Task), char *Name, uint32_t TaskP
   System.Task[System.NumberOfTasks].TaskID=System.NumberOfTasks;
   System.Task[System.NumberOfTasks].RunningOnCoreID=-1;
   strncpy(System.Task[System.NumberOfTasks].TaskName, Name, MAX_TASK_NAME_LENGTH);
+  System.Task[System.NumberOfTasks].TaskIsSystemTask=(strncmp(Name,"TISM_",5)==0);
   System.Task[System.NumberOfTasks].TaskFunction=Function;
   System.Task[System.NumberOfTasks].TaskState=INIT;
   System.Task[System.NumberOfTasks].TaskDebug=System.SystemDebug;
   System.Task[System.NumberOfTasks].TaskPriority=TaskPriority;
+  System.Task[System.NumberOfTasks].TaskDeadline=0;
+  System.Task[System.NumberOfTasks].TaskTimeout=0;
+  System.TaskLastRun[System.NumberOfTasks]=0;
   System.Task[System.NumberOfTasks].TaskWakeUpTimer=0;
   System.Task[System.NumberOfTasks].TaskSleeping=false;
+  System.Task[System.NumberOfTasks].TaskAffinity=CORE_ANY;
   System.Task[System.NumberOfTasks].TaskDebug=DEBUG_NONE;
+  System.Task[System.NumberOfTasks].TaskContext=NULL;
+  System.Task[System.NumberOfTasks].TaskWaitForMessage=TISM_NOT_WAITING;
+  System.Task[System.NumberOfTasks].TaskResumePoint=0;
 
   // Initialize the inbound messaging queue for this task. Place a pointer to the corresponding queue in the task struct.
+  if(!TISM_CircularBufferAllocate(&InboundMessageQueue[System.NumberOfTasks], QueueSize))
+  {
+    fprintf(STDERR, "TISM_RegisterTask: can't allocate an inbound queue of %d messages for %s (%d of %d slots in use).\n", QueueSize, Name, MessagePoolSlotsUsed, MESSAGE_POOL_SIZE);
+    return(ERR_QUEUE_ALLOCATION);
+  }
   System.Task[System.NumberOfTasks].InboundMessageQueue=&InboundMessageQueue[System.NumberOfTasks];
-  TISM_CircularBufferInit(System.Task[System.NumberOfTasks].InboundMessageQueue); 
+  TISM_CircularBufferInitMultiProducer(System.Task[System.NumberOfTasks].InboundMessageQueue); 
   System.Task[System.NumberOfTasks].OutboundMessageQueue=NULL;          // Will be provided by the scheduler.
+  TISM_SchedulerUpdateTask(System.NumberOfTasks);
 
   if(System.SystemDebug>=DEBUG_LOW) 
-    fprintf (STDOUT, "TISM: Task %s registered as task ID %d with priority %d.\n", System.Task[System.NumberOfTasks].TaskName, System.NumberOfTasks, System.Task[System.NumberOfTasks].TaskPriority);
+    fprintf (STDOUT, "TISM: Task %s registered as task ID %d with priority %d and queue size %d.\n", System.Task[System.NumberOfTasks].TaskName, System.NumberOfTasks, System.Task[System.NumberOfTasks].TaskPriority, QueueSize);
   System.NumberOfTasks++;
   return(OK);
 }
 
 
+/*
+  Description
+  Register a new task in the global System struct, with an inbound queue of the default size (QUEUE_SIZE_DEFAULT).
+
+  Parameters:
+  int *Function           - Pointer to the function for this task; function returns int and takes no variables.
+  char *Name              - Pointer to text buffer with name of this process.
+  int TaskDefaultPriority - Priority for this task (PRIORITY_HIGH, PRIORITY_NORMAL, PRIORITY_LOW or other value in msec).
+
+  Return value:
+  ERR_TOO_MANY_TASKS      - Attempt was made to register > MAX_TASKS.
+  ERR_QUEUE_ALLOCATION    - Not enough free slots in the message pool for the inbound queue.
+  OK                      - Succes
+*/
+int TISM_RegisterTask(uint8_t (*Function)(TISM_Task *), char *Name, uint32_t TaskPriority)
+{
+  return(TISM_RegisterTaskWithQueueSize(Function, Name, TaskPriority, QUEUE_SIZE_DEFAULT));
+}
+
+
+/*
+  Description
+  Register a new task with a context; a pointer to the data of the task (e.g. a struct with its state), which the task
+  finds in ThisTask->TaskContext. This allows multiple tasks to share the same task function, each with its own data
+  instead of file-scope globals (see TISM_RegisterTaskInstances).
+
+  Parameters:
+  int *Function           - Pointer to the function for this task; function returns int and takes no variables.
+  char *Name              - Pointer to text buffer with name of this process.
+  int TaskDefaultPriority - Priority for this task (PRIORITY_HIGH, PRIORITY_NORMAL, PRIORITY_LOW or other value in msec).
+  uint16_t QueueSize      - Number of messages the inbound queue of this task can hold.
+  void *Context           - Pointer to the data of this task.
+
+  Return value:
+  ERR_TOO_MANY_TASKS      - Attempt was made to register > MAX_TASKS.
+  ERR_QUEUE_ALLOCATION    - Not enough free slots in the message pool for the inbound queue.
+  OK                      - Succes
+*/
+int TISM_RegisterTaskWithContext(uint8_t (*Function)(TISM_Task *), char *Name, uint32_t TaskPriority, uint16_t QueueSize, void *Context)
+{
+  uint8_t TaskID=System.NumberOfTasks;
+  int ReturnValue=TISM_RegisterTaskWithQueueSize(Function, Name, TaskPriority, QueueSize);
+  if(ReturnValue==OK)
+    System.Task[TaskID].TaskContext=Context;
+  return(ReturnValue);
+}
+
+
+/*
+  Description
+  Register multiple instances of the same task function, e.g. one for each channel of a sensor. Each instance is a
+  regular task with its own inbound queue (keep QueueSize small to save message slots) and its own element of the array
+  of contexts as TaskContext. The instances are named "<Name>#<instance>" and get consecutive task IDs, starting with
+  TISM_GetTaskID("<Name>#0"). Either all instances are registered, or none.
+
+  Parameters:
+  int *Function           - Pointer to the function for the instances; function returns int and takes no variables.
+  char *Name              - Pointer to text buffer with the base name of the instances.
+  int TaskDefaultPriority - Priority for the instances (PRIORITY_HIGH, PRIORITY_NORMAL, PRIORITY_LOW or other value in msec).
+  uint16_t QueueSize      - Number of messages the inbound queue of each instance can hold.
+  void *Contexts          - Pointer to an array with the data of the instances (may be NULL).
+  size_t ContextSize      - Size of one element of the array (e.g. sizeof(struct SensorChannel)).
+  uint8_t NumberOfInstances - Number of instances to register.
+
+  Return value:
+  ERR_TOO_MANY_TASKS      - Not enough room for all instances (MAX_TASKS).
+  ERR_QUEUE_ALLOCATION    - Not enough free slots in the message pool for the inbound queues.
+  OK                      - Succes
+*/
+int TISM_RegisterTaskInstances(uint8_t (*Function)(TISM_Task *), char *Name, uint32_t TaskPriority, uint16_t QueueSize, void *Contexts, size_t ContextSize, uint8_t NumberOfInstances)
+{
+  if(System.NumberOfTasks+NumberOfInstances>MAX_TASKS)
+  {
+    fprintf(STDERR, "TISM_RegisterTaskInstances: too many tasks to register (maximum: %d) while attempting to register %d instances of %s.\n", MAX_TASKS, NumberOfInstances, Name);
+    return(ERR_TOO_MANY_TASKS);
+  }
+  if((uint32_t)(QueueSize+1)*NumberOfInstances>MESSAGE_POOL_SIZE-MessagePoolSlotsUsed)
+  {
+    fprintf(STDERR, "TISM_RegisterTaskInstances: can't allocate %d inbound queues of %d messages for %s (%d of %d slots in use).\n", NumberOfInstances, QueueSize, Name, MessagePoolSlotsUsed, MESSAGE_POOL_SIZE);
+    return(ERR_QUEUE_ALLOCATION);
+  }
+  char InstanceName[MAX_TASK_NAME_LENGTH+1];
+  for(uint8_t Instance=0;Instance<NumberOfInstances;Instance++)
+  {
+    snprintf(InstanceName, sizeof(InstanceName), "%.*s#%d", MAX_TASK_NAME_LENGTH-4, Name, Instance);
+    int ReturnValue=TISM_RegisterTaskWithContext(Function, InstanceName, TaskPriority, QueueSize, (Contexts==NULL?NULL:(uint8_t *)Contexts+(Instance*ContextSize)));
+    if(ReturnValue!=OK)
+      return(ReturnValue);
+  }
+  return(OK);
+}
+
+
+// Task functions of tasks using the by-value API, registered via TISM_RegisterTaskByValue.
+uint8_t (*TISM_TaskFunctionByValue[MAX_TASKS])(TISM_Task);
+
+
+// Internal function - run a task using the by-value API; it receives a copy of its task struct.
+uint8_t TISM_RunTaskByValue(TISM_Task *ThisTask)
+{
+  return((*TISM_TaskFunctionByValue[ThisTask->TaskID])(*ThisTask));
+}
+
+
+/*
+  Description
+  Compatibility for tasks that take their task struct by value (uint8_t Task(TISM_Task ThisTask)). Register the task
+  in the global System struct; the scheduler runs it with a copy of its task struct. Changes the task makes to this
+  copy are lost, like before. TISM_RegisterTask calls this function automatically for these tasks (see TISM.h).
+
+  Parameters:
+  int *Function           - Pointer to the function for this task; function returns int and takes a TISM_Task struct.
+  char *Name              - Pointer to text buffer with name of this process.
+  int TaskDefaultPriority - Priority for this task (PRIORITY_HIGH, PRIORITY_NORMAL, PRIORITY_LOW or other value in msec).
+  uint16_t QueueSize      - Number of messages the inbound queue of this task can hold.
+
+  Return value:
+  ERR_TOO_MANY_TASKS      - Attempt was made to register > MAX_TASKS.
+  ERR_QUEUE_ALLOCATION    - Not enough free slots in the message pool for the inbound queue.
+  OK                      - Succes
+*/
+int TISM_RegisterTaskByValueWithQueueSize(uint8_t (*Function)(TISM_Task), char *Name, uint32_t TaskPriority, uint16_t QueueSize)
+{
+  uint8_t TaskID=System.NumberOfTasks;
+  int ReturnValue=TISM_RegisterTaskWithQueueSize(&TISM_RunTaskByValue, Name, TaskPriority, QueueSize);
+  if(ReturnValue==OK)
+    TISM_TaskFunctionByValue[TaskID]=Function;
+  return(ReturnValue);
+}
+
+
+// Register a task using the by-value API, with an inbound queue of the default size (QUEUE_SIZE_DEFAULT).
+int TISM_RegisterTaskByValue(uint8_t (*Function)(TISM_Task), char *Name, uint32_t TaskPriority)
+{
+  return(TISM_RegisterTaskByValueWithQueueSize(Function, Name, TaskPriority, QUEUE_SIZE_DEFAULT));
+}
+
+
 /*
   Description
   Initialize the global System-struct by providing default values. Furthermore, register the standard TISM tasks.
@@ -156,43 +317,71 @@ int TISM_InitializeSystem()
   gpio_init(SYSTEM_READY_PORT);
   gpio_set_dir(SYSTEM_READY_PORT, GPIO_OUT);
   gpio_put(SYSTEM_READY_PORT, 0);
-  sleep_ms(STARTUP_DELAY);    // Add some sleep to allow USB comms to initialize.
+
+  // Wait for a host to open the USB serial port, so the first log entries aren't lost. Don't wait longer than
+  // STARTUP_USB_TIMEOUT and not at all after a reset by the watchdog; the system should resume control right away.
+#if LIB_PICO_STDIO_USB
+  uint64_t USBTimeout=time_us_64()+(STARTUP_USB_TIMEOUT*1000);
+  while(STARTUP_WAIT_FOR_USB && !watchdog_caused_reboot() && !stdio_usb_connected() && (time_us_64()<USBTimeout))
+    sleep_ms(1);
+#endif
 
   // Initialize the TISM-system. Provide variables default values where possible and register the TISM system tasks.
   System.State=INIT;
+  MessagePoolSlotsUsed=0;
   for(int counter=0;counter<MAX_CORES;counter++)
   {
     // Uneven core numbers start at 0 and run the queue upwards; even cores start at the last task and run downwards.
     System.RunPointer[counter]=255;            // 255 shows this pointer isn´t used yet; 0 is also a valid task number.
     System.RunPointerDirection[counter]=(counter%2==0?QUEUE_RUN_ASCENDING:QUEUE_RUN_DESCENDING);
+#if OUTBOUND_QUEUES_IN_SCRATCH
+    OutboundMessageQueue[counter].Message=(counter==CORE0?OutboundMessageSlotsCore0:OutboundMessageSlotsCore1);
+    OutboundMessageQueue[counter].Size=QUEUE_SIZE_OUTBOUND+1;
+#else
+    if(!TISM_CircularBufferAllocate (&(OutboundMessageQueue[counter]), QUEUE_SIZE_OUTBOUND))
+      return(ERR_INITIALIZING);
+#endif
     TISM_CircularBufferInit (&(OutboundMessageQueue[counter]));
   }
   System.NumberOfTasks=0;
-  TISM_CircularBufferInit (&IRQHandlerInboundQueue); 
+  System.PostmanDeliveryLock=spin_lock_instance(spin_lock_claim_unused(true));
+  TISM_SchedulerInit();
+  TISM_SoftwareTimerInitPrecision();
+  TISM_EventLoggerInit();
+  TISM_IRQHandlerInit();
+  TISM_BufferPoolInit();
+  TISM_StreamInit();
+  TISM_TraceInit();
 	                           
   // Now register the standard TISM_processes.
-  if ((TISM_RegisterTask(NULL, "TISM_Scheduler", PRIORITY_LOW)+                           // Dummy entry for the scheduler
-       TISM_RegisterTask(&TISM_EventLogger, "TISM_EventLogger", PRIORITY_LOW)+
+  if ((TISM_RegisterTaskWithQueueSize(NULL, "TISM_Scheduler", PRIORITY_LOW, 0)+           // Dummy entry for the scheduler; receives no messages
+       TISM_RegisterTaskWithQueueSize(&TISM_EventLogger, "TISM_EventLogger", PRIORITY_LOW, QUEUE_SIZE_EVENTLOGGER)+
        TISM_RegisterTask(&TISM_Postman, "TISM_Postman", PRIORITY_LOW)+
        TISM_RegisterTask(&TISM_IRQHandler, "TISM_IRQHandler", PRIORITY_LOW)+
-       TISM_RegisterTask(&TISM_Watchdog, "TISM_Watchdog", PRIORITY_LOW)+
-       TISM_RegisterTask(&TISM_TaskManager, "TISM_TaskManager", PRIORITY_LOW)+
-       TISM_RegisterTask(&TISM_SoftwareTimer, "TISM_SoftwareTimer", PRIORITY_HIGH))!=0)
+       TISM_RegisterTaskWithQueueSize(&TISM_Watchdog, "TISM_Watchdog", PRIORITY_LOW, QUEUE_SIZE_WATCHDOG)+
+       TISM_RegisterTaskWithQueueSize(&TISM_TaskManager, "TISM_TaskManager", PRIORITY_LOW, QUEUE_SIZE_TASKMANAGER)+
+       TISM_RegisterTaskWithQueueSize(&TISM_SoftwareTimer, "TISM_SoftwareTimer", PRIORITY_HIGH, QUEUE_SIZE_SOFTWARETIMER))!=0)
   {
     // Some error during setting up ITSM system tasks
     return(ERR_INITIALIZING);
   }
-  else
-  {
-    // Collect the Task IDs for the system tasks.
-    System.TISM_PostmanTaskID=TISM_GetTaskID("TISM_Postman");
-    System.TISM_IRQHandlerTaskID=TISM_GetTaskID("TISM_IRQHandler");
-    System.TISM_TaskManagerTaskID=TISM_GetTaskID("TISM_TaskManager");
-    System.TISM_WatchdogTaskID=TISM_GetTaskID("TISM_Watchdog");
-    System.TISM_EventLoggerTaskID=TISM_GetTaskID("TISM_EventLogger");
-    System.TISM_SoftwareTimerTaskID=TISM_GetTaskID("TISM_SoftwareTimer");
-    return(OK);
-  }
+
+  // The Task IDs for the system tasks are fixed (see TISM.h); these variables remain for existing tasks.
+  System.TISM_PostmanTaskID=TISM_POSTMAN_TASK_ID;
+  System.TISM_IRQHandlerTaskID=TISM_IRQHANDLER_TASK_ID;
+  System.TISM_TaskManagerTaskID=TISM_TASKMANAGER_TASK_ID;
+  System.TISM_WatchdogTaskID=TISM_WATCHDOG_TASK_ID;
+  System.TISM_EventLoggerTaskID=TISM_EVENTLOGGER_TASK_ID;
+  System.TISM_SoftwareTimerTaskID=TISM_SOFTWARETIMER_TASK_ID;
+
+#ifdef TISM_TASK_TABLE
+  // Install the static task table (see TISM.h); task IDs follow the system tasks in the order of the table.
+  #define TISM_TASK_TABLE_REGISTER(Name, Priority, QueueSize) +TISM_RegisterTaskWithQueueSize(&Name, #Name, Priority, QueueSize)
+  if((0 TISM_TASK_TABLE(TISM_TASK_TABLE_REGISTER))!=0)
+    return(ERR_INITIALIZING);
+  #undef TISM_TASK_TABLE_REGISTER
+#endif
+  return(OK);
 }
     
 
@@ -12,6 +12,7 @@
 #define TISM
 
 #include <stdbool.h>
+#include "hardware/sync.h"
 
 /*
 
@@ -29,29 +30,91 @@
 #define QUEUE_RUN_DESCENDING     -1      // Run the process queue from <NumberOfTasks> downwards.
 #define CORE0                    0
 #define CORE1                    1                       
-#define MAX_TASKS                30      // Maximum number of TISM tasks. Maximum value = 250.
+#define CORE_ANY                 2       // Task affinity; task can run on either core. Tasks pinned to CORE1 only run when TISM_Scheduler runs on CORE1.
+#define MAX_TASKS                64      // Maximum number of TISM tasks, including task instances (see TISM_RegisterTaskInstances). Maximum value = 250.
+                                         // The message pool (MESSAGE_POOL_SIZE) has room for MAX_TASKS tasks with the default queue size; larger queues leave room for fewer tasks.
 #define MAX_TASK_NAME_LENGTH     30      // Maximum length of the name of a task
 #define DEBUG_HIGH               2       // Debug levels
 #define DEBUG_LOW                1
 #define DEBUG_NONE               0
-#define STARTUP_DELAY            5000    // Milliseconds - Delay, wait for things to settle down before we start.
+#define STARTUP_DELAY            0       // Milliseconds - Delay between the initialization of the tasks and their first run.
+#define STARTUP_WAIT_FOR_USB     true    // Wait until a host opens the USB serial port (CDC) before initializing the tasks, so the first log entries aren't lost. Not after a reset by the watchdog.
+#define STARTUP_USB_TIMEOUT      250     // Milliseconds - Maximum time to wait for the USB serial port; the system starts without it.
+#define SHUTDOWN_DELAY           1000    // Milliseconds - Delay after the system went down, to allow the last output to be written.
 #define PRIORITY_HIGH            50000   // Microseconds - High priority task; time after which task should be restarted. Lower = higher prio.
 #define PRIORITY_NORMAL          100000  // Microseconds - Normal priority task; time after which task should be restarted. Lower = higher prio.
 #define PRIORITY_LOW             500000  // Microseconds - Low priority task; time after which task should be restarted. Lower = higher prio.
 #define SYSTEM_READY_PORT        25      // Use this GPIO to indicate that system is ready and running. 'High' means system is ready. Default value=25 (onboard LED).
 
+// Task IDs of the TISM system tasks. TISM_InitializeSystem registers these first, in this order.
+#define TISM_SCHEDULER_TASK_ID   0       // Dummy entry for the scheduler.
+#define TISM_EVENTLOGGER_TASK_ID 1
+#define TISM_POSTMAN_TASK_ID     2
+#define TISM_IRQHANDLER_TASK_ID  3
+#define TISM_WATCHDOG_TASK_ID    4
+#define TISM_TASKMANAGER_TASK_ID 5
+#define TISM_SOFTWARETIMER_TASK_ID 6
+#define TISM_NUMBER_OF_SYSTEM_TASKS 7
+
 // System and task states
 #define DOWN                     0       
 #define STOP                     1
 #define RUN                      2
 #define INIT                     3
 
+// Definitions for the scheduler
+#define SCHEDULER_PRIORITY_CLASSES 3     // PRIORITY_HIGH, PRIORITY_NORMAL and PRIORITY_LOW (and lower).
+#define SCHEDULER_MASK_WORDS     ((MAX_TASKS+31)/32) // Number of 32 bit words in the bitmap of ready tasks.
+#define SCHEDULER_IDLE_SLEEP     true    // Let a core sleep (WFE) when no task is ready, until the next wake-up time, an interrupt or an event from the other core.
+#define SCHEDULER_IDLE_MIN_USEC  50      // Microseconds - Don't go to sleep when the next task is due within this time.
+#define SCHEDULER_IDLE_MAX_USEC  100000  // Microseconds - Maximum time a core sleeps before checking the task list again.
+#define SCHEDULER_EDF            false   // Always run the ready task with the earliest deadline (wake-up time + TaskDeadline), instead of cycling through the priority classes.
+#define SCHEDULER_STATISTICS     true    // Keep run statistics per task and per core (runs, run time, lateness, missed periods).
+#define SCHEDULER_STATISTICS_INTERVAL 0  // Milliseconds - Interval at which TISM_TaskManager logs the statistics of all tasks. 0 = only on request.
+#define SCHEDULER_PARALLEL_INIT  false   // Both cores initialize the user tasks (INIT state), each claiming the next task in order of task ID. Only for tasks that don't depend on each other's initialization.
+#define SCHEDULER_CODE_IN_RAM    true    // Run the scheduler, the messaging functions and the interrupt callbacks from RAM instead of flash (XIP cache), see TISM_IN_RAM.
+
 // Definitions for the software timer
 #define TISM_CANCEL_TIMER        0
 #define TISM_SET_TIMER           1
+#define MAX_SOFTWARE_TIMERS      256     // Maximum number of software timers that can be active at the same time.
+#define MAX_PRECISION_TIMERS     12      // Maximum number of precision timers; these use the alarm pool of the SDK (16 alarms, see
+                                         // PICO_TIME_DEFAULT_ALARM_POOL_MAX_TIMERS). The rest is left for the SDK and the application.
+#define PRECISION_TIMER_RETRY_USEC 100   // Microseconds - Retry interval when a precision timer can't deliver its message (inbound queue full).
+#define TISM_TIMER_PRECISION_MSEC 0      // Regular software timer, interval in milliseconds, handled by TISM_SoftwareTimer.
+#define TISM_TIMER_PRECISION_USEC 1      // Precision timer, interval in microseconds, handled by the hardware alarm.
 
 // Definitions used for TISM event logging.
-#define EVENT_LOG_ENTRY_LENGTH   150     // Maximum text length of a single entry in the log. MAX_MESSAGES determines the number of entries in the circular buffer.
+#define EVENT_LOG_ENTRY_LENGTH   150     // Maximum text length of a single entry in the log.
+#define EVENT_LOG_POOL_SIZE      64      // Number of log entries that can be pending (not yet written by TISM_EventLogger) at the same time. Max. 255.
+#define EVENT_LOG_MAX_ARGUMENTS  12      // Maximum number of arguments of a log entry with deferred formatting.
+#define EVENT_LOG_DEFERRED_FORMAT true   // Store the format string and arguments; TISM_EventLogger formats the text instead of the logging task.
+#define EVENT_LOG_SINK_STDIO     0       // Output buffer is written to STDOUT, one chunk per run of TISM_EventLogger.
+#define EVENT_LOG_SINK_UART_DMA  1       // Output buffer is sent to EVENT_LOG_UART by DMA.
+#define EVENT_LOG_DROP_NEW       0       // Output buffer full: drop the new line.
+#define EVENT_LOG_DROP_OLDEST    1       // Output buffer full: drop the oldest lines that haven't been written yet.
+#define EVENT_LOG_OUTPUT_BUFFER  4096    // Bytes - Size of the output buffer of TISM_EventLogger. 0 = write each line to STDOUT/STDERR right away (blocking).
+#define EVENT_LOG_OUTPUT_SINK    EVENT_LOG_SINK_STDIO // Where the output buffer is written to.
+#define EVENT_LOG_OUTPUT_OVERFLOW EVENT_LOG_DROP_NEW  // What to do when the output buffer is full. Dropped lines are counted and reported.
+#define EVENT_LOG_OUTPUT_CHUNK   256     // Bytes - Maximum part of the output buffer written at once. At least the length of a log line.
+#define EVENT_LOG_OUTPUT_INTERVAL 2000   // Microseconds - Interval at which TISM_EventLogger writes the next chunk while output is pending.
+#define EVENT_LOG_UART           uart1   // EVENT_LOG_SINK_UART_DMA: UART, TX pin and baud rate to use.
+#define EVENT_LOG_UART_TX_PIN    4
+#define EVENT_LOG_UART_BAUDRATE  115200
+
+// Definitions for the trace recorder (see TISM_Trace.c). Argument per type of event:
+#define TRACE_ENABLED            false   // Record the runs of tasks, messages, interrupts and timers in a ring buffer in RAM; dump with TISM_DUMP_TRACE.
+#define TRACE_BUFFER_SIZE        2048    // Number of records in the ring buffer, 8 bytes each. The oldest records are overwritten. Max. 65535.
+#define TRACE_CORE_SHIFT         7       // The core is stored in the highest bit of the event.
+#define TRACE_TASK_START         1       // Core starts a run of the task. Argument: 0.
+#define TRACE_TASK_END           2       // Run of the task completed. Argument: return value of the task.
+#define TRACE_CORE_IDLE          3       // Core goes to sleep (TaskID 0). Argument: 0.
+#define TRACE_CORE_WAKE          4       // Core wakes up again (TaskID 0). Argument: 0.
+#define TRACE_MESSAGE_SENT       5       // Task sent a message. Argument: recipient ID<<8 | message type.
+#define TRACE_MESSAGE_DELIVERED  6       // Message delivered in the inbound queue of the task. Argument: sender ID<<8 | message type.
+#define TRACE_IRQ                7       // Interrupt taken (TaskID TISM_IRQHANDLER_TASK_ID). Argument: GPIO<<8 | events.
+#define TRACE_TIMER_FIRED        8       // Timer of the task expired. Argument: timer precision<<8 | timer ID.
+#define TRACE_STREAM_BLOCK       9       // Block of a stream filled by DMA (TaskID of the subscriber). Argument: stream ID<<8 | buffer ID (255 = dropped).
 
 // Error messages; these are between 0 and 49
 #define OK                       0
@@ -63,9 +126,31 @@
 #define ERR_TASK_SLEEPING        6       // Task to assign something to is not running (sleeping)
 #define ERR_RUNNING_TASK         7       // Error occured when executing a task, or task returned an error
 #define ERR_INVALID_OPERATION    8       // Invalid operation requested
+#define ERR_QUEUE_ALLOCATION     9       // Not enough free slots in the message pool for the requested queue
 
 // Definitions used for TISM_messaging. Currently a maximum number of 255 message types are allowed.
-#define MAX_MESSAGES             150     // Length of the message queues (circular buffers). Max value is 65535 (16 bits). Extensive logging requires sufficient queue size.
+#define MAX_MESSAGES             150     // Maximum number of messages processed by a task in a single run.
+#define MESSAGE_POOL_SYSTEM_SLOTS ((OUTBOUND_QUEUES_IN_SCRATCH?0:MAX_CORES*(QUEUE_SIZE_OUTBOUND+1))+(QUEUE_SIZE_EVENTLOGGER+1)+(QUEUE_SIZE_TASKMANAGER+1)+(QUEUE_SIZE_SOFTWARETIMER+1)+(QUEUE_SIZE_WATCHDOG+1)+2*(QUEUE_SIZE_DEFAULT+1)+1) // Slots used by the queues of the system tasks and the outbound queues.
+#define MESSAGE_POOL_SIZE        (MESSAGE_POOL_SYSTEM_SLOTS+(MAX_TASKS-TISM_NUMBER_OF_SYSTEM_TASKS)*(QUEUE_SIZE_DEFAULT+1)) // Total number of message slots shared by all message queues (circular buffers). Each slot takes 24 bytes of RAM.
+#define QUEUE_SIZE_DEFAULT       16      // Default number of messages the inbound queue of a task can hold (see TISM_RegisterTaskWithQueueSize).
+#define QUEUE_SIZE_OUTBOUND      150     // Number of messages the outbound queue of each core can hold.
+#define OUTBOUND_QUEUES_IN_SCRATCH false // Put the outbound queue of core 0 in SCRATCH_Y and of core 1 in SCRATCH_X, next to the stack of the core, instead of the message pool. Requires QUEUE_SIZE_OUTBOUND<=84.
+#define QUEUE_SIZE_EVENTLOGGER   150     // Inbound queue of TISM_EventLogger. Extensive logging requires sufficient queue size.
+#define QUEUE_SIZE_TASKMANAGER   (2*MAX_TASKS) // Inbound queue of TISM_TaskManager; receives the sleep requests of all tasks and the wake requests of TISM_Postman. Min. 2*MAX_TASKS.
+#define QUEUE_SIZE_WATCHDOG      (2*MAX_TASKS) // Inbound queue of TISM_Watchdog; receives the ECHO replies of all tasks it pings. Min. 2*MAX_TASKS.
+#define QUEUE_SIZE_SOFTWARETIMER 64      // Inbound queue of TISM_SoftwareTimer; receives the set/cancel requests of all tasks.
+#define POSTMAN_DIRECT_DELIVERY  true    // Write messages straight into the inbound queue of the recipient when possible, skipping TISM_Postman and TISM_TaskManager.
+#define POSTMAN_NOTIFY_DROPS     false   // Send TISM_MESSAGE_DROPPED to the sender when TISM_Postman can't deliver a message (inbound queue of the recipient full).
+#define POSTMAN_DROP_REPORT_INTERVAL 1000000 // Microseconds - Minimum interval between the log entries of TISM_Postman about messages it couldn't deliver.
+#define MAX_TOPICS               32      // Number of topics tasks can publish to and subscribe to (see TISM_PostmanPublish). Max. 255.
+#define TOPIC_MASK_WORDS         ((MAX_TASKS+31)/32) // Number of 32 bit words in the bitmap of subscribers of a topic.
+#define TISM_NO_TOPIC            255     // Topic of messages that were not published.
+#define TISM_TOPIC_RECIPIENT     255     // RecipientTaskID of published messages in the outbound queue; TISM_Postman delivers them to the subscribers.
+#define TISM_ANY_MESSAGE         -1      // Wait for a message of any type (see TISM_PostmanWaitForMessage).
+#define TISM_NOT_WAITING         -2      // Task isn't waiting for a message.
+#define TISM_WAIT_FOREVER        0       // Timeout of TISM_PostmanWaitForMessage; sleep until the message arrives.
+#define BUFFER_POOL_BLOCKS       16      // Number of buffers in the buffer pool (see TISM_BufferPool.c). Max. 254.
+#define BUFFER_POOL_BLOCK_SIZE   256     // Bytes - Size of each buffer in the buffer pool.
 
 // Standard message types used in the TISM messaging system; TISM system message type values are between 50 and 99.
 #define TISM_TEST                50      // Dummy message.
@@ -73,6 +158,8 @@
 #define TISM_ECHO                52      // Response to ping-request.
 #define TISM_LOG_EVENT_NOTIFY    53      // Log entry of type 'notification'
 #define TISM_LOG_EVENT_ERROR     54      // Log entry of type 'error'
+#define TISM_MESSAGE_DROPPED     66      // Message could not be delivered (POSTMAN_NOTIFY_DROPS); Message=recipient ID, Specification=message type.
+#define TISM_BUFFER              67      // Message refers to a buffer of the buffer pool; Message=buffer ID, Specification is free to use.
 
 // Message types for altering the state of the system or specific tasks
 #define TISM_SET_SYS_STATE       55      // Change the state of the whole system (aka runlevel).
@@ -83,6 +170,12 @@
 #define TISM_SET_TASK_DEBUG      60      // Set the debug level of a specific task   
 #define TISM_WAKE_ALL_TASKS      61      // Wake all tasks.
 #define TISM_DEDICATE_TO_TASK    62      // Dedicate the whole system to a specific task - use with caution.
+#define TISM_SET_TASK_AFFINITY   63      // Set the core a specific task runs on (CORE0, CORE1 or CORE_ANY).
+#define TISM_LOG_STATISTICS      64      // Log the run statistics of a specific task (or all tasks) via the EventLogger.
+#define TISM_RESET_STATISTICS    65      // Reset the run statistics of a specific task (or all tasks).
+#define TISM_SET_TASK_DEADLINE   68      // Set the relative deadline of a specific task (usec after its wake-up time; 0 = its period).
+#define TISM_SET_TASK_TIMEOUT    69      // Set the heartbeat timeout of a specific task (usec; 0 = WATCHDOG_TASK_TIMEOUT). Tasks with a timeout are critical.
+#define TISM_DUMP_TRACE          70      // Dump the trace (see TISM_Trace.c) to STDOUT.
 
 // GPIO numbers of the Raspberry Pi Pico, mostly used by TISM_IRQHandler.c
 #define NUMBER_OF_GPIO_PORTS     29      // Number of GPIOs on the GP2040.
@@ -116,10 +209,21 @@
 #define GPIO_27                  27
 #define GPIO_28                  28
 #define IRQ_UNSUBSCRIBE          0       // Unsubscribe from IRQ events for the specified GPIO
+#define MAX_IRQ_SUBSCRIPTIONS    32      // Maximum number of subscriptions (task and GPIO combinations) to IRQ events. Maximum value = 32.
+
+// Definitions for TISM_Stream.c
+#define STREAM_ENABLED           false   // Capture ADC samples or PIO RX FIFO data by DMA into buffers of the buffer pool (see TISM_Stream.c). Needs hardware_adc, hardware_dma and hardware_pio.
+#define MAX_STREAMS              4       // Number of streams that can be active at the same time; each stream claims two DMA channels. Only one stream can use the ADC.
+#define STREAM_DMA_IRQ_INDEX     1       // DMA interrupt used for the completed blocks of the streams (0 = DMA_IRQ_0, 1 = DMA_IRQ_1).
+#define STREAM_ADC_TEMPERATURE   4       // ADC input of the internal temperature sensor.
 
 // Definitions for TISM_Watchdog.c
 #define WATCHDOG_CHECK_INTERVAL 30000000 // Microseconds - Interval between 'are you alive' checks
-#define WATCHDOG_TASK_TIMEOUT   5000000  // Microseconds - Timeout period before we expect a task replies to a PING message.
+#define WATCHDOG_TASK_TIMEOUT   5000000  // Microseconds - Timeout period before we expect a task replies to a PING message. Also the default heartbeat timeout.
+#define WATCHDOG_HEARTBEAT      false    // Check the time each task last completed a run (heartbeat) instead of sending PING messages.
+#define WATCHDOG_HEARTBEAT_INTERVAL 100000 // Microseconds - Interval between heartbeat checks.
+#define WATCHDOG_HARDWARE       false    // Heartbeat mode only: feed the hardware watchdog while all critical tasks are healthy. If not, the RP2040 resets.
+#define WATCHDOG_HARDWARE_TIMEOUT 2000   // Milliseconds - Timeout of the hardware watchdog (max. 8388).
 #define WATCHDOG_MAX_COUNTER    50000    // Max. size of the counter of outbound messages - if reached, reset counter to 0.
 
 
@@ -130,16 +234,48 @@
 */
 
 // Structure containing all TISM tasks data - the tasks running within the system.
+// The fields the scheduler, TISM_Postman and the other core read for every task (wake-up timer, period, state, sleep
+// state, affinity and the function) come first and take 28 bytes; on the Cortex-M0+ these are all within reach of a
+// single load instruction relative to the task (byte offsets below 32). The name and the queue pointers come last.
 typedef struct TISM_Task
 {  
-  uint8_t TaskID, RunningOnCoreID, TaskState, TaskDebug, (*TaskFunction) (struct TISM_Task);
-  uint32_t TaskPriority;
-  bool TaskSleeping;
-  char TaskName[MAX_TASK_NAME_LENGTH+1];
+  uint64_t TaskWakeUpTimer;
+  uint32_t TaskPriority;                                                          // Period of the task; usec between each run.
+  uint32_t TaskDeadline;                                                          // Relative deadline; usec after the wake-up time. 0 = same as the period.
+  uint8_t TaskID, RunningOnCoreID, TaskState, TaskAffinity;
+  bool TaskSleeping, TaskIsSystemTask;
+  uint8_t TaskDebug, (*TaskFunction) (struct TISM_Task *);
+
+  // Cold data; not used for scheduling.
+  uint32_t TaskTimeout;                                                           // Heartbeat timeout (see TISM_Watchdog). 0 = WATCHDOG_TASK_TIMEOUT, not critical.
+  int16_t TaskWaitForMessage;                                                     // Message type the task waits for (see TISM_PostmanWaitForMessage), TISM_ANY_MESSAGE or TISM_NOT_WAITING.
+  uint16_t TaskResumePoint;                                                       // Where the coroutine of the task resumes (see TISM_COROUTINE_BEGIN); 0 = at the start.
   struct TISM_CircularBuffer *InboundMessageQueue;                                // Inbound queue for each task. 
   struct TISM_CircularBuffer *OutboundMessageQueue;                               // Pointer to outbound queue - depending on the core the task is running on.
-  uint64_t TaskWakeUpTimer;
+  void *TaskContext;                                                              // Data of this task or task instance (see TISM_RegisterTaskWithContext); NULL if not used.
+  char TaskName[MAX_TASK_NAME_LENGTH+1];
 } TISM_Task;
+_Static_assert(__builtin_offsetof(TISM_Task, TaskSleeping)<32, "TISM_Task: scheduling fields must stay at the start of the struct.");
+
+
+// Run statistics of a task, kept by TISM_Scheduler when SCHEDULER_STATISTICS is enabled. All times in microseconds.
+// Lateness is the time between the wake-up time of a task and the actual start; it is only known for the runs started
+// by the run loop (ScheduledRuns), not for the runs of system tasks started in between. A missed period is a run of the
+// task that was skipped because it started (or finished) too late. A deadline miss is a scheduled run that finished after
+// its deadline (wake-up time + TaskDeadline).
+typedef struct TISM_TaskStatistics
+{
+  uint32_t Runs, ScheduledRuns, MissedPeriods, DeadlineMisses, MaxRunTime, MaxLateness;
+  uint64_t TotalRunTime, TotalLateness;
+} TISM_TaskStatistics;
+
+
+// Run statistics of a core; BusyTime is the time spent in tasks, IdleTime the time spent sleeping (SCHEDULER_IDLE_SLEEP).
+typedef struct TISM_CoreStatistics
+{
+  uint32_t Runs;
+  uint64_t BusyTime, IdleTime;
+} TISM_CoreStatistics;
 
 
 // Structure of the TISM-system - the system itself. This is a global variable.
@@ -154,6 +290,17 @@ typedef struct TISM_System
   // Task IDs for TISM system tasks; used for sending messages to system tasks.
   uint8_t TISM_PostmanTaskID, TISM_IRQHandlerTaskID, TISM_TaskManagerTaskID, TISM_WatchdogTaskID, TISM_SoftwareTimerTaskID, TISM_EventLoggerTaskID;
 
+  // Spinlock making direct delivery of a message plus the wake-up of the recipient atomic towards sleep requests.
+  spin_lock_t *PostmanDeliveryLock;
+
+  // Run statistics per task and per core, collected since StatisticsTimestamp. Written by TISM_Scheduler only.
+  TISM_TaskStatistics TaskStatistics[MAX_TASKS];
+  TISM_CoreStatistics CoreStatistics[MAX_CORES];
+  uint64_t StatisticsTimestamp;
+
+  // Time each task last completed a run (heartbeat); written by TISM_Scheduler, checked by TISM_Watchdog.
+  uint64_t TaskLastRun[MAX_TASKS];
+
   // Debug related variables.
   uint8_t SystemDebug;
 } TISM_System;
@@ -161,21 +308,91 @@ TISM_System System;
 
 
 // Structures for a TISM messaging system using circular buffers (aka ringbuffer).
+// Topic is the topic the message was published to (TISM_NO_TOPIC when it was sent to the recipient directly).
 typedef struct TISM_Message
 {
-  uint8_t SenderTaskID, RecipientTaskID, MessageType;
+  uint8_t SenderTaskID, RecipientTaskID, MessageType, Topic;
   uint32_t Message, Specification; 
   uint64_t MessageTimestamp;                                                 
 } TISM_Message;
 
 
+// Buffer of the buffer pool (see TISM_BufferPool.c); Length is the number of bytes in use, set by the owner.
+typedef struct TISM_Buffer
+{
+  uint16_t Length;
+  uint8_t References;
+  uint8_t Data[BUFFER_POOL_BLOCK_SIZE] __attribute__((aligned(4)));   // Word aligned, for DMA and 16/32 bit samples.
+} TISM_Buffer;
+
+
+// Record of the trace (see TISM_Trace.c); 8 bytes. Event holds the type of event and the core it occurred on.
+typedef struct TISM_TraceEntry
+{
+  uint32_t TimestampDelta;
+  uint8_t Event, TaskID;
+  uint16_t Argument;
+} TISM_TraceEntry;
+
+
 // Structure of a circular buffer. One for interrupt handling, one inbound queue per task, one outbound queue per core (=scheduler instance). These are global variables.
+// The slots of all buffers are taken from the shared MessagePool; Size is the number of slots of this buffer.
+// Head is only written by the producer(s), Tail only by the consumer. ProducerLock is NULL for buffers with a single producer.
+// HighWaterMark, Enqueued and Dropped are statistics maintained by the producer(s); Dropped counts the writes rejected as the buffer was full.
 typedef struct TISM_CircularBuffer
 {
-  struct TISM_Message Message[MAX_MESSAGES];
-  uint16_t Head, Tail;
+  struct TISM_Message *Message;
+  uint16_t Size, HighWaterMark;
+  volatile uint16_t Head, Tail;
+  uint32_t Enqueued, Dropped;
+  spin_lock_t *ProducerLock;
 } TISM_CircularBuffer;
-TISM_CircularBuffer IRQHandlerInboundQueue, InboundMessageQueue[MAX_TASKS], OutboundMessageQueue[MAX_CORES];
+TISM_CircularBuffer InboundMessageQueue[MAX_TASKS], OutboundMessageQueue[MAX_CORES];
+// TISM_TaskManager and TISM_Watchdog receive a message from every task; their queues must be able to hold these.
+_Static_assert((QUEUE_SIZE_TASKMANAGER>=2*MAX_TASKS) && (QUEUE_SIZE_WATCHDOG>=2*MAX_TASKS), "QUEUE_SIZE_TASKMANAGER and QUEUE_SIZE_WATCHDOG must be at least 2*MAX_TASKS.");
+TISM_Message MessagePool[MESSAGE_POOL_SIZE];
+uint16_t MessagePoolSlotsUsed;
+
+// Slots of the outbound queues in the scratch banks (OUTBOUND_QUEUES_IN_SCRATCH). Each bank is 4 KB and also holds the
+// stack of its core (2 KB by default); both cores then write their outbound queue without contending for the same bank.
+#if OUTBOUND_QUEUES_IN_SCRATCH
+_Static_assert((QUEUE_SIZE_OUTBOUND+1)*sizeof(TISM_Message)<=2048, "OUTBOUND_QUEUES_IN_SCRATCH: QUEUE_SIZE_OUTBOUND too large for the scratch banks.");
+TISM_Message __scratch_y("TISM_OutboundMessageQueue") OutboundMessageSlotsCore0[QUEUE_SIZE_OUTBOUND+1];
+TISM_Message __scratch_x("TISM_OutboundMessageQueue") OutboundMessageSlotsCore1[QUEUE_SIZE_OUTBOUND+1];
+#endif
+
+// The hot paths (the scheduler loop, the circular buffers, delivery from interrupt handlers) are placed in RAM with
+// TISM_IN_RAM(FunctionName) in their definition, so they don't depend on the XIP cache shared with the application code.
+#if SCHEDULER_CODE_IN_RAM
+#define TISM_IN_RAM(Function)    __not_in_flash_func(Function)
+#else
+#define TISM_IN_RAM(Function)    Function
+#endif
+
+
+/*
+
+  Optional static task table. Define TISM_TASK_TABLE before including TISM.h to declare the user tasks at build time,
+  instead of registering them with TISM_RegisterTask:
+
+    #define TISM_TASK_TABLE(TASK) \
+            TASK(ExampleTask1, PRIORITY_NORMAL, QUEUE_SIZE_DEFAULT) \
+            TASK(ExampleTask2, PRIORITY_HIGH, 32)
+
+  Each entry specifies the task function (also used as task name), its priority and the size of its inbound queue.
+  TISM_InitializeSystem registers these tasks directly after the system tasks, in the order of the table. The task IDs
+  are compile-time constants; use TISM_TASK_ID(ExampleTask2) instead of TISM_GetTaskID("ExampleTask2"). Tasks can still
+  be registered with TISM_RegisterTask afterwards. Tasks in the table must use the pointer-based task API.
+
+*/
+#define TISM_TASK_ID(Name)       TISM_TASK_ID_##Name
+#ifdef TISM_TASK_TABLE
+#define TISM_TASK_TABLE_PROTOTYPE(Name, Priority, QueueSize) uint8_t Name(TISM_Task *ThisTask);
+#define TISM_TASK_TABLE_ID(Name, Priority, QueueSize) TISM_TASK_ID(Name),
+TISM_TASK_TABLE(TISM_TASK_TABLE_PROTOTYPE)
+enum TISM_TaskTableID { TISM_TASK_TABLE_START=TISM_NUMBER_OF_SYSTEM_TASKS-1, TISM_TASK_TABLE(TISM_TASK_TABLE_ID) TISM_TASK_TABLE_END };
+_Static_assert(TISM_TASK_TABLE_END<=MAX_TASKS, "TISM_TASK_TABLE: too many tasks (MAX_TASKS).");
+#endif
 
 
 /*
@@ -189,15 +406,22 @@ int TISM_GetTaskID(char *TaskName);
 bool TISM_IsValidTaskID(int TaskID);
 bool TISM_IsTaskAwake(int TaskID);
 bool TISM_IsSystemTask(int TaskID);
-int TISM_RegisterTask(uint8_t (*Function)(TISM_Task), char *Name, uint32_t TaskPriority);
+int TISM_RegisterTaskWithQueueSize(uint8_t (*Function)(TISM_Task *), char *Name, uint32_t TaskPriority, uint16_t QueueSize);
+int TISM_RegisterTask(uint8_t (*Function)(TISM_Task *), char *Name, uint32_t TaskPriority);
+int TISM_RegisterTaskWithContext(uint8_t (*Function)(TISM_Task *), char *Name, uint32_t TaskPriority, uint16_t QueueSize, void *Context);
+int TISM_RegisterTaskInstances(uint8_t (*Function)(TISM_Task *), char *Name, uint32_t TaskPriority, uint16_t QueueSize, void *Contexts, size_t ContextSize, uint8_t NumberOfInstances);
+int TISM_RegisterTaskByValueWithQueueSize(uint8_t (*Function)(TISM_Task), char *Name, uint32_t TaskPriority, uint16_t QueueSize);
+int TISM_RegisterTaskByValue(uint8_t (*Function)(TISM_Task), char *Name, uint32_t TaskPriority);
 int TISM_InitializeSystem();
 
 
 
-// IRQHandler.c - Routines to process external interrupts (IRQs). Other functions can 'subscribe' to these events, after which IRQHandler will
-//                send messages when events occur. This task uses the global circular buffer IRQHandlerInboundQueue defined in TISM_Definitions.h
-bool TISM_IRQHandlerSubscribe(TISM_Task ThisTask, uint8_t GPIO, uint32_t Events, bool GPIOPullDown, uint32_t AntiBounceTimeout);
-uint8_t TISM_IRQHandler(TISM_Task ThisTask);
+// IRQHandler.c - Routines to process external interrupts (IRQs). Other functions can 'subscribe' to these events, after which the interrupt
+//                handler sends messages straight to the subscribed tasks when events occur.
+bool TISM_IRQHandlerSubscribe(const TISM_Task *ThisTask, uint8_t GPIO, uint32_t Events, bool GPIOPullDown, uint32_t AntiBounceTimeout);
+void TISM_IRQHandlerResetStatistics();
+void TISM_IRQHandlerInit();
+uint8_t TISM_IRQHandler(TISM_Task *ThisTask);
 
 
 
@@ -205,47 +429,125 @@ uint8_t TISM_IRQHandler(TISM_Task ThisTask);
 uint16_t TISM_CircularBufferMessagesWaiting(struct TISM_CircularBuffer *Buffer);
 uint16_t TISM_CircularBufferSlotsAvailable(struct TISM_CircularBuffer *Buffer);
 struct TISM_Message *TISM_CircularBufferRead(struct TISM_CircularBuffer *Buffer);
+uint16_t TISM_CircularBufferReadSpan(struct TISM_CircularBuffer *Buffer, struct TISM_Message **Messages);
 void TISM_CircularBufferDelete(struct TISM_CircularBuffer *Buffer);
+void TISM_CircularBufferDeleteMultiple(struct TISM_CircularBuffer *Buffer, uint16_t Count);
 bool TISM_CircularBufferWriteWithTimestamp (struct TISM_CircularBuffer *Buffer, uint8_t SenderTaskID, uint8_t RecipientTaskID, uint8_t MessageType, uint32_t Message, uint32_t Specification, uint64_t Timestamp);
 bool TISM_CircularBufferWrite(struct TISM_CircularBuffer *Buffer, uint8_t SenderTaskID, uint8_t RecipientTaskID, uint8_t MessageType, uint32_t Message, uint32_t Specification);
+bool TISM_CircularBufferWriteBatch(struct TISM_CircularBuffer *Buffer, uint8_t SenderTaskID, uint8_t RecipientTaskID, uint8_t MessageType, const uint32_t *Messages, uint32_t Specification, uint16_t Count, uint64_t Timestamp);
+bool TISM_CircularBufferCopy(struct TISM_CircularBuffer *Buffer, const struct TISM_Message *Messages, uint16_t Count);
 void TISM_CircularBufferClear(struct TISM_CircularBuffer *Buffer);
+void TISM_CircularBufferResetStatistics(struct TISM_CircularBuffer *Buffer);
+bool TISM_CircularBufferAllocate(struct TISM_CircularBuffer *Buffer, uint16_t QueueSize);
 void TISM_CircularBufferInit(struct TISM_CircularBuffer *Buffer); 
+void TISM_CircularBufferInitMultiProducer(struct TISM_CircularBuffer *Buffer);
+
+
+// TISM_BufferPool.c - Pool of fixed size buffers with reference counting, to pass larger data between tasks without copying.
+int TISM_BufferPoolAllocate(uint16_t Length);
+TISM_Buffer *TISM_BufferPoolGet(uint32_t BufferID);
+bool TISM_BufferPoolRetain(uint32_t BufferID);
+void TISM_BufferPoolRelease(uint32_t BufferID);
+void TISM_BufferPoolResetStatistics();
+void TISM_BufferPoolInit();
+
+
+// TISM_Stream.c - Capture of ADC samples or PIO RX FIFO data by DMA into buffers, sent to the subscribed task when filled.
+int TISM_StreamStartADC(const TISM_Task *ThisTask, uint8_t InputMask, uint32_t SampleRate, uint16_t SamplesPerBuffer);
+int TISM_StreamStartPIO(const TISM_Task *ThisTask, uint8_t PIONumber, uint8_t StateMachine, uint16_t WordsPerBuffer);
+bool TISM_StreamStop(const TISM_Task *ThisTask, uint8_t StreamID);
+void TISM_StreamResetStatistics();
+void TISM_StreamInit();
+
+
+// TISM_Trace.c - Recorder of the order of events (runs of tasks, messages, interrupts, timers) in a ring buffer in RAM.
+void TISM_TraceRecord(uint8_t Event, uint8_t TaskID, uint16_t Argument);
+void TISM_TraceDump(FILE *Output);
+void TISM_TraceInit();
 
 
 // TISM_Postman.c - Tools for managing the postboxes (outbound and inbound queues) and delivery of messages between tasks.
-uint16_t TISM_PostmanMessagesWaiting(TISM_Task ThisTask);
-bool TISM_PostmanWriteMessage(TISM_Task ThisTask, uint8_t RecipientTaskID, uint8_t MessageType, uint32_t Message, uint32_t Specification);
-struct TISM_Message *TISM_PostmanReadMessage(TISM_Task ThisTask);
-void TISM_PostmanDeleteMessage(TISM_Task ThisTask);
-uint8_t TISM_Postman(TISM_Task ThisTask);
+uint16_t TISM_PostmanMessagesWaiting(const TISM_Task *ThisTask);
+bool TISM_PostmanWaitForMessage(const TISM_Task *ThisTask, int16_t MessageType, uint32_t Timeout);
+bool TISM_PostmanDeliverDirect(const TISM_Task *ThisTask, uint8_t RecipientTaskID, uint8_t MessageType, uint32_t Message, uint32_t Specification, uint64_t Timestamp);
+bool TISM_PostmanDeliverAndWake(uint8_t SenderTaskID, uint8_t RecipientTaskID, uint8_t MessageType, uint32_t Message, uint32_t Specification, uint64_t Timestamp);
+bool TISM_PostmanQueueMessage(const TISM_Task *ThisTask, uint8_t RecipientTaskID, uint8_t MessageType, uint32_t Message, uint32_t Specification, uint64_t Timestamp);
+bool TISM_PostmanWriteMessage(const TISM_Task *ThisTask, uint8_t RecipientTaskID, uint8_t MessageType, uint32_t Message, uint32_t Specification);
+bool TISM_PostmanWriteMessages(const TISM_Task *ThisTask, uint8_t RecipientTaskID, uint8_t MessageType, const uint32_t *Messages, uint32_t Specification, uint16_t Count);
+bool TISM_PostmanWriteBuffer(const TISM_Task *ThisTask, uint8_t RecipientTaskID, uint32_t BufferID, uint32_t Specification);
+bool TISM_PostmanSubscribe(const TISM_Task *ThisTask, uint8_t Topic);
+bool TISM_PostmanUnsubscribe(const TISM_Task *ThisTask, uint8_t Topic);
+bool TISM_PostmanPublish(const TISM_Task *ThisTask, uint8_t Topic, uint8_t MessageType, uint32_t Message, uint32_t Specification);
+bool TISM_PostmanPublishBuffer(const TISM_Task *ThisTask, uint8_t Topic, uint32_t BufferID, uint32_t Specification);
+uint8_t TISM_PostmanSendMessage(const TISM_Task *ThisTask, uint8_t RecipientTaskID, uint8_t MessageType, uint32_t Message, uint32_t Specification);
+uint8_t TISM_PostmanSendMessages(const TISM_Task *ThisTask, uint8_t RecipientTaskID, uint8_t MessageType, const uint32_t *Messages, uint32_t Specification, uint16_t Count);
+struct TISM_Message *TISM_PostmanReadMessage(const TISM_Task *ThisTask);
+uint16_t TISM_PostmanReadMessages(const TISM_Task *ThisTask, TISM_Message **Messages);
+void TISM_PostmanDeleteMessage(const TISM_Task *ThisTask);
+void TISM_PostmanDeleteMessages(const TISM_Task *ThisTask, uint16_t Count);
+uint8_t TISM_Postman(TISM_Task *ThisTask);
 
 
 //   TISM_Scheduler.c - The scheduler of the TISM-system (non-preemptive/cooperative multitasking).
+void TISM_SchedulerInit();
+void TISM_SchedulerUpdateTask(uint8_t TaskID);
+void TISM_SchedulerYield(const TISM_Task *ThisTask, uint32_t Delay);
+void TISM_SchedulerResetStatistics(uint8_t TaskID);
 uint8_t TISM_Scheduler(uint8_t ThisCoreID);
 
+/*
+  Stackless coroutines (protothreads) for tasks; split a long operation over multiple runs of the task without adding
+  task states. The point where the task continues is saved in its TaskResumePoint, the local variables are not: keep
+  the variables that have to survive a yield in the data of the task (static, or TaskContext). Use these macros in
+  tasks with the pointer API (uint8_t Task(TISM_Task *ThisTask)), once per task and not inside a switch statement
+  between BEGIN and END. Each yield ends the run of the task (return OK).
+    TISM_COROUTINE_BEGIN(Task)                       - Start of the coroutine; the task continues at the last yield.
+    TISM_COROUTINE_YIELD(Task)                       - End the run; continue here in the next cycle of the scheduler.
+    TISM_COROUTINE_SLEEP(Task, Usec)                 - End the run; continue here after Usec microseconds.
+    TISM_COROUTINE_YIELD_UNTIL(Task, Condition)      - Continue when Condition is true; checked in each scheduled run.
+    TISM_COROUTINE_WAIT_FOR_MESSAGE(Task, Type, Timeout) - Sleep until a message of Type (or TISM_ANY_MESSAGE) arrives, or
+                                                       Timeout usec pass (TISM_WAIT_FOREVER). The message isn't read;
+                                                       expiry of a software timer is a message of type timer ID.
+    TISM_COROUTINE_END(Task)                         - End of the coroutine; the next run starts at BEGIN again.
+    TISM_COROUTINE_RESET(Task)                       - Start at BEGIN in the next run (e.g. when the task is stopped).
+*/
+#define TISM_COROUTINE_BEGIN(Task)                  switch((Task)->TaskResumePoint) { case 0:
+#define TISM_COROUTINE_END(Task)                    } (Task)->TaskResumePoint=0
+#define TISM_COROUTINE_RESET(Task)                  (Task)->TaskResumePoint=0
+#define TISM_COROUTINE_SLEEP(Task, Usec)            do { TISM_SchedulerYield((Task), (Usec)); (Task)->TaskResumePoint=__LINE__; return(OK); case __LINE__:; } while(0)
+#define TISM_COROUTINE_YIELD(Task)                  TISM_COROUTINE_SLEEP(Task, 0)
+#define TISM_COROUTINE_YIELD_UNTIL(Task, Condition) do { (Task)->TaskResumePoint=__LINE__; case __LINE__: if(!(Condition)) return(OK); } while(0)
+#define TISM_COROUTINE_WAIT_FOR_MESSAGE(Task, Type, Timeout) do { TISM_PostmanWaitForMessage((Task), (Type), (Timeout)); (Task)->TaskResumePoint=__LINE__; return(OK); case __LINE__:; } while(0)
+
 
 // TISM_SoftwareTimer.c - Library for setting and triggering timers. This library defines 2 types of timers; virtual and software.
 uint64_t TISM_SoftwareTimerSetVirtual(uint64_t TimerUsec);
 bool TISM_SoftwareTimerVirtualExpired(uint64_t TimerUsec);
-bool TISM_SoftwareTimerSet(TISM_Task ThisTask, uint8_t TimerID, bool RepetitiveTimer, uint32_t TimerIntervalMsec);
-bool TISM_SoftwareTimerCancel(TISM_Task ThisTask, uint8_t TimerID);
-uint8_t TISM_SoftwareTimer(TISM_Task ThisTask);
+void TISM_SoftwareTimerInitPrecision();
+bool TISM_SoftwareTimerSetWithPrecision(const TISM_Task *ThisTask, uint8_t TimerID, bool RepetitiveTimer, uint32_t TimerInterval, uint8_t Precision);
+bool TISM_SoftwareTimerSet(const TISM_Task *ThisTask, uint8_t TimerID, bool RepetitiveTimer, uint32_t TimerIntervalMsec);
+bool TISM_SoftwareTimerCancel(const TISM_Task *ThisTask, uint8_t TimerID);
+uint8_t TISM_SoftwareTimer(TISM_Task *ThisTask);
 
 
 //   TISM_TaskManager.c - Library with functions to manipulate task properties and system states, when requested via messages.
-uint8_t TISM_TaskManagerSetTaskAttribute(struct TISM_Task ThisTask, uint8_t TargetTaskID, uint8_t AttributeToChange, uint32_t Setting);
-uint8_t TISM_TaskManagerSetMyTaskAttribute(struct TISM_Task ThisTask, uint8_t AttributeToChange, uint32_t Setting);
-uint8_t TISM_TaskManagerSetSystemState(struct TISM_Task ThisTask, uint8_t SystemState);
-uint8_t TISM_TaskManager(TISM_Task ThisTask);
+uint8_t TISM_TaskManagerSetTaskAttribute(const TISM_Task *ThisTask, uint8_t TargetTaskID, uint8_t AttributeToChange, uint32_t Setting);
+uint8_t TISM_TaskManagerSetMyTaskAttribute(const TISM_Task *ThisTask, uint8_t AttributeToChange, uint32_t Setting);
+uint8_t TISM_TaskManagerSetSystemState(const TISM_Task *ThisTask, uint8_t SystemState);
+uint8_t TISM_TaskManager(TISM_Task *ThisTask);
 
 
 // TISM_Watchdoc.c - Task to check if other tasks are still alive. Generate warnings to the EventLogger in case of timeouts.	
-uint8_t TISM_Watchdog(TISM_Task ThisTask);
+uint8_t TISM_Watchdog(TISM_Task *ThisTask);
 
 
 // TISM_EventLogger.c - A uniform and thread-safe method for handling of log entries.
-bool TISM_EventLoggerLogEvent (struct TISM_Task ThisTask, uint8_t LogEntryType, const char *format, ...);
-uint8_t TISM_EventLogger (TISM_Task ThisTask);
+void TISM_EventLoggerReleaseEntry(uint32_t EntryID);
+void TISM_EventLoggerLogStatistics(const TISM_Task *ThisTask);
+void TISM_EventLoggerResetStatistics();
+void TISM_EventLoggerInit();
+bool TISM_EventLoggerLogEvent (const TISM_Task *ThisTask, uint8_t LogEntryType, const char *format, ...);
+uint8_t TISM_EventLogger (TISM_Task *ThisTask);
 
 
 // Inclusion of the code segments
@@ -254,10 +556,60 @@ uint8_t TISM_EventLogger (TISM_Task ThisTask);
 #include "TISM_Scheduler.c"
 #include "TISM_Postman.c"
 #include "TISM_Messaging.c"
+#include "TISM_BufferPool.c"
+#include "TISM_Stream.c"
+#include "TISM_Trace.c"
 #include "TISM.c"
 #include "TISM_TaskManager.c"
 #include "TISM_Watchdog.c"
 #include "TISM_EventLogger.c"
 
 
+/*
+
+  Compatibility with tasks written for the by-value API (uint8_t Task(TISM_Task ThisTask)). Tasks receive a pointer
+  to their entry in System.Task; the functions above take a pointer as well. The macros below accept both a pointer and 
+  the by-value copy, so existing tasks compile without changes. A copy is translated to the entry of the task in 
+  System.Task. As these macros are defined after the code segments of TISM, only the user tasks are affected.
+  Define TISM_NO_BY_VALUE_API before including TISM.h to disable.
+
+*/
+#ifndef TISM_NO_BY_VALUE_API
+static inline const TISM_Task *TISM_TaskContextFromPointer(const TISM_Task *ThisTask) { return(ThisTask); }
+static inline const TISM_Task *TISM_TaskContextFromValue(TISM_Task ThisTask) { return(&System.Task[ThisTask.TaskID]); }
+#define TISM_TASK_CONTEXT(Task)                     _Generic((Task), TISM_Task: TISM_TaskContextFromValue, default: TISM_TaskContextFromPointer)(Task)
+
+#define TISM_RegisterTask(Function, ...)            _Generic((Function), uint8_t (*)(TISM_Task): TISM_RegisterTaskByValue, default: TISM_RegisterTask)(Function, __VA_ARGS__)
+#define TISM_RegisterTaskWithQueueSize(Function, ...) _Generic((Function), uint8_t (*)(TISM_Task): TISM_RegisterTaskByValueWithQueueSize, default: TISM_RegisterTaskWithQueueSize)(Function, __VA_ARGS__)
+#define TISM_IRQHandlerSubscribe(Task, ...)         TISM_IRQHandlerSubscribe(TISM_TASK_CONTEXT(Task), __VA_ARGS__)
+#define TISM_StreamStartADC(Task, ...)              TISM_StreamStartADC(TISM_TASK_CONTEXT(Task), __VA_ARGS__)
+#define TISM_StreamStartPIO(Task, ...)              TISM_StreamStartPIO(TISM_TASK_CONTEXT(Task), __VA_ARGS__)
+#define TISM_StreamStop(Task, ...)                  TISM_StreamStop(TISM_TASK_CONTEXT(Task), __VA_ARGS__)
+#define TISM_SchedulerYield(Task, ...)              TISM_SchedulerYield(TISM_TASK_CONTEXT(Task), __VA_ARGS__)
+#define TISM_PostmanMessagesWaiting(Task)           TISM_PostmanMessagesWaiting(TISM_TASK_CONTEXT(Task))
+#define TISM_PostmanWaitForMessage(Task, ...)       TISM_PostmanWaitForMessage(TISM_TASK_CONTEXT(Task), __VA_ARGS__)
+#define TISM_PostmanDeliverDirect(Task, ...)        TISM_PostmanDeliverDirect(TISM_TASK_CONTEXT(Task), __VA_ARGS__)
+#define TISM_PostmanWriteMessage(Task, ...)         TISM_PostmanWriteMessage(TISM_TASK_CONTEXT(Task), __VA_ARGS__)
+#define TISM_PostmanWriteMessages(Task, ...)        TISM_PostmanWriteMessages(TISM_TASK_CONTEXT(Task), __VA_ARGS__)
+#define TISM_PostmanWriteBuffer(Task, ...)          TISM_PostmanWriteBuffer(TISM_TASK_CONTEXT(Task), __VA_ARGS__)
+#define TISM_PostmanSubscribe(Task, ...)            TISM_PostmanSubscribe(TISM_TASK_CONTEXT(Task), __VA_ARGS__)
+#define TISM_PostmanUnsubscribe(Task, ...)          TISM_PostmanUnsubscribe(TISM_TASK_CONTEXT(Task), __VA_ARGS__)
+#define TISM_PostmanPublish(Task, ...)              TISM_PostmanPublish(TISM_TASK_CONTEXT(Task), __VA_ARGS__)
+#define TISM_PostmanPublishBuffer(Task, ...)        TISM_PostmanPublishBuffer(TISM_TASK_CONTEXT(Task), __VA_ARGS__)
+#define TISM_PostmanSendMessage(Task, ...)          TISM_PostmanSendMessage(TISM_TASK_CONTEXT(Task), __VA_ARGS__)
+#define TISM_PostmanSendMessages(Task, ...)         TISM_PostmanSendMessages(TISM_TASK_CONTEXT(Task), __VA_ARGS__)
+#define TISM_PostmanReadMessage(Task)               TISM_PostmanReadMessage(TISM_TASK_CONTEXT(Task))
+#define TISM_PostmanReadMessages(Task, ...)         TISM_PostmanReadMessages(TISM_TASK_CONTEXT(Task), __VA_ARGS__)
+#define TISM_PostmanDeleteMessage(Task)             TISM_PostmanDeleteMessage(TISM_TASK_CONTEXT(Task))
+#define TISM_PostmanDeleteMessages(Task, ...)       TISM_PostmanDeleteMessages(TISM_TASK_CONTEXT(Task), __VA_ARGS__)
+#define TISM_SoftwareTimerSetWithPrecision(Task, ...) TISM_SoftwareTimerSetWithPrecision(TISM_TASK_CONTEXT(Task), __VA_ARGS__)
+#define TISM_SoftwareTimerSet(Task, ...)            TISM_SoftwareTimerSet(TISM_TASK_CONTEXT(Task), __VA_ARGS__)
+#define TISM_SoftwareTimerCancel(Task, ...)         TISM_SoftwareTimerCancel(TISM_TASK_CONTEXT(Task), __VA_ARGS__)
+#define TISM_TaskManagerSetTaskAttribute(Task, ...) TISM_TaskManagerSetTaskAttribute(TISM_TASK_CONTEXT(Task), __VA_ARGS__)
+#define TISM_TaskManagerSetMyTaskAttribute(Task, ...) TISM_TaskManagerSetMyTaskAttribute(TISM_TASK_CONTEXT(Task), __VA_ARGS__)
+#define TISM_TaskManagerSetSystemState(Task, ...)   TISM_TaskManagerSetSystemState(TISM_TASK_CONTEXT(Task), __VA_ARGS__)
+#define TISM_EventLoggerLogEvent(Task, ...)         TISM_EventLoggerLogEvent(TISM_TASK_CONTEXT(Task), __VA_ARGS__)
+#endif
+
+
 #endif
\ No newline at end of file
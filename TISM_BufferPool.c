@@ -0,0 +1,182 @@
+/*
+  TISM_BufferPool.c
+  =================
+  A pool of fixed size data blocks (buffers) that can be shared between tasks, e.g. to pass sensor frames or protocol
+  packets without copying them. A TISM message only holds two 32 bit values; larger data is put in a buffer and the
+  message only contains the ID of the buffer.
+
+  How buffers are used:
+  - A task claims a buffer with TISM_BufferPoolAllocate (O(1), no heap) and fills it (see TISM_BufferPoolGet). The
+    task now holds one reference to the buffer.
+  - The buffer is sent with TISM_PostmanWriteBuffer; each message of type TISM_BUFFER holds a reference of its own. A
+    buffer can be sent to multiple recipients; they all share the same data, which should therefore be treated as
+    read-only once sent.
+  - The sending task drops its own reference with TISM_BufferPoolRelease when it doesn't need the buffer anymore.
+  - The reference of a message is dropped automatically when the recipient deletes the message (TISM_PostmanDeleteMessage
+    or TISM_PostmanDeleteMessages), or when TISM_Postman can't deliver it. A recipient that needs the data for longer
+    takes a reference of its own with TISM_BufferPoolRetain.
+  - The buffer returns to the pool when the last reference is dropped.
+
+  Copyright (c) 2024 Maarten Klarenbeek (https://github.com/mjklaren)
+  Distributed under the GPLv3 license
+
+*/
+
+#include "TISM.h"
+
+#define BUFFER_POOL_NO_BLOCK     255     // End of the list of free buffers.
+
+
+struct TISM_BufferPoolData
+{
+  spin_lock_t *Lock;
+  TISM_Buffer Buffer[BUFFER_POOL_BLOCKS];
+  uint8_t FirstFreeBuffer, NextFreeBuffer[BUFFER_POOL_BLOCKS];
+  uint16_t BuffersUsed, HighWaterMark;
+  uint32_t Allocated, Failed;
+} TISM_BufferPoolData;
+
+
+/*
+  Description:
+  Claim a buffer from the pool. The reference count of the buffer is set to 1 (the reference of the calling task).
+
+  Parameters:
+  uint16_t Length         - Number of bytes that will be used (max. BUFFER_POOL_BLOCK_SIZE); stored in the buffer.
+
+  Return value:
+  UNDEFINED               - No free buffer available, or Length too large.
+  <value>                 - ID of the buffer.
+*/
+int TISM_BufferPoolAllocate(uint16_t Length)
+{
+  if(Length>BUFFER_POOL_BLOCK_SIZE)
+    return(UNDEFINED);
+  uint32_t LockState=spin_lock_blocking(TISM_BufferPoolData.Lock);
+  uint8_t BufferID=TISM_BufferPoolData.FirstFreeBuffer;
+  if(BufferID!=BUFFER_POOL_NO_BLOCK)
+  {
+    TISM_BufferPoolData.FirstFreeBuffer=TISM_BufferPoolData.NextFreeBuffer[BufferID];
+    TISM_BufferPoolData.Buffer[BufferID].References=1;
+    TISM_BufferPoolData.Buffer[BufferID].Length=Length;
+    TISM_BufferPoolData.Allocated++;
+    if(++TISM_BufferPoolData.BuffersUsed>TISM_BufferPoolData.HighWaterMark)
+      TISM_BufferPoolData.HighWaterMark=TISM_BufferPoolData.BuffersUsed;
+  }
+  else
+    TISM_BufferPoolData.Failed++;
+  spin_unlock(TISM_BufferPoolData.Lock, LockState);
+  return(BufferID!=BUFFER_POOL_NO_BLOCK?BufferID:UNDEFINED);
+}
+
+
+/*
+  Description:
+  Get the buffer for the specified ID, to read or write the data.
+
+  Parameters:
+  uint32_t BufferID       - ID of the buffer (e.g. the Message-field of a TISM_BUFFER message).
+
+  Return value:
+  NULL                    - Invalid ID, or the buffer isn't in use.
+  *TISM_Buffer            - Pointer to the buffer.
+*/
+TISM_Buffer *TISM_BufferPoolGet(uint32_t BufferID)
+{
+  if((BufferID>=BUFFER_POOL_BLOCKS) || (TISM_BufferPoolData.Buffer[BufferID].References==0))
+    return(NULL);
+  return(&TISM_BufferPoolData.Buffer[BufferID]);
+}
+
+
+/*
+  Description:
+  Add a reference to a buffer that is in use.
+
+  Parameters:
+  uint32_t BufferID       - ID of the buffer.
+
+  Return value:
+  false                   - Invalid ID, the buffer isn't in use or has too many references.
+  true                    - Reference added.
+*/
+bool TISM_BufferPoolRetain(uint32_t BufferID)
+{
+  if(BufferID>=BUFFER_POOL_BLOCKS)
+    return(false);
+  uint32_t LockState=spin_lock_blocking(TISM_BufferPoolData.Lock);
+  bool InUse=((TISM_BufferPoolData.Buffer[BufferID].References>0) && (TISM_BufferPoolData.Buffer[BufferID].References<UINT8_MAX));
+  if(InUse)
+    TISM_BufferPoolData.Buffer[BufferID].References++;
+  spin_unlock(TISM_BufferPoolData.Lock, LockState);
+  return(InUse);
+}
+
+
+/*
+  Description:
+  Drop a reference to a buffer. The buffer returns to the pool when the last reference is dropped.
+
+  Parameters:
+  uint32_t BufferID       - ID of the buffer.
+
+  Return value:
+  None
+*/
+void TISM_BufferPoolRelease(uint32_t BufferID)
+{
+  if(BufferID>=BUFFER_POOL_BLOCKS)
+    return;
+  uint32_t LockState=spin_lock_blocking(TISM_BufferPoolData.Lock);
+  if((TISM_BufferPoolData.Buffer[BufferID].References>0) && (--TISM_BufferPoolData.Buffer[BufferID].References==0))
+  {
+    TISM_BufferPoolData.NextFreeBuffer[BufferID]=TISM_BufferPoolData.FirstFreeBuffer;
+    TISM_BufferPoolData.FirstFreeBuffer=BufferID;
+    TISM_BufferPoolData.BuffersUsed--;
+  }
+  spin_unlock(TISM_BufferPoolData.Lock, LockState);
+}
+
+
+/*
+  Description:
+  Reset the statistics of the buffer pool (high water mark, number of allocations and failed allocations).
+
+  Parameters:
+  None
+
+  Return value:
+  None
+*/
+void TISM_BufferPoolResetStatistics()
+{
+  uint32_t LockState=spin_lock_blocking(TISM_BufferPoolData.Lock);
+  TISM_BufferPoolData.HighWaterMark=TISM_BufferPoolData.BuffersUsed;
+  TISM_BufferPoolData.Allocated=0;
+  TISM_BufferPoolData.Failed=0;
+  spin_unlock(TISM_BufferPoolData.Lock, LockState);
+}
+
+
+/*
+  Description:
+  Initialize the buffer pool. Called once by TISM_InitializeSystem.
+
+  Parameters:
+  None
+
+  Return value:
+  None
+*/
+void TISM_BufferPoolInit()
+{
+  for(uint8_t BufferID=0;BufferID<BUFFER_POOL_BLOCKS;BufferID++)
+  {
+    TISM_BufferPoolData.Buffer[BufferID].References=0;
+    TISM_BufferPoolData.NextFreeBuffer[BufferID]=(BufferID+1<BUFFER_POOL_BLOCKS?BufferID+1:BUFFER_POOL_NO_BLOCK);
+  }
+  TISM_BufferPoolData.FirstFreeBuffer=(BUFFER_POOL_BLOCKS>0?0:BUFFER_POOL_NO_BLOCK);
+  TISM_BufferPoolData.BuffersUsed=0;
+  TISM_BufferPoolData.Lock=spin_lock_instance(spin_lock_claim_unused(true));
+  TISM_BufferPoolResetStatistics();
+}
@@ -9,36 +9,461 @@
   As both cores run independently in some occasions the entries are not always logged in the correct order (when looking at 
   the timestamp) between both cores. Entries for each individual core are always logged correctly.
 
+  Writing to STDOUT (USB CDC) blocks when the host is slow. With EVENT_LOG_OUTPUT_BUFFER set the formatted lines are
+  stored in an output buffer instead, which is written in parts of at most EVENT_LOG_OUTPUT_CHUNK bytes:
+  - EVENT_LOG_SINK_STDIO: one chunk is written to STDOUT per run of TISM_EventLogger.
+  - EVENT_LOG_SINK_UART_DMA: chunks are sent to EVENT_LOG_UART by DMA; TISM_EventLogger only starts the next transfer.
+  While output is pending TISM_EventLogger wakes up every EVENT_LOG_OUTPUT_INTERVAL usec. When the buffer is full the
+  new line or the oldest lines are dropped (EVENT_LOG_OUTPUT_OVERFLOW); the number of dropped lines is reported in the
+  log as soon as there is room again. Notifications and errors share the same output (there is no separate STDERR).
+  The output buffer is only used by TISM_EventLogger itself, so no locking is needed.
+
   Copyright (c) 2024 Maarten Klarenbeek (https://github.com/mjklaren)
   Distributed under the GPLv3 license
 
 */
 
 #include <stdarg.h>
+#include <string.h>
 #include "TISM.h"
+#if EVENT_LOG_OUTPUT_SINK==EVENT_LOG_SINK_UART_DMA
+#include "hardware/dma.h"
+#include "hardware/uart.h"
+#endif
+
+
+/*
+
+  The pool of log entries. Log entries are claimed from the pool by the task logging the event and are returned to the
+  pool when written by TISM_EventLogger. The message sent to TISM_EventLogger only contains the ID of the log entry.
+  When EVENT_LOG_DEFERRED_FORMAT is enabled the logging task only stores the pointer to the format string and the raw
+  arguments (strings are copied); formatting of the text is done by TISM_EventLogger. Format strings must therefore be
+  constants (string literals). Entries with conversions that can't be deferred are formatted immediately.
+
+*/
+
+#define EVENT_LOG_NO_ENTRY       255     // End of the list of free log entries.
+#define EVENT_LOG_ARGUMENT_INT   0       // Types of the arguments of a deferred log entry.
+#define EVENT_LOG_ARGUMENT_LONG  1
+#define EVENT_LOG_ARGUMENT_LONGLONG 2
+#define EVENT_LOG_ARGUMENT_DOUBLE 3
+#define EVENT_LOG_ARGUMENT_STRING 4      // Copied into the Text of the log entry; Argument contains the offset.
+#define EVENT_LOG_ARGUMENT_POINTER 5
+#define EVENT_LOG_MAX_SPECIFICATION 24   // Maximum length of a single conversion specification (e.g. "%-08ld").
+#define EVENT_LOG_LINE_LENGTH    (EVENT_LOG_ENTRY_LENGTH+MAX_TASK_NAME_LENGTH+40) // Maximum length of a line of output (timestamp, task, entry).
+#define EVENT_LOG_OUTPUT_SIZE    (EVENT_LOG_OUTPUT_BUFFER>0?EVENT_LOG_OUTPUT_BUFFER:1)
+
+_Static_assert(EVENT_LOG_OUTPUT_BUFFER==0 || EVENT_LOG_OUTPUT_CHUNK>=EVENT_LOG_LINE_LENGTH, "EVENT_LOG_OUTPUT_CHUNK: must be at least the length of a log line.");
+
+typedef struct TISM_EventLogEntry
+{
+  const char *Format;                                        // Format string; NULL when Text contains the formatted entry.
+  uint8_t NumberOfArguments, NextEntry, ArgumentType[EVENT_LOG_MAX_ARGUMENTS];
+  union
+  {
+    long long Integer;
+    double Real;
+    const void *Pointer;
+  } Argument[EVENT_LOG_MAX_ARGUMENTS];
+  char Text[EVENT_LOG_ENTRY_LENGTH];                         // Formatted entry, or the strings of the arguments (deferred).
+} TISM_EventLogEntry;
+
+struct TISM_EventLoggerData
+{
+  spin_lock_t *Lock;
+  TISM_EventLogEntry Entry[EVENT_LOG_POOL_SIZE];
+  uint8_t FirstFreeEntry;
+
+  // Output buffer (circular); Used bytes starting at OutputTail.
+  char Output[EVENT_LOG_OUTPUT_SIZE], Chunk[EVENT_LOG_OUTPUT_CHUNK];
+  uint32_t OutputHead, OutputTail, OutputUsed, OutputHighWaterMark, LinesDropped, LinesDroppedReported;
+  int DMAChannel;
+} TISM_EventLoggerData;
+
+
+// Internal functions - the sink that writes the chunks of the output buffer.
+#if EVENT_LOG_OUTPUT_SINK==EVENT_LOG_SINK_UART_DMA
+void TISM_EventLoggerSinkInit()
+{
+  uart_init(EVENT_LOG_UART, EVENT_LOG_UART_BAUDRATE);
+  gpio_set_function(EVENT_LOG_UART_TX_PIN, GPIO_FUNC_UART);
+  TISM_EventLoggerData.DMAChannel=dma_claim_unused_channel(true);
+  dma_channel_config Config=dma_channel_get_default_config(TISM_EventLoggerData.DMAChannel);
+  channel_config_set_transfer_data_size(&Config, DMA_SIZE_8);
+  channel_config_set_read_increment(&Config, true);
+  channel_config_set_write_increment(&Config, false);
+  channel_config_set_dreq(&Config, uart_get_dreq(EVENT_LOG_UART, true));
+  dma_channel_configure(TISM_EventLoggerData.DMAChannel, &Config, &uart_get_hw(EVENT_LOG_UART)->dr, TISM_EventLoggerData.Chunk, 0, false);
+}
+
+bool TISM_EventLoggerSinkBusy() { return(dma_channel_is_busy(TISM_EventLoggerData.DMAChannel)); }
+
+void TISM_EventLoggerSinkWrite(uint16_t Length) { dma_channel_transfer_from_buffer_now(TISM_EventLoggerData.DMAChannel, TISM_EventLoggerData.Chunk, Length); }
+#else
+void TISM_EventLoggerSinkInit() { TISM_EventLoggerData.DMAChannel=UNDEFINED; }
+
+bool TISM_EventLoggerSinkBusy() { return(false); }
+
+void TISM_EventLoggerSinkWrite(uint16_t Length) { fwrite(TISM_EventLoggerData.Chunk, 1, Length, STDOUT); }
+#endif
+
+
+// Internal function - store a line in the output buffer. When the buffer is full the line or the oldest lines are
+// dropped, depending on EVENT_LOG_OUTPUT_OVERFLOW. Returns false when the line was dropped.
+bool TISM_EventLoggerBufferLine(const char *Line, uint16_t Length, bool DropOldest)
+{
+  while(EVENT_LOG_OUTPUT_SIZE-TISM_EventLoggerData.OutputUsed<Length)
+  {
+    if(!DropOldest || TISM_EventLoggerData.OutputUsed==0)
+    {
+      TISM_EventLoggerData.LinesDropped++;
+      return(false);
+    }
+
+    // Drop the oldest line; the output buffer always starts at the beginning of a line.
+    uint32_t Dropped=0;
+    while((Dropped<TISM_EventLoggerData.OutputUsed) && (TISM_EventLoggerData.Output[(TISM_EventLoggerData.OutputTail+Dropped)%EVENT_LOG_OUTPUT_SIZE]!='\n'))
+      Dropped++;
+    Dropped=(Dropped<TISM_EventLoggerData.OutputUsed?Dropped+1:Dropped);
+    TISM_EventLoggerData.OutputTail=(TISM_EventLoggerData.OutputTail+Dropped)%EVENT_LOG_OUTPUT_SIZE;
+    TISM_EventLoggerData.OutputUsed-=Dropped;
+    TISM_EventLoggerData.LinesDropped++;
+  }
+
+  // Copy the line, in two parts when it wraps around the end of the buffer.
+  uint32_t FirstPart=(EVENT_LOG_OUTPUT_SIZE-TISM_EventLoggerData.OutputHead<Length?EVENT_LOG_OUTPUT_SIZE-TISM_EventLoggerData.OutputHead:Length);
+  memcpy(&TISM_EventLoggerData.Output[TISM_EventLoggerData.OutputHead], Line, FirstPart);
+  memcpy(TISM_EventLoggerData.Output, Line+FirstPart, Length-FirstPart);
+  TISM_EventLoggerData.OutputHead=(TISM_EventLoggerData.OutputHead+Length)%EVENT_LOG_OUTPUT_SIZE;
+  TISM_EventLoggerData.OutputUsed+=Length;
+  if(TISM_EventLoggerData.OutputUsed>TISM_EventLoggerData.OutputHighWaterMark)
+    TISM_EventLoggerData.OutputHighWaterMark=TISM_EventLoggerData.OutputUsed;
+  return(true);
+}
+
+
+// Internal function - write a line of output for TISM_EventLogger. Without an output buffer the line is written to the
+// specified stream right away; otherwise it is stored in the output buffer (see TISM_EventLoggerDrain).
+void TISM_EventLoggerOutput(FILE *Stream, const char *format, ...)
+{
+  char Line[EVENT_LOG_LINE_LENGTH];
+  va_list args;
+  va_start(args,format);
+  int Length=vsnprintf(Line, EVENT_LOG_LINE_LENGTH, format, args);
+  va_end(args);
+  if(EVENT_LOG_OUTPUT_BUFFER==0)
+  {
+    fputs(Line, Stream);
+    return;
+  }
+  if(Length<0)
+    return;
+  if(Length>=EVENT_LOG_LINE_LENGTH)
+  {
+    // Truncated; keep the end of the line.
+    Length=EVENT_LOG_LINE_LENGTH-1;
+    Line[Length-1]='\n';
+  }
+
+  // Report lines dropped earlier, as soon as there is room for it.
+  if(TISM_EventLoggerData.LinesDropped!=TISM_EventLoggerData.LinesDroppedReported)
+  {
+    char Report[EVENT_LOG_LINE_LENGTH];
+    int ReportLength=snprintf(Report, EVENT_LOG_LINE_LENGTH, "%llu %s (ID %d) ERROR: %lu lines of log output dropped (output buffer full).\n", time_us_64(), System.Task[TISM_EVENTLOGGER_TASK_ID].TaskName, TISM_EVENTLOGGER_TASK_ID, TISM_EventLoggerData.LinesDropped-TISM_EventLoggerData.LinesDroppedReported);
+    uint32_t LinesDropped=TISM_EventLoggerData.LinesDropped;
+    if(TISM_EventLoggerBufferLine(Report, ReportLength, false))
+      TISM_EventLoggerData.LinesDroppedReported=LinesDropped;
+    else
+      TISM_EventLoggerData.LinesDropped--;        // The report itself doesn't count as a dropped line.
+  }
+  TISM_EventLoggerBufferLine(Line, Length, EVENT_LOG_OUTPUT_OVERFLOW==EVENT_LOG_DROP_OLDEST);
+}
+
+
+// Internal function - hand the next chunk of the output buffer to the sink, when it's ready for it. A chunk ends at the
+// end of a line. Returns true when output is still pending.
+bool TISM_EventLoggerDrain()
+{
+  if(EVENT_LOG_OUTPUT_BUFFER==0)
+    return(false);
+  if(TISM_EventLoggerSinkBusy())
+    return(true);
+  uint16_t Length=(TISM_EventLoggerData.OutputUsed<EVENT_LOG_OUTPUT_CHUNK?TISM_EventLoggerData.OutputUsed:EVENT_LOG_OUTPUT_CHUNK);
+  for(uint16_t Counter=0;Counter<Length;Counter++)
+    TISM_EventLoggerData.Chunk[Counter]=TISM_EventLoggerData.Output[(TISM_EventLoggerData.OutputTail+Counter)%EVENT_LOG_OUTPUT_SIZE];
+  while((Length>0) && (Length<TISM_EventLoggerData.OutputUsed) && (TISM_EventLoggerData.Chunk[Length-1]!='\n'))
+    Length--;
+  if(Length==0)
+    return(false);
+  TISM_EventLoggerData.OutputTail=(TISM_EventLoggerData.OutputTail+Length)%EVENT_LOG_OUTPUT_SIZE;
+  TISM_EventLoggerData.OutputUsed-=Length;
+  TISM_EventLoggerSinkWrite(Length);
+  return((TISM_EventLoggerData.OutputUsed>0) || TISM_EventLoggerSinkBusy());
+}
+
+
+// Internal function - parse a single conversion specification (Format points to the character after the '%'). 
+// Returns a pointer to the character after the specification and provides the type of the argument. Returns NULL when
+// the conversion can't be deferred (variable field width '*', %n, long double or wide strings).
+const char *TISM_EventLoggerParseSpecification(const char *Format, uint8_t *ArgumentType)
+{
+  uint8_t Length=0;     // 0=default, 1=l, 2=ll/j
+  while((*Format!=0) && (strchr("-+ #0123456789.", *Format)!=NULL))
+    Format++;
+  while((*Format!=0) && (strchr("hljzt", *Format)!=NULL))
+  {
+    Length=((*Format=='l') || (*Format=='z') || (*Format=='t')?Length+1:(*Format=='j'?2:Length));
+    Format++;
+  }
+  if(Length>2)
+    return(NULL);
+  switch(*Format)
+  {
+    case 'd': case 'i': case 'u': case 'o': case 'x': case 'X': case 'c':
+              *ArgumentType=(Length==0?EVENT_LOG_ARGUMENT_INT:(Length==1?EVENT_LOG_ARGUMENT_LONG:EVENT_LOG_ARGUMENT_LONGLONG));
+              break;
+    case 'f': case 'F': case 'e': case 'E': case 'g': case 'G': case 'a': case 'A':
+              *ArgumentType=EVENT_LOG_ARGUMENT_DOUBLE;
+              break;
+    case 's': *ArgumentType=EVENT_LOG_ARGUMENT_STRING;
+              if(Length>0)
+                return(NULL);
+              break;
+    case 'p': *ArgumentType=EVENT_LOG_ARGUMENT_POINTER;
+              break;
+    default:  return(NULL);
+  }
+  return(Format+1);
+}
+
+
+// Internal function - store the arguments of a log entry without formatting it. Returns false when the format string
+// contains conversions that can't be deferred.
+bool TISM_EventLoggerStoreArguments(TISM_EventLogEntry *Entry, const char *Format, va_list Arguments)
+{
+  uint8_t ArgumentType;
+  uint16_t TextUsed=0, StringLength;
+  const char *String;
+  Entry->NumberOfArguments=0;
+  while((Format=strchr(Format, '%'))!=NULL)
+  {
+    if(*(++Format)=='%')
+    {
+      Format++;
+      continue;
+    }
+    if((Entry->NumberOfArguments>=EVENT_LOG_MAX_ARGUMENTS) || ((Format=TISM_EventLoggerParseSpecification(Format, &ArgumentType))==NULL))
+      return(false);
+    Entry->ArgumentType[Entry->NumberOfArguments]=ArgumentType;
+    switch(ArgumentType)
+    {
+      case EVENT_LOG_ARGUMENT_INT:      Entry->Argument[Entry->NumberOfArguments].Integer=va_arg(Arguments, int);
+                                        break;
+      case EVENT_LOG_ARGUMENT_LONG:     Entry->Argument[Entry->NumberOfArguments].Integer=va_arg(Arguments, long);
+                                        break;
+      case EVENT_LOG_ARGUMENT_LONGLONG: Entry->Argument[Entry->NumberOfArguments].Integer=va_arg(Arguments, long long);
+                                        break;
+      case EVENT_LOG_ARGUMENT_DOUBLE:   Entry->Argument[Entry->NumberOfArguments].Real=va_arg(Arguments, double);
+                                        break;
+      case EVENT_LOG_ARGUMENT_STRING:   // Copy the string; it might not exist anymore when the entry is formatted.
+                                        String=va_arg(Arguments, const char *);
+                                        if(String==NULL)
+                                          String="(null)";
+                                        StringLength=strnlen(String, EVENT_LOG_ENTRY_LENGTH-TextUsed-1);
+                                        memcpy(&Entry->Text[TextUsed], String, StringLength);
+                                        Entry->Text[TextUsed+StringLength]=0;
+                                        Entry->Argument[Entry->NumberOfArguments].Integer=TextUsed;
+                                        // When the text is full, the remaining strings share the last terminator and become empty.
+                                        TextUsed=(TextUsed+StringLength+1<EVENT_LOG_ENTRY_LENGTH?TextUsed+StringLength+1:EVENT_LOG_ENTRY_LENGTH-1);
+                                        break;
+      case EVENT_LOG_ARGUMENT_POINTER:  Entry->Argument[Entry->NumberOfArguments].Pointer=va_arg(Arguments, const void *);
+                                        break;
+    }
+    Entry->NumberOfArguments++;
+  }
+  return(true);
+}
+
+
+// Internal function - format a log entry into the specified buffer, one conversion specification at a time.
+void TISM_EventLoggerFormat(TISM_EventLogEntry *Entry, char *Buffer, uint16_t BufferSize)
+{
+  if(Entry->Format==NULL)
+  {
+    // Already formatted by the logging task.
+    snprintf(Buffer, BufferSize, "%s", Entry->Text);
+    return;
+  }
+
+  const char *Format=Entry->Format, *Next;
+  char Specification[EVENT_LOG_MAX_SPECIFICATION+1];
+  uint8_t ArgumentType, ArgumentCounter=0;
+  uint16_t Used=0;
+  int Written=0;
+  while((*Format!=0) && (Used<BufferSize-1))
+  {
+    // Copy the text in between the conversion specifications.
+    if((*Format!='%') || (*(Format+1)=='%'))
+    {
+      Buffer[Used++]=*Format;
+      Format+=(*Format=='%'?2:1);
+      continue;
+    }
+    Next=TISM_EventLoggerParseSpecification(Format+1, &ArgumentType);
+    if((Next-Format)>EVENT_LOG_MAX_SPECIFICATION)
+      break;
+    memcpy(Specification, Format, Next-Format);
+    Specification[Next-Format]=0;
+    switch(ArgumentType)
+    {
+      case EVENT_LOG_ARGUMENT_INT:      Written=snprintf(&Buffer[Used], BufferSize-Used, Specification, (int)Entry->Argument[ArgumentCounter].Integer);
+                                        break;
+      case EVENT_LOG_ARGUMENT_LONG:     Written=snprintf(&Buffer[Used], BufferSize-Used, Specification, (long)Entry->Argument[ArgumentCounter].Integer);
+                                        break;
+      case EVENT_LOG_ARGUMENT_LONGLONG: Written=snprintf(&Buffer[Used], BufferSize-Used, Specification, Entry->Argument[ArgumentCounter].Integer);
+                                        break;
+      case EVENT_LOG_ARGUMENT_DOUBLE:   Written=snprintf(&Buffer[Used], BufferSize-Used, Specification, Entry->Argument[ArgumentCounter].Real);
+                                        break;
+      case EVENT_LOG_ARGUMENT_STRING:   Written=snprintf(&Buffer[Used], BufferSize-Used, Specification, &Entry->Text[Entry->Argument[ArgumentCounter].Integer]);
+                                        break;
+      case EVENT_LOG_ARGUMENT_POINTER:  Written=snprintf(&Buffer[Used], BufferSize-Used, Specification, Entry->Argument[ArgumentCounter].Pointer);
+                                        break;
+    }
+    Used=(Used+Written<BufferSize-1?Used+Written:BufferSize-1);
+    ArgumentCounter++;
+    Format=Next;
+  }
+  Buffer[Used]=0;
+}
 
 
 /*
   Description:
-  Function to handle events to be logged in the outbound circular buffer, for handling by the EventLogger.
+  Return a log entry to the pool. Used by TISM_EventLogger when the entry is written, and by TISM_Postman when the
+  log entry could not be delivered.
 
   Parameters:
-  TISM_Task ThisTask      - Struct containing all relevant information for this task to run. This is provided by the scheduler.
+  uint32_t EntryID        - ID of the log entry (the Message-field of the log message).
+  
+  Return value:
+  None
+*/
+void TISM_EventLoggerReleaseEntry(uint32_t EntryID)
+{
+  if(EntryID>=EVENT_LOG_POOL_SIZE)
+    return;
+  uint32_t LockState=spin_lock_blocking(TISM_EventLoggerData.Lock);
+  TISM_EventLoggerData.Entry[EntryID].NextEntry=TISM_EventLoggerData.FirstFreeEntry;
+  TISM_EventLoggerData.FirstFreeEntry=EntryID;
+  spin_unlock(TISM_EventLoggerData.Lock, LockState);
+}
+
+
+/*
+  Description:
+  Log the statistics of the output buffer (see EVENT_LOG_OUTPUT_BUFFER). Used by TISM_TaskManager.
+
+  Parameters:
+  TISM_Task *ThisTask     - Pointer to struct containing all relevant information for the calling task.
+  
+  Return value:
+  None
+*/
+void TISM_EventLoggerLogStatistics(const TISM_Task *ThisTask)
+{
+  if(EVENT_LOG_OUTPUT_BUFFER>0)
+    TISM_EventLoggerLogEvent (ThisTask, TISM_LOG_EVENT_NOTIFY, "Statistics log output: %lu/%d bytes used, %lu max, %lu lines dropped.", TISM_EventLoggerData.OutputUsed, EVENT_LOG_OUTPUT_BUFFER, TISM_EventLoggerData.OutputHighWaterMark, TISM_EventLoggerData.LinesDropped);
+}
+
+
+/*
+  Description:
+  Reset the statistics of the output buffer (high water mark and number of dropped lines).
+
+  Parameters:
+  None
+  
+  Return value:
+  None
+*/
+void TISM_EventLoggerResetStatistics()
+{
+  TISM_EventLoggerData.OutputHighWaterMark=TISM_EventLoggerData.OutputUsed;
+  TISM_EventLoggerData.LinesDropped-=TISM_EventLoggerData.LinesDroppedReported;
+  TISM_EventLoggerData.LinesDroppedReported=0;
+}
+
+
+/*
+  Description:
+  Initialize the pool of log entries and the output buffer. Called once by TISM_InitializeSystem, before anything is logged.
+
+  Parameters:
+  None
+  
+  Return value:
+  None
+*/
+void TISM_EventLoggerInit()
+{
+  for(uint8_t EntryID=0;EntryID<EVENT_LOG_POOL_SIZE;EntryID++)
+    TISM_EventLoggerData.Entry[EntryID].NextEntry=(EntryID+1<EVENT_LOG_POOL_SIZE?EntryID+1:EVENT_LOG_NO_ENTRY);
+  TISM_EventLoggerData.FirstFreeEntry=0;
+  TISM_EventLoggerData.Lock=spin_lock_instance(spin_lock_claim_unused(true));
+  TISM_EventLoggerData.OutputHead=0;
+  TISM_EventLoggerData.OutputTail=0;
+  TISM_EventLoggerData.OutputUsed=0;
+  TISM_EventLoggerData.OutputHighWaterMark=0;
+  TISM_EventLoggerData.LinesDropped=0;
+  TISM_EventLoggerData.LinesDroppedReported=0;
+}
+
+
+/*
+  Description:
+  Function to handle events to be logged in the outbound circular buffer, for handling by the EventLogger. The event is
+  stored in an entry from the pool of log entries; no memory is allocated.
+
+  Parameters:
+  TISM_Task *ThisTask     - Pointer to struct containing all relevant information for this task to run. This is provided by the scheduler.
   uint8_t LogEntryType    - Type of event (notification or error; see TISM.h).
   const char *format, ... - Composition of a string with the event to handle (use the same formatting as with printf, eg "%s-%d").
+                            With EVENT_LOG_DEFERRED_FORMAT this must be a constant string.
   
   Return value:
-  false                   - Event could not be delivered (unable to store in the outbound circular buffer).
+  false                   - Event could not be delivered (no free log entry or unable to store in the outbound circular buffer).
   true                    - Event logged succesfully.
 */
-bool TISM_EventLoggerLogEvent (TISM_Task ThisTask, uint8_t LogEntryType, const char *format, ...)
+bool TISM_EventLoggerLogEvent (const TISM_Task *ThisTask, uint8_t LogEntryType, const char *format, ...)
 {
-  char *ReturnBuffer=malloc(sizeof(char)*EVENT_LOG_ENTRY_LENGTH);
+  // Claim an entry from the pool.
+  uint32_t LockState=spin_lock_blocking(TISM_EventLoggerData.Lock);
+  uint8_t EntryID=TISM_EventLoggerData.FirstFreeEntry;
+  if(EntryID!=EVENT_LOG_NO_ENTRY)
+    TISM_EventLoggerData.FirstFreeEntry=TISM_EventLoggerData.Entry[EntryID].NextEntry;
+  spin_unlock(TISM_EventLoggerData.Lock, LockState);
+  if(EntryID==EVENT_LOG_NO_ENTRY)
+    return(false);
+
+  // Store the arguments, or format the entry right away when we can't defer it.
+  TISM_EventLogEntry *Entry=&TISM_EventLoggerData.Entry[EntryID];
   va_list args;
   va_start(args,format);
+  Entry->Format=format;
+  if(!EVENT_LOG_DEFERRED_FORMAT || !TISM_EventLoggerStoreArguments(Entry, format, args))
+  {
+    va_end(args);
+    va_start(args,format);
+    Entry->Format=NULL;
+    vsnprintf(Entry->Text,EVENT_LOG_ENTRY_LENGTH,format,args);
+  }
   va_end(args);
-  vsnprintf(ReturnBuffer,EVENT_LOG_ENTRY_LENGTH,format,args);
-  return(TISM_CircularBufferWriteWithTimestamp(ThisTask.OutboundMessageQueue, ThisTask.TaskID, System.TISM_EventLoggerTaskID, LogEntryType, (uint32_t)ReturnBuffer, 0, time_us_64()));
+  if(!TISM_PostmanQueueMessage(ThisTask, TISM_EVENTLOGGER_TASK_ID, LogEntryType, EntryID, 0, time_us_64()))
+  {
+    TISM_EventLoggerReleaseEntry(EntryID);
+    return(false);
+  }
+  return(true);
 }
 
 
@@ -48,38 +473,41 @@ bool TISM_EventLoggerLogEvent (TISM_Task ThisTask, uint8_t LogEntryType, const c
 
 
   Parameters:
-  TISM_Task ThisTask      - Struct containing all relevant information for this task to run. This is provided by the scheduler.
+  TISM_Task *ThisTask     - Pointer to struct containing all relevant information for this task to run. This is provided by the scheduler.
   
   Return value:
   <non-zero value>        - Task returned an error when executing. A non-zero value will stop the system.
   OK                      - Run succesfully completed.                    - Run succesfully completed.
 */
-uint8_t TISM_EventLogger (TISM_Task ThisTask)
+uint8_t TISM_EventLogger (TISM_Task *ThisTask)
 {
-  if (ThisTask.TaskDebug==DEBUG_HIGH) fprintf(STDOUT, "%llu %s (ID %d): Run starting.\n", time_us_64(), ThisTask.TaskName, ThisTask.TaskID);
+  if (ThisTask->TaskDebug==DEBUG_HIGH) TISM_EventLoggerOutput(STDOUT, "%llu %s (ID %d): Run starting.\n", time_us_64(), ThisTask->TaskName, ThisTask->TaskID);
   
-  switch(ThisTask.TaskState)   
+  switch(ThisTask->TaskState)   
   {
     case INIT:  // Activities to initialize this task (e.g. initialize ports or peripherals).
-                // Write the first log entry
-                fprintf(STDOUT, "%llu %s (ID %d): Logging started.\n", time_us_64(), ThisTask.TaskName, ThisTask.TaskID);
+                // Set up the sink of the output buffer and write the first log entry.
+                if(EVENT_LOG_OUTPUT_BUFFER>0)
+                  TISM_EventLoggerSinkInit();
+                TISM_EventLoggerOutput(STDOUT, "%llu %s (ID %d): Logging started.\n", time_us_64(), ThisTask->TaskName, ThisTask->TaskID);
 
-                if (ThisTask.TaskDebug) fprintf(STDOUT, "%llu %s (ID %d): Initializing with priority %d.\n", time_us_64(), ThisTask.TaskName, ThisTask.TaskID, ThisTask.TaskPriority);
+                if (ThisTask->TaskDebug) TISM_EventLoggerOutput(STDOUT, "%llu %s (ID %d): Initializing with priority %d.\n", time_us_64(), ThisTask->TaskName, ThisTask->TaskID, ThisTask->TaskPriority);
 				        
                 // As the EventLogger only responds to events, go to sleep.
                 TISM_TaskManagerSetMyTaskAttribute(ThisTask,TISM_SET_TASK_SLEEP,true);
 				        break;
 	  case RUN:   // Do the work.						
-		      	    if (ThisTask.TaskDebug==DEBUG_HIGH) fprintf(STDOUT, "%llu %s (ID %d): Doing work with priority %d on core %d.\n", time_us_64(), ThisTask.TaskName, ThisTask.TaskID, ThisTask.TaskPriority, ThisTask.RunningOnCoreID);
+		      	    if (ThisTask->TaskDebug==DEBUG_HIGH) TISM_EventLoggerOutput(STDOUT, "%llu %s (ID %d): Doing work with priority %d on core %d.\n", time_us_64(), ThisTask->TaskName, ThisTask->TaskID, ThisTask->TaskPriority, ThisTask->RunningOnCoreID);
 
                 // First check for incoming messages and process them.
                 uint8_t MessageCounter=0;
                 TISM_Message *MessageToProcess;
+                char LogText[EVENT_LOG_ENTRY_LENGTH];
                 while((TISM_PostmanMessagesWaiting(ThisTask)>0) && (MessageCounter<MAX_MESSAGES))
                 {
                   MessageToProcess=TISM_PostmanReadMessage(ThisTask);
 
-                  if (ThisTask.TaskDebug) fprintf(STDOUT, "%llu %s (ID %d): Message '%ld' type %d from TaskID %d (%s) received.\n", time_us_64(), ThisTask.TaskName, ThisTask.TaskID, MessageToProcess->Message, MessageToProcess->MessageType, MessageToProcess->SenderTaskID, System.Task[MessageToProcess->SenderTaskID].TaskName);
+                  if (ThisTask->TaskDebug) TISM_EventLoggerOutput(STDOUT, "%llu %s (ID %d): Message '%ld' type %d from TaskID %d (%s) received.\n", time_us_64(), ThisTask->TaskName, ThisTask->TaskID, MessageToProcess->Message, MessageToProcess->MessageType, MessageToProcess->SenderTaskID, System.Task[MessageToProcess->SenderTaskID].TaskName);
 
                   // Processed the message; delete it.
                   switch(MessageToProcess->MessageType)
@@ -88,26 +516,40 @@ uint8_t TISM_EventLogger (TISM_Task ThisTask)
                                                 TISM_PostmanWriteMessage(ThisTask,MessageToProcess->SenderTaskID,TISM_ECHO,MessageToProcess->Message,0);
                                                 break;
                     case TISM_LOG_EVENT_NOTIFY: // Log event message; write the message to STDOUT.
-                                                fprintf(STDOUT, "%llu %s (ID %d): %s\n", MessageToProcess->MessageTimestamp, System.Task[MessageToProcess->SenderTaskID].TaskName, MessageToProcess->SenderTaskID, (char *)MessageToProcess->Message);
-                                                free((char *)MessageToProcess->Message); 
+                                                if(MessageToProcess->Message<EVENT_LOG_POOL_SIZE)
+                                                {
+                                                  TISM_EventLoggerFormat(&TISM_EventLoggerData.Entry[MessageToProcess->Message], LogText, EVENT_LOG_ENTRY_LENGTH);
+                                                  TISM_EventLoggerOutput(STDOUT, "%llu %s (ID %d): %s\n", MessageToProcess->MessageTimestamp, System.Task[MessageToProcess->SenderTaskID].TaskName, MessageToProcess->SenderTaskID, LogText);
+                                                  TISM_EventLoggerReleaseEntry(MessageToProcess->Message);
+                                                }
                                                 break;
                     case TISM_LOG_EVENT_ERROR:  // Log error message; write the message to STDERR.
-                                                fprintf(STDERR, "%llu %s (ID %d) ERROR: %s\n", MessageToProcess->MessageTimestamp, System.Task[MessageToProcess->SenderTaskID].TaskName, MessageToProcess->SenderTaskID, (char *)MessageToProcess->Message);
-                                                free((char *)MessageToProcess->Message); 
+                                                if(MessageToProcess->Message<EVENT_LOG_POOL_SIZE)
+                                                {
+                                                  TISM_EventLoggerFormat(&TISM_EventLoggerData.Entry[MessageToProcess->Message], LogText, EVENT_LOG_ENTRY_LENGTH);
+                                                  TISM_EventLoggerOutput(STDERR, "%llu %s (ID %d) ERROR: %s\n", MessageToProcess->MessageTimestamp, System.Task[MessageToProcess->SenderTaskID].TaskName, MessageToProcess->SenderTaskID, LogText);
+                                                  TISM_EventLoggerReleaseEntry(MessageToProcess->Message);
+                                                }
                                                 break;
                     default:                    // Unknown message type - ignore.
-                    printf("FOUT: message type %d\n",MessageToProcess->MessageType);
                                                 break;
                   }
                   TISM_PostmanDeleteMessage(ThisTask);
                   MessageCounter++;
                 }
 
-                // Logs handled; return to sleep.
-                TISM_TaskManagerSetMyTaskAttribute(ThisTask,TISM_SET_TASK_SLEEP,true);
+                // Logs handled. Write the next chunk of output; return to sleep when all output has been written.
+                if(TISM_EventLoggerDrain())
+                  ThisTask->TaskWakeUpTimer=time_us_64()+EVENT_LOG_OUTPUT_INTERVAL;
+                else
+                  TISM_TaskManagerSetMyTaskAttribute(ThisTask,TISM_SET_TASK_SLEEP,true);
 				        break;
 	  case STOP:  // Task required to stop this task, including the last log entry.
-                fprintf(STDOUT, "%llu %s (ID %d): Logging stopped.\n", time_us_64(), ThisTask.TaskName, ThisTask.TaskID);
+                TISM_EventLoggerOutput(STDOUT, "%llu %s (ID %d): Logging stopped.\n", time_us_64(), ThisTask->TaskName, ThisTask->TaskID);
+
+                // Write all pending output before going down.
+                while(TISM_EventLoggerDrain())
+                  tight_loop_contents();
 
                 // Set the task state to DOWN. 
                 TISM_TaskManagerSetMyTaskAttribute(ThisTask,TISM_SET_TASK_STATE,DOWN);
@@ -115,7 +557,7 @@ uint8_t TISM_EventLogger (TISM_Task ThisTask)
   }
 		
   // Run completed.
-  if (ThisTask.TaskDebug==DEBUG_HIGH) fprintf(STDOUT, "%llu %s (ID %d): Run completed.\n", time_us_64(), ThisTask.TaskName, ThisTask.TaskID);
+  if (ThisTask->TaskDebug==DEBUG_HIGH) TISM_EventLoggerOutput(STDOUT, "%llu %s (ID %d): Run completed.\n", time_us_64(), ThisTask->TaskName, ThisTask->TaskID);
 
   return (OK);
 }
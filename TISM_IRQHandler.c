@@ -1,17 +1,20 @@
 /*
   IRQHandler.c
   ============
-  Routines to process external interrupts (IRQs). Other functions can 'subscribe' to these events, after which IRQHandler will
-  send messages when events occur. This task uses the global circular buffer IRQHandlerInboundQueue defined in TISM_Definitions.h
+  Routines to process external interrupts (IRQs). Other functions can 'subscribe' to these events, after which the interrupt
+  handler sends messages to the subscribed tasks when events occur.
 
   The IRQ handler process:
   - Task subscribe thenselves to events on GPIOs by using TISM_IRQHandlerSubscribe-function, which sends a 
     subscription-message to TISM_IRQHandler (type=GPIO number, message=interrupt events).
-  - TISM_IRQHander registers the subscriptions (using linear list) and the generic eventhandler to the specified GPIO.
-  - When an interrupt is received TISM_IRQHandler (TISM_IRQHandlerCallback function) writes a message to IRQHandlerInboundQueue.
-  - TISM_Scheduler continuously checks for the availability of new messages in this queue. If a message is waiting, 
-    TISM_IRQHandler is started.
-  - Based on the linear list TISM_IRQHandler sends messages to the corresponding tasks via the regular messaging method.
+  - TISM_IRQHander registers the subscriptions in a fixed table (MAX_IRQ_SUBSCRIPTIONS entries, no heap) and the generic
+    interrupt handler to the specified GPIO. Each GPIO keeps a bitmask of the entries in the table subscribed to it.
+  - When an interrupt is received the interrupt handler (TISM_IRQHandlerCallback function) walks the subscriptions of the
+    GPIO, applies the anti-bounce timeout of each subscription and writes the message straight into the inbound queue of
+    the subscribed task, waking it up when it is sleeping. No task has to run before the event reaches the subscriber;
+    bouncing inputs are filtered before they take up any queue space.
+  - When the inbound queue of a subscriber is full, the events are kept (coalesced) and sent along with the next event
+    of that GPIO that gets through.
   - The subscribed tasks will receive a message coming from TISM_IRQHandler, GPIO number as message type and Event number as 
     message for further processing.
 
@@ -30,14 +33,14 @@
   The internal structures for the IRQ handler.
 */
 
-// Structure of the linear list containing all subscriptions to interrupts; one list per GPIO.
+// Structure of an entry in the table of subscriptions to interrupts.
 struct TISM_IRQHandlerSubscription
 {
   uint8_t TaskID;
   uint32_t Events;
   uint32_t AntiBounceTimeout;
+  uint32_t PostponedEvents;            // Events not delivered as the inbound queue of the task was full.
   uint64_t LastSuccessfullInterrupt;
-  struct TISM_IRQHandlerSubscription *NextSubscription;
 };
 
 
@@ -46,14 +49,19 @@ struct TISM_IRQHandlerDataGPIO
 {
   bool Initialized, GPIOPullDown;
   uint32_t EventMask;
-  struct TISM_IRQHandlerSubscription *Subscriptions;
+  uint32_t Subscriptions;              // Bitmask of the entries in the subscription table for this GPIO.
 };
 
 
-// The structure containing all data for TISM_IRQHandler to run.
+// The structure containing all data for TISM_IRQHandler to run. The table is shared with the interrupt handler and protected
+// by the spinlock.
 struct TISM_IRQHandlerData
 {
   struct TISM_IRQHandlerDataGPIO GPIO[NUMBER_OF_GPIO_PORTS];
+  struct TISM_IRQHandlerSubscription Subscription[MAX_IRQ_SUBSCRIPTIONS];
+  uint32_t FreeSubscriptions;          // Bitmask of the free entries in the subscription table.
+  uint32_t Interrupts, Delivered, Bounced, Postponed;
+  spin_lock_t *Lock;
 } TISM_IRQHandlerData;
 
 
@@ -68,7 +76,7 @@ struct TISM_IRQHandlerData
         GPIO_FUNC_SIO, direction is set to input and treated as 'pull down' port.
 
   Parameters:
-  TISM_Task ThisTask         - Struct containing all task related information.
+  TISM_Task *ThisTask        - Pointer to struct containing all task related information.
   uint GPIO                  - GPIO subscription to modify.
   uint32_t Events            - Events to subscribe to (one or more, by applying bitwise OR '|'):
                                GPIO_IRQ_LEVEL_LOW
@@ -86,134 +94,273 @@ struct TISM_IRQHandlerData
   Return value:
   false - Message delivery failed.
   true  - Request sent.
-*/bool TISM_IRQHandlerSubscribe(TISM_Task ThisTask, uint8_t GPIO, uint32_t Events, bool GPIOPullDown, uint32_t AntiBounceTimeout)
+*/bool TISM_IRQHandlerSubscribe(const TISM_Task *ThisTask, uint8_t GPIO, uint32_t Events, bool GPIOPullDown, uint32_t AntiBounceTimeout)
 {
   // Use the Specification-field in the message to capture the AntiBounceTimeout and the GPIOPullDown.
   uint32_t CombinedValue=(0xFFFFFF & AntiBounceTimeout)+(GPIOPullDown==true?0x01000000:0);
-  return(TISM_PostmanWriteMessage(ThisTask,System.TISM_IRQHandlerTaskID,GPIO,Events,CombinedValue));
+  return(TISM_PostmanWriteMessage(ThisTask,TISM_IRQHANDLER_TASK_ID,GPIO,Events,CombinedValue));
 }
 
 
-// Calculate the event mask for all registered subscriptions for a specific GPIO by calculating the OR-value of all events.
-uint32_t TISM_IRQHandlerCalculateEventsMask(struct TISM_IRQHandlerSubscription *GPIO)
+// Internal function - calculate the event mask for all registered subscriptions for a specific GPIO by calculating the
+// OR-value of all events.
+uint32_t TISM_IRQHandlerCalculateEventsMask(uint8_t GPIO)
 {
-  uint32_t EventMask=0;
-  struct TISM_IRQHandlerSubscription *NextGPIO;
+  uint32_t EventMask=0, Subscriptions=TISM_IRQHandlerData.GPIO[GPIO].Subscriptions;
+  while(Subscriptions!=0)
+  {
+    EventMask|=TISM_IRQHandlerData.Subscription[__builtin_ctz(Subscriptions)].Events;
+    Subscriptions&=Subscriptions-1;
+  }
+  return(EventMask);
+}
+
+
+// Internal function - find the entry in the subscription table of the specified task for the specified GPIO.
+// Returns -1 when the task has no subscription to this GPIO.
+int8_t TISM_IRQHandlerFindSubscription(uint8_t GPIO, uint8_t TaskID)
+{
+  uint32_t Subscriptions=TISM_IRQHandlerData.GPIO[GPIO].Subscriptions;
+  while(Subscriptions!=0)
+  {
+    uint8_t Entry=__builtin_ctz(Subscriptions);
+    if(TISM_IRQHandlerData.Subscription[Entry].TaskID==TaskID)
+      return(Entry);
+    Subscriptions&=Subscriptions-1;
+  }
+  return(-1);
+}
+
 
-  // Is the first value not null (no subscription registered for this GPIO)?
-  if(GPIO!=NULL)
+//  The generic interrupt handler; this function is registered for handling of all interrupts. When an interrupt occurs
+//  the events are written straight into the inbound queues of the subscribed tasks, taking the anti bounce timeout of each
+//  subscription into account. Runs in interrupt context.
+void TISM_IN_RAM(TISM_IRQHandlerCallback)(uint8_t GPIO,uint32_t Events)
+{
+  uint64_t Now=time_us_64();
+  if(TRACE_ENABLED) TISM_TraceRecord(TRACE_IRQ, TISM_IRQHANDLER_TASK_ID, (GPIO<<8)|(Events&0xFF));
+  uint32_t LockState=spin_lock_blocking(TISM_IRQHandlerData.Lock);
+  TISM_IRQHandlerData.Interrupts++;
+  uint32_t Subscriptions=TISM_IRQHandlerData.GPIO[GPIO].Subscriptions;
+  while(Subscriptions!=0)
   {
-    // Run through all the registered subscription events and calculate the events mask (OR-function of all registered events).
-    NextGPIO=GPIO;
-    do
+    struct TISM_IRQHandlerSubscription *Subscription=&TISM_IRQHandlerData.Subscription[__builtin_ctz(Subscriptions)];
+    Subscriptions&=Subscriptions-1;
+    if((Events & Subscription->Events)==0)
+      continue;
+
+    // Is an anti bounce value specified? If so, did we receive this interrupt too soon?
+    if((Subscription->AntiBounceTimeout!=0) && (Now<=Subscription->LastSuccessfullInterrupt+Subscription->AntiBounceTimeout))
+    {
+      TISM_IRQHandlerData.Bounced++;
+      continue;
+    }
+    Subscription->LastSuccessfullInterrupt=Now;
+
+    // Deliver, including the events we couldn't deliver before. Keep the events when the inbound queue is full.
+    if(TISM_PostmanDeliverAndWake(TISM_IRQHANDLER_TASK_ID,Subscription->TaskID,GPIO,Events|Subscription->PostponedEvents,TISM_IRQHandlerData.GPIO[GPIO].GPIOPullDown,Now))
     {
-      EventMask=EventMask|NextGPIO->Events;
-      NextGPIO=NextGPIO->NextSubscription;
+      Subscription->PostponedEvents=0;
+      TISM_IRQHandlerData.Delivered++;
+    }
+    else
+    {
+      Subscription->PostponedEvents|=Events;
+      TISM_IRQHandlerData.Postponed++;
     }
-    while(NextGPIO!=NULL);
   }
-  else
+  spin_unlock(TISM_IRQHandlerData.Lock, LockState);
+  gpio_acknowledge_irq(GPIO,Events);
+
+  // Wake up the other core in case it is idle; this core wakes up by handling the interrupt.
+  __sev();
+}
+
+
+// Internal function - register, modify or remove the subscription of a task to a GPIO, as requested in the message.
+void TISM_IRQHandlerUpdateSubscription(TISM_Task *ThisTask, TISM_Message *MessageToProcess)
+{
+  uint8_t GPIO=MessageToProcess->MessageType;
+  struct TISM_IRQHandlerDataGPIO *GPIOData=&TISM_IRQHandlerData.GPIO[GPIO];
+
+  // Is this GPIO already initialized? If not, then this is our first subscription.
+  if(!GPIOData->Initialized)
   {
-    // Current GPIO register is empty; return 0.
-    return(0);
+    // Bug fix; when we receive an IRQ_UNSUBSCRIBE-request to an uninitialized port.
+    if(MessageToProcess->Message==IRQ_UNSUBSCRIBE)
+    {
+      TISM_EventLoggerLogEvent (ThisTask, TISM_LOG_EVENT_ERROR, "Warning - Unsubscribe request received from %d (%s) for an uninitialized GPIO (%d); ignoring.", MessageToProcess->SenderTaskID, System.Task[MessageToProcess->SenderTaskID].TaskName, GPIO);
+      return;
+    }
+
+    // Initialize the GPIO port for inbound, with the internal pull-down resistor set.
+    gpio_set_function(GPIO, GPIO_FUNC_SIO);
+    gpio_set_dir(GPIO, false);
+
+    // Is the 'pull down' bit set in the Specification-field?
+    if((MessageToProcess->Specification & 0x01000000)==0x01000000)
+    {
+      gpio_pull_down(GPIO);
+      GPIOData->GPIOPullDown=true;
+    }
+    else
+    {
+      gpio_pull_up(GPIO);
+      GPIOData->GPIOPullDown=false;
+    }
+
+    if (ThisTask->TaskDebug==DEBUG_HIGH) TISM_EventLoggerLogEvent (ThisTask, TISM_LOG_EVENT_NOTIFY, "First subscription, GPIO %d initialized (request from Task ID %d, event %d, internal resistor pull-%s).", GPIO, MessageToProcess->SenderTaskID, MessageToProcess->Message, (GPIOData->GPIOPullDown==false?"up":"down"));
+
+    GPIOData->Initialized=true;
+  }
+
+  // Find the entry for this TaskID in the subscription table and update it, or claim a new one. The interrupt handler
+  // reads the table; change it while holding the lock.
+  int8_t Entry=TISM_IRQHandlerFindSubscription(GPIO, MessageToProcess->SenderTaskID);
+  uint32_t PreviousEventMask=GPIOData->EventMask;
+  bool TableFull=false;
+  uint32_t LockState=spin_lock_blocking(TISM_IRQHandlerData.Lock);
+  if(Entry>=0)
+  {
+    if(MessageToProcess->Message==IRQ_UNSUBSCRIBE)
+    {
+      // Unsubscribe = release the entry.
+      GPIOData->Subscriptions&=~(1u<<Entry);
+      TISM_IRQHandlerData.FreeSubscriptions|=(1u<<Entry);
+    }
+    else
+      TISM_IRQHandlerData.Subscription[Entry].Events=MessageToProcess->Message;
+  }
+  else if(MessageToProcess->Message!=IRQ_UNSUBSCRIBE)
+  {
+    if(TISM_IRQHandlerData.FreeSubscriptions!=0)
+    {
+      Entry=__builtin_ctz(TISM_IRQHandlerData.FreeSubscriptions);
+      TISM_IRQHandlerData.Subscription[Entry].TaskID=MessageToProcess->SenderTaskID;
+      TISM_IRQHandlerData.Subscription[Entry].Events=MessageToProcess->Message;
+      TISM_IRQHandlerData.Subscription[Entry].AntiBounceTimeout=(MessageToProcess->Specification & 0xFFFFFF);
+      TISM_IRQHandlerData.Subscription[Entry].PostponedEvents=0;
+      TISM_IRQHandlerData.Subscription[Entry].LastSuccessfullInterrupt=0;
+      TISM_IRQHandlerData.FreeSubscriptions&=~(1u<<Entry);
+      GPIOData->Subscriptions|=(1u<<Entry);
+    }
+    else
+      TableFull=true;
+  }
+  GPIOData->EventMask=TISM_IRQHandlerCalculateEventsMask(GPIO);
+  spin_unlock(TISM_IRQHandlerData.Lock, LockState);
+
+  if(TableFull)
+  {
+    TISM_EventLoggerLogEvent (ThisTask, TISM_LOG_EVENT_ERROR, "Subscription of task ID %d (%s) to GPIO %d failed; maximum number of subscriptions (%d) reached.", MessageToProcess->SenderTaskID, System.Task[MessageToProcess->SenderTaskID].TaskName, GPIO, MAX_IRQ_SUBSCRIPTIONS);
+    return;
+  }
+
+  // (Re)register our interrupt-handler to this GPIO, and disable the events no task is subscribed to anymore.
+  if(GPIOData->EventMask!=0)
+    gpio_set_irq_enabled_with_callback(GPIO,GPIOData->EventMask,true,(void*)&TISM_IRQHandlerCallback);
+  if((PreviousEventMask & ~GPIOData->EventMask)!=0)
+    gpio_set_irq_enabled_with_callback(GPIO,PreviousEventMask & ~GPIOData->EventMask,false,(void*)&TISM_IRQHandlerCallback);
+
+  if (ThisTask->TaskDebug)
+  {
+    TISM_EventLoggerLogEvent (ThisTask, TISM_LOG_EVENT_NOTIFY, "Subscriptions list for GPIO %d updated.", GPIO);
+    TISM_EventLoggerLogEvent (ThisTask, TISM_LOG_EVENT_NOTIFY, "Tasks registered to interrupts on this GPIO:");
+    TISM_EventLoggerLogEvent (ThisTask, TISM_LOG_EVENT_NOTIFY, "============================================");
+    uint32_t Subscriptions=GPIOData->Subscriptions;
+    while(Subscriptions!=0)
+    {
+      struct TISM_IRQHandlerSubscription *Subscription=&TISM_IRQHandlerData.Subscription[__builtin_ctz(Subscriptions)];
+      TISM_EventLoggerLogEvent (ThisTask, TISM_LOG_EVENT_NOTIFY, "Task ID: %d (%s) subscribed to event %d, anti-bounce value %d.", Subscription->TaskID, System.Task[Subscription->TaskID].TaskName, Subscription->Events, Subscription->AntiBounceTimeout);
+      Subscriptions&=Subscriptions-1;
+    }
+    TISM_EventLoggerLogEvent (ThisTask, TISM_LOG_EVENT_NOTIFY, "List complete. Summary event mask: %ld. GPIO initialized as %s.", GPIOData->EventMask, (GPIOData->GPIOPullDown?"pull-down":"pull-up"));
   }
-  return(EventMask);
 }
 
 
-//  The generic interrupt handler; this function is registered for handling of all interrupts. When an interrupt occurs
-//  the details of the event are written to a circular buffer (IRQHandlerInboundQueue) for future processing.
-void TISM_IRQHandlerCallback(uint8_t GPIO,uint32_t Events)
+/*
+  Description
+  Reset the interrupt statistics (number of interrupts, delivered events, events within the anti bounce timeout and
+  events postponed because the inbound queue of the subscriber was full).
+
+  Parameters:
+  None
+
+  Return value:
+  None
+*/
+void TISM_IRQHandlerResetStatistics()
 {
-  // Interrupt received; write the interrupt to the circular buffer IRQHandlerInboundQueue for later processing.
-  TISM_CircularBufferWrite(&IRQHandlerInboundQueue,System.TISM_IRQHandlerTaskID,System.TISM_IRQHandlerTaskID,GPIO,Events,0);
-  gpio_acknowledge_irq(GPIO,Events);
+  uint32_t LockState=spin_lock_blocking(TISM_IRQHandlerData.Lock);
+  TISM_IRQHandlerData.Interrupts=0;
+  TISM_IRQHandlerData.Delivered=0;
+  TISM_IRQHandlerData.Bounced=0;
+  TISM_IRQHandlerData.Postponed=0;
+  spin_unlock(TISM_IRQHandlerData.Lock, LockState);
 }
 
 
 /*
   Description
-  The main task for the IRQ handler. Handles the initialization and registration of subscriptions to GPIO interrupts.
-  This function is called by TISM_Scheduler.
+  Initialize the subscription table. Called once by TISM_InitializeSystem, before any interrupt can occur.
 
   Parameters:
-  TISM_Task ThisTask - Struct containing all task related information.
+  None
+
+  Return value:
+  None
+*/
+void TISM_IRQHandlerInit()
+{
+  TISM_IRQHandlerData.Lock=spin_lock_instance(spin_lock_claim_unused(true));
+  for(uint8_t counter=0;counter<NUMBER_OF_GPIO_PORTS;counter++)
+  {
+    TISM_IRQHandlerData.GPIO[counter].Initialized=false;
+    TISM_IRQHandlerData.GPIO[counter].GPIOPullDown=true;
+    TISM_IRQHandlerData.GPIO[counter].EventMask=0;
+    TISM_IRQHandlerData.GPIO[counter].Subscriptions=0;
+  }
+  TISM_IRQHandlerData.FreeSubscriptions=(MAX_IRQ_SUBSCRIPTIONS==32?0xFFFFFFFF:(1u<<MAX_IRQ_SUBSCRIPTIONS)-1);
+  TISM_IRQHandlerResetStatistics();
+}
+
+
+/*
+  Description
+  The main task for the IRQ handler. Handles the registration of subscriptions to GPIO interrupts; the interrupts
+  themselves are handled by TISM_IRQHandlerCallback. This function is called by TISM_Scheduler.
+
+  Parameters:
+  TISM_Task *ThisTask - Pointer to struct containing all task related information.
 
   Return value:
   OK              - Task run completed succesfully.
   None-zero value - Error
 */
-uint8_t TISM_IRQHandler (TISM_Task ThisTask)
+uint8_t TISM_IRQHandler (TISM_Task *ThisTask)
 {
-  if (ThisTask.TaskDebug==DEBUG_HIGH) TISM_EventLoggerLogEvent (ThisTask, TISM_LOG_EVENT_NOTIFY, "Run starting.");
+  if (ThisTask->TaskDebug==DEBUG_HIGH) TISM_EventLoggerLogEvent (ThisTask, TISM_LOG_EVENT_NOTIFY, "Run starting.");
   
-  switch(ThisTask.TaskState)   
+  switch(ThisTask->TaskState)   
   {
     case INIT:  // Task required to initialize                
-		      	    if (ThisTask.TaskDebug==DEBUG_HIGH) TISM_EventLoggerLogEvent (ThisTask, TISM_LOG_EVENT_NOTIFY, "Doing work with priority %d on core %d.", ThisTask.TaskPriority, ThisTask.RunningOnCoreID);
+		      	    if (ThisTask->TaskDebug==DEBUG_HIGH) TISM_EventLoggerLogEvent (ThisTask, TISM_LOG_EVENT_NOTIFY, "Doing work with priority %d on core %d.", ThisTask->TaskPriority, ThisTask->RunningOnCoreID);
 
-                // Init the circular buffer to receive interrupts and clear the subscription-list.
-                TISM_CircularBufferInit (&IRQHandlerInboundQueue);           
-                for(uint8_t counter=0;counter<NUMBER_OF_GPIO_PORTS;counter++)
-                {
-                  TISM_IRQHandlerData.GPIO[counter].Initialized=false;
-                  TISM_IRQHandlerData.GPIO[counter].GPIOPullDown=true;                  
-                  TISM_IRQHandlerData.GPIO[counter].EventMask=0;
-                  TISM_IRQHandlerData.GPIO[counter].Subscriptions=NULL;
-                }
-
-                // Go to sleep; we only wake on incoming messages. 
+                // The subscription table is initialized by TISM_IRQHandlerInit. Go to sleep; we only wake on incoming messages. 
                 TISM_TaskManagerSetMyTaskAttribute(ThisTask,TISM_SET_TASK_SLEEP,true);
 				        break;
 	  case RUN:   // Do the work						
-		      	    if (ThisTask.TaskDebug==DEBUG_HIGH) TISM_EventLoggerLogEvent (ThisTask, TISM_LOG_EVENT_NOTIFY, "Doing work with priority %d on core %d.", ThisTask.TaskPriority, ThisTask.RunningOnCoreID);
+		      	    if (ThisTask->TaskDebug==DEBUG_HIGH) TISM_EventLoggerLogEvent (ThisTask, TISM_LOG_EVENT_NOTIFY, "Doing work with priority %d on core %d.", ThisTask->TaskPriority, ThisTask->RunningOnCoreID);
 
-                // Are there any interrupts waiting in the circular buffer we need to process?
+                // Check for pending messages from other tasks.
                 uint16_t MessageCounter=0;
                 TISM_Message *MessageToProcess;	
-                while((TISM_CircularBufferMessagesWaiting(&IRQHandlerInboundQueue)>0) && (MessageCounter<MAX_MESSAGES))
-                {
-                  // Read the next IRQ message from the queue and check which tasks have subscribed to it.
-                  MessageToProcess=TISM_CircularBufferRead(&IRQHandlerInboundQueue);
-
-                  if (ThisTask.TaskDebug) TISM_EventLoggerLogEvent (ThisTask, TISM_LOG_EVENT_NOTIFY, "Processing interrupt message '%ld' with type %d from the IRQ handler queue.", MessageToProcess->Message, MessageToProcess->MessageType);
-
-                  if(TISM_IRQHandlerData.GPIO[MessageToProcess->MessageType].Initialized)
-                  {                
-                    struct TISM_IRQHandlerSubscription *SearchPointer=TISM_IRQHandlerData.GPIO[MessageToProcess->MessageType].Subscriptions;
-                    while(SearchPointer!=NULL)
-                    {
-                      if(MessageToProcess->Message & SearchPointer->Events)
-                      {
-                        // Is an anti bounce value specified? If so, did we receive a message too soon?
-                        if((SearchPointer->AntiBounceTimeout==0) || 
-                          (MessageToProcess->MessageTimestamp>(SearchPointer->LastSuccessfullInterrupt+SearchPointer->AntiBounceTimeout)))
-                        {
-                          TISM_PostmanWriteMessage(ThisTask,SearchPointer->TaskID,MessageToProcess->MessageType,MessageToProcess->Message,TISM_IRQHandlerData.GPIO[MessageToProcess->MessageType].GPIOPullDown);                          
-                          SearchPointer->LastSuccessfullInterrupt=MessageToProcess->MessageTimestamp;
-                        }
-                        else
-                        {
-                          // Message blocked as it is received within the anti bounce timeout period.
-                          if (ThisTask.TaskDebug) TISM_EventLoggerLogEvent (ThisTask, TISM_LOG_EVENT_NOTIFY, "Interrupt from GPIO %d blocked for task ID %d, within anti bounce timeout (%d).", MessageToProcess->MessageType, SearchPointer->TaskID, SearchPointer->AntiBounceTimeout);
-                        }
-                      }
-                      SearchPointer=SearchPointer->NextSubscription;
-                    }
-                  }
-          
-                  // Processed the message; delete it.
-                  TISM_CircularBufferDelete(&IRQHandlerInboundQueue);
-                  MessageCounter++;
-                }
-
-                // Now check for other pending messages from other tasks.
-                MessageCounter=0;
                 while((TISM_PostmanMessagesWaiting(ThisTask)>0) && (MessageCounter<MAX_MESSAGES))
                 {
                   MessageToProcess=TISM_PostmanReadMessage(ThisTask);
 
-                  if (ThisTask.TaskDebug) TISM_EventLoggerLogEvent (ThisTask, TISM_LOG_EVENT_NOTIFY, "Message '%ld' type %d from TaskID %d (%s) received.", MessageToProcess->Message, MessageToProcess->MessageType, MessageToProcess->SenderTaskID, System.Task[MessageToProcess->SenderTaskID].TaskName);
+                  if (ThisTask->TaskDebug) TISM_EventLoggerLogEvent (ThisTask, TISM_LOG_EVENT_NOTIFY, "Message '%ld' type %d from TaskID %d (%s) received.", MessageToProcess->Message, MessageToProcess->MessageType, MessageToProcess->SenderTaskID, System.Task[MessageToProcess->SenderTaskID].TaskName);
 
                   // Processed the message.
                   switch(MessageToProcess->MessageType)
@@ -247,144 +394,8 @@ uint8_t TISM_IRQHandler (TISM_Task ThisTask)
                     case GPIO_26:
                     case GPIO_27:
                     case GPIO_28:   // Subscription request received; register or update.
-                                    // Is this GPIO already initialized? If not, then this is our first subscription.
-                                    if (ThisTask.TaskDebug) TISM_EventLoggerLogEvent (ThisTask, TISM_LOG_EVENT_NOTIFY, "Processing GPIO request.");
-                                    
-                                    struct TISM_IRQHandlerSubscription *SearchPointer, *PreviousSearchPointer;
-                                    if(TISM_IRQHandlerData.GPIO[MessageToProcess->MessageType].Initialized==false)
-                                    {
-                                      // Bug fix; when we receive an IRQ_UNSUBSCRIBE-request to an uninitialized port.
-                                      if(MessageToProcess->Message==IRQ_UNSUBSCRIBE)
-                                      {
-                                        TISM_EventLoggerLogEvent (ThisTask, TISM_LOG_EVENT_ERROR, "Warning - Unsubscribe request received from %d (%s) for an uninitialized GPIO (%d); ignoring.", MessageToProcess->SenderTaskID, System.Task[MessageToProcess->SenderTaskID].TaskName, MessageToProcess->MessageType);
-                                        break;
-                                      }
-
-                                      // Initialize the GPIO port for inbound, with the internal pull-down resistor set.
-                                      gpio_set_function(MessageToProcess->MessageType, GPIO_FUNC_SIO);
-                                      gpio_set_dir(MessageToProcess->MessageType, false);
-
-                                      // Is the 'pull down' bit set in the Specification-field?
-                                      if((MessageToProcess->Specification & 0x01000000)==0x01000000)
-                                      {
-                                        gpio_pull_down(MessageToProcess->MessageType);
-                                        TISM_IRQHandlerData.GPIO[MessageToProcess->MessageType].GPIOPullDown=true;
-                                      }
-                                      else
-                                      {
-                                        gpio_pull_up(MessageToProcess->MessageType);
-                                        TISM_IRQHandlerData.GPIO[MessageToProcess->MessageType].GPIOPullDown=false;
-                                      }
-
-                                      if (ThisTask.TaskDebug==DEBUG_HIGH) TISM_EventLoggerLogEvent (ThisTask, TISM_LOG_EVENT_NOTIFY, "First subscription, GPIO %d initialized (request from Task ID %d, event %d, internal resistor pull-%s).", MessageToProcess->MessageType, MessageToProcess->SenderTaskID, MessageToProcess->Message, (TISM_IRQHandlerData.GPIO[MessageToProcess->MessageType].GPIOPullDown==false?"up":"down"));
-
-                                      TISM_IRQHandlerData.GPIO[MessageToProcess->MessageType].Initialized=true;
-
-                                      // Now register the first subscription in the linear list.
-                                      TISM_IRQHandlerData.GPIO[MessageToProcess->MessageType].Subscriptions=(struct TISM_IRQHandlerSubscription *) malloc(sizeof(struct TISM_IRQHandlerSubscription));
-                                      TISM_IRQHandlerData.GPIO[MessageToProcess->MessageType].Subscriptions->TaskID=MessageToProcess->SenderTaskID;
-                                      TISM_IRQHandlerData.GPIO[MessageToProcess->MessageType].Subscriptions->Events=MessageToProcess->Message;
-                                      TISM_IRQHandlerData.GPIO[MessageToProcess->MessageType].Subscriptions->AntiBounceTimeout=(MessageToProcess->Specification & 0xFFFFFF);
-                                      TISM_IRQHandlerData.GPIO[MessageToProcess->MessageType].Subscriptions->LastSuccessfullInterrupt=0;
-                                      TISM_IRQHandlerData.GPIO[MessageToProcess->MessageType].Subscriptions->NextSubscription=NULL;
-                                    }
-                                    else
-                                    {
-                                      // There are already tasks subscribed to this GPIO. 
-                                      if (ThisTask.TaskDebug==DEBUG_HIGH) TISM_EventLoggerLogEvent (ThisTask, TISM_LOG_EVENT_NOTIFY, "Subscription to GPIO %d being added or modified (Task ID %d, event %d).", MessageToProcess->MessageType, MessageToProcess->SenderTaskID, MessageToProcess->Message);
-
-                                      // Find the entry for this TaskID in the linear list, or create a new one.
-                                      SearchPointer=TISM_IRQHandlerData.GPIO[MessageToProcess->MessageType].Subscriptions;
-                                      PreviousSearchPointer=SearchPointer;
-                                      while((SearchPointer!=NULL) && (SearchPointer->TaskID!=MessageToProcess->SenderTaskID))
-                                      {
-                                        // Not the one weŕe looking for; move to the next entry.
-                                        PreviousSearchPointer=SearchPointer;
-                                        SearchPointer=SearchPointer->NextSubscription;
-                                      }
-
-                                      // Weŕe out of the loop; the pointer is either pointing to an existing record, or at the end of the list.
-                                      if(SearchPointer!=NULL)
-                                      {
-                                        // Delete or update the existing record?
-                                        if(MessageToProcess->Message==IRQ_UNSUBSCRIBE)
-                                        {
-                                          // Unsubscribe = delete the record from the linear list.
-                                          if(SearchPointer==PreviousSearchPointer)
-                                          {
-                                            // The record is the very first in the list.
-                                            TISM_IRQHandlerData.GPIO[MessageToProcess->MessageType].Subscriptions=SearchPointer->NextSubscription;
-                                          }
-                                          else
-                                          {
-                                            // Remove the record from within the list.
-                                            PreviousSearchPointer->NextSubscription=SearchPointer->NextSubscription;
-                                          }
-                                          free(SearchPointer);
-
-                                          if (ThisTask.TaskDebug==DEBUG_HIGH) TISM_EventLoggerLogEvent (ThisTask, TISM_LOG_EVENT_NOTIFY, "Task ID %d unsubscribed from GPIO %d.", MessageToProcess->SenderTaskID, MessageToProcess->MessageType);
-
-                                          // Was this the last subscription to this GPIO? Then we can 'release' this GPIO.
-                                          if(TISM_IRQHandlerData.GPIO[MessageToProcess->MessageType].Subscriptions==NULL)
-                                          {
-                                             // No subscriptions.
-                                            if (ThisTask.TaskDebug==DEBUG_HIGH) TISM_EventLoggerLogEvent (ThisTask, TISM_LOG_EVENT_NOTIFY, "No tasks subscribed to GPIO %d, releasing.", MessageToProcess->MessageType);
-
-                                            // Todo; interrupt handler for GPIO's are never released - not even possible in SDK?
-                                          }
-                                        }
-                                        else
-                                        {
-                                          // Update the existing record in the list.
-                                          SearchPointer->Events=MessageToProcess->Message;
-
-                                          if (ThisTask.TaskDebug==DEBUG_HIGH) TISM_EventLoggerLogEvent (ThisTask, TISM_LOG_EVENT_NOTIFY, "Subscription to GPIO %d modified.", MessageToProcess->MessageType);
-                                        }
-                                      }
-                                      else
-                                      {
-                                        // Add a new record to the linear list
-                                        struct TISM_IRQHandlerSubscription *NewSubscription=(struct TISM_IRQHandlerSubscription *) malloc(sizeof(struct TISM_IRQHandlerSubscription));
-                                        NewSubscription->TaskID=MessageToProcess->SenderTaskID;
-                                        NewSubscription->Events=MessageToProcess->Message;
-                                        NewSubscription->AntiBounceTimeout=(MessageToProcess->Specification & 0xFFFFFF);
-                                        NewSubscription->LastSuccessfullInterrupt=0;
-                                        NewSubscription->NextSubscription=NULL;
-                                        PreviousSearchPointer->NextSubscription=NewSubscription;
-
-                                        if (ThisTask.TaskDebug==DEBUG_HIGH) TISM_EventLoggerLogEvent (ThisTask, TISM_LOG_EVENT_NOTIFY, "Task ID %d subscribed to GPIO %d, anti-bounce value %d", MessageToProcess->SenderTaskID, MessageToProcess->MessageType, NewSubscription->AntiBounceTimeout);                                        
-                                      }
-                                    }
-
-                                    // Recalculate the new eventmask for this GPIO and set it.
-                                    if(TISM_IRQHandlerData.GPIO[MessageToProcess->MessageType].Subscriptions!=NULL)
-                                    {
-                                      // There are still subscriptions left; recalculate the event mask and set the interrupt handler.
-                                      TISM_IRQHandlerData.GPIO[MessageToProcess->MessageType].EventMask=TISM_IRQHandlerCalculateEventsMask(TISM_IRQHandlerData.GPIO[MessageToProcess->MessageType].Subscriptions);
-
-                                      // (Re)register our interrupt-handler to this GPIO.
-                                      gpio_set_irq_enabled_with_callback(MessageToProcess->MessageType,TISM_IRQHandlerData.GPIO[MessageToProcess->MessageType].EventMask,true,(void*)&TISM_IRQHandlerCallback);
-                                    }
-                                    else
-                                    {
-                                      // No subscriptions left. Set the eventmask to 0 and disable the interrupt handler for this GPIO.
-                                      TISM_IRQHandlerData.GPIO[MessageToProcess->MessageType].EventMask=0;
-                                      //gpio_set_irq_enabled_with_callback(MessageToProcess->MessageType,TISM_IRQHandlerData.GPIO[MessageToProcess->MessageType].EventMask,false,(void*)&TISM_IRQHandlerCallback);                                    
-                                    }
-                                    
-		                                if (ThisTask.TaskDebug) 
-                                    {
-                                      TISM_EventLoggerLogEvent (ThisTask, TISM_LOG_EVENT_NOTIFY, "Subscriptions list for GPIO %d updated.", MessageToProcess->MessageType);
-                                      TISM_EventLoggerLogEvent (ThisTask, TISM_LOG_EVENT_NOTIFY, "Tasks registered to interrupts on this GPIO:");
-                                      TISM_EventLoggerLogEvent (ThisTask, TISM_LOG_EVENT_NOTIFY, "============================================");                                      
-                                      SearchPointer=TISM_IRQHandlerData.GPIO[MessageToProcess->MessageType].Subscriptions;
-                                      while(SearchPointer!=NULL)
-                                      {
-                                        TISM_EventLoggerLogEvent (ThisTask, TISM_LOG_EVENT_NOTIFY, "Task ID: %d (%s) subscribed to event %d, anti-bounce value %d.", SearchPointer->TaskID, System.Task[SearchPointer->TaskID].TaskName, SearchPointer->Events, SearchPointer->AntiBounceTimeout);
-                                        SearchPointer=SearchPointer->NextSubscription;
-                                      }
-                                      TISM_EventLoggerLogEvent (ThisTask, TISM_LOG_EVENT_NOTIFY, "List complete. Summary event mask: %ld. GPIO initialized as %s.", TISM_IRQHandlerData.GPIO[MessageToProcess->MessageType].EventMask, (TISM_IRQHandlerData.GPIO[MessageToProcess->MessageType].GPIOPullDown?"pull-down":"pull-up"));
-                                    }
+                                    if (ThisTask->TaskDebug) TISM_EventLoggerLogEvent (ThisTask, TISM_LOG_EVENT_NOTIFY, "Processing GPIO request.");
+                                    TISM_IRQHandlerUpdateSubscription(ThisTask,MessageToProcess);
                                     break;
                     case GPIO_23:   // Power save
                     case GPIO_24:   // VBUS detect
@@ -401,7 +412,7 @@ uint8_t TISM_IRQHandler (TISM_Task ThisTask)
                 TISM_TaskManagerSetMyTaskAttribute(ThisTask,TISM_SET_TASK_SLEEP,true);
 				        break;
 	  case STOP:  // Task required to stop
-		            if (ThisTask.TaskDebug) TISM_EventLoggerLogEvent (ThisTask, TISM_LOG_EVENT_NOTIFY, "Stopping.");
+		            if (ThisTask->TaskDebug) TISM_EventLoggerLogEvent (ThisTask, TISM_LOG_EVENT_NOTIFY, "Stopping.");
 		        
 				        // Tasks for stopping
 			          
@@ -411,7 +422,7 @@ uint8_t TISM_IRQHandler (TISM_Task ThisTask)
   }
 		
   // All done.
-  if (ThisTask.TaskDebug==DEBUG_HIGH) TISM_EventLoggerLogEvent (ThisTask, TISM_LOG_EVENT_NOTIFY, "Run completed.");
+  if (ThisTask->TaskDebug==DEBUG_HIGH) TISM_EventLoggerLogEvent (ThisTask, TISM_LOG_EVENT_NOTIFY, "Run completed.");
   return (OK);
 }
 
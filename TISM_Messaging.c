@@ -5,13 +5,25 @@
   Structure and tools for thread-safe messaging between tasks using circular buffers.
 
   Message queueing is based on using circular buffers:
-  - One producer (head), one consumer (tail).
-  - Buffer length determined by MAX_MESSAGES.
+  - One producer (head), one consumer (tail). Only the producer writes the head, only the consumer writes the tail.
+  - Buffers with more than one producer (e.g. the inbound queues of tasks) are initialized with
+    TISM_CircularBufferInitMultiProducer; producers then claim a hardware spinlock while writing. There is always only
+    one consumer.
+  - Memory barriers make sure the contents of a slot are written before the head is advanced (release) and read after
+    the head is observed (acquire), so producer and consumer can safely run on different cores or in an interrupt.
+  - The slots of all buffers are carved from one shared pool (MessagePool, MESSAGE_POOL_SIZE slots). The length of each
+    buffer is set when it is allocated (TISM_CircularBufferAllocate); allocated slots are never returned to the pool.
   - Buffer is full when head is about to over the tail ("head + 1 = tail"):
     - This means one slot will always remain empty!
-    - Actual capacity is MAX_MESSAGES-1
+    - Actual capacity is Size-1; TISM_CircularBufferAllocate reserves this extra slot.
   - Buffer is empty when head = tail.
   - New data is rejected when the buffer is full; write-function returns 'false' in such cases.
+  - Messages can also be written, read and deleted in batches (TISM_CircularBufferWriteBatch, TISM_CircularBufferCopy,
+    TISM_CircularBufferReadSpan, TISM_CircularBufferDeleteMultiple); a batch is written with a single check for free
+    slots and is either written completely or not at all.
+  - Each buffer keeps track of the number of messages written (Enqueued), the number of writes rejected because the
+    buffer was full (Dropped) and the maximum number of messages waiting at the same time (HighWaterMark). Use these to
+    size the queues.
 
   Copyright (c) 2024 Maarten Klarenbeek (https://github.com/mjklaren)
   Distributed under the GPLv3 license
@@ -20,6 +32,7 @@
 
 #include <sys/time.h>
 #include <stdbool.h>
+#include <string.h>
 #include "pico/stdlib.h"
 #include "TISM.h"
 
@@ -36,17 +49,19 @@
   <value> - Integer value of number of messages waiting
   0       - No message(s) waiting
 */
-uint16_t TISM_CircularBufferMessagesWaiting(struct TISM_CircularBuffer *Buffer)
+uint16_t TISM_IN_RAM(TISM_CircularBufferMessagesWaiting)(struct TISM_CircularBuffer *Buffer)
 {
-  if(Buffer->Head!=Buffer->Tail)
+  // Take a snapshot of head and tail; the other side might change them while we're calculating.
+  uint16_t Head=Buffer->Head, Tail=Buffer->Tail;
+  if(Head!=Tail)
   {
     // Head and Tail differ; there must be messages waiting. Calculate how many.
-    if(Buffer->Head>Buffer->Tail)
+    if(Head>Tail)
     {
-      return(Buffer->Head-Buffer->Tail);
+      return(Head-Tail);
     }
     else
-      return((MAX_MESSAGES-Buffer->Tail)+Buffer->Head);
+      return((Buffer->Size-Tail)+Head);
   }
   else
     return(0);
@@ -56,7 +71,7 @@ uint16_t TISM_CircularBufferMessagesWaiting(struct TISM_CircularBuffer *Buffer)
 /*
   Description
   Calculate the number of slots available in the buffer. As there is always one slot unused between head and tail, 
-  max capacity will be MAX_MESSAGES-(number of messages waiting)-1.
+  max capacity will be Size-(number of messages waiting)-1.
   This function is somewhat redundant to TISM_CircularBufferMessagesWaiting, but used for readability of the code.
 
   Parameters:
@@ -65,9 +80,9 @@ uint16_t TISM_CircularBufferMessagesWaiting(struct TISM_CircularBuffer *Buffer)
   Return value:
   <value> - Integer value of number of slots available.
 */
-uint16_t TISM_CircularBufferSlotsAvailable(struct TISM_CircularBuffer *Buffer)
+uint16_t TISM_IN_RAM(TISM_CircularBufferSlotsAvailable)(struct TISM_CircularBuffer *Buffer)
 {
-  return(MAX_MESSAGES-TISM_CircularBufferMessagesWaiting(Buffer)-1);
+  return(Buffer->Size-TISM_CircularBufferMessagesWaiting(Buffer)-1);
 }
 
 
@@ -81,11 +96,13 @@ uint16_t TISM_CircularBufferSlotsAvailable(struct TISM_CircularBuffer *Buffer)
   Return value:
   *TISM_message - Pointer to message of type struct TISM_Message; the current message in the buffer.
 */
-struct TISM_Message *TISM_CircularBufferRead (struct TISM_CircularBuffer *Buffer)
+struct TISM_Message *TISM_IN_RAM(TISM_CircularBufferRead)(struct TISM_CircularBuffer *Buffer)
 {
   // Is a message waiting? If not, return NULL.
   if(TISM_CircularBufferMessagesWaiting(Buffer))
   {
+    // Make sure the contents of the slot are read after the head was observed (acquire).
+    __mem_fence_acquire();
     return(&(Buffer->Message[Buffer->Tail]));
   }
   else
@@ -93,6 +110,36 @@ struct TISM_Message *TISM_CircularBufferRead (struct TISM_CircularBuffer *Buffer
 }
 
 
+/*
+  Description
+  Read the first unread messages from the buffer without deleting these (don't move tail). Returns the number of messages
+  that are stored contiguously from the tail onwards; when the messages wrap around the end of the buffer, read again
+  after deleting the first part (TISM_CircularBufferDeleteMultiple).
+
+  Parameters:
+  *TISM_CircularBuffer   - Pointer to the TISM_CircularBuffer struct.
+  TISM_Message **Messages - Set to the first message in the buffer (NULL when the buffer is empty).
+
+  Return value:
+  <value>                - Number of messages available at *Messages.
+  0                      - No messages waiting.
+*/
+uint16_t TISM_IN_RAM(TISM_CircularBufferReadSpan)(struct TISM_CircularBuffer *Buffer, struct TISM_Message **Messages)
+{
+  uint16_t Head=Buffer->Head, Tail=Buffer->Tail;
+  if(Head==Tail)
+  {
+    *Messages=NULL;
+    return(0);
+  }
+
+  // Make sure the contents of the slots are read after the head was observed (acquire).
+  __mem_fence_acquire();
+  *Messages=&(Buffer->Message[Tail]);
+  return(Head>Tail?Head-Tail:Buffer->Size-Tail);
+}
+
+
 /*
   Description
   Remove the first unread message from stack by advancing the tail +1.
@@ -103,18 +150,94 @@ struct TISM_Message *TISM_CircularBufferRead (struct TISM_CircularBuffer *Buffer
   Return value:
   None
 */
-void TISM_CircularBufferDelete (struct TISM_CircularBuffer *Buffer)
+void TISM_IN_RAM(TISM_CircularBufferDelete)(struct TISM_CircularBuffer *Buffer)
 {
   // Is the tail already at the same position as the head? Then we don't have to do anything.
   if(TISM_CircularBufferMessagesWaiting(Buffer)>0)
   {
-    Buffer->Tail++;
-    if(Buffer->Tail==MAX_MESSAGES)
-      Buffer->Tail=0;
+    // Finish reading the slot before it is handed back to the producer (release).
+    uint16_t Tail=Buffer->Tail+1;
+    if(Tail==Buffer->Size)
+      Tail=0;
+    __mem_fence_release();
+    Buffer->Tail=Tail;
   }
 }
 
 
+/*
+  Description
+  Remove the first unread messages from the buffer by advancing the tail. When less messages are waiting, all messages
+  are removed.
+
+  Parameters:
+  *TISM_CircularBuffer - Pointer to the TISM_CircularBuffer struct.
+  uint16_t Count       - Number of messages to remove.
+
+  Return value:
+  None
+*/
+void TISM_IN_RAM(TISM_CircularBufferDeleteMultiple)(struct TISM_CircularBuffer *Buffer, uint16_t Count)
+{
+  uint16_t Waiting=TISM_CircularBufferMessagesWaiting(Buffer);
+  if(Count>Waiting)
+    Count=Waiting;
+  if(Count>0)
+  {
+    // Finish reading the slots before these are handed back to the producer (release).
+    uint32_t Tail=(uint32_t)Buffer->Tail+Count;
+    if(Tail>=Buffer->Size)
+      Tail-=Buffer->Size;
+    __mem_fence_release();
+    Buffer->Tail=Tail;
+  }
+}
+
+
+// Internal function - start writing Count messages; claim the spinlock of buffers with multiple producers and check if
+// enough slots are available. When that is not the case the write is rejected (counted as dropped) and the lock released.
+// Otherwise finish with TISM_CircularBufferEndWrite.
+bool TISM_IN_RAM(TISM_CircularBufferBeginWrite)(struct TISM_CircularBuffer *Buffer, uint16_t Count, uint32_t *LockState, uint16_t *SlotsAvailable)
+{
+  *LockState=0;
+  if(Buffer->ProducerLock!=NULL)
+    *LockState=spin_lock_blocking(Buffer->ProducerLock);
+  *SlotsAvailable=TISM_CircularBufferSlotsAvailable(Buffer);
+  if((Count==0) || (*SlotsAvailable<Count))
+  {
+    Buffer->Dropped+=Count;
+    if(Buffer->ProducerLock!=NULL)
+      spin_unlock(Buffer->ProducerLock, *LockState);
+    return(false);
+  }
+
+  // Don't touch the slots before the consumer has released them (acquire).
+  __mem_fence_acquire();
+  return(true);
+}
+
+
+// Internal function - finish writing Count messages (see TISM_CircularBufferBeginWrite); advance the head, update the
+// statistics and release the spinlock.
+void TISM_IN_RAM(TISM_CircularBufferEndWrite)(struct TISM_CircularBuffer *Buffer, uint16_t Count, uint32_t LockState, uint16_t SlotsAvailable)
+{
+  // The slots need to be completely written before the consumer can see the new head (release).
+  uint32_t Head=(uint32_t)Buffer->Head+Count;
+  if(Head>=Buffer->Size)
+    Head-=Buffer->Size;
+  __mem_fence_release();
+  Buffer->Head=Head;
+
+  // Update the statistics; the number of messages waiting now is the capacity minus the slots that were available, plus Count.
+  Buffer->Enqueued+=Count;
+  if(Buffer->Size-1-SlotsAvailable+Count>Buffer->HighWaterMark)
+    Buffer->HighWaterMark=Buffer->Size-1-SlotsAvailable+Count;
+
+  if(Buffer->ProducerLock!=NULL)
+    spin_unlock(Buffer->ProducerLock, LockState);
+}
+
+
 /*
   Description
   Insert data into the current position of the circular buffer (head) and and advance head +1. This function allows the 
@@ -133,29 +256,24 @@ void TISM_CircularBufferDelete (struct TISM_CircularBuffer *Buffer)
   false - Buffer is full.
   true  - Succes
 */
-bool TISM_CircularBufferWriteWithTimestamp (struct TISM_CircularBuffer *Buffer, uint8_t SenderTaskID, uint8_t RecipientTaskID, uint8_t MessageType, uint32_t Message, uint32_t Specification, uint64_t Timestamp)
+bool TISM_IN_RAM(TISM_CircularBufferWriteWithTimestamp)(struct TISM_CircularBuffer *Buffer, uint8_t SenderTaskID, uint8_t RecipientTaskID, uint8_t MessageType, uint32_t Message, uint32_t Specification, uint64_t Timestamp)
 {
-  // First check if a slot is available in the ringbuffer
-  if(TISM_CircularBufferSlotsAvailable(Buffer)>0)
-  {
-    // Write a record to the current position of the head-pointer and add a timestamp.
-    Buffer->Message[Buffer->Head].SenderTaskID=SenderTaskID;
-    Buffer->Message[Buffer->Head].RecipientTaskID=RecipientTaskID;
-    Buffer->Message[Buffer->Head].MessageType=MessageType;
-    Buffer->Message[Buffer->Head].Message=Message;
-    Buffer->Message[Buffer->Head].Specification=Specification;
-    Buffer->Message[Buffer->Head].MessageTimestamp=Timestamp;
-    
-    // Advance the head-pointer +1; set to 0 if the end is reached. If the buffer is full, do not advance the head pointer.  
-    Buffer->Head++;
-    if(Buffer->Head==MAX_MESSAGES)
-      Buffer->Head=0;
-  }
-  else
-  {
-    // No slots available; circulair buffer is full.
-    return (false);
-  }
+  // Buffers with multiple producers; the spinlock is claimed while writing (this also disables interrupts on this core).
+  uint32_t LockState;
+  uint16_t SlotsAvailable;
+  if(!TISM_CircularBufferBeginWrite(Buffer, 1, &LockState, &SlotsAvailable))
+    return(false);
+
+  // Write a record to the current position of the head-pointer and add a timestamp.
+  uint16_t Head=Buffer->Head;
+  Buffer->Message[Head].SenderTaskID=SenderTaskID;
+  Buffer->Message[Head].RecipientTaskID=RecipientTaskID;
+  Buffer->Message[Head].MessageType=MessageType;
+  Buffer->Message[Head].Topic=TISM_NO_TOPIC;
+  Buffer->Message[Head].Message=Message;
+  Buffer->Message[Head].Specification=Specification;
+  Buffer->Message[Head].MessageTimestamp=Timestamp;
+  TISM_CircularBufferEndWrite(Buffer, 1, LockState, SlotsAvailable);
   return(true);
 }
 
@@ -176,12 +294,90 @@ bool TISM_CircularBufferWriteWithTimestamp (struct TISM_CircularBuffer *Buffer,
   false - Buffer is full.
   true  - Succes
 */
-bool TISM_CircularBufferWrite (struct TISM_CircularBuffer *Buffer, uint8_t SenderTaskID, uint8_t RecipientTaskID, uint8_t MessageType, uint32_t Message, uint32_t Specification)
+bool TISM_IN_RAM(TISM_CircularBufferWrite)(struct TISM_CircularBuffer *Buffer, uint8_t SenderTaskID, uint8_t RecipientTaskID, uint8_t MessageType, uint32_t Message, uint32_t Specification)
 {
   return(TISM_CircularBufferWriteWithTimestamp(Buffer, SenderTaskID, RecipientTaskID, MessageType, Message, Specification, time_us_64()));
 } 
 
 
+/*
+  Description
+  Insert a batch of messages of the same type with the same timestamp into the circular buffer, with a single check for free
+  slots. The batch is written completely, or not at all.
+
+  Parameters:
+  *TISM_CircularBuffer     - Pointer to the TISM_CircularBuffer struct.
+  uint8_t SenderTaskID     - ID of the sender of the messages.
+  uint8_t RecipientTaskID  - ID of the intended recipient of the messages.
+  uint8_t MessageType      - Type of the messages.
+  uint32_t *Messages       - Array with the Message-field of each message.
+  uint32_t Specification   - Specification, the same for all messages.
+  uint16_t Count           - Number of messages in the batch.
+  uint64_t Timestamp       - Timestamp to be added to the messages.
+
+  Return value:
+  false - Not enough room in the buffer for the whole batch; nothing written.
+  true  - Succes
+*/
+bool TISM_IN_RAM(TISM_CircularBufferWriteBatch)(struct TISM_CircularBuffer *Buffer, uint8_t SenderTaskID, uint8_t RecipientTaskID, uint8_t MessageType, const uint32_t *Messages, uint32_t Specification, uint16_t Count, uint64_t Timestamp)
+{
+  uint32_t LockState;
+  uint16_t SlotsAvailable;
+  if(!TISM_CircularBufferBeginWrite(Buffer, Count, &LockState, &SlotsAvailable))
+    return(false);
+
+  uint16_t Head=Buffer->Head;
+  for(uint16_t counter=0;counter<Count;counter++)
+  {
+    Buffer->Message[Head].SenderTaskID=SenderTaskID;
+    Buffer->Message[Head].RecipientTaskID=RecipientTaskID;
+    Buffer->Message[Head].MessageType=MessageType;
+    Buffer->Message[Head].Topic=TISM_NO_TOPIC;
+    Buffer->Message[Head].Message=Messages[counter];
+    Buffer->Message[Head].Specification=Specification;
+    Buffer->Message[Head].MessageTimestamp=Timestamp;
+    Head++;
+    if(Head==Buffer->Size)
+      Head=0;
+  }
+  TISM_CircularBufferEndWrite(Buffer, Count, LockState, SlotsAvailable);
+  return(true);
+}
+
+
+/*
+  Description
+  Copy a number of messages (e.g. from another circular buffer, see TISM_CircularBufferReadSpan) into the circular buffer
+  as a block, with a single check for free slots. The messages are copied completely, or not at all.
+
+  Parameters:
+  *TISM_CircularBuffer     - Pointer to the TISM_CircularBuffer struct.
+  TISM_Message *Messages   - The messages to copy.
+  uint16_t Count           - Number of messages.
+
+  Return value:
+  false - Not enough room in the buffer for all messages; nothing written.
+  true  - Succes
+*/
+bool TISM_IN_RAM(TISM_CircularBufferCopy)(struct TISM_CircularBuffer *Buffer, const struct TISM_Message *Messages, uint16_t Count)
+{
+  uint32_t LockState;
+  uint16_t SlotsAvailable;
+  if(!TISM_CircularBufferBeginWrite(Buffer, Count, &LockState, &SlotsAvailable))
+    return(false);
+
+  // Copy up to the end of the buffer, then the rest to the start.
+  uint16_t Head=Buffer->Head, FirstPart=Buffer->Size-Head;
+  if(FirstPart>Count)
+    FirstPart=Count;
+  memcpy(&Buffer->Message[Head], Messages, FirstPart*sizeof(struct TISM_Message));
+  if(Count>FirstPart)
+    memcpy(&Buffer->Message[0], &Messages[FirstPart], (Count-FirstPart)*sizeof(struct TISM_Message));
+  TISM_CircularBufferEndWrite(Buffer, Count, LockState, SlotsAvailable);
+  return(true);
+}
+
+
 /*
   Description
   (Virtually) remove all messages by setting the tail at the same position as the head.
@@ -195,13 +391,61 @@ bool TISM_CircularBufferWrite (struct TISM_CircularBuffer *Buffer, uint8_t Sende
 void TISM_CircularBufferClear (struct TISM_CircularBuffer *Buffer)           
 {
   // 'Remove' all messages by setting the tail pointer to the same position as head. All data in the buffer is ignored.
-  Buffer->Tail=Buffer->Head;
+  uint16_t Head=Buffer->Head;
+  __mem_fence_release();
+  Buffer->Tail=Head;
+}
+
+
+/*
+  Description
+  Reset the statistics of the circular buffer (high-water mark, number of messages enqueued and dropped).
+
+  Parameters:
+  *TISM_CircularBuffer - Pointer to the TISM_CircularBuffer struct.
+
+  Return value:
+  None
+*/
+void TISM_CircularBufferResetStatistics (struct TISM_CircularBuffer *Buffer)
+{
+  Buffer->HighWaterMark=0;
+  Buffer->Enqueued=0;
+  Buffer->Dropped=0;
 }
 
 
 /*
   Description
-  Initialize the circular buffer. For read safety, add default values.
+  Claim the slots for a circular buffer from the shared message pool. This is done once, when the system is initialized
+  or a task is registered; slots are not returned to the pool. Initialize the buffer before use. A buffer of size 0 takes
+  a single slot and can't hold any messages; writes to it fail.
+
+  Parameters:
+  *TISM_CircularBuffer - Pointer to the TISM_CircularBuffer struct.
+  uint16_t QueueSize   - The number of messages the buffer should be able to hold.
+
+  Return value:
+  false                - Not enough free slots in the message pool.
+  true                 - Slots allocated.
+*/
+bool TISM_CircularBufferAllocate (struct TISM_CircularBuffer *Buffer, uint16_t QueueSize)
+{
+  // One slot always remains empty; reserve one extra.
+  uint32_t Slots=(uint32_t)QueueSize+1;
+  if(Slots>MESSAGE_POOL_SIZE-MessagePoolSlotsUsed)
+    return(false);
+  Buffer->Message=&MessagePool[MessagePoolSlotsUsed];
+  Buffer->Size=Slots;
+  MessagePoolSlotsUsed+=Slots;
+  return(true);
+}
+
+
+/*
+  Description
+  Initialize the circular buffer. For read safety, add default values. The producer mode of the buffer (single or
+  multiple producers, see TISM_CircularBufferInitMultiProducer) is not changed.
 
   Parameters:
   *TISM_CircularBuffer - Pointer to the TISM_CircularBuffer struct.
@@ -211,18 +455,39 @@ void TISM_CircularBufferClear (struct TISM_CircularBuffer *Buffer)
 */
 void TISM_CircularBufferInit (struct TISM_CircularBuffer *Buffer)           
 {
-  // Set head and tail to 0.
+  // Set head and tail to 0 and reset the statistics.
   Buffer->Tail=0;
   Buffer->Head=0;
+  TISM_CircularBufferResetStatistics(Buffer);
 
   // Give the slots in the buffer an initial value (not needed, but perhaps safer for reading operations).
-  for(uint8_t counter=0;counter<MAX_MESSAGES; counter++)
+  for(uint16_t counter=0;counter<Buffer->Size; counter++)
   {
     Buffer->Message[counter].SenderTaskID=0;
     Buffer->Message[counter].RecipientTaskID=0;
     Buffer->Message[counter].MessageType=0;
+    Buffer->Message[counter].Topic=TISM_NO_TOPIC;
     Buffer->Message[counter].Message=0;
     Buffer->Message[counter].Specification=0;
     Buffer->Message[counter].MessageTimestamp=0;
   }
 }
+
+
+/*
+  Description
+  Initialize a circular buffer that is written by more than one producer (e.g. tasks on both cores, or an interrupt
+  handler). Producers claim a hardware spinlock while writing; reading remains lock-free as there is only one consumer.
+
+  Parameters:
+  *TISM_CircularBuffer - Pointer to the TISM_CircularBuffer struct.
+
+  Return value:
+  None
+*/
+void TISM_CircularBufferInitMultiProducer (struct TISM_CircularBuffer *Buffer)
+{
+  // Use one of the striped spinlocks of the SDK; critical sections are very short.
+  Buffer->ProducerLock=spin_lock_instance(next_striped_spin_lock_num());
+  TISM_CircularBufferInit(Buffer);
+}
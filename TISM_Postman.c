@@ -12,6 +12,31 @@
   - TISM_Postman handles the delivery of messages by processing the messages from the outbound queue for the specific
     scheduler-instance, and delivers it to the inbound queue of the specified task. 
   - As only one instance of TISM_Postman can run at a time, this process is thread-safe.
+  - When POSTMAN_DIRECT_DELIVERY is enabled messages to regular (non-system) tasks are written straight into the inbound
+    queue of the recipient by the sender, and the recipient is woken up immediately. The outbound queue, TISM_Postman and
+    TISM_TaskManager are only used when this isn't possible (system task as recipient, inbound queue full etc). As the
+    inbound queues accept multiple producers, this also works when sender and recipient run on different cores.
+  - TISM_PostmanWriteMessage only fails when the message can't be queued at all. Producers that need to know if the
+    inbound queue of the recipient is full use TISM_PostmanSendMessage (returns ERR_MAILBOX_FULL), to throttle. When
+    TISM_Postman can't deliver a message later on, the message is dropped; with POSTMAN_NOTIFY_DROPS the sender then
+    receives a TISM_MESSAGE_DROPPED message.
+
+  - Tasks that send or receive many messages at once (e.g. streams of samples) can use the batch functions:
+    TISM_PostmanWriteMessages (or TISM_PostmanSendMessages) writes a batch of messages with one timestamp and a single
+    check for free slots,
+    TISM_PostmanReadMessages and TISM_PostmanDeleteMessages read and consume a contiguous span of the inbound queue.
+  - TISM_Postman moves consecutive messages for the same recipient from the outbound queue to the inbound queue of the
+    recipient as one block copy.
+  - Larger data is sent in a buffer of the buffer pool (see TISM_BufferPool.c) with TISM_PostmanWriteBuffer. Deleting
+    the message, or failing to deliver it, drops the reference of the message to the buffer.
+  - Event driven tasks end their run with TISM_PostmanWaitForMessage; the task sleeps until a message of the specified
+    type (or any message) is delivered, or until the timeout expires. The one delivering the message wakes the task
+    directly; messages of other types are queued without waking it (except a TISM_PING of TISM_Watchdog).
+  - With TRACE_ENABLED each message sent and each message delivered is recorded in the trace (see TISM_Trace.c).
+  - Tasks can subscribe to topics (TISM_PostmanSubscribe). A message published to a topic (TISM_PostmanPublish) takes a
+    single slot in the outbound queue; TISM_Postman delivers a copy to each subscriber in the same run. Subscribers find
+    the topic in the Topic-field of the message. Buffers published with TISM_PostmanPublishBuffer are shared by all
+    subscribers.
 
   TISM_Postman uses the functions in TISM_Messaging; the definitions of messaging struct is defined in TISM_Definitions.
   The outbound queues for the TISM_Scheduler instances are global variables; OutboundMessageQueue[CORE0] and OutboundMessageQueue[CORE1].
@@ -23,33 +48,258 @@
 */
 
 #include <stdio.h>
+#include <string.h>
 #include "pico/stdlib.h"
 #include "TISM.h"
 
 
+// The structure containing all data for TISM_Postman to run. Queued and Processed count the messages per recipient in the
+// outbound queue of each core; Queued is counted for every message written (see TISM_PostmanQueueMessage), Processed by
+// TISM_Postman for every message taken out. The difference is the number of messages still waiting for delivery.
+struct TISM_PostmanData
+{
+  uint32_t TaskReceivedMessage[SCHEDULER_MASK_WORDS];           // Bitmap of the tasks that received a message and have to be woken up.
+  uint16_t Queued[MAX_CORES][MAX_TASKS], Processed[MAX_CORES][MAX_TASKS];
+  uint32_t TopicSubscribers[MAX_TOPICS][TOPIC_MASK_WORDS];      // Bitmap of the subscribed tasks, per topic.
+  uint32_t MessagesDropped, MessagesDroppedReported;            // Messages that couldn't be delivered; see TISM_PostmanReportDrops.
+  TISM_Message LastDropped;
+  uint64_t NextDropReport;
+} TISM_PostmanData;
+
+
 /*
   Description
   Wrapper for TISM_CircularBufferMessagesWaiting; allows tasks to easer check if a message is waiting in their inbound queue.
   
   Parameters:
-  TISM_Task ThisTask - Struct containing all task related information.
+  TISM_Task *ThisTask - Pointer to struct containing all task related information.
 
   Return value:
   <value>            - Integer value of number of messages waiting
   0                  - No messages waiting
 */
-uint16_t TISM_PostmanMessagesWaiting(TISM_Task ThisTask)
+uint16_t TISM_IN_RAM(TISM_PostmanMessagesWaiting)(const TISM_Task *ThisTask)
+{
+  return(TISM_CircularBufferMessagesWaiting(ThisTask->InboundMessageQueue));
+}
+
+
+// Internal function - check if a message that ends a wait of the specified type (see TISM_PostmanWakeRecipient) is waiting in the queue.
+bool TISM_PostmanMessageOfTypeWaiting(struct TISM_CircularBuffer *Buffer, int16_t MessageType)
 {
-  return(TISM_CircularBufferMessagesWaiting(ThisTask.InboundMessageQueue));
+  if(MessageType==TISM_ANY_MESSAGE)
+    return(TISM_CircularBufferMessagesWaiting(Buffer)>0);
+  for(uint16_t Slot=Buffer->Tail;Slot!=Buffer->Head;Slot=(Slot+1)%Buffer->Size)
+    if((Buffer->Message[Slot].MessageType==MessageType) || (Buffer->Message[Slot].MessageType==TISM_PING))
+      return(true);
+  return(false);
 }
 
 
 /*
   Description
-  Wrapper for TISM_CircularBufferWrite; allows tasks to easier write messages to the outbound queue.
+  Let the task wait until a message of the specified type (or any message) is delivered in its inbound queue, or until
+  the timeout expires, whichever comes first. Call this at the end of a run, instead of putting the task to sleep via
+  TISM_TaskManager. The task is woken directly by the one delivering the message (another task, an interrupt handler or
+  TISM_Postman); messages of other types are queued without waking the task. A TISM_PING of TISM_Watchdog always ends
+  the wait, so the task can reply in time. Events of TISM_IRQHandler and
+  TISM_SoftwareTimer arrive as messages too (type = GPIO or timer ID). After waking up, the task can check if the
+  message arrived (e.g. TISM_PostmanMessagesWaiting) or the timeout expired.
 
   Parameters:
-  TISM_Task ThisTask         - Struct containing all task related information.
+  TISM_Task *ThisTask        - Pointer to struct containing all task related information.
+  int16_t MessageType        - Type of message to wait for, or TISM_ANY_MESSAGE.
+  uint32_t Timeout           - Maximum time to wait in usec, or TISM_WAIT_FOREVER.
+
+  Return value:
+  false - A matching message is already waiting; the task runs again right away.
+  true  - The task waits for the message.
+*/
+bool TISM_PostmanWaitForMessage(const TISM_Task *ThisTask, int16_t MessageType, uint32_t Timeout)
+{
+  TISM_Task *Task=&System.Task[ThisTask->TaskID];
+  bool Waiting=false;
+
+  // Messages that are delivered from now on see the wait; the ones already delivered are in the queue.
+  uint32_t LockState=spin_lock_blocking(System.PostmanDeliveryLock);
+  if(TISM_PostmanMessageOfTypeWaiting(Task->InboundMessageQueue, MessageType))
+    Task->TaskWakeUpTimer=time_us_64();
+  else
+  {
+    Task->TaskWaitForMessage=MessageType;
+    if(Timeout==TISM_WAIT_FOREVER)
+      Task->TaskSleeping=true;
+    else
+      Task->TaskWakeUpTimer=time_us_64()+Timeout;
+    Waiting=true;
+  }
+  spin_unlock(System.PostmanDeliveryLock, LockState);
+
+  // Make the scheduler respect the new wake-up timer when the run is completed, instead of the period of the task.
+  TISM_SchedulerUpdateTask(Task->TaskID);
+  return(Waiting);
+}
+
+
+// Internal function - check if Count messages can be delivered directly to the recipient (see TISM_PostmanDeliverDirect).
+bool TISM_IN_RAM(TISM_PostmanCanDeliverDirect)(const TISM_Task *ThisTask, uint8_t RecipientTaskID, uint16_t Count)
+{
+  if((!TISM_IsValidTaskID(RecipientTaskID)) || (TISM_IsSystemTask(RecipientTaskID)) ||
+     (ThisTask->OutboundMessageQueue==NULL) || (TISM_CircularBufferMessagesWaiting(ThisTask->OutboundMessageQueue)>0))
+    return(false);
+
+  // Don't attempt to write into a full queue; this would count as dropped messages while we can still fall back.
+  return(TISM_CircularBufferSlotsAvailable(&InboundMessageQueue[RecipientTaskID])>=Count);
+}
+
+
+// Internal function - wake the recipient of a message when it is sleeping. A recipient that waits for a message (see
+// TISM_PostmanWaitForMessage) is only woken by the message type it waits for. Called while holding System.PostmanDeliveryLock.
+void TISM_IN_RAM(TISM_PostmanWakeRecipient)(uint8_t RecipientTaskID, uint8_t MessageType, uint64_t Timestamp)
+{
+  int16_t WaitForMessage=System.Task[RecipientTaskID].TaskWaitForMessage;
+  if(WaitForMessage!=TISM_NOT_WAITING)
+  {
+    // Messages of other types don't end the wait, except a PING of TISM_Watchdog. The task could be waiting for its
+    // timeout instead of sleeping.
+    if((WaitForMessage!=TISM_ANY_MESSAGE) && (WaitForMessage!=MessageType) && (MessageType!=TISM_PING))
+      return;
+    System.Task[RecipientTaskID].TaskWaitForMessage=TISM_NOT_WAITING;
+  }
+  else if(!System.Task[RecipientTaskID].TaskSleeping)
+    return;
+  System.Task[RecipientTaskID].TaskWakeUpTimer=Timestamp;
+  System.Task[RecipientTaskID].TaskSleeping=false;
+  TISM_SchedulerUpdateTask(RecipientTaskID);
+}
+
+
+// Internal function - wake the recipient of messages delivered by TISM_Postman. Recipients that wait for a message are
+// woken directly (see TISM_PostmanWaitForMessage); others via TISM_TaskManager, when the run of TISM_Postman is completed.
+void TISM_PostmanNotifyRecipient(uint8_t RecipientTaskID, const TISM_Message *Messages, uint16_t Count)
+{
+  if(RecipientTaskID==TISM_TASKMANAGER_TASK_ID)
+    return;
+  uint64_t Timestamp=time_us_64();
+  uint32_t LockState=spin_lock_blocking(System.PostmanDeliveryLock);
+  if(System.Task[RecipientTaskID].TaskWaitForMessage==TISM_NOT_WAITING)
+    TISM_PostmanData.TaskReceivedMessage[RecipientTaskID/32]|=(1u<<(RecipientTaskID%32));
+  else
+    for(uint16_t counter=0;(counter<Count) && (System.Task[RecipientTaskID].TaskWaitForMessage!=TISM_NOT_WAITING);counter++)
+      TISM_PostmanWakeRecipient(RecipientTaskID, Messages[counter].MessageType, Timestamp);
+  spin_unlock(System.PostmanDeliveryLock, LockState);
+}
+
+
+// Internal function - write a message and wake the recipient in one go, so TISM_TaskManager can't put it to sleep in
+// between. When tracing, a send recorded here (RecordSent) precedes its delivery and only shows up when written.
+bool TISM_IN_RAM(TISM_PostmanWriteAndWake)(uint8_t SenderTaskID, uint8_t RecipientTaskID, uint8_t MessageType, uint32_t Message, uint32_t Specification, uint64_t Timestamp, bool RecordSent)
+{
+  bool Delivered=false;
+  uint32_t LockState=spin_lock_blocking(System.PostmanDeliveryLock);
+  if(TISM_CircularBufferWriteWithTimestamp(&InboundMessageQueue[RecipientTaskID], SenderTaskID, RecipientTaskID, MessageType, Message, Specification, Timestamp))
+  {
+    if(TRACE_ENABLED)
+    {
+      if(RecordSent) TISM_TraceRecord(TRACE_MESSAGE_SENT, SenderTaskID, (RecipientTaskID<<8)|MessageType);
+      TISM_TraceRecord(TRACE_MESSAGE_DELIVERED, RecipientTaskID, (SenderTaskID<<8)|MessageType);
+    }
+    TISM_PostmanWakeRecipient(RecipientTaskID, MessageType, Timestamp);
+    Delivered=true;
+  }
+  spin_unlock(System.PostmanDeliveryLock, LockState);
+  return(Delivered);
+}
+
+
+/*
+  Description
+  Write a message into the inbound queue of the recipient and wake the recipient when it is sleeping. No checks are done
+  on the recipient or the order of messages; see TISM_PostmanDeliverDirect. This function can also be called from
+  interrupt handlers (e.g. alarm callbacks of TISM_SoftwareTimer).
+
+  Parameters:
+  uint8_t SenderTaskID       - TaskID of the sender.
+  uint8_t RecipientTaskID    - TaskID of the recipient.
+  uint8_t MessageType        - Type of message (see TISM_Definitions.h).
+  uint32_t Message           - Message. Could also contain a pointer to something (e.g. text buffer).
+  uint32_t Specification     - Specification to the provided message. Could also contain a pointer to something (e.g. text buffer).
+  uint64_t Timestamp         - Timestamp to be added to the message.
+
+  Return value:
+  false - Inbound queue of the recipient is full, message not delivered.
+  true  - Message delivered in the inbound queue of the recipient.
+*/
+bool TISM_IN_RAM(TISM_PostmanDeliverAndWake)(uint8_t SenderTaskID, uint8_t RecipientTaskID, uint8_t MessageType, uint32_t Message, uint32_t Specification, uint64_t Timestamp)
+{
+  return(TISM_PostmanWriteAndWake(SenderTaskID, RecipientTaskID, MessageType, Message, Specification, Timestamp, false));
+}
+
+
+/*
+  Description
+  Deliver a message straight into the inbound queue of the recipient and wake the recipient when it is sleeping, without
+  the intervention of TISM_Postman and TISM_TaskManager. Direct delivery is only done when:
+  - The recipient is a valid task and not a TISM system task (these depend on the Postman/TaskManager run sequence).
+  - The outbound queue of the sender is empty; otherwise the message could overtake earlier messages.
+  - There is room in the inbound queue of the recipient.
+  In all other cases the message should be sent via the outbound queue (see TISM_PostmanWriteMessage).
+
+  Parameters:
+  TISM_Task *ThisTask        - Pointer to struct containing all task related information.
+  uint8_t RecipientTaskID    - TaskID of the recipient.
+  uint8_t MessageType        - Type of message (see TISM_Definitions.h).
+  uint32_t Message           - Message. Could also contain a pointer to something (e.g. text buffer).
+  uint32_t Specification     - Specification to the provided message. Could also contain a pointer to something (e.g. text buffer).
+  uint64_t Timestamp         - Timestamp to be added to the message.
+
+  Return value:
+  false - Direct delivery not possible, message not delivered.
+  true  - Message delivered in the inbound queue of the recipient.
+*/
+bool TISM_IN_RAM(TISM_PostmanDeliverDirect)(const TISM_Task *ThisTask, uint8_t RecipientTaskID, uint8_t MessageType, uint32_t Message, uint32_t Specification, uint64_t Timestamp)
+{
+  if(!TISM_PostmanCanDeliverDirect(ThisTask, RecipientTaskID, 1))
+    return(false);
+  return(TISM_PostmanWriteAndWake(ThisTask->TaskID, RecipientTaskID, MessageType, Message, Specification, Timestamp, true));
+}
+
+
+/*
+  Description
+  Write a message into the outbound queue of the core the task is running on, for delivery by TISM_Postman. Every
+  write into an outbound queue has to go through this function (or be counted like it), as TISM_PostmanSendMessage
+  relies on the number of messages per recipient still waiting in the outbound queues.
+
+  Parameters:
+  TISM_Task *ThisTask        - Pointer to struct containing all task related information.
+  uint8_t RecipientTaskID    - TaskID of the recipient.
+  uint8_t MessageType        - Type of message (see TISM_Definitions.h).
+  uint32_t Message           - Message.
+  uint32_t Specification     - Specification to the provided message.
+  uint64_t Timestamp         - Timestamp of the message.
+
+  Return value:
+  false - Outbound queue full.
+  true  - Succes 
+*/
+bool TISM_IN_RAM(TISM_PostmanQueueMessage)(const TISM_Task *ThisTask, uint8_t RecipientTaskID, uint8_t MessageType, uint32_t Message, uint32_t Specification, uint64_t Timestamp)
+{
+  if(!TISM_CircularBufferWriteWithTimestamp(ThisTask->OutboundMessageQueue, ThisTask->TaskID, RecipientTaskID, MessageType, Message, Specification, Timestamp))
+    return(false);
+  if(RecipientTaskID<MAX_TASKS)
+    TISM_PostmanData.Queued[ThisTask->OutboundMessageQueue-OutboundMessageQueue][RecipientTaskID]++;
+  return(true);
+}
+
+
+/*
+  Description
+  Wrapper for TISM_CircularBufferWrite; allows tasks to easier write messages to the outbound queue. When POSTMAN_DIRECT_DELIVERY
+  is enabled the message is delivered directly to the recipient when possible (see TISM_PostmanDeliverDirect).
+
+  Parameters:
+  TISM_Task *ThisTask        - Pointer to struct containing all task related information.
   uint8_t RecipientTaskID    - TaskID of the recipient.
   uint8_t MessageType        - Type of message (see TISM_Definitions.h).
   uint32_t Message           - Message. Could also contain a pointer to something (e.g. text buffer).
@@ -59,9 +309,288 @@ uint16_t TISM_PostmanMessagesWaiting(TISM_Task ThisTask)
   false - Buffer is full.
   true  - Succes 
 */
-bool TISM_PostmanWriteMessage(TISM_Task ThisTask, uint8_t RecipientTaskID, uint8_t MessageType, uint32_t Message, uint32_t Specification)
+bool TISM_IN_RAM(TISM_PostmanWriteMessage)(const TISM_Task *ThisTask, uint8_t RecipientTaskID, uint8_t MessageType, uint32_t Message, uint32_t Specification)
+{
+  uint64_t Timestamp=time_us_64();
+
+  // Try to skip the outbound queue first; fall back to TISM_Postman if direct delivery isn't possible. The send is
+  // traced only once the message is written; in case of direct delivery right before its delivery.
+  if(POSTMAN_DIRECT_DELIVERY && TISM_PostmanDeliverDirect(ThisTask, RecipientTaskID, MessageType, Message, Specification, Timestamp))
+    return(true);
+  if(!TISM_PostmanQueueMessage(ThisTask, RecipientTaskID, MessageType, Message, Specification, Timestamp))
+    return(false);
+  if(TRACE_ENABLED) TISM_TraceRecord(TRACE_MESSAGE_SENT, ThisTask->TaskID, (RecipientTaskID<<8)|MessageType);
+  return(true);
+}
+
+
+/*
+  Description
+  Write a batch of messages of the same type to one recipient, with a single timestamp and a single check for free slots.
+  Like TISM_PostmanWriteMessage the batch is delivered directly to the recipient when possible, otherwise it is written into
+  the outbound queue. The batch is written completely or not at all; keep batches smaller than the inbound queue of the
+  recipient.
+
+  Parameters:
+  TISM_Task *ThisTask        - Pointer to struct containing all task related information.
+  uint8_t RecipientTaskID    - TaskID of the recipient.
+  uint8_t MessageType        - Type of the messages (see TISM_Definitions.h).
+  uint32_t *Messages         - Array with the Message-field of each message.
+  uint32_t Specification     - Specification, the same for all messages.
+  uint16_t Count             - Number of messages in the batch.
+
+  Return value:
+  false - Not enough room for the whole batch; nothing written.
+  true  - Succes 
+*/
+bool TISM_PostmanWriteMessages(const TISM_Task *ThisTask, uint8_t RecipientTaskID, uint8_t MessageType, const uint32_t *Messages, uint32_t Specification, uint16_t Count)
 {
-  return(TISM_CircularBufferWriteWithTimestamp(ThisTask.OutboundMessageQueue, ThisTask.TaskID, RecipientTaskID, MessageType, Message, Specification, time_us_64()));  
+  uint64_t Timestamp=time_us_64();
+
+  // Try to skip the outbound queue first; write and wake in one go, as TISM_PostmanDeliverAndWake.
+  if(POSTMAN_DIRECT_DELIVERY && TISM_PostmanCanDeliverDirect(ThisTask, RecipientTaskID, Count))
+  {
+    bool Delivered=false;
+    uint32_t LockState=spin_lock_blocking(System.PostmanDeliveryLock);
+    if(TISM_CircularBufferWriteBatch(&InboundMessageQueue[RecipientTaskID], ThisTask->TaskID, RecipientTaskID, MessageType, Messages, Specification, Count, Timestamp))
+    {
+      if(TRACE_ENABLED)
+      {
+        TISM_TraceRecord(TRACE_MESSAGE_SENT, ThisTask->TaskID, (RecipientTaskID<<8)|MessageType);
+        TISM_TraceRecord(TRACE_MESSAGE_DELIVERED, RecipientTaskID, (ThisTask->TaskID<<8)|MessageType);
+      }
+      TISM_PostmanWakeRecipient(RecipientTaskID, MessageType, Timestamp);
+      Delivered=true;
+    }
+    spin_unlock(System.PostmanDeliveryLock, LockState);
+    if(Delivered)
+      return(true);
+  }
+  if(!TISM_CircularBufferWriteBatch(ThisTask->OutboundMessageQueue, ThisTask->TaskID, RecipientTaskID, MessageType, Messages, Specification, Count, Timestamp))
+    return(false);
+  if(RecipientTaskID<MAX_TASKS)
+    TISM_PostmanData.Queued[ThisTask->OutboundMessageQueue-OutboundMessageQueue][RecipientTaskID]+=Count;
+  if(TRACE_ENABLED) TISM_TraceRecord(TRACE_MESSAGE_SENT, ThisTask->TaskID, (RecipientTaskID<<8)|MessageType);
+  return(true);
+}
+
+
+// Internal function - the number of free slots in the inbound queue of the recipient, minus the messages for the recipient
+// still waiting in the outbound queues.
+int32_t TISM_PostmanSlotsAvailable(uint8_t RecipientTaskID)
+{
+  int32_t Pending=0;
+  for(uint8_t CoreCounter=0;CoreCounter<MAX_CORES;CoreCounter++)
+    Pending+=(uint16_t)(TISM_PostmanData.Queued[CoreCounter][RecipientTaskID]-TISM_PostmanData.Processed[CoreCounter][RecipientTaskID]);
+  return((int32_t)TISM_CircularBufferSlotsAvailable(&InboundMessageQueue[RecipientTaskID])-Pending);
+}
+
+
+/*
+  Description
+  Send a buffer of the buffer pool to a recipient, as a message of type TISM_BUFFER with the ID of the buffer as
+  Message. The message holds a reference to the buffer of its own; the reference of the calling task is left untouched
+  (release it with TISM_BufferPoolRelease when done). Send the same buffer to multiple recipients by calling this
+  function for each of them.
+
+  Parameters:
+  TISM_Task *ThisTask        - Pointer to struct containing all task related information.
+  uint8_t RecipientTaskID    - TaskID of the recipient.
+  uint32_t BufferID          - ID of the buffer (see TISM_BufferPoolAllocate).
+  uint32_t Specification     - Specification of the contents of the buffer; free to use.
+
+  Return value:
+  false - Invalid buffer or buffer full; no reference added.
+  true  - Succes 
+*/
+bool TISM_PostmanWriteBuffer(const TISM_Task *ThisTask, uint8_t RecipientTaskID, uint32_t BufferID, uint32_t Specification)
+{
+  if(!TISM_BufferPoolRetain(BufferID))
+    return(false);
+  if(!TISM_PostmanWriteMessage(ThisTask, RecipientTaskID, TISM_BUFFER, BufferID, Specification))
+  {
+    TISM_BufferPoolRelease(BufferID);
+    return(false);
+  }
+  return(true);
+}
+
+
+// Internal function - set or clear the bit of the task in the bitmap of subscribers of the topic.
+bool TISM_PostmanUpdateSubscription(const TISM_Task *ThisTask, uint8_t Topic, bool Subscribe)
+{
+  if(Topic>=MAX_TOPICS)
+    return(false);
+  uint32_t LockState=spin_lock_blocking(System.PostmanDeliveryLock);
+  if(Subscribe)
+    TISM_PostmanData.TopicSubscribers[Topic][ThisTask->TaskID/32]|=(1u<<(ThisTask->TaskID%32));
+  else
+    TISM_PostmanData.TopicSubscribers[Topic][ThisTask->TaskID/32]&=~(1u<<(ThisTask->TaskID%32));
+  spin_unlock(System.PostmanDeliveryLock, LockState);
+  return(true);
+}
+
+
+/*
+  Description
+  Subscribe to a topic; messages published to the topic are delivered to the inbound queue of this task.
+
+  Parameters:
+  TISM_Task *ThisTask        - Pointer to struct containing all task related information.
+  uint8_t Topic              - The topic (0 - MAX_TOPICS-1).
+
+  Return value:
+  false - Invalid topic.
+  true  - Succes 
+*/
+bool TISM_PostmanSubscribe(const TISM_Task *ThisTask, uint8_t Topic)
+{
+  return(TISM_PostmanUpdateSubscription(ThisTask, Topic, true));
+}
+
+
+/*
+  Description
+  Cancel the subscription to a topic.
+
+  Parameters:
+  TISM_Task *ThisTask        - Pointer to struct containing all task related information.
+  uint8_t Topic              - The topic (0 - MAX_TOPICS-1).
+
+  Return value:
+  false - Invalid topic.
+  true  - Succes 
+*/
+bool TISM_PostmanUnsubscribe(const TISM_Task *ThisTask, uint8_t Topic)
+{
+  return(TISM_PostmanUpdateSubscription(ThisTask, Topic, false));
+}
+
+
+// Internal function - write a published message into the outbound queue for TISM_Postman. Queued tells if the message
+// was written; not when the topic has no subscribers. Returns false for an invalid topic or a full outbound queue.
+bool TISM_PostmanQueuePublished(const TISM_Task *ThisTask, uint8_t Topic, uint8_t MessageType, uint32_t Message, uint32_t Specification, bool *Queued)
+{
+  *Queued=false;
+  if(Topic>=MAX_TOPICS)
+    return(false);
+  bool Subscribers=false;
+  for(uint8_t counter=0;counter<TOPIC_MASK_WORDS;counter++)
+    Subscribers|=(TISM_PostmanData.TopicSubscribers[Topic][counter]!=0);
+  if(!Subscribers)
+    return(true);
+  TISM_Message Published={ .SenderTaskID=ThisTask->TaskID, .RecipientTaskID=TISM_TOPIC_RECIPIENT, .MessageType=MessageType, .Topic=Topic,
+                           .Message=Message, .Specification=Specification, .MessageTimestamp=time_us_64() };
+  *Queued=TISM_CircularBufferCopy(ThisTask->OutboundMessageQueue, &Published, 1);
+  if(TRACE_ENABLED && *Queued) TISM_TraceRecord(TRACE_MESSAGE_SENT, ThisTask->TaskID, (TISM_TOPIC_RECIPIENT<<8)|MessageType);
+  return(*Queued);
+}
+
+
+/*
+  Description
+  Publish a message to all subscribers of a topic. The message takes a single slot in the outbound queue; TISM_Postman
+  delivers a copy to each subscriber. When there are no subscribers nothing is written.
+
+  Parameters:
+  TISM_Task *ThisTask        - Pointer to struct containing all task related information.
+  uint8_t Topic              - The topic (0 - MAX_TOPICS-1).
+  uint8_t MessageType        - Type of message (see TISM_Definitions.h).
+  uint32_t Message           - Message.
+  uint32_t Specification     - Specification to the provided message.
+
+  Return value:
+  false - Invalid topic or outbound queue full.
+  true  - Succes 
+*/
+bool TISM_PostmanPublish(const TISM_Task *ThisTask, uint8_t Topic, uint8_t MessageType, uint32_t Message, uint32_t Specification)
+{
+  bool Queued;
+  return(TISM_PostmanQueuePublished(ThisTask, Topic, MessageType, Message, Specification, &Queued));
+}
+
+
+/*
+  Description
+  Publish a buffer of the buffer pool to all subscribers of a topic, as a message of type TISM_BUFFER. All subscribers
+  share the buffer; each message holds a reference of its own (see TISM_PostmanWriteBuffer).
+
+  Parameters:
+  TISM_Task *ThisTask        - Pointer to struct containing all task related information.
+  uint8_t Topic              - The topic (0 - MAX_TOPICS-1).
+  uint32_t BufferID          - ID of the buffer (see TISM_BufferPoolAllocate).
+  uint32_t Specification     - Specification of the contents of the buffer; free to use.
+
+  Return value:
+  false - Invalid topic or buffer, or outbound queue full.
+  true  - Succes 
+*/
+bool TISM_PostmanPublishBuffer(const TISM_Task *ThisTask, uint8_t Topic, uint32_t BufferID, uint32_t Specification)
+{
+  if(!TISM_BufferPoolRetain(BufferID))
+    return(false);
+  // The reference belongs to the published message; drop it when nothing was written (e.g. no subscribers).
+  bool Queued, Result=TISM_PostmanQueuePublished(ThisTask, Topic, TISM_BUFFER, BufferID, Specification, &Queued);
+  if(!Queued)
+    TISM_BufferPoolRelease(BufferID);
+  return(Result);
+}
+
+
+/*
+  Description
+  Send a message like TISM_PostmanWriteMessage, but report if the inbound queue of the recipient is full, so the sender
+  can throttle or retry later. Messages for the recipient still waiting in the outbound queues count as occupied slots.
+  As other tasks can write to the same inbound queue in the meantime, a message that has to be delivered by TISM_Postman
+  can still be dropped (see POSTMAN_NOTIFY_DROPS).
+
+  Parameters:
+  TISM_Task *ThisTask        - Pointer to struct containing all task related information.
+  uint8_t RecipientTaskID    - TaskID of the recipient.
+  uint8_t MessageType        - Type of message (see TISM_Definitions.h).
+  uint32_t Message           - Message. Could also contain a pointer to something (e.g. text buffer).
+  uint32_t Specification     - Specification to the provided message. Could also contain a pointer to something (e.g. text buffer).
+
+  Return value:
+  ERR_RECIPIENT_INVALID      - The TaskID of the recipient is invalid.
+  ERR_MAILBOX_FULL           - The inbound queue of the recipient, or the outbound queue of this core is full.
+  OK                         - Succes
+*/
+uint8_t TISM_PostmanSendMessage(const TISM_Task *ThisTask, uint8_t RecipientTaskID, uint8_t MessageType, uint32_t Message, uint32_t Specification)
+{
+  if(!TISM_IsValidTaskID(RecipientTaskID))
+    return(ERR_RECIPIENT_INVALID);
+  if(TISM_PostmanSlotsAvailable(RecipientTaskID)<1)
+    return(ERR_MAILBOX_FULL);
+  return(TISM_PostmanWriteMessage(ThisTask, RecipientTaskID, MessageType, Message, Specification)?OK:ERR_MAILBOX_FULL);
+}
+
+
+/*
+  Description
+  Send a batch of messages like TISM_PostmanWriteMessages, but report if the inbound queue of the recipient can't hold the
+  whole batch (see TISM_PostmanSendMessage).
+
+  Parameters:
+  TISM_Task *ThisTask        - Pointer to struct containing all task related information.
+  uint8_t RecipientTaskID    - TaskID of the recipient.
+  uint8_t MessageType        - Type of the messages (see TISM_Definitions.h).
+  uint32_t *Messages         - Array with the Message-field of each message.
+  uint32_t Specification     - Specification, the same for all messages.
+  uint16_t Count             - Number of messages in the batch.
+
+  Return value:
+  ERR_RECIPIENT_INVALID      - The TaskID of the recipient is invalid.
+  ERR_MAILBOX_FULL           - The inbound queue of the recipient, or the outbound queue of this core can't hold the batch.
+  OK                         - Succes
+*/
+uint8_t TISM_PostmanSendMessages(const TISM_Task *ThisTask, uint8_t RecipientTaskID, uint8_t MessageType, const uint32_t *Messages, uint32_t Specification, uint16_t Count)
+{
+  if(!TISM_IsValidTaskID(RecipientTaskID))
+    return(ERR_RECIPIENT_INVALID);
+  if(TISM_PostmanSlotsAvailable(RecipientTaskID)<Count)
+    return(ERR_MAILBOX_FULL);
+  return(TISM_PostmanWriteMessages(ThisTask, RecipientTaskID, MessageType, Messages, Specification, Count)?OK:ERR_MAILBOX_FULL);
 }
 
 
@@ -70,38 +599,161 @@ bool TISM_PostmanWriteMessage(TISM_Task ThisTask, uint8_t RecipientTaskID, uint8
   Wrapper for TISM_CircularBufferRead; allows tasks to easier read messages from the inbound queue.
 
   Parameters:
-  TISM_Task ThisTask - Struct containing all task related information.
+  TISM_Task *ThisTask - Pointer to struct containing all task related information.
 
   Return value:
   *TISM_message      - Pointer to message of type struct TISM_Message; the current message in the buffer.
 */
-struct TISM_Message *TISM_PostmanReadMessage(TISM_Task ThisTask)
+struct TISM_Message *TISM_IN_RAM(TISM_PostmanReadMessage)(const TISM_Task *ThisTask)
+{
+  return(TISM_CircularBufferRead(ThisTask->InboundMessageQueue));
+}
+
+
+/*
+  Description
+  Wrapper for TISM_CircularBufferReadSpan; allows tasks to read a batch of messages from their inbound queue at once. The
+  messages are stored contiguously; process them and consume them with TISM_PostmanDeleteMessages. Messages that wrap
+  around the end of the queue are returned by the next call.
+
+  Parameters:
+  TISM_Task *ThisTask     - Pointer to struct containing all task related information.
+  TISM_Message **Messages - Set to the first message (NULL when no messages are waiting).
+
+  Return value:
+  <value>                 - Number of messages available at *Messages.
+  0                       - No messages waiting.
+*/
+uint16_t TISM_PostmanReadMessages(const TISM_Task *ThisTask, TISM_Message **Messages)
+{
+  return(TISM_CircularBufferReadSpan(ThisTask->InboundMessageQueue, Messages));
+}
+
+
+// Internal function - drop the references to buffers of the first messages in the queue, before they are deleted.
+void TISM_PostmanReleaseBuffers(struct TISM_CircularBuffer *Buffer, uint16_t Count)
 {
-  return(TISM_CircularBufferRead(ThisTask.InboundMessageQueue));
+  uint16_t Waiting=TISM_CircularBufferMessagesWaiting(Buffer);
+  __mem_fence_acquire();
+  for(uint16_t Counter=0;(Counter<Count) && (Counter<Waiting);Counter++)
+  {
+    TISM_Message *Message=&Buffer->Message[(Buffer->Tail+Counter)%Buffer->Size];
+    if(Message->MessageType==TISM_BUFFER)
+      TISM_BufferPoolRelease(Message->Message);
+  }
 }
 
 
 /*
   Description
   Wrapper for TISM_CircularBufferDelete; allows tasks to easier delete the first message from their inbound queue.
+  When the message refers to a buffer (TISM_BUFFER) the reference to the buffer is dropped.
 
   Parameters:
-  TISM_Task ThisTask - Struct containing all task related information.
+  TISM_Task *ThisTask - Pointer to struct containing all task related information.
 
   Return value:
   none
 */
-void TISM_PostmanDeleteMessage(TISM_Task ThisTask)
+void TISM_IN_RAM(TISM_PostmanDeleteMessage)(const TISM_Task *ThisTask)
 {
-  TISM_CircularBufferDelete(ThisTask.InboundMessageQueue);
+  TISM_PostmanReleaseBuffers(ThisTask->InboundMessageQueue, 1);
+  TISM_CircularBufferDelete(ThisTask->InboundMessageQueue);
 }
 
 
-// The structure containing all data for TISM_Postman to run.
-struct TISM_PostmanData
+/*
+  Description
+  Wrapper for TISM_CircularBufferDeleteMultiple; delete the first messages from the inbound queue of the task. References
+  to buffers (TISM_BUFFER) are dropped.
+
+  Parameters:
+  TISM_Task *ThisTask - Pointer to struct containing all task related information.
+  uint16_t Count      - Number of messages to delete.
+
+  Return value:
+  none
+*/
+void TISM_PostmanDeleteMessages(const TISM_Task *ThisTask, uint16_t Count)
 {
-  bool TaskReceivedMessage[MAX_TASKS];  
-} TISM_PostmanData;
+  TISM_PostmanReleaseBuffers(ThisTask->InboundMessageQueue, Count);
+  TISM_CircularBufferDeleteMultiple(ThisTask->InboundMessageQueue, Count);
+}
+
+
+
+// Internal function - a message couldn't be delivered (inbound queue of the recipient full). Count it for the next
+// report (see TISM_PostmanReportDrops) and let the sender know when POSTMAN_NOTIFY_DROPS is set, so it can throttle.
+// System tasks don't act on this.
+void TISM_PostmanMessageDropped(TISM_Task *ThisTask, const TISM_Message *Message)
+{
+  TISM_PostmanData.MessagesDropped++;
+  TISM_PostmanData.LastDropped=*Message;
+  if(POSTMAN_NOTIFY_DROPS && TISM_IsValidTaskID(Message->SenderTaskID) && !TISM_IsSystemTask(Message->SenderTaskID))
+  {
+    // Wake the sender like any other recipient; it could be waiting for a message (see TISM_PostmanWaitForMessage).
+    TISM_Message Notice={ .SenderTaskID=ThisTask->TaskID, .RecipientTaskID=Message->SenderTaskID, .MessageType=TISM_MESSAGE_DROPPED, .Topic=TISM_NO_TOPIC,
+                          .Message=Message->RecipientTaskID, .Specification=Message->MessageType, .MessageTimestamp=time_us_64() };
+    if(TISM_CircularBufferCopy(&InboundMessageQueue[Notice.RecipientTaskID], &Notice, 1))
+      TISM_PostmanNotifyRecipient(Notice.RecipientTaskID, &Notice, 1);
+  }
+}
+
+
+// Internal function - log the number of messages that couldn't be delivered since the last report, at most once every
+// POSTMAN_DROP_REPORT_INTERVAL. This goes through TISM_EventLogger, so TISM_Postman never waits for the output; when
+// the log entry can't be written the drops are reported in a later run. Returns true when a report is still pending.
+bool TISM_PostmanReportDrops(TISM_Task *ThisTask)
+{
+  uint32_t Dropped=TISM_PostmanData.MessagesDropped-TISM_PostmanData.MessagesDroppedReported;
+  if(Dropped==0)
+    return(false);
+  if((time_us_64()>=TISM_PostmanData.NextDropReport) && TISM_EventLoggerLogEvent (ThisTask, TISM_LOG_EVENT_ERROR, "%lu message(s) could not be delivered; last one '%ld' type %d from TaskID %d to %d.", Dropped, TISM_PostmanData.LastDropped.Message, TISM_PostmanData.LastDropped.MessageType, TISM_PostmanData.LastDropped.SenderTaskID, TISM_PostmanData.LastDropped.RecipientTaskID))
+  {
+    TISM_PostmanData.MessagesDroppedReported+=Dropped;
+    TISM_PostmanData.NextDropReport=time_us_64()+POSTMAN_DROP_REPORT_INTERVAL;
+    return(false);
+  }
+  return(true);
+}
+
+
+// Internal function - deliver a copy of a published message to each subscriber of the topic. Every copy of a TISM_BUFFER
+// message takes a reference to the buffer; the reference of the published message is dropped afterwards.
+void TISM_PostmanDeliverPublished(TISM_Task *ThisTask, const TISM_Message *Published)
+{
+  uint32_t Subscribers[TOPIC_MASK_WORDS];
+  uint32_t LockState=spin_lock_blocking(System.PostmanDeliveryLock);
+  memcpy(Subscribers, TISM_PostmanData.TopicSubscribers[Published->Topic], sizeof(Subscribers));
+  spin_unlock(System.PostmanDeliveryLock, LockState);
+
+  TISM_Message Copy=*Published;
+  for(uint8_t Word=0;Word<TOPIC_MASK_WORDS;Word++)
+  {
+    while(Subscribers[Word]!=0)
+    {
+      uint8_t RecipientTaskID=Word*32+__builtin_ctz(Subscribers[Word]);
+      Subscribers[Word]&=Subscribers[Word]-1;
+      if(RecipientTaskID>=System.NumberOfTasks)
+        continue;
+      Copy.RecipientTaskID=RecipientTaskID;
+      if((Copy.MessageType!=TISM_BUFFER) || TISM_BufferPoolRetain(Copy.Message))
+      {
+        if(TISM_CircularBufferCopy(&InboundMessageQueue[RecipientTaskID], &Copy, 1))
+        {
+          if(TRACE_ENABLED) TISM_TraceRecord(TRACE_MESSAGE_DELIVERED, RecipientTaskID, (Copy.SenderTaskID<<8)|Copy.MessageType);
+          TISM_PostmanNotifyRecipient(RecipientTaskID, &Copy, 1);
+          continue;
+        }
+        if(Copy.MessageType==TISM_BUFFER)
+          TISM_BufferPoolRelease(Copy.Message);
+      }
+      TISM_PostmanMessageDropped(ThisTask, &Copy);
+    }
+  }
+  if(Published->MessageType==TISM_BUFFER)
+    TISM_BufferPoolRelease(Published->Message);
+}
 
 
 /*
@@ -110,27 +762,26 @@ struct TISM_PostmanData
   This function is called by TISM_Scheduler.
 
   Parameters:
-  TISM_Task ThisTask - Struct containing all task related information.
+  TISM_Task *ThisTask - Pointer to struct containing all task related information.
 
   Return value:
   OK                 - Task run completed succesfully.
   None-zero value    - Error
 */
-uint8_t TISM_Postman (TISM_Task ThisTask)
+uint8_t TISM_Postman (TISM_Task *ThisTask)
 {
-  if (ThisTask.TaskDebug==DEBUG_HIGH) TISM_EventLoggerLogEvent (ThisTask, TISM_LOG_EVENT_NOTIFY, "Run starting.");
+  if (ThisTask->TaskDebug==DEBUG_HIGH) TISM_EventLoggerLogEvent (ThisTask, TISM_LOG_EVENT_NOTIFY, "Run starting.");
 
-  switch(ThisTask.TaskState)
+  switch(ThisTask->TaskState)
   {
     case INIT:  // Task required to initialize                
-                if (ThisTask.TaskDebug) TISM_EventLoggerLogEvent (ThisTask, TISM_LOG_EVENT_NOTIFY, "Initializing with priority %d.", ThisTask.TaskPriority);
+                if (ThisTask->TaskDebug) TISM_EventLoggerLogEvent (ThisTask, TISM_LOG_EVENT_NOTIFY, "Initializing with priority %d.", ThisTask->TaskPriority);
 
                 // Empty the register we use to track which tasks we need to send a wake-up request for.
-                for(uint8_t counter=0;counter<MAX_TASKS;counter++)
-                  TISM_PostmanData.TaskReceivedMessage[counter]=false;
+                memset(TISM_PostmanData.TaskReceivedMessage, 0, sizeof(TISM_PostmanData.TaskReceivedMessage));
 				        break;
 	  case RUN:   // Do the work		
-		      	    if (ThisTask.TaskDebug==DEBUG_HIGH) TISM_EventLoggerLogEvent (ThisTask, TISM_LOG_EVENT_NOTIFY, "Doing work with priority %d on core %d.", ThisTask.TaskPriority, ThisTask.RunningOnCoreID);
+		      	    if (ThisTask->TaskDebug==DEBUG_HIGH) TISM_EventLoggerLogEvent (ThisTask, TISM_LOG_EVENT_NOTIFY, "Doing work with priority %d on core %d.", ThisTask->TaskPriority, ThisTask->RunningOnCoreID);
 				
                 // We put a limit on message processed in each run, to prevent tasks claiming all of the system.
                 uint16_t MessageCounter=0;
@@ -141,7 +792,7 @@ uint8_t TISM_Postman (TISM_Task ThisTask)
                 {
                   MessageToProcess=TISM_PostmanReadMessage(ThisTask);
 
-                  if (ThisTask.TaskDebug) TISM_EventLoggerLogEvent (ThisTask, TISM_LOG_EVENT_NOTIFY, "Message '%ld' type %d from TaskID %d (%s) received.", MessageToProcess->Message, MessageToProcess->MessageType, MessageToProcess->SenderTaskID, System.Task[MessageToProcess->SenderTaskID].TaskName);
+                  if (ThisTask->TaskDebug) TISM_EventLoggerLogEvent (ThisTask, TISM_LOG_EVENT_NOTIFY, "Message '%ld' type %d from TaskID %d (%s) received.", MessageToProcess->Message, MessageToProcess->MessageType, MessageToProcess->SenderTaskID, System.Task[MessageToProcess->SenderTaskID].TaskName);
 
                   // Processed the message; delete it.
                   switch(MessageToProcess->MessageType)
@@ -161,68 +812,111 @@ uint8_t TISM_Postman (TISM_Task ThisTask)
                 {
                   while((TISM_CircularBufferMessagesWaiting(&OutboundMessageQueue[CoreCounter])>0) && (MessageCounter<MAX_MESSAGES))
                   {
-                    MessageToProcess=TISM_CircularBufferRead(&OutboundMessageQueue[CoreCounter]);
+                    // Take the run of consecutive messages for the same recipient at the start of the queue.
+                    TISM_Message *Messages;
+                    uint16_t Count=TISM_CircularBufferReadSpan(&OutboundMessageQueue[CoreCounter], &Messages), RunLength=1;
 
-                    if (ThisTask.TaskDebug) TISM_EventLoggerLogEvent (ThisTask, TISM_LOG_EVENT_NOTIFY, "Processing message '%ld' from the queue of core %d type %d from TaskID %d (%s) to %d (%s).", MessageToProcess->Message, CoreCounter, MessageToProcess->MessageType, MessageToProcess->SenderTaskID, System.Task[MessageToProcess->SenderTaskID].TaskName, MessageToProcess->RecipientTaskID, System.Task[MessageToProcess->RecipientTaskID].TaskName);
-
-                    // Write this message to the inbound queue of SenderTaskID. Check validity of the recipient ID.
-                    if((MessageToProcess->RecipientTaskID>=0) && 
-                       (MessageToProcess->RecipientTaskID<System.NumberOfTasks) &&
-                       (!TISM_CircularBufferWriteWithTimestamp (&InboundMessageQueue[MessageToProcess->RecipientTaskID], MessageToProcess->SenderTaskID, MessageToProcess->RecipientTaskID, MessageToProcess->MessageType, MessageToProcess->Message, MessageToProcess->Specification, MessageToProcess->MessageTimestamp)))
+                    // Published messages go to all subscribers of the topic.
+                    if(Messages[0].RecipientTaskID==TISM_TOPIC_RECIPIENT)
                     {
-                      // Failure in delivery - buffer full? Give warning.
-                      // Don't use the system logger - doesn't make sense to use it when there are issues with circulair buffers.
-                      fprintf(STDERR, "%llu %s (ID %d) ERROR: Message '%ld' type %d from TaskID %d to %d could not be delivered.", time_us_64(), ThisTask.TaskName, ThisTask.TaskID, MessageToProcess->Message, MessageToProcess->MessageType, MessageToProcess->SenderTaskID, MessageToProcess->RecipientTaskID);
-                    
-                      // Prevent a memory leak; when a message is sent to the EventLogger, free the claimed memory.
-                      if(MessageToProcess->RecipientTaskID==System.TISM_EventLoggerTaskID && (MessageToProcess->MessageType==TISM_LOG_EVENT_NOTIFY || MessageToProcess->MessageType==TISM_LOG_EVENT_ERROR))
+                      TISM_PostmanDeliverPublished(ThisTask, &Messages[0]);
+                      TISM_CircularBufferDelete(&OutboundMessageQueue[CoreCounter]);
+                      MessageCounter++;
+                      continue;
+                    }
+                    uint8_t RecipientTaskID=Messages[0].RecipientTaskID;
+                    while((RunLength<Count) && (MessageCounter+RunLength<MAX_MESSAGES) && (Messages[RunLength].RecipientTaskID==RecipientTaskID))
+                      RunLength++;
+
+                    if (ThisTask->TaskDebug)
+                      for(uint16_t counter=0;counter<RunLength;counter++)
+                        TISM_EventLoggerLogEvent (ThisTask, TISM_LOG_EVENT_NOTIFY, "Processing message '%ld' from the queue of core %d type %d from TaskID %d (%s) to %d (%s).", Messages[counter].Message, CoreCounter, Messages[counter].MessageType, Messages[counter].SenderTaskID, System.Task[Messages[counter].SenderTaskID].TaskName, RecipientTaskID, System.Task[RecipientTaskID].TaskName);
+
+                    // Write the messages to the inbound queue of the recipient as one block. Check validity of the recipient ID.
+                    // When there is no room for all of them, deliver the first one by itself.
+                    // Senders can write directly into inbound queues as well; these queues are multi-producer safe.
+                    bool Delivered=false;
+                    if(RecipientTaskID<System.NumberOfTasks)
+                    {
+                      if((RunLength>1) && (TISM_CircularBufferSlotsAvailable(&InboundMessageQueue[RecipientTaskID])>=RunLength))
+                        Delivered=TISM_CircularBufferCopy(&InboundMessageQueue[RecipientTaskID], Messages, RunLength);
+                      if(!Delivered)
                       {
-                        // Messages from this type sent to EventHandler have claimed memory, Release it to prevent memory leaks.
-                        fprintf(STDERR, " Attempting to free claimed memory.");
-                        free((char *)MessageToProcess->Message);
+                        RunLength=1;
+                        Delivered=TISM_CircularBufferCopy(&InboundMessageQueue[RecipientTaskID], Messages, 1);
                       }
-                      fprintf(STDERR, "\n");
+                    }
+                    else
+                      RunLength=1;
+                    if(RecipientTaskID<MAX_TASKS)
+                      TISM_PostmanData.Processed[CoreCounter][RecipientTaskID]+=RunLength;
+
+                    if(!Delivered)
+                    {
+                      // Failure in delivery - buffer full? Count it; it's reported by TISM_PostmanReportDrops.
+                      MessageToProcess=&Messages[0];
+                      TISM_PostmanMessageDropped(ThisTask, MessageToProcess);
+                    
+                      // Log entries sent to the EventLogger have claimed an entry from the pool; return it.
+                      if(MessageToProcess->RecipientTaskID==TISM_EVENTLOGGER_TASK_ID && (MessageToProcess->MessageType==TISM_LOG_EVENT_NOTIFY || MessageToProcess->MessageType==TISM_LOG_EVENT_ERROR))
+                        TISM_EventLoggerReleaseEntry(MessageToProcess->Message);
+
+                      // Same for the reference of the message to a buffer.
+                      if(MessageToProcess->MessageType==TISM_BUFFER)
+                        TISM_BufferPoolRelease(MessageToProcess->Message);
                     }
                     else
                     {
-                      // Note that we need to ask TaskManager to wake the recipient.
+                      if(TRACE_ENABLED)
+                        for(uint16_t counter=0;counter<RunLength;counter++)
+                          TISM_TraceRecord(TRACE_MESSAGE_DELIVERED, RecipientTaskID, (Messages[counter].SenderTaskID<<8)|Messages[counter].MessageType);
+
+                      // Note that we need to ask TaskManager to wake the recipient, unless it waits for a message.
                       // Further note, we do not have to ask TaskManager and IRQHandler to wake itself.
-                      if(MessageToProcess->RecipientTaskID!=System.TISM_TaskManagerTaskID)
-                        TISM_PostmanData.TaskReceivedMessage[MessageToProcess->RecipientTaskID]=true;
+                      TISM_PostmanNotifyRecipient(RecipientTaskID, Messages, RunLength);
                     }
                    
-                    // Processed the message; delete it.
-                    TISM_CircularBufferDelete(&OutboundMessageQueue[CoreCounter]);
-                    MessageCounter++;
+                    // Processed the messages; delete them.
+                    TISM_CircularBufferDeleteMultiple(&OutboundMessageQueue[CoreCounter], RunLength);
+                    MessageCounter+=RunLength;
                   }
                 }
 
                 // Now send messages to TaskManager to wake all processes who have received a message.
-                for(uint8_t counter=0;counter<System.NumberOfTasks;counter++)
+                // Only the tasks in the bitmap are visited, so the cost doesn't grow with the number of tasks.
+                // When the queue of TaskManager is full the task stays in the bitmap; we stay awake and try again next run.
+                bool WakeUpPending=false;
+                for(uint8_t Word=0;Word<SCHEDULER_MASK_WORDS;Word++)
                 {
-                  if(TISM_PostmanData.TaskReceivedMessage[counter])
+                  for(uint32_t Received=TISM_PostmanData.TaskReceivedMessage[Word];Received!=0;Received&=Received-1)
                   {
-                    TISM_CircularBufferWrite(&InboundMessageQueue[System.TISM_TaskManagerTaskID],ThisTask.TaskID,System.TISM_TaskManagerTaskID,TISM_SET_TASK_SLEEP,false,counter); 
-                    TISM_PostmanData.TaskReceivedMessage[counter]=false;
+                    if(TISM_CircularBufferWrite(&InboundMessageQueue[TISM_TASKMANAGER_TASK_ID],ThisTask->TaskID,TISM_TASKMANAGER_TASK_ID,TISM_SET_TASK_SLEEP,false,(Word*32)+__builtin_ctz(Received)))
+                      TISM_PostmanData.TaskReceivedMessage[Word]&=~(Received&-Received);
+                    else
+                      WakeUpPending=true;
                   }
                 }
-                // Go to sleep; we only wake on incoming messages. 
+                // Go to sleep; we only wake on incoming messages. Stay awake until pending drops are reported as well.
                 // We do it directly here to prevent circulair dependencies with TISM_TaskManager.
-                System.Task[System.TISM_PostmanTaskID].TaskSleeping=true;
+                bool ReportPending=TISM_PostmanReportDrops(ThisTask);
+                if(!WakeUpPending && ReportPending)
+                  System.Task[TISM_POSTMAN_TASK_ID].TaskWakeUpTimer=TISM_PostmanData.NextDropReport;
+                else if(!WakeUpPending)
+                  System.Task[TISM_POSTMAN_TASK_ID].TaskSleeping=true;
                 // All done.				
 				        break;
 	  case STOP:  // Task required to stop
-		            if (ThisTask.TaskDebug) TISM_EventLoggerLogEvent (ThisTask, TISM_LOG_EVENT_NOTIFY, "Stopping.");
+		            if (ThisTask->TaskDebug) TISM_EventLoggerLogEvent (ThisTask, TISM_LOG_EVENT_NOTIFY, "Stopping.");
 		        
 				        // Tasks for stopping
 			          
                 // Set the task state to DOWN. We do it directly here to prevent circulair dependencies with TISM_TaskManager.
-                System.Task[System.TISM_PostmanTaskID].TaskState=DOWN;
+                System.Task[TISM_POSTMAN_TASK_ID].TaskState=DOWN;
 		            break;
     default:    // All other states (e.g. SLEEP) are ignored/no action.
                 break;					
   }	
   // All done.
-  if (ThisTask.TaskDebug==DEBUG_HIGH) TISM_EventLoggerLogEvent (ThisTask, TISM_LOG_EVENT_NOTIFY, "Run completed.");
+  if (ThisTask->TaskDebug==DEBUG_HIGH) TISM_EventLoggerLogEvent (ThisTask, TISM_LOG_EVENT_NOTIFY, "Run completed.");
   return (OK);
 }
@@ -6,22 +6,48 @@
   The scheduling process:
   - When each task is registered a priority is specified (PRIORITY_HIGH, PRIORITY_NORMAL and PRIORITY_LOW). This is
     actually a value describing the number of microseconds between each run of the specified task ("wake up timer").
-  - The TaskIDs of all tasks are collected in a list; CORE0 cycles through the list from bottom to top, 
-    CORE1 in the other direction, both via a separate instance of TISM_Scheduler.
+  - The scheduler keeps track of the tasks that are ready to run (awake and wake-up timer expired) in a bitmap per
+    priority class (PRIORITY_HIGH, PRIORITY_NORMAL, PRIORITY_LOW). Tasks that are awake but have to wait for their wake-up
+    timer are kept in a heap ordered on their wake-up time; these are moved to the ready bitmap only when the first
+    wake-up time has passed. Sleeping tasks are in neither. Whenever the sleep state, wake-up timer or priority of a task
+    is changed by another task, TISM_SchedulerUpdateTask has to be called to update this administration.
+  - Each core has its own run queue (set of ready bitmaps). Tasks have a core affinity (TaskAffinity); tasks pinned to
+    CORE0 or CORE1 are only placed in the run queue of that core, tasks with CORE_ANY are placed in the run queue of the
+    core that ran them last. A core that has no ready tasks in its own run queue steals CORE_ANY tasks from the run
+    queue of the other core; the stolen task then stays with the new core.
+  - CORE0 cycles through its ready tasks from bottom to top, CORE1 in the other direction, both via a separate instance
+    of TISM_Scheduler. The next ready task is found by searching the bitmap (count trailing/leading zeros) instead of
+    evaluating every task.
   - When running through the list the priorities of tasks are considered via a cycle; first tasks with PRIORITY_HIGH
     are evaluated, then PRIORITY_NORMAL and higher, and last PRIORITY_LOW and higher. This means that tasks with
     PRIORITY_HIGH are executed more frequently and get the most CPU-time; PRIORITY_NORMAL a bit less etc.
-  - For each "run through the list" the scheduler makes the following evaluations:
-    - Are both cores (TISM_Scheduler instances) looking at the same TaskID ("collision")? If so, skip.
-    - Is the task sleeping? If so, skip.
-    - Is the wake-up timer for this task expired? If not, skip.
-    If all these conditions do not apply the task is executed. When any other value than OK (0) is returned, the scheduler stops
-    and generates a fatal error.
+  - With SCHEDULER_EDF the cycle is skipped; the core always runs the ready task with the earliest deadline, from its own
+    run queue or one to steal from the other core. The deadline of a task is its wake-up time plus its relative deadline
+    (TaskDeadline, by default its period). Tasks with a custom period are treated by their deadline instead of as
+    PRIORITY_LOW. Runs that complete after their deadline are counted as deadline misses, in both modes.
+  - A task is claimed by a core before it is run; a claimed task is removed from the run queue, so both cores never
+    run the same task at the same time. TISM_Postman and TISM_TaskManager are started by both cores
+    when needed, regardless of their affinity. When any other value than OK (0) is returned, the scheduler stops and generates
+    a fatal error.
   - When a task has run succesfully the outbound messagequeue for the specific instance of TISM_Scheduler is checked. If
     messages are waiting, TISM_Postman (delivery of messages) and TISM_Taskmanager (wake up tasks who have received 
     messages) are started.
-  - Last, check if any interrupts where received. If so then start TISM_IRQHandler, followed by TISM_Postman 
-    and TISM_Taskmanager.
+  - Interrupts don't pass through the scheduler; the interrupt handler of TISM_IRQHandler writes the events straight
+    into the inbound queues of the subscribed tasks and wakes them up.
+  - When no task is ready after a full cycle through the priorities, the core goes to sleep (SCHEDULER_IDLE_SLEEP) until
+    the next wake-up time of a waiting task. A hardware alarm, an interrupt or an event (SEV) sent when a task is woken
+    up ends the sleep.
+  - Each run of a task is recorded in System.TaskStatistics and System.CoreStatistics (SCHEDULER_STATISTICS); the number
+    of runs, the run time, the lateness (start of the task minus its wake-up time) and the number of missed periods.
+    TISM_TaskManager logs these on request (TISM_LOG_STATISTICS).
+  - The time each run of a task completes is stored in System.TaskLastRun; TISM_Watchdog uses this as heartbeat.
+  - With TRACE_ENABLED the start and end of each run, and the idle periods of the cores, are recorded in the trace (see
+    TISM_Trace.c).
+  - A task that waits for a message (TISM_PostmanWaitForMessage) is asleep, or waits for its timeout in the heap. It is
+    made ready by the one delivering the message it waits for, without a message to TISM_TaskManager.
+  - At start-up CORE0 runs the INIT state of the system tasks, then of the user tasks; with SCHEDULER_PARALLEL_INIT
+    CORE1 joins in for the user tasks. CORE1 waits for an event (SEV) from CORE0 instead of polling the system state.
+    The tasks start running STARTUP_DELAY msec after all tasks are initialized.
 
   As this is non-preemptive/cooperative multitasking, this mechanism only works if each task briefly executes and 
   then exits, freeing up time for other tasks to run.
@@ -41,6 +67,440 @@
 #include "TISM.h"
 
 
+/*
+  
+  The internal structures containing the administration of ready and waiting tasks. Protected by a spinlock, as both
+  cores (and tasks delivering messages) modify it.
+
+*/
+
+#define SCHEDULER_TASK_SLEEPING  0       // Task is sleeping; not in the bitmap or heap.
+#define SCHEDULER_TASK_WAITING   1       // Task is awake but waits for its wake-up timer; in the heap.
+#define SCHEDULER_TASK_READY     2       // Task is ready to run; in the bitmap.
+#define SCHEDULER_TASK_RUNNING   3       // Task is claimed by one of the cores.
+
+struct TISM_SchedulerData
+{
+  spin_lock_t *Lock;
+  uint32_t ReadyTasks[MAX_CORES][SCHEDULER_PRIORITY_CLASSES][SCHEDULER_MASK_WORDS];   // Run queue per core; bitmap of ready tasks per priority class.
+  uint32_t AnyCoreTasks[SCHEDULER_MASK_WORDS];                             // Bitmap of tasks with CORE_ANY affinity; these can be stolen.
+  uint8_t WaitingTasks[MAX_TASKS], NumberOfWaitingTasks;                   // Heap of waiting tasks, ordered on wake-up time.
+  uint8_t HeapIndex[MAX_TASKS], TaskState[MAX_TASKS], PriorityClass[MAX_TASKS];
+  uint8_t ReadyCore[MAX_TASKS], HomeCore[MAX_TASKS];                       // Run queue the task is in; core that ran the task last.
+  bool TaskUpdated[MAX_TASKS];                                             // Task was updated while it was running.
+  uint64_t WakeUpTimer[MAX_TASKS];                                         // Wake-up time the heap is ordered on.
+  uint64_t Deadline[MAX_TASKS];                                            // Deadline of ready tasks (SCHEDULER_EDF).
+  uint8_t InitNextTask, InitCompleted;                                     // Next user task to initialize; number of user tasks initialized.
+  bool InitReleased;                                                       // System tasks initialized; CORE1 may start initializing user tasks.
+} TISM_SchedulerData;
+
+
+// Internal function - determine the priority class of a task; tasks with a lower priority than PRIORITY_LOW run in the PRIORITY_LOW class.
+uint8_t TISM_IN_RAM(TISM_SchedulerPriorityClass)(uint32_t TaskPriority)
+{
+  return(TaskPriority<=PRIORITY_HIGH?0:(TaskPriority<=PRIORITY_NORMAL?1:2));
+}
+
+
+// Internal function - determine the deadline of a task that wakes up at the specified time.
+uint64_t TISM_IN_RAM(TISM_SchedulerDeadline)(uint8_t TaskID, uint64_t WakeUpTimer)
+{
+  return(WakeUpTimer+(System.Task[TaskID].TaskDeadline>0?System.Task[TaskID].TaskDeadline:System.Task[TaskID].TaskPriority));
+}
+
+
+// Internal function - place a task on a position in the heap and update its index.
+void TISM_IN_RAM(TISM_SchedulerHeapPlace)(uint8_t HeapIndex, uint8_t TaskID)
+{
+  TISM_SchedulerData.WaitingTasks[HeapIndex]=TaskID;
+  TISM_SchedulerData.HeapIndex[TaskID]=HeapIndex;
+}
+
+
+// Internal function - move the task at the specified heap position up or down until the heap is ordered again.
+void TISM_IN_RAM(TISM_SchedulerHeapRestore)(uint8_t HeapIndex)
+{
+  uint8_t TaskID=TISM_SchedulerData.WaitingTasks[HeapIndex], ChildIndex;
+  uint64_t WakeUpTimer=TISM_SchedulerData.WakeUpTimer[TaskID];
+  while((HeapIndex>0) && (TISM_SchedulerData.WakeUpTimer[TISM_SchedulerData.WaitingTasks[(HeapIndex-1)/2]]>WakeUpTimer))
+  {
+    TISM_SchedulerHeapPlace(HeapIndex, TISM_SchedulerData.WaitingTasks[(HeapIndex-1)/2]);
+    HeapIndex=(HeapIndex-1)/2;
+  }
+  while((ChildIndex=(HeapIndex*2)+1)<TISM_SchedulerData.NumberOfWaitingTasks)
+  {
+    if((ChildIndex+1<TISM_SchedulerData.NumberOfWaitingTasks) &&
+       (TISM_SchedulerData.WakeUpTimer[TISM_SchedulerData.WaitingTasks[ChildIndex+1]]<TISM_SchedulerData.WakeUpTimer[TISM_SchedulerData.WaitingTasks[ChildIndex]]))
+      ChildIndex++;
+    if(TISM_SchedulerData.WakeUpTimer[TISM_SchedulerData.WaitingTasks[ChildIndex]]>=WakeUpTimer)
+      break;
+    TISM_SchedulerHeapPlace(HeapIndex, TISM_SchedulerData.WaitingTasks[ChildIndex]);
+    HeapIndex=ChildIndex;
+  }
+  TISM_SchedulerHeapPlace(HeapIndex, TaskID);
+}
+
+
+// Internal function - remove a task from the heap.
+void TISM_IN_RAM(TISM_SchedulerHeapRemove)(uint8_t TaskID)
+{
+  uint8_t HeapIndex=TISM_SchedulerData.HeapIndex[TaskID];
+  TISM_SchedulerData.NumberOfWaitingTasks--;
+  if(HeapIndex<TISM_SchedulerData.NumberOfWaitingTasks)
+  {
+    TISM_SchedulerHeapPlace(HeapIndex, TISM_SchedulerData.WaitingTasks[TISM_SchedulerData.NumberOfWaitingTasks]);
+    TISM_SchedulerHeapRestore(HeapIndex);
+  }
+}
+
+
+// Internal function - mark a task as ready to run; place it in the run queue of the core it belongs to.
+void TISM_IN_RAM(TISM_SchedulerSetReady)(uint8_t TaskID)
+{
+  TISM_SchedulerData.TaskState[TaskID]=SCHEDULER_TASK_READY;
+  TISM_SchedulerData.ReadyCore[TaskID]=(System.Task[TaskID].TaskAffinity==CORE_ANY?TISM_SchedulerData.HomeCore[TaskID]:System.Task[TaskID].TaskAffinity);
+  TISM_SchedulerData.ReadyTasks[TISM_SchedulerData.ReadyCore[TaskID]][TISM_SchedulerData.PriorityClass[TaskID]][TaskID/32]|=(1u<<(TaskID%32));
+  if(SCHEDULER_EDF)
+    TISM_SchedulerData.Deadline[TaskID]=TISM_SchedulerDeadline(TaskID, System.Task[TaskID].TaskWakeUpTimer);
+}
+
+
+// Internal function - remove a task from the bitmap or heap. Lock must be held.
+void TISM_IN_RAM(TISM_SchedulerDetachTask)(uint8_t TaskID)
+{
+  switch(TISM_SchedulerData.TaskState[TaskID])
+  {
+    case SCHEDULER_TASK_READY:   TISM_SchedulerData.ReadyTasks[TISM_SchedulerData.ReadyCore[TaskID]][TISM_SchedulerData.PriorityClass[TaskID]][TaskID/32]&=~(1u<<(TaskID%32));
+                                 break;
+    case SCHEDULER_TASK_WAITING: TISM_SchedulerHeapRemove(TaskID);
+                                 break;
+  }
+  TISM_SchedulerData.TaskState[TaskID]=SCHEDULER_TASK_SLEEPING;
+}
+
+
+// Internal function - add a task to the bitmap or heap, depending on its sleep state and wake-up timer. Lock must be held.
+void TISM_IN_RAM(TISM_SchedulerAttachTask)(uint8_t TaskID, uint64_t Now)
+{
+  // Task ID 0 is the scheduler itself.
+  TISM_SchedulerData.PriorityClass[TaskID]=TISM_SchedulerPriorityClass(System.Task[TaskID].TaskPriority);
+  if(System.Task[TaskID].TaskAffinity==CORE_ANY)
+    TISM_SchedulerData.AnyCoreTasks[TaskID/32]|=(1u<<(TaskID%32));
+  else
+    TISM_SchedulerData.AnyCoreTasks[TaskID/32]&=~(1u<<(TaskID%32));
+  if((System.Task[TaskID].TaskSleeping) || (System.Task[TaskID].TaskFunction==NULL))
+    TISM_SchedulerData.TaskState[TaskID]=SCHEDULER_TASK_SLEEPING;
+  else if(System.Task[TaskID].TaskWakeUpTimer<=Now)
+    TISM_SchedulerSetReady(TaskID);
+  else
+  {
+    TISM_SchedulerData.TaskState[TaskID]=SCHEDULER_TASK_WAITING;
+    TISM_SchedulerData.WakeUpTimer[TaskID]=System.Task[TaskID].TaskWakeUpTimer;
+    TISM_SchedulerHeapPlace(TISM_SchedulerData.NumberOfWaitingTasks, TaskID);
+    TISM_SchedulerData.NumberOfWaitingTasks++;
+    TISM_SchedulerHeapRestore(TISM_SchedulerData.NumberOfWaitingTasks-1);
+  }
+}
+
+
+// Internal function - move waiting tasks whose wake-up timer has expired to the ready bitmap. Lock must be held.
+void TISM_IN_RAM(TISM_SchedulerPromoteWaitingTasks)(uint64_t Now)
+{
+  while((TISM_SchedulerData.NumberOfWaitingTasks>0) && (TISM_SchedulerData.WakeUpTimer[TISM_SchedulerData.WaitingTasks[0]]<=Now))
+  {
+    uint8_t TaskID=TISM_SchedulerData.WaitingTasks[0];
+    TISM_SchedulerHeapRemove(TaskID);
+    TISM_SchedulerSetReady(TaskID);
+  }
+}
+
+
+// Internal function - find the next ready task in the run queue of the specified core after position From, in the
+// specified direction, within the priority classes allowed in this run. When stealing only tasks with CORE_ANY affinity
+// are considered. Returns 255 if none is found. Lock must be held.
+uint8_t TISM_IN_RAM(TISM_SchedulerFindReadyTask)(uint8_t CoreID, int16_t From, int8_t Direction, uint8_t MaxPriorityClass, bool Steal)
+{
+  int16_t Start=From+Direction;
+  if((Start<0) || (Start>=MAX_TASKS))
+    return(255);
+  for(int16_t Word=Start/32;(Word>=0) && (Word<SCHEDULER_MASK_WORDS);Word+=Direction)
+  {
+    uint32_t Ready=0;
+    for(uint8_t Class=0;Class<=MaxPriorityClass;Class++)
+      Ready|=TISM_SchedulerData.ReadyTasks[CoreID][Class][Word];
+    if(Steal)
+      Ready&=TISM_SchedulerData.AnyCoreTasks[Word];
+
+    // Only consider the tasks beyond the starting point in the first word.
+    if(Word==Start/32)
+      Ready&=(Direction==QUEUE_RUN_ASCENDING?(0xFFFFFFFF<<(Start%32)):(Start%32==31?0xFFFFFFFF:((1u<<((Start%32)+1))-1)));
+    if(Ready!=0)
+      return((Word*32)+(Direction==QUEUE_RUN_ASCENDING?__builtin_ctz(Ready):(31-__builtin_clz(Ready))));
+  }
+  return(255);
+}
+
+
+// Internal function - find the ready task with the earliest deadline in the run queue of this core, and the tasks with
+// CORE_ANY affinity in the run queue of the other core (SCHEDULER_EDF). Returns 255 if none is found. Lock must be held.
+uint8_t TISM_IN_RAM(TISM_SchedulerFindEarliestDeadline)(uint8_t ThisCoreID, bool *Stolen)
+{
+  uint8_t TaskID=255, OtherCoreID=(ThisCoreID+1)%MAX_CORES;
+  uint64_t EarliestDeadline=UINT64_MAX;
+  for(uint8_t Word=0;Word<SCHEDULER_MASK_WORDS;Word++)
+  {
+    uint32_t Own=0, Other=0;
+    for(uint8_t Class=0;Class<SCHEDULER_PRIORITY_CLASSES;Class++)
+    {
+      Own|=TISM_SchedulerData.ReadyTasks[ThisCoreID][Class][Word];
+      Other|=TISM_SchedulerData.ReadyTasks[OtherCoreID][Class][Word];
+    }
+    Other&=TISM_SchedulerData.AnyCoreTasks[Word];
+    for(uint32_t Ready=Own|Other;Ready!=0;Ready&=Ready-1)
+    {
+      uint8_t Candidate=(Word*32)+__builtin_ctz(Ready);
+      if(TISM_SchedulerData.Deadline[Candidate]<EarliestDeadline)
+      {
+        TaskID=Candidate;
+        EarliestDeadline=TISM_SchedulerData.Deadline[Candidate];
+        *Stolen=((Own&(Ready&-Ready))==0);
+      }
+    }
+  }
+  return(TaskID);
+}
+
+
+// Internal function - claim the next ready task for this core (see TISM_SchedulerFindReadyTask). When the run queue of
+// this core has no ready tasks left, steal one from the other core. With SCHEDULER_EDF the task with the earliest
+// deadline is claimed instead (see TISM_SchedulerFindEarliestDeadline). Returns 255 if none is found.
+uint8_t TISM_IN_RAM(TISM_SchedulerClaimNextTask)(uint8_t ThisCoreID, int16_t From, int8_t Direction, uint8_t MaxPriorityClass, bool *Stolen)
+{
+  uint32_t LockState=spin_lock_blocking(TISM_SchedulerData.Lock);
+  TISM_SchedulerPromoteWaitingTasks(time_us_64());
+  *Stolen=false;
+  uint8_t TaskID=(SCHEDULER_EDF?TISM_SchedulerFindEarliestDeadline(ThisCoreID, Stolen):TISM_SchedulerFindReadyTask(ThisCoreID, From, Direction, MaxPriorityClass, false));
+  if((TaskID==255) && !SCHEDULER_EDF)
+  {
+    // Nothing left in our own run queue; search the whole run queue of the other core.
+    TaskID=TISM_SchedulerFindReadyTask((ThisCoreID+1)%MAX_CORES, (Direction==QUEUE_RUN_ASCENDING?-1:MAX_TASKS), Direction, MaxPriorityClass, true);
+    *Stolen=(TaskID!=255);
+  }
+  if(TaskID!=255)
+  {
+    TISM_SchedulerDetachTask(TaskID);
+    TISM_SchedulerData.TaskState[TaskID]=SCHEDULER_TASK_RUNNING;
+    TISM_SchedulerData.TaskUpdated[TaskID]=false;
+
+    // A wait for a message (see TISM_PostmanWaitForMessage) ends when the task runs, for whatever reason.
+    System.Task[TaskID].TaskWaitForMessage=TISM_NOT_WAITING;
+  }
+  spin_unlock(TISM_SchedulerData.Lock, LockState);
+  return(TaskID);
+}
+
+
+// Internal function - claim a specific task for this core. Returns false, without waiting, when the other core is
+// running it.
+bool TISM_IN_RAM(TISM_SchedulerTryClaimTask)(uint8_t TaskID)
+{
+  bool Claimed=false;
+  uint32_t LockState=spin_lock_blocking(TISM_SchedulerData.Lock);
+  if(TISM_SchedulerData.TaskState[TaskID]!=SCHEDULER_TASK_RUNNING)
+  {
+    TISM_SchedulerDetachTask(TaskID);
+    TISM_SchedulerData.TaskState[TaskID]=SCHEDULER_TASK_RUNNING;
+    TISM_SchedulerData.TaskUpdated[TaskID]=false;
+    Claimed=true;
+  }
+  spin_unlock(TISM_SchedulerData.Lock, LockState);
+  return(Claimed);
+}
+
+
+// Internal function - release a claimed task; add it to the bitmap or heap again. The task now belongs to the core that ran it.
+void TISM_IN_RAM(TISM_SchedulerReleaseTask)(uint8_t TaskID)
+{
+  uint32_t LockState=spin_lock_blocking(TISM_SchedulerData.Lock);
+  TISM_SchedulerData.TaskState[TaskID]=SCHEDULER_TASK_SLEEPING;
+  TISM_SchedulerData.HomeCore[TaskID]=System.Task[TaskID].RunningOnCoreID;
+  TISM_SchedulerAttachTask(TaskID, time_us_64());
+  spin_unlock(TISM_SchedulerData.Lock, LockState);
+}
+
+
+/*
+  Description
+  Update the administration of the scheduler after the sleep state, wake-up timer or priority of a task has changed.
+  To be called by every function that changes these attributes of a task other than the one that is running. Changes
+  a task makes to itself while running are picked up when the run is completed.
+
+  Parameters:
+  uint8_t TaskID          - ID of the task that was changed.
+  
+  Return value:
+  None
+*/
+void TISM_IN_RAM(TISM_SchedulerUpdateTask)(uint8_t TaskID)
+{
+  uint32_t LockState=spin_lock_blocking(TISM_SchedulerData.Lock);
+  if(TISM_SchedulerData.TaskState[TaskID]==SCHEDULER_TASK_RUNNING)
+  {
+    // Task is running; remember the update so the scheduler respects a new wake-up timer when the run is completed.
+    TISM_SchedulerData.TaskUpdated[TaskID]=true;
+  }
+  else
+  {
+    TISM_SchedulerDetachTask(TaskID);
+    TISM_SchedulerAttachTask(TaskID, time_us_64());
+  }
+  spin_unlock(TISM_SchedulerData.Lock, LockState);
+
+  // The task might be due earlier now; wake up any idle core so it re-evaluates its sleep time.
+  __sev();
+}
+
+
+/*
+  Description
+  Let the calling task run again after the specified delay, instead of after its period. The task is woken up when
+  it is sleeping. Used by the TISM_COROUTINE macros to continue a long operation in the next run (Delay=0: in the next
+  cycle of the scheduler, after the other ready tasks).
+
+  Parameters:
+  TISM_Task *ThisTask     - Pointer to struct containing all task related information.
+  uint32_t Delay          - Microseconds from now the task wants to run again.
+
+  Return value:
+  None
+*/
+void TISM_IN_RAM(TISM_SchedulerYield)(const TISM_Task *ThisTask, uint32_t Delay)
+{
+  TISM_Task *Task=&System.Task[ThisTask->TaskID];
+  uint32_t LockState=spin_lock_blocking(System.PostmanDeliveryLock);
+  Task->TaskWakeUpTimer=time_us_64()+Delay;
+  Task->TaskSleeping=false;
+  spin_unlock(System.PostmanDeliveryLock, LockState);
+
+  // Make the scheduler respect the new wake-up timer when the run is completed, instead of the period of the task.
+  TISM_SchedulerUpdateTask(Task->TaskID);
+}
+
+
+// Internal function - determine the earliest moment a task needs to run. Returns 0 when tasks are ready to run on this
+// core now (including tasks that can be stolen from the other core), UINT64_MAX when all tasks are sleeping.
+uint64_t TISM_IN_RAM(TISM_SchedulerNextWakeUp)(uint8_t ThisCoreID)
+{
+  uint64_t WakeUp=UINT64_MAX;
+  uint32_t LockState=spin_lock_blocking(TISM_SchedulerData.Lock);
+  TISM_SchedulerPromoteWaitingTasks(time_us_64());
+  for(uint8_t Class=0;(Class<SCHEDULER_PRIORITY_CLASSES) && (WakeUp>0);Class++)
+    for(uint8_t Word=0;Word<SCHEDULER_MASK_WORDS;Word++)
+      if((TISM_SchedulerData.ReadyTasks[ThisCoreID][Class][Word]!=0) ||
+         ((TISM_SchedulerData.ReadyTasks[(ThisCoreID+1)%MAX_CORES][Class][Word]&TISM_SchedulerData.AnyCoreTasks[Word])!=0))
+        WakeUp=0;
+  if((WakeUp>0) && (TISM_SchedulerData.NumberOfWaitingTasks>0))
+    WakeUp=TISM_SchedulerData.WakeUpTimer[TISM_SchedulerData.WaitingTasks[0]];
+  spin_unlock(TISM_SchedulerData.Lock, LockState);
+  return(WakeUp);
+}
+
+
+// Internal function - record a run of a task in the statistics of the task and the core. The lateness is only known for
+// tasks started by the run loop; for other runs the wake-up time is 0. Only the core that claimed the task writes its statistics.
+void TISM_IN_RAM(TISM_SchedulerRecordRun)(uint8_t TaskID, uint8_t ThisCoreID, uint64_t WakeUpTimer, uint64_t StartTimestamp, uint64_t EndTimestamp)
+{
+  TISM_TaskStatistics *Statistics=&System.TaskStatistics[TaskID];
+  uint32_t RunTime=(uint32_t)(EndTimestamp-StartTimestamp);
+  Statistics->Runs++;
+  Statistics->TotalRunTime+=RunTime;
+  if(RunTime>Statistics->MaxRunTime)
+    Statistics->MaxRunTime=RunTime;
+  if(WakeUpTimer>0)
+  {
+    uint32_t Lateness=(StartTimestamp>WakeUpTimer?(uint32_t)(StartTimestamp-WakeUpTimer):0);
+    Statistics->ScheduledRuns++;
+    Statistics->TotalLateness+=Lateness;
+    if(Lateness>Statistics->MaxLateness)
+      Statistics->MaxLateness=Lateness;
+    if(EndTimestamp>TISM_SchedulerDeadline(TaskID, WakeUpTimer))
+      Statistics->DeadlineMisses++;
+  }
+  System.CoreStatistics[ThisCoreID].Runs++;
+  System.CoreStatistics[ThisCoreID].BusyTime+=RunTime;
+}
+
+
+// Internal function - let the core sleep when there is nothing to do. A hardware alarm is set for the earliest wake-up
+// time of the waiting tasks (limited by SCHEDULER_IDLE_MAX_USEC), after which the core waits for an event (WFE). Any
+// interrupt, the alarm or an event (SEV) from the other core - when a task is woken up or the system state changes -
+// ends the sleep. Events that occur just before going to sleep are latched by the processor, so these are not missed.
+void TISM_IN_RAM(TISM_SchedulerIdle)(uint8_t ThisCoreID)
+{
+  if(TISM_CircularBufferMessagesWaiting(&OutboundMessageQueue[ThisCoreID])>0)
+    return;
+  uint64_t Now=time_us_64(), WakeUp=TISM_SchedulerNextWakeUp(ThisCoreID);
+  if(WakeUp<Now+SCHEDULER_IDLE_MIN_USEC)
+    return;
+  if(WakeUp>Now+SCHEDULER_IDLE_MAX_USEC)
+    WakeUp=Now+SCHEDULER_IDLE_MAX_USEC;
+  if(TRACE_ENABLED) TISM_TraceRecord(TRACE_CORE_IDLE, TISM_SCHEDULER_TASK_ID, 0);
+  best_effort_wfe_or_timeout(from_us_since_boot(WakeUp));
+  if(TRACE_ENABLED) TISM_TraceRecord(TRACE_CORE_WAKE, TISM_SCHEDULER_TASK_ID, 0);
+  if(SCHEDULER_STATISTICS)
+    System.CoreStatistics[ThisCoreID].IdleTime+=time_us_64()-Now;
+}
+
+
+/*
+  Description
+  Reset the run statistics of a task. Specify TISM_SCHEDULER_TASK_ID to reset the statistics of all tasks and cores.
+
+  Parameters:
+  uint8_t TaskID          - ID of the task to reset the statistics for, or TISM_SCHEDULER_TASK_ID for all.
+  
+  Return value:
+  None
+*/
+void TISM_SchedulerResetStatistics(uint8_t TaskID)
+{
+  if(TaskID==TISM_SCHEDULER_TASK_ID)
+  {
+    memset(&System.TaskStatistics, 0, sizeof(System.TaskStatistics));
+    memset(&System.CoreStatistics, 0, sizeof(System.CoreStatistics));
+    System.StatisticsTimestamp=time_us_64();
+  }
+  else
+    memset(&System.TaskStatistics[TaskID], 0, sizeof(TISM_TaskStatistics));
+}
+
+
+/*
+  Description
+  Initialize the administration of the scheduler. Called once by TISM_InitializeSystem, before tasks are registered.
+
+  Parameters:
+  None
+  
+  Return value:
+  None
+*/
+void TISM_SchedulerInit()
+{
+  memset(&TISM_SchedulerData.ReadyTasks, 0, sizeof(TISM_SchedulerData.ReadyTasks));
+  memset(&TISM_SchedulerData.AnyCoreTasks, 0, sizeof(TISM_SchedulerData.AnyCoreTasks));
+  memset(&TISM_SchedulerData.TaskState, SCHEDULER_TASK_SLEEPING, sizeof(TISM_SchedulerData.TaskState));
+  for(uint8_t TaskID=0;TaskID<MAX_TASKS;TaskID++)
+    TISM_SchedulerData.HomeCore[TaskID]=TaskID%MAX_CORES;      // Spread the tasks with CORE_ANY affinity over both cores.
+  TISM_SchedulerData.NumberOfWaitingTasks=0;
+  TISM_SchedulerData.InitNextTask=TISM_NUMBER_OF_SYSTEM_TASKS;
+  TISM_SchedulerData.InitCompleted=0;
+  TISM_SchedulerData.InitReleased=false;
+  TISM_SchedulerData.Lock=spin_lock_instance(spin_lock_claim_unused(true));
+  TISM_SchedulerResetStatistics(TISM_SCHEDULER_TASK_ID);
+}
+
+
 /*
   Description
   Force the run of the process pointed to by the RunPointer in the global System struct for the specified core.
@@ -56,20 +516,28 @@
 uint8_t TISM_SchedulerRunTaskUnconditionally(uint8_t ThisCoreID)
 {
    // Update the most relevant information in the task struct to be able to pass it as the parameter.
-  System.Task[System.RunPointer[ThisCoreID]].OutboundMessageQueue=&(OutboundMessageQueue[ThisCoreID]);
-  System.Task[System.RunPointer[ThisCoreID]].RunningOnCoreID=ThisCoreID;
+  uint8_t ReturnValue=OK, TaskID=System.RunPointer[ThisCoreID];
+  System.Task[TaskID].OutboundMessageQueue=&(OutboundMessageQueue[ThisCoreID]);
+  System.Task[TaskID].RunningOnCoreID=ThisCoreID;
 
   // Run the task the RunPointer is referring to.
-  if((*System.Task[System.RunPointer[ThisCoreID]].TaskFunction)((System.Task[System.RunPointer[ThisCoreID]])))
-    return(ERR_RUNNING_TASK);
-  return(OK);
+  uint64_t StartTimestamp=(SCHEDULER_STATISTICS?time_us_64():0);
+  if(TRACE_ENABLED) TISM_TraceRecord(TRACE_TASK_START, TaskID, 0);
+  if((*System.Task[TaskID].TaskFunction)(&System.Task[TaskID]))
+    ReturnValue=ERR_RUNNING_TASK;
+  if(TRACE_ENABLED) TISM_TraceRecord(TRACE_TASK_END, TaskID, ReturnValue);
+  System.TaskLastRun[TaskID]=time_us_64();
+  if(SCHEDULER_STATISTICS)
+    TISM_SchedulerRecordRun(TaskID, ThisCoreID, 0, StartTimestamp, System.TaskLastRun[TaskID]);
+  return(ReturnValue);
 }
 
 
 /*
   Description
   Run the process pointed to by the RunPointer in the global System struct for the specified core. If the system state
-  changes to anything else than "RUN" execution of the tasks is skipped.
+  changes to anything else than "RUN" execution of the tasks is skipped. When the other core is running the task, this
+  run is skipped as well; the other core handles the messages (see TISM_Scheduler).
 
   Parameters:
   int ThisCoreID          - ID of the current core we're trying to run a task for.
@@ -78,33 +546,91 @@ uint8_t TISM_SchedulerRunTaskUnconditionally(uint8_t ThisCoreID)
   ERR_RUNNING_TASK        - Task returned an error when executing.
   OK                      - Succes; task executed or already executed by other core (='collision')
 */
-uint8_t TISM_SchedulerRunTask(uint8_t ThisCoreID)
+uint8_t TISM_IN_RAM(TISM_SchedulerRunTask)(uint8_t ThisCoreID)
 {
+  // Check if the other core is running the same process; skip this run if this is the case.
+  uint8_t ReturnValue=OK, TaskID=System.RunPointer[ThisCoreID];
+  if(!TISM_SchedulerTryClaimTask(TaskID))
+    return(OK);
+
   // Update the most relevant information in the task struct to be able to pass it as the parameter.
-  System.Task[System.RunPointer[ThisCoreID]].OutboundMessageQueue=&(OutboundMessageQueue[ThisCoreID]);
-  System.Task[System.RunPointer[ThisCoreID]].RunningOnCoreID=ThisCoreID;
+  System.Task[TaskID].OutboundMessageQueue=&(OutboundMessageQueue[ThisCoreID]);
+  System.Task[TaskID].RunningOnCoreID=ThisCoreID;
+  
+  // Run the task the RunPointer is referring to, if we're still in RUN-state. The claim makes sure the other core isn't
+  // running it; its wake-up timer doesn't matter here, as these tasks only process the messages waiting for them.
+  if(System.State==RUN)
+  {
+    uint64_t StartTimestamp=(SCHEDULER_STATISTICS?time_us_64():0);
+    if(TRACE_ENABLED) TISM_TraceRecord(TRACE_TASK_START, TaskID, 0);
+    if((*System.Task[TaskID].TaskFunction)(&System.Task[TaskID]))
+      ReturnValue=ERR_RUNNING_TASK;
+    if(TRACE_ENABLED) TISM_TraceRecord(TRACE_TASK_END, TaskID, ReturnValue);
+    System.TaskLastRun[TaskID]=time_us_64();
+    if(SCHEDULER_STATISTICS)
+      TISM_SchedulerRecordRun(TaskID, ThisCoreID, 0, StartTimestamp, System.TaskLastRun[TaskID]);
+  }
+  TISM_SchedulerReleaseTask(TaskID);
+  return(ReturnValue);
+}
+
 
-  // Check if the other core is running the same process; wait if this is the case. Add variable wait time to prevent lockups.
-  uint8_t CurrentRunPointer=System.RunPointer[ThisCoreID];
-  while(System.RunPointer[CORE0]==System.RunPointer[CORE1])
+// Internal function - run the INIT state of the specified task and move it to RUN. When the task fails to initialize,
+// the system stops.
+void TISM_SchedulerInitTask(uint8_t ThisCoreID, uint8_t TaskID, TISM_Task *ThisTask)
+{
+  System.RunPointer[ThisCoreID]=TaskID;
+  System.Task[TaskID].TaskState=INIT;
+  if(TISM_SchedulerRunTaskUnconditionally(ThisCoreID)!=OK)
   {
-    System.RunPointer[ThisCoreID]=255;
-    busy_wait_us(5+(ThisCoreID*2));
-    System.RunPointer[ThisCoreID]=CurrentRunPointer;
+    // We've run into an error.
+    System.State=STOP;
+    TISM_EventLoggerLogEvent (ThisTask, TISM_LOG_EVENT_ERROR, "Core #%d: Process %s failed to initialize correctly.", ThisCoreID, System.Task[TaskID].TaskName);
   }
-  
-  // Run the task the RunPointer is referring to. Check if we're still in RUN-state and the TaskWakeUpTimer hasn't changed in the meantime (task running on other core).
-  if((System.State==RUN) && System.Task[System.RunPointer[ThisCoreID]].TaskWakeUpTimer<=time_us_64())
-    if((*System.Task[System.RunPointer[ThisCoreID]].TaskFunction)((System.Task[System.RunPointer[ThisCoreID]])))
-      return(ERR_RUNNING_TASK);
-  return(OK);
+  else
+  {
+    // Task initialized OK; set it's state to RUN.
+    System.Task[TaskID].TaskState=RUN;
+  }
+}
+
+
+// Internal function - initialize the user tasks that are left, in order of task ID. With SCHEDULER_PARALLEL_INIT both
+// cores run this at the same time; each claims the next task, so independent tasks are initialized in parallel.
+void TISM_SchedulerInitUserTasks(uint8_t ThisCoreID, TISM_Task *ThisTask)
+{
+  while(true)
+  {
+    uint32_t LockState=spin_lock_blocking(TISM_SchedulerData.Lock);
+    uint8_t TaskID=(TISM_SchedulerData.InitNextTask<System.NumberOfTasks?TISM_SchedulerData.InitNextTask++:255);
+    spin_unlock(TISM_SchedulerData.Lock, LockState);
+    if(TaskID==255)
+      return;
+    TISM_SchedulerInitTask(ThisCoreID, TaskID, ThisTask);
+
+    LockState=spin_lock_blocking(TISM_SchedulerData.Lock);
+    TISM_SchedulerData.InitCompleted++;
+    spin_unlock(TISM_SchedulerData.Lock, LockState);
+    __sev();
+  }
+}
+
+
+// Internal function - check if all user tasks are initialized (including the ones the other core is busy with).
+bool TISM_SchedulerInitDone()
+{
+  uint32_t LockState=spin_lock_blocking(TISM_SchedulerData.Lock);
+  bool Done=(TISM_NUMBER_OF_SYSTEM_TASKS+TISM_SchedulerData.InitCompleted>=System.NumberOfTasks);
+  spin_unlock(TISM_SchedulerData.Lock, LockState);
+  return(Done);
 }
 
 
 /*
   Description:
-  The scheduler of TISM. Schedulers running on both cores run through the same task list; when wake-up timer is expired
-  the task is started. The even core runs the queue ascending; uneven core descending.
+  The scheduler of TISM. The schedulers running on both cores each run through their own run queue; when wake-up timer
+  is expired the task is started. When a run queue is empty, tasks are stolen from the other core. The even core runs
+  the queue ascending; uneven core descending.
 
   Parameters:
   int ThisCoreID          - ID of the current core we're trying to run tasks for.
@@ -113,10 +639,9 @@ uint8_t TISM_SchedulerRunTask(uint8_t ThisCoreID)
   ERR_RUNNING_TASK        - One of the Tasks returned an error when executing.
   OK                      - System stopped without any errors.
 */
-uint8_t TISM_Scheduler(uint8_t ThisCoreID)
+uint8_t TISM_IN_RAM(TISM_Scheduler)(uint8_t ThisCoreID)
 {
   // The scheduler runs through 3 states; INIT, RUN and STOP.
-  uint8_t PreviousRunPointer;
   uint32_t RunPriority;
   TISM_Task ThisTask;         // Dummy Task struct so we can use the EventLogger.
   while (System.State>DOWN)
@@ -133,6 +658,7 @@ uint8_t TISM_Scheduler(uint8_t ThisCoreID)
                    ThisTask.TaskFunction=NULL;
                    ThisTask.TaskPriority=PRIORITY_NORMAL;
                    ThisTask.TaskSleeping=true;
+                   ThisTask.TaskIsSystemTask=true;
                    sprintf(ThisTask.TaskName, "TISM_Scheduler #%d", ThisCoreID);
                    ThisTask.InboundMessageQueue=NULL;
                    ThisTask.OutboundMessageQueue=&(OutboundMessageQueue[ThisCoreID]);
@@ -141,33 +667,29 @@ uint8_t TISM_Scheduler(uint8_t ThisCoreID)
                    // We only run INIT on CORE0.                
                    if(ThisCoreID==CORE0)
                    {
-                     if (System.SystemDebug) TISM_EventLoggerLogEvent (ThisTask, TISM_LOG_EVENT_NOTIFY, "Core #0 Initializing tasks.");
+                     if (System.SystemDebug) TISM_EventLoggerLogEvent (&ThisTask, TISM_LOG_EVENT_NOTIFY, "Core #0 Initializing tasks.");
 
-                     // Set the state of tasks to INIT and Let the tasks for this core initialize themselves.
-                     for(uint8_t TaskCounter=1;TaskCounter<System.NumberOfTasks;TaskCounter++)       // Task ID 0 is the scheduler itself.
+                     // Set the state of tasks to INIT and let them initialize themselves; the system tasks first. Then release
+                     // CORE1 to help with the user tasks (SCHEDULER_PARALLEL_INIT) and wait until all tasks are done.
+                     for(uint8_t TaskCounter=1;(TaskCounter<TISM_NUMBER_OF_SYSTEM_TASKS) && (TaskCounter<System.NumberOfTasks);TaskCounter++)       // Task ID 0 is the scheduler itself.
+                       TISM_SchedulerInitTask(CORE0, TaskCounter, &ThisTask);
+                     if(SCHEDULER_PARALLEL_INIT)
                      {
-                       System.RunPointer[CORE0]=TaskCounter;
-                       System.Task[TaskCounter].TaskState=INIT;
-                       System.Task[TaskCounter].OutboundMessageQueue=&(OutboundMessageQueue[CORE0]);
-                       if(TISM_SchedulerRunTaskUnconditionally(CORE0)!=OK)
-                       {
-                         // We've run into an error.
-                         System.State=STOP;
-                         TISM_EventLoggerLogEvent (ThisTask, TISM_LOG_EVENT_ERROR, "Core #%d: Process %s failed to initialize correctly.", ThisCoreID, System.Task[TaskCounter].TaskName);
-                       }
-                       else
-                       {
-                         // Task initialized OK; set it's state to RUN.
-                         System.Task[TaskCounter].TaskState=RUN;
-                       }
+                       uint32_t LockState=spin_lock_blocking(TISM_SchedulerData.Lock);
+                       TISM_SchedulerData.InitReleased=true;
+                       spin_unlock(TISM_SchedulerData.Lock, LockState);
+                       __sev();
                      }
+                     TISM_SchedulerInitUserTasks(CORE0, &ThisTask);
+                     while(!TISM_SchedulerInitDone())
+                       best_effort_wfe_or_timeout(from_us_since_boot(time_us_64()+SCHEDULER_IDLE_MAX_USEC));
                      
                      // Attempt to start Postmaster, Taskmanager and EventLogger to process any messages. Do not check for return values. 
-                     System.RunPointer[CORE0]=System.TISM_PostmanTaskID;
+                     System.RunPointer[CORE0]=TISM_POSTMAN_TASK_ID;
                      TISM_SchedulerRunTaskUnconditionally(CORE0);
-                     System.RunPointer[CORE0]=System.TISM_TaskManagerTaskID;
+                     System.RunPointer[CORE0]=TISM_TASKMANAGER_TASK_ID;
                      TISM_SchedulerRunTaskUnconditionally(CORE0);       
-                     System.RunPointer[CORE0]=System.TISM_EventLoggerTaskID;
+                     System.RunPointer[CORE0]=TISM_EVENTLOGGER_TASK_ID;
                      TISM_SchedulerRunTaskUnconditionally(CORE0);
 
                      // No errors? Schedule the start of all tasks and move the system to RUN state.
@@ -189,7 +711,7 @@ uint8_t TISM_Scheduler(uint8_t ThisCoreID)
                          }
                        }
                       
-                       if (System.SystemDebug==DEBUG_HIGH) TISM_EventLoggerLogEvent (ThisTask, TISM_LOG_EVENT_NOTIFY, "Core #%d: %d prio high, %d prio normal and %d other tasks.", ThisCoreID, PriorityHigh, PriorityNormal, PriorityOther);
+                       if (System.SystemDebug==DEBUG_HIGH) TISM_EventLoggerLogEvent (&ThisTask, TISM_LOG_EVENT_NOTIFY, "Core #%d: %d prio high, %d prio normal and %d other tasks.", ThisCoreID, PriorityHigh, PriorityNormal, PriorityOther);
 
                        // Calculate the offsite by dividing the available time by the number of tasks.
                        uint32_t PriorityHighOffset=(PriorityHigh>0?round(PRIORITY_HIGH/PriorityHigh):0);
@@ -215,134 +737,151 @@ uint8_t TISM_Scheduler(uint8_t ThisCoreID)
                                                  break;                            
                          }
 
-                         if (System.SystemDebug==DEBUG_HIGH) TISM_EventLoggerLogEvent (ThisTask, TISM_LOG_EVENT_NOTIFY, "Core #%d: Task %d (%s; priority %d) will start at %llu.", ThisCoreID, counter, System.Task[counter].TaskName, System.Task[counter].TaskPriority, System.Task[counter].TaskWakeUpTimer);
+                         if (System.SystemDebug==DEBUG_HIGH) TISM_EventLoggerLogEvent (&ThisTask, TISM_LOG_EVENT_NOTIFY, "Core #%d: Task %d (%s; priority %d) will start at %llu.", ThisCoreID, counter, System.Task[counter].TaskName, System.Task[counter].TaskPriority, System.Task[counter].TaskWakeUpTimer);
                        }
+                       // Now all wake-up timers are known; fill the administration of ready and waiting tasks.
+                       for(uint8_t counter=1;counter<System.NumberOfTasks;counter++)     // Task ID 0 is the scheduler itself.
+                         TISM_SchedulerUpdateTask(counter);
+
                        System.State=RUN;
-                       if (System.SystemDebug) TISM_EventLoggerLogEvent (ThisTask, TISM_LOG_EVENT_NOTIFY, "Core #%d: %d task(s) initialized.", ThisCoreID, System.NumberOfTasks);
+                       __sev();      // Release CORE1.
+                       if (System.SystemDebug) TISM_EventLoggerLogEvent (&ThisTask, TISM_LOG_EVENT_NOTIFY, "Core #%d: %d task(s) initialized.", ThisCoreID, System.NumberOfTasks);
 
                        // All tasks initialized and ready to go! Set the SYSTEM_READY_PORT to HIGH.
                        gpio_put(SYSTEM_READY_PORT, 1);
 
-                       if (System.SystemDebug) TISM_EventLoggerLogEvent (ThisTask, TISM_LOG_EVENT_NOTIFY, "Core #%d: Set SYSTEM_READY_PORT %d to high.", ThisCoreID, SYSTEM_READY_PORT);
+                       if (System.SystemDebug) TISM_EventLoggerLogEvent (&ThisTask, TISM_LOG_EVENT_NOTIFY, "Core #%d: Set SYSTEM_READY_PORT %d to high.", ThisCoreID, SYSTEM_READY_PORT);
                      }
                      else  
                      {
                        // Failed to initialize correctly.
-                       if (System.SystemDebug) TISM_EventLoggerLogEvent (ThisTask, TISM_LOG_EVENT_ERROR, "Core #%d: System failed to initalize correctly.", ThisCoreID);
+                       if (System.SystemDebug) TISM_EventLoggerLogEvent (&ThisTask, TISM_LOG_EVENT_ERROR, "Core #%d: System failed to initalize correctly.", ThisCoreID);
                      }
 
                      // Attempt to start Postmaster, Taskmanager and EventLogger to process any messages. Do not check for return values. 
-                     System.RunPointer[CORE0]=System.TISM_PostmanTaskID;
+                     System.RunPointer[CORE0]=TISM_POSTMAN_TASK_ID;
                      TISM_SchedulerRunTaskUnconditionally(CORE0);
-                     System.RunPointer[CORE0]=System.TISM_TaskManagerTaskID;
+                     System.RunPointer[CORE0]=TISM_TASKMANAGER_TASK_ID;
                      TISM_SchedulerRunTaskUnconditionally(CORE0);       
-                     System.RunPointer[CORE0]=System.TISM_EventLoggerTaskID;
+                     System.RunPointer[CORE0]=TISM_EVENTLOGGER_TASK_ID;
                      TISM_SchedulerRunTaskUnconditionally(CORE0);
                    }
                    else
                    {
-                     // We're on a different core; wait until system state has changed.
+                     // We're on a different core; help initializing the user tasks when CORE0 releases us, then wait until
+                     // the system state has changed. CORE0 sends an event (SEV) for both.
+                     if (System.SystemDebug) TISM_EventLoggerLogEvent (&ThisTask, TISM_LOG_EVENT_NOTIFY, "Core #%d: Waiting....", ThisCoreID);
+                     while(SCHEDULER_PARALLEL_INIT && (System.State==INIT) && !TISM_SchedulerData.InitReleased)
+                       best_effort_wfe_or_timeout(from_us_since_boot(time_us_64()+SCHEDULER_IDLE_MAX_USEC));
+                     if(SCHEDULER_PARALLEL_INIT && (System.State==INIT))
+                       TISM_SchedulerInitUserTasks(ThisCoreID, &ThisTask);
                      while(System.State==INIT)
-                     {
-                       if (System.SystemDebug) TISM_EventLoggerLogEvent (ThisTask, TISM_LOG_EVENT_NOTIFY, "Core #%d: Waiting....", ThisCoreID);
-                       sleep_ms(500);
-                     }
+                       best_effort_wfe_or_timeout(from_us_since_boot(time_us_64()+SCHEDULER_IDLE_MAX_USEC));
                    }
                    
                    // We start the first run with PRIORITY_HIGH tasks. 
                    RunPriority=PRIORITY_HIGH;
                    break;
         case RUN: // The actual loop that runs tasks.
-                  if(System.SystemDebug) TISM_EventLoggerLogEvent (ThisTask, TISM_LOG_EVENT_NOTIFY, "Core #%d: Starting run loop, %s through tasklist.", ThisCoreID, (System.RunPointerDirection[ThisCoreID]==QUEUE_RUN_ASCENDING?"ascending":"descending"));
+                  if(System.SystemDebug) TISM_EventLoggerLogEvent (&ThisTask, TISM_LOG_EVENT_NOTIFY, "Core #%d: Starting run loop, %s through ready tasks.", ThisCoreID, (System.RunPointerDirection[ThisCoreID]==QUEUE_RUN_ASCENDING?"ascending":"descending"));
 
-                  uint8_t LastProcessInRun, RunPointerBackup, ThisTaskID;
-                  uint64_t RunTimestamp;
+                  uint8_t NextTaskID;
+                  bool Stolen;
+                  uint64_t RunTimestamp, StartTimestamp, WakeUpTimer;
+                  int16_t RunCursor;
                   while (System.State==RUN)
                   {
-                    // Run through all the tasks; check which need to start. 
-                    // What is the criteria to stop a run? Do we ascend or descend? Where do we start in the queue?
-                    // We check in each run in case tasks are created after initialization (and the queue grows).
-                    
-                    LastProcessInRun=(System.RunPointerDirection[ThisCoreID]==QUEUE_RUN_ASCENDING?(System.NumberOfTasks-1):1);                 // Task ID 0 is the scheduler itself.
-                    System.RunPointer[ThisCoreID]=(System.RunPointerDirection[ThisCoreID]==QUEUE_RUN_ASCENDING?1:(System.NumberOfTasks-1));    // Task ID 0 is the scheduler itself.                    
+                    // Run through all the ready tasks; the bitmap tells which need to start. 
+                    // Where do we start in the queue? We check in each run in case tasks are created after initialization (and the queue grows).
+                    RunCursor=(System.RunPointerDirection[ThisCoreID]==QUEUE_RUN_ASCENDING?0:System.NumberOfTasks);       // Task ID 0 is the scheduler itself.
                     do
                     {
-                      // Are both cores looking at different processes to run?
-                      // Is the tasks allowed to run, considering its priority?
-                      // Is the task specified by RunPointer not sleeping and is the wake-up timer for this task expired?
-                      RunTimestamp=time_us_64();   
-                      if((System.RunPointer[CORE0]!=System.RunPointer[CORE1]) &&
-                         (System.Task[System.RunPointer[ThisCoreID]].TaskPriority<=RunPriority) &&
-                         (!System.Task[System.RunPointer[ThisCoreID]].TaskSleeping) &&
-                         (System.Task[System.RunPointer[ThisCoreID]].TaskWakeUpTimer<=RunTimestamp))
+                      // Claim the next task in our run queue that is ready to run and is allowed to run, considering its priority.
+                      // Claimed tasks are taken out of the run queue; the other core can't start them. A task stolen from the other
+                      // core doesn't move our position in the run queue.
+                      NextTaskID=TISM_SchedulerClaimNextTask(ThisCoreID, RunCursor, System.RunPointerDirection[ThisCoreID], TISM_SchedulerPriorityClass(RunPriority), &Stolen);
+                      if(NextTaskID!=255)
                       { 
-                        if(System.State==RUN && System.SystemDebug==DEBUG_HIGH) TISM_EventLoggerLogEvent (ThisTask, TISM_LOG_EVENT_NOTIFY, "Core #%d: Starting Task ID %d (%s).", ThisCoreID, System.RunPointer[ThisCoreID], System.Task[System.RunPointer[ThisCoreID]].TaskName);
+                        if(!Stolen)
+                          RunCursor=NextTaskID;
+                        System.RunPointer[ThisCoreID]=NextTaskID;
+                        System.Task[NextTaskID].OutboundMessageQueue=&(OutboundMessageQueue[ThisCoreID]);
+                        System.Task[NextTaskID].RunningOnCoreID=ThisCoreID;
+
+                        if(System.State==RUN && System.SystemDebug==DEBUG_HIGH) TISM_EventLoggerLogEvent (&ThisTask, TISM_LOG_EVENT_NOTIFY, "Core #%d: Starting Task ID %d (%s).", ThisCoreID, NextTaskID, System.Task[NextTaskID].TaskName);
                                    
-                        if(TISM_SchedulerRunTask(ThisCoreID)==OK)
+                        WakeUpTimer=System.Task[NextTaskID].TaskWakeUpTimer;
+                        StartTimestamp=time_us_64();
+                        if(TRACE_ENABLED) TISM_TraceRecord(TRACE_TASK_START, NextTaskID, 0);
+                        uint8_t TaskReturnValue=(*System.Task[NextTaskID].TaskFunction)(&System.Task[NextTaskID]);
+                        if(TRACE_ENABLED) TISM_TraceRecord(TRACE_TASK_END, NextTaskID, TaskReturnValue);
+                        if(TaskReturnValue==OK)
                         {
-                          // Is the system still in RUN-state?
-                          if(System.State==RUN)
+                          // Task ran succesfully; calculate the next wake-up time based on the task's priority, but only when needed.
+                          // If the task hasn´t set a new value for TaskWakeUpTimer, set one based on the task's priority. Skip this when the
+                          // task was woken up by someone else while it was running.
+                          if(System.SystemDebug==DEBUG_HIGH) TISM_EventLoggerLogEvent (&ThisTask, TISM_LOG_EVENT_NOTIFY, "Core #%d: Task ID %d (%s) completed.", ThisCoreID, NextTaskID, System.Task[NextTaskID].TaskName);
+
+                          RunTimestamp=time_us_64();
+                          System.TaskLastRun[NextTaskID]=RunTimestamp;
+                          if(SCHEDULER_STATISTICS)
+                            TISM_SchedulerRecordRun(NextTaskID, ThisCoreID, WakeUpTimer, StartTimestamp, RunTimestamp);
+                          if(!TISM_SchedulerData.TaskUpdated[NextTaskID])
                           {
-                            // Did the task generate any messages in the queue for this core? 
-                            // If so, start the Postman and Taskmanager tasks (securely),
-                            if(TISM_CircularBufferMessagesWaiting(&OutboundMessageQueue[ThisCoreID])>0)
-                            {
-                              // Messages waiting; start Postman and Taskmanager tasks. No checking for return values.
-                              PreviousRunPointer=System.RunPointer[ThisCoreID];
-                              System.RunPointer[ThisCoreID]=System.TISM_PostmanTaskID;
-                              TISM_SchedulerRunTask(ThisCoreID);
-                              System.RunPointer[ThisCoreID]=System.TISM_TaskManagerTaskID;
-                              TISM_SchedulerRunTask(ThisCoreID);
-
-                              // Restore the RunPointer to it's original value so we can continue the cycle.
-                              System.RunPointer[ThisCoreID]=PreviousRunPointer;
-                            }
-
-                            // Task ran succesfully; calculate the next wake-up time based on the task's priority, but only when needed.
-                            // Also update the timestamp we're comparing with.
-                            if(System.SystemDebug==DEBUG_HIGH) TISM_EventLoggerLogEvent (ThisTask, TISM_LOG_EVENT_NOTIFY, "Core #%d: Task ID %d (%s) completed.", ThisCoreID, System.RunPointer[ThisCoreID], System.Task[System.RunPointer[ThisCoreID]].TaskName);
-                          
-                            // If the task hasn´t set a new value for TaskWakeUpTimer, set one based on the task's priority.
-                            RunTimestamp=time_us_64();
-                            while (System.Task[System.RunPointer[ThisCoreID]].TaskWakeUpTimer<RunTimestamp)
+                            uint32_t Periods=0;
+                            while (System.Task[NextTaskID].TaskWakeUpTimer<=RunTimestamp)
                             {
                               // Make sure the next WakeUpTimer-moment is beyond the current timestamp, in case we've missed earlier timeslots.
-                              System.Task[System.RunPointer[ThisCoreID]].TaskWakeUpTimer+=System.Task[System.RunPointer[ThisCoreID]].TaskPriority;
+                              System.Task[NextTaskID].TaskWakeUpTimer+=System.Task[NextTaskID].TaskPriority;
+                              Periods++;
                             }
-                          
-                            if(System.SystemDebug==DEBUG_HIGH) TISM_EventLoggerLogEvent (ThisTask, TISM_LOG_EVENT_NOTIFY, "Core #%d: Task ID %d (%s) wants to wake up at %llu (now running on core %d).", ThisCoreID, System.RunPointer[ThisCoreID], System.Task[System.RunPointer[ThisCoreID]].TaskName, System.Task[System.RunPointer[ThisCoreID]].TaskWakeUpTimer, ThisCoreID);
+                            if(SCHEDULER_STATISTICS && (Periods>1))
+                              System.TaskStatistics[NextTaskID].MissedPeriods+=Periods-1;
+                          }
+                          TISM_SchedulerReleaseTask(NextTaskID);
+
+                          if(System.SystemDebug==DEBUG_HIGH) TISM_EventLoggerLogEvent (&ThisTask, TISM_LOG_EVENT_NOTIFY, "Core #%d: Task ID %d (%s) wants to wake up at %llu (now running on core %d).", ThisCoreID, NextTaskID, System.Task[NextTaskID].TaskName, System.Task[NextTaskID].TaskWakeUpTimer, ThisCoreID);
+
+                          // Is the system still in RUN-state?
+                          // Did the task generate any messages in the queue for this core? 
+                          // If so, start the Postman and Taskmanager tasks (securely),
+                          if((System.State==RUN) && (TISM_CircularBufferMessagesWaiting(&OutboundMessageQueue[ThisCoreID])>0))
+                          {
+                            // Messages waiting; start Postman and Taskmanager tasks. No checking for return values.
+                            System.RunPointer[ThisCoreID]=TISM_POSTMAN_TASK_ID;
+                            TISM_SchedulerRunTask(ThisCoreID);
+                            System.RunPointer[ThisCoreID]=TISM_TASKMANAGER_TASK_ID;
+                            TISM_SchedulerRunTask(ThisCoreID);
                           }
                         }
                         else
                         {
                           // Task execution returened an error. Stop the System.
-                          TISM_EventLoggerLogEvent (ThisTask, TISM_LOG_EVENT_ERROR, "Core #%d: task %s returned a fatal error. Stopping.", ThisCoreID, System.Task[System.RunPointer[ThisCoreID]].TaskName);
+                          TISM_SchedulerReleaseTask(NextTaskID);
+                          TISM_EventLoggerLogEvent (&ThisTask, TISM_LOG_EVENT_ERROR, "Core #%d: task %s returned a fatal error. Stopping.", ThisCoreID, System.Task[NextTaskID].TaskName);
                           System.State=STOP;
                           break;
                         }
                       }
 
-                      // Did we receive any interrupts? Check the inbound circular buffer and start the IRQ handler when needed.
-                      if(TISM_CircularBufferMessagesWaiting(&IRQHandlerInboundQueue)>0)
-                      {
-                        // IRQ messages waiting; IRQ Hander, Postman and Taskmanager MUST run. No checking for return values.
-                        PreviousRunPointer=System.RunPointer[ThisCoreID];
-                        System.RunPointer[ThisCoreID]=System.TISM_IRQHandlerTaskID;
-                        TISM_SchedulerRunTask(ThisCoreID);
-                        System.RunPointer[ThisCoreID]=System.TISM_PostmanTaskID;
-                        TISM_SchedulerRunTask(ThisCoreID);
-                        System.RunPointer[ThisCoreID]=System.TISM_TaskManagerTaskID;
-                        TISM_SchedulerRunTask(ThisCoreID);
-
-                        // Restore the RunPointer to it's original value so we can continue the cycle.
-                        System.RunPointer[ThisCoreID]=PreviousRunPointer;
-                      }
-                      
-                      // Move the RunPointer to the next in line. 
-                      // Take care; RunPointer is uint8_t, so wraps to 255 when it descents to 0.
-                      System.RunPointer[ThisCoreID]+=System.RunPointerDirection[ThisCoreID];
+                      System.RunPointer[ThisCoreID]=255;
+                    }
+                    while ((NextTaskID!=255) && (System.State==RUN));
+
+                    // Messages left in the outbound queue of this core, e.g. when the other core was running TISM_Postman
+                    // while we tried to; deliver them before going idle.
+                    if((System.State==RUN) && (TISM_CircularBufferMessagesWaiting(&OutboundMessageQueue[ThisCoreID])>0))
+                    {
+                      System.RunPointer[ThisCoreID]=TISM_POSTMAN_TASK_ID;
+                      TISM_SchedulerRunTask(ThisCoreID);
+                      System.RunPointer[ThisCoreID]=TISM_TASKMANAGER_TASK_ID;
+                      TISM_SchedulerRunTask(ThisCoreID);
+                      System.RunPointer[ThisCoreID]=255;
                     }
-                    while ((System.RunPointerDirection[ThisCoreID]!=QUEUE_RUN_ASCENDING?(System.RunPointer[ThisCoreID]>=LastProcessInRun):(System.RunPointer[ThisCoreID]<=LastProcessInRun)) && (System.State==RUN));
+
+                    // Nothing (more) to do in this run; sleep until the next task is due.
+                    if(SCHEDULER_IDLE_SLEEP && (System.State==RUN) && (SCHEDULER_EDF || (RunPriority==PRIORITY_LOW)))
+                      TISM_SchedulerIdle(ThisCoreID);
 
                     // Run completed; set priority level for the next run.
                     switch(RunPriority)
@@ -356,10 +895,10 @@ uint8_t TISM_Scheduler(uint8_t ThisCoreID)
                   }
 
                   // Loop has ended; most likely a state switch.
-                  if (System.SystemDebug) TISM_EventLoggerLogEvent (ThisTask, TISM_LOG_EVENT_NOTIFY, "Core #%d: run loop stopped, entering state %d.", ThisCoreID, System.State);
+                  if (System.SystemDebug) TISM_EventLoggerLogEvent (&ThisTask, TISM_LOG_EVENT_NOTIFY, "Core #%d: run loop stopped, entering state %d.", ThisCoreID, System.State);
 
                   // Run Postman to make sure log entries are delivered to the EventLogger.
-                  System.RunPointer[ThisCoreID]=System.TISM_PostmanTaskID;
+                  System.RunPointer[ThisCoreID]=TISM_POSTMAN_TASK_ID;
                   TISM_SchedulerRunTask(ThisCoreID);
                   break;
         default:  // STOP or illegal state. Execute all tasks once, requesting to stop.
@@ -373,8 +912,8 @@ uint8_t TISM_Scheduler(uint8_t ThisCoreID)
                     
                     if (System.SystemDebug) 
                     {
-                      TISM_EventLoggerLogEvent (ThisTask, TISM_LOG_EVENT_NOTIFY, "Core #%d: Set SYSTEM_READY_PORT %d to low.", ThisCoreID, SYSTEM_READY_PORT);
-                      TISM_EventLoggerLogEvent (ThisTask, TISM_LOG_EVENT_NOTIFY, "Core #%d: Stopping after state %d.", ThisCoreID, System.State);
+                      TISM_EventLoggerLogEvent (&ThisTask, TISM_LOG_EVENT_NOTIFY, "Core #%d: Set SYSTEM_READY_PORT %d to low.", ThisCoreID, SYSTEM_READY_PORT);
+                      TISM_EventLoggerLogEvent (&ThisTask, TISM_LOG_EVENT_NOTIFY, "Core #%d: Stopping after state %d.", ThisCoreID, System.State);
                     }
 
                     // Stop all tasks; set each task state to STOP, run them once, give the opportunity to clean up.
@@ -382,26 +921,26 @@ uint8_t TISM_Scheduler(uint8_t ThisCoreID)
                     uint8_t ReturnValue;
                     for(uint8_t TaskCounter=System.NumberOfTasks-1;TaskCounter>1;TaskCounter--)  // Task ID 0 is the scheduler itself.
                     {
-                      if((TaskCounter!=System.TISM_EventLoggerTaskID) && (TaskCounter!=System.TISM_PostmanTaskID))
+                      if((TaskCounter!=TISM_EVENTLOGGER_TASK_ID) && (TaskCounter!=TISM_POSTMAN_TASK_ID))
                       {
                         System.RunPointer[CORE0]=TaskCounter;
                         System.Task[TaskCounter].TaskState=STOP;
                         ReturnValue=TISM_SchedulerRunTaskUnconditionally(CORE0);
 
-                        if (System.SystemDebug) TISM_EventLoggerLogEvent (ThisTask, TISM_LOG_EVENT_NOTIFY, "Core #%d: Task ID %d (%s) stopped with return value %d.", ThisCoreID, TaskCounter, System.Task[TaskCounter].TaskName, ReturnValue);
+                        if (System.SystemDebug) TISM_EventLoggerLogEvent (&ThisTask, TISM_LOG_EVENT_NOTIFY, "Core #%d: Task ID %d (%s) stopped with return value %d.", ThisCoreID, TaskCounter, System.Task[TaskCounter].TaskName, ReturnValue);
                       }
                     }
 
-                    if(System.SystemDebug) TISM_EventLoggerLogEvent (ThisTask, TISM_LOG_EVENT_NOTIFY, "Core #%d: All tasks stopped, system going down.", ThisCoreID);
+                    if(System.SystemDebug) TISM_EventLoggerLogEvent (&ThisTask, TISM_LOG_EVENT_NOTIFY, "Core #%d: All tasks stopped, system going down.", ThisCoreID);
 
                     // Run Postman and EventLogger to process last log entries, then tell it to stop.
-                    System.RunPointer[ThisCoreID]=System.TISM_PostmanTaskID;
+                    System.RunPointer[ThisCoreID]=TISM_POSTMAN_TASK_ID;
                     TISM_SchedulerRunTaskUnconditionally(CORE0);
-                    System.Task[System.TISM_PostmanTaskID].TaskState=STOP;
+                    System.Task[TISM_POSTMAN_TASK_ID].TaskState=STOP;
                     TISM_SchedulerRunTaskUnconditionally(CORE0);
-                    System.RunPointer[ThisCoreID]=System.TISM_EventLoggerTaskID;
+                    System.RunPointer[ThisCoreID]=TISM_EVENTLOGGER_TASK_ID;
                     TISM_SchedulerRunTaskUnconditionally(CORE0);
-                    System.Task[System.TISM_EventLoggerTaskID].TaskState=STOP;
+                    System.Task[TISM_EVENTLOGGER_TASK_ID].TaskState=STOP;
                     TISM_SchedulerRunTaskUnconditionally(CORE0);
                   }
                   else
@@ -410,16 +949,17 @@ uint8_t TISM_Scheduler(uint8_t ThisCoreID)
                     // Set the RunPointer to the starting value.
                     System.RunPointer[ThisCoreID]=255;
                     while(System.State==STOP)
-                      sleep_ms(500);
+                      best_effort_wfe_or_timeout(from_us_since_boot(time_us_64()+SCHEDULER_IDLE_MAX_USEC));
                   }
                   System.State=DOWN; 
+                  __sev();      // Release the other core.
                   break;
     }
   }
   
   //All done.
   if (System.SystemDebug) fprintf(STDOUT, "TISM: Core #%d: All done.", ThisCoreID);
-  sleep_ms(STARTUP_DELAY);
+  sleep_ms(SHUTDOWN_DELAY);
   return(OK);
 }
 
@@ -7,6 +7,9 @@
   Software timers are registered and a message is sent to the requesting task once the timer has expired.
   As this is a software timer it isn´t very accurate; therefore timer values for software timers are specified in milliseconds.
   Despite the inaccuracy software timers are still very usefull for scheduling (repetitive) tasks.
+  For more accuracy, timers can be set with TISM_TIMER_PRECISION_USEC. These precision timers are specified in
+  microseconds and use the alarm pool of the Pico SDK (hardware timer); when a precision timer expires the message is
+  written into the inbound queue of the task directly from the alarm interrupt, and the task is woken up.
 
   Copyright (c) 2024 Maarten Klarenbeek (https://github.com/mjklaren)
   Distributed under the GPLv3 license
@@ -14,7 +17,6 @@
 */
 
 #include <stdio.h>
-#include <stdlib.h>
 #include <stdint.h>
 #include "pico/stdlib.h"
 #include "TISM.h"
@@ -23,62 +25,289 @@
 /*
   
   The internal structures containing all data for TISM_SoftwareTimer to run.
+  Timers are stored in a fixed pool of entries (MAX_SOFTWARE_TIMERS); no memory is allocated when timers are set.
+  - Active entries are ordered in a binary min-heap on NextTimerEventUsec; the first timer to expire is always at the
+    top. Adding, expiring and removing a timer takes O(log n).
+  - Active entries are also linked per task, so a cancellation only has to search the timers of the requesting task.
+  - Unused entries are kept in a free list.
 
 */
 
-// Structure of the linear list containing all software timers.
+#define TISM_SOFTWARE_TIMER_NO_ENTRY 0xFFFF
+
+// Structure of an entry in the pool containing all software timers.
 struct TISM_SoftwareTimerEntry
 {
   uint8_t TaskID, TimerID;
   bool RepetitiveTimer;
+  uint16_t HeapIndex, NextEntry;      // Position in the heap; next entry of the same task (or next free entry).
   uint32_t TimerIntervalMsec;
   uint64_t NextTimerEventUsec;
-  struct TISM_SoftwareTimerEntry *NextEvent;
 };
 
 
 // All internal data for the TISM_SoftwareTimer task
 struct TISM_SoftwareTimerData
 {
-  struct TISM_SoftwareTimerEntry *Entries;
+  struct TISM_SoftwareTimerEntry Entry[MAX_SOFTWARE_TIMERS];
+  uint16_t Heap[MAX_SOFTWARE_TIMERS], NumberOfTimers;                      // Min-heap of entry numbers, ordered on NextTimerEventUsec.
+  uint16_t FirstTaskEntry[MAX_TASKS], FirstFreeEntry;
   uint64_t FirstTimerEventUsec;
 } TISM_SoftwareTimerData;
 
 
-// Internal function - cancel a specific timer - erase the entry from the linear list.
+// Structure of an entry in the pool of precision timers. These are handled by the alarm pool of the SDK, not by this task.
+struct TISM_SoftwareTimerPrecisionEntry
+{
+  uint8_t TaskID, TimerID;
+  bool Active, RepetitiveTimer;
+  alarm_id_t AlarmID;
+  uint32_t TimerIntervalUsec;
+  uint64_t NextTimerEventUsec;
+};
+
+
+// All data for precision timers; shared by tasks on both cores and the alarm interrupt, protected by the spinlock.
+struct TISM_SoftwareTimerPrecisionData
+{
+  struct TISM_SoftwareTimerPrecisionEntry Entry[MAX_PRECISION_TIMERS];
+  spin_lock_t *Lock;
+} TISM_SoftwareTimerPrecisionData;
+
+
+// Internal function - place an entry on a position in the heap and update its index.
+void TISM_SoftwareTimerHeapPlace(uint16_t HeapIndex, uint16_t EntryNumber)
+{
+  TISM_SoftwareTimerData.Heap[HeapIndex]=EntryNumber;
+  TISM_SoftwareTimerData.Entry[EntryNumber].HeapIndex=HeapIndex;
+}
+
+
+// Internal function - move the entry at the specified heap position up or down until the heap is ordered again.
+void TISM_SoftwareTimerHeapRestore(uint16_t HeapIndex)
+{
+  uint16_t EntryNumber=TISM_SoftwareTimerData.Heap[HeapIndex], ChildIndex;
+  uint64_t EventUsec=TISM_SoftwareTimerData.Entry[EntryNumber].NextTimerEventUsec;
+
+  // Move up while the parent expires later.
+  while((HeapIndex>0) && (TISM_SoftwareTimerData.Entry[TISM_SoftwareTimerData.Heap[(HeapIndex-1)/2]].NextTimerEventUsec>EventUsec))
+  {
+    TISM_SoftwareTimerHeapPlace(HeapIndex, TISM_SoftwareTimerData.Heap[(HeapIndex-1)/2]);
+    HeapIndex=(HeapIndex-1)/2;
+  }
+
+  // Move down while one of the children expires earlier.
+  while((ChildIndex=(HeapIndex*2)+1)<TISM_SoftwareTimerData.NumberOfTimers)
+  {
+    if((ChildIndex+1<TISM_SoftwareTimerData.NumberOfTimers) &&
+       (TISM_SoftwareTimerData.Entry[TISM_SoftwareTimerData.Heap[ChildIndex+1]].NextTimerEventUsec<TISM_SoftwareTimerData.Entry[TISM_SoftwareTimerData.Heap[ChildIndex]].NextTimerEventUsec))
+      ChildIndex++;
+    if(TISM_SoftwareTimerData.Entry[TISM_SoftwareTimerData.Heap[ChildIndex]].NextTimerEventUsec>=EventUsec)
+      break;
+    TISM_SoftwareTimerHeapPlace(HeapIndex, TISM_SoftwareTimerData.Heap[ChildIndex]);
+    HeapIndex=ChildIndex;
+  }
+  TISM_SoftwareTimerHeapPlace(HeapIndex, EntryNumber);
+}
+
+
+// Internal function - add a new timer. Returns false when the pool is exhausted.
+bool TISM_SoftwareTimerAddTimer(uint8_t TaskID, uint8_t TimerID, bool RepetitiveTimer, uint32_t TimerIntervalMsec, uint64_t NextTimerEventUsec)
+{
+  uint16_t EntryNumber=TISM_SoftwareTimerData.FirstFreeEntry;
+  if(EntryNumber==TISM_SOFTWARE_TIMER_NO_ENTRY)
+    return(false);
+  TISM_SoftwareTimerData.FirstFreeEntry=TISM_SoftwareTimerData.Entry[EntryNumber].NextEntry;
+
+  // Fill the entry and link it to the timers of this task.
+  TISM_SoftwareTimerData.Entry[EntryNumber].TaskID=TaskID;
+  TISM_SoftwareTimerData.Entry[EntryNumber].TimerID=TimerID;
+  TISM_SoftwareTimerData.Entry[EntryNumber].RepetitiveTimer=RepetitiveTimer;
+  TISM_SoftwareTimerData.Entry[EntryNumber].TimerIntervalMsec=TimerIntervalMsec;
+  TISM_SoftwareTimerData.Entry[EntryNumber].NextTimerEventUsec=NextTimerEventUsec;
+  TISM_SoftwareTimerData.Entry[EntryNumber].NextEntry=TISM_SoftwareTimerData.FirstTaskEntry[TaskID];
+  TISM_SoftwareTimerData.FirstTaskEntry[TaskID]=EntryNumber;
+
+  // Add it to the bottom of the heap and move it up to its place.
+  TISM_SoftwareTimerHeapPlace(TISM_SoftwareTimerData.NumberOfTimers, EntryNumber);
+  TISM_SoftwareTimerData.NumberOfTimers++;
+  TISM_SoftwareTimerHeapRestore(TISM_SoftwareTimerData.NumberOfTimers-1);
+  return(true);
+}
+
+
+// Internal function - remove an entry from the heap and return it to the pool. PreviousEntry is the preceding entry
+// in the list of timers of the same task (TISM_SOFTWARE_TIMER_NO_ENTRY when it's the first).
+void TISM_SoftwareTimerRemoveEntry(uint16_t EntryNumber, uint16_t PreviousEntry)
+{
+  struct TISM_SoftwareTimerEntry *Entry=&TISM_SoftwareTimerData.Entry[EntryNumber];
+
+  // Unlink from the timers of this task.
+  if(PreviousEntry==TISM_SOFTWARE_TIMER_NO_ENTRY)
+    TISM_SoftwareTimerData.FirstTaskEntry[Entry->TaskID]=Entry->NextEntry;
+  else
+    TISM_SoftwareTimerData.Entry[PreviousEntry].NextEntry=Entry->NextEntry;
+
+  // Replace it in the heap by the last entry, then restore the order from that position.
+  uint16_t HeapIndex=Entry->HeapIndex;
+  TISM_SoftwareTimerData.NumberOfTimers--;
+  if(HeapIndex<TISM_SoftwareTimerData.NumberOfTimers)
+  {
+    TISM_SoftwareTimerHeapPlace(HeapIndex, TISM_SoftwareTimerData.Heap[TISM_SoftwareTimerData.NumberOfTimers]);
+    TISM_SoftwareTimerHeapRestore(HeapIndex);
+  }
+
+  // Return the entry to the free list.
+  Entry->NextEntry=TISM_SoftwareTimerData.FirstFreeEntry;
+  TISM_SoftwareTimerData.FirstFreeEntry=EntryNumber;
+}
+
+
+// Internal function - remove one specific entry, e.g. an expired non-repetitive timer. Other timers of the task with the
+// same timer ID are kept.
+void TISM_SoftwareTimerDeleteEntry(uint16_t EntryNumber)
+{
+  uint16_t CurrentEntry=TISM_SoftwareTimerData.FirstTaskEntry[TISM_SoftwareTimerData.Entry[EntryNumber].TaskID], PreviousEntry=TISM_SOFTWARE_TIMER_NO_ENTRY;
+  while(CurrentEntry!=EntryNumber)
+  {
+    PreviousEntry=CurrentEntry;
+    CurrentEntry=TISM_SoftwareTimerData.Entry[CurrentEntry].NextEntry;
+  }
+  TISM_SoftwareTimerRemoveEntry(EntryNumber, PreviousEntry);
+}
+
+
+// Internal function - cancel a specific timer - remove all entries with this task and timer ID.
 void TISM_SoftwareTimerCancelTimer(uint8_t TaskID, uint8_t TimerID)
 {
-  struct TISM_SoftwareTimerEntry *SearchPointer=TISM_SoftwareTimerData.Entries, *PreviousSearchPointer=SearchPointer;
-  while(SearchPointer!=NULL)
+  uint16_t EntryNumber=TISM_SoftwareTimerData.FirstTaskEntry[TaskID], PreviousEntry=TISM_SOFTWARE_TIMER_NO_ENTRY, NextEntry;
+  while(EntryNumber!=TISM_SOFTWARE_TIMER_NO_ENTRY)
   {
-    // Search for the timer with the specified Task and timer ID and remove it from the linear list.
-    if(SearchPointer->TaskID==TaskID && SearchPointer->TimerID==TimerID)
+    NextEntry=TISM_SoftwareTimerData.Entry[EntryNumber].NextEntry;
+    if(TISM_SoftwareTimerData.Entry[EntryNumber].TimerID==TimerID)
+      TISM_SoftwareTimerRemoveEntry(EntryNumber, PreviousEntry);
+    else
+      PreviousEntry=EntryNumber;
+    EntryNumber=NextEntry;
+  }
+}
+
+
+// Internal function - alarm callback for precision timers, runs in interrupt context. Deliver the message directly to the
+// inbound queue of the task. The return value tells the alarm pool when to call us again, relative to the time this
+// alarm was scheduled (negative value; see the Pico SDK documentation), or 0 when the timer is done.
+int64_t TISM_IN_RAM(TISM_SoftwareTimerPrecisionCallback)(alarm_id_t AlarmID, void *UserData)
+{
+  struct TISM_SoftwareTimerPrecisionEntry *Entry=(struct TISM_SoftwareTimerPrecisionEntry *)UserData;
+  int64_t Reschedule=0;
+  uint32_t LockState=spin_lock_blocking(TISM_SoftwareTimerPrecisionData.Lock);
+
+  // Timer could have been cancelled (and the entry reused) while this alarm was about to fire.
+  if((Entry->Active) && (Entry->AlarmID==AlarmID))
+  {
+    uint64_t Now=time_us_64(), PreviousTimerEventUsec=Entry->NextTimerEventUsec;
+    if(TRACE_ENABLED) TISM_TraceRecord(TRACE_TIMER_FIRED, Entry->TaskID, (TISM_TIMER_PRECISION_USEC<<8)|Entry->TimerID);
+    if(!TISM_PostmanDeliverAndWake(TISM_SOFTWARETIMER_TASK_ID, Entry->TaskID, Entry->TimerID, 0, 0, Now))
+    {
+      // Inbound queue is full; try again shortly.
+      Entry->NextTimerEventUsec=Now+PRECISION_TIMER_RETRY_USEC;
+    }
+    else if(Entry->RepetitiveTimer)
     {
-      // Remove this entry.
-      // Is this the first record in the linear list?
-      if(SearchPointer==TISM_SoftwareTimerData.Entries)
+      // Reschedule; skip the events we missed.
+      while(Entry->NextTimerEventUsec<=Now)
+        Entry->NextTimerEventUsec+=Entry->TimerIntervalUsec;
+    }
+    else
+      Entry->Active=false;
+
+    if(Entry->Active)
+      Reschedule=-(int64_t)(Entry->NextTimerEventUsec-PreviousTimerEventUsec);
+  }
+  spin_unlock(TISM_SoftwareTimerPrecisionData.Lock, LockState);
+  return(Reschedule);
+}
+
+
+// Internal function - set a precision timer; claim an entry and add an alarm to the alarm pool.
+bool TISM_SoftwareTimerSetPrecision(uint8_t TaskID, uint8_t TimerID, bool RepetitiveTimer, uint32_t TimerIntervalUsec)
+{
+  bool Result=false;
+  uint32_t LockState=spin_lock_blocking(TISM_SoftwareTimerPrecisionData.Lock);
+  for(uint8_t counter=0;counter<MAX_PRECISION_TIMERS;counter++)
+  {
+    struct TISM_SoftwareTimerPrecisionEntry *Entry=&TISM_SoftwareTimerPrecisionData.Entry[counter];
+    if(!Entry->Active)
+    {
+      Entry->TaskID=TaskID;
+      Entry->TimerID=TimerID;
+      Entry->RepetitiveTimer=RepetitiveTimer;
+      Entry->TimerIntervalUsec=TimerIntervalUsec;
+      Entry->NextTimerEventUsec=time_us_64()+TimerIntervalUsec;
+
+      // Don't let the alarm pool fire the callback from here; we're holding the lock. The callback checks the alarm ID,
+      // which is only known when add_alarm_at returns; as we hold the lock it can't run before that.
+      Entry->AlarmID=add_alarm_at(from_us_since_boot(Entry->NextTimerEventUsec), &TISM_SoftwareTimerPrecisionCallback, Entry, false);
+      if(Entry->AlarmID>0)
       {
-        // First record in the list.
-        TISM_SoftwareTimerData.Entries=TISM_SoftwareTimerData.Entries->NextEvent;
-        free(SearchPointer);
-        SearchPointer=TISM_SoftwareTimerData.Entries;
-        PreviousSearchPointer=SearchPointer;
+        Entry->Active=true;
+        Result=true;
       }
-      else
+      else if(Entry->AlarmID==0)
       {
-        // Not the first record.
-        PreviousSearchPointer->NextEvent=SearchPointer->NextEvent;
-        free(SearchPointer);
-        SearchPointer=PreviousSearchPointer->NextEvent;
+        // Timer already expired while setting it; deliver the message right away.
+        Entry->Active=RepetitiveTimer;
+        Result=TISM_PostmanDeliverAndWake(TISM_SOFTWARETIMER_TASK_ID, TaskID, TimerID, 0, 0, time_us_64());
+        if(RepetitiveTimer)
+        {
+          Entry->NextTimerEventUsec+=TimerIntervalUsec;
+          Entry->AlarmID=add_alarm_at(from_us_since_boot(Entry->NextTimerEventUsec), &TISM_SoftwareTimerPrecisionCallback, Entry, false);
+          Entry->Active=Result=(Entry->AlarmID>0);
+        }
       }
+      break;
     }
-    else
+  }
+  spin_unlock(TISM_SoftwareTimerPrecisionData.Lock, LockState);
+  return(Result);
+}
+
+
+// Internal function - cancel all precision timers with the specified task and timer ID. Returns true if any were found.
+bool TISM_SoftwareTimerCancelPrecision(uint8_t TaskID, uint8_t TimerID)
+{
+  bool Found=false;
+  uint32_t LockState=spin_lock_blocking(TISM_SoftwareTimerPrecisionData.Lock);
+  for(uint8_t counter=0;counter<MAX_PRECISION_TIMERS;counter++)
+  {
+    struct TISM_SoftwareTimerPrecisionEntry *Entry=&TISM_SoftwareTimerPrecisionData.Entry[counter];
+    if((Entry->Active) && (Entry->TaskID==TaskID) && (Entry->TimerID==TimerID))
     {
-      // Evaluate the next record
-      PreviousSearchPointer=SearchPointer;
-      SearchPointer=SearchPointer->NextEvent;
+      cancel_alarm(Entry->AlarmID);
+      Entry->Active=false;
+      Found=true;
     }
   }
+  spin_unlock(TISM_SoftwareTimerPrecisionData.Lock, LockState);
+  return(Found);
+}
+
+
+/*
+  Description
+  Initialize the data for precision timers. Called once by TISM_InitializeSystem, before any task can set a timer.
+
+  Parameters:
+  None
+
+  Return value:
+  None
+*/
+void TISM_SoftwareTimerInitPrecision()
+{
+  for(uint8_t counter=0;counter<MAX_PRECISION_TIMERS;counter++)
+    TISM_SoftwareTimerPrecisionData.Entry[counter].Active=false;
+  TISM_SoftwareTimerPrecisionData.Lock=spin_lock_instance(spin_lock_claim_unused(true));
 }
 
 
@@ -118,11 +347,42 @@ bool TISM_SoftwareTimerVirtualExpired(uint64_t TimerUsec)
 
 /*
   Description
-  Create a SoftwareTimerEntry struct and send a message to TISM_SoftwareTimer in order to register a new timer.
-  As the RP2040 doesn´t have a realtime clock the specified time is measured in usec from 'NOW'.
+  Set a new timer. Regular timers (TISM_TIMER_PRECISION_MSEC) are registered by sending a message to TISM_SoftwareTimer;
+  the timer starts at the moment of sending. Precision timers (TISM_TIMER_PRECISION_USEC) are armed in the alarm pool
+  of the SDK right away. In both cases a message with the TimerID as message type is sent to the task when it expires.
+  As the RP2040 doesn´t have a realtime clock the specified time is measured from 'NOW'.
+
+  Parameters:
+  TISM_Task *ThisTask        - Pointer to struct containing all task related information.
+  uint8_t TimerID            - The identifier for this specific timer (unique for this Task ID).
+  bool RepetitiveTimer       - Repetitive timer (true/false)
+  uint32_t TimerInterval     - Time when timer should expired (measured from 'NOW'); milliseconds or microseconds, depending on Precision.
+  uint8_t Precision          - TISM_TIMER_PRECISION_MSEC or TISM_TIMER_PRECISION_USEC.
+
+  Return value:
+  true                       - Timer set 
+  false                      - Error setting the timer
+*/
+bool TISM_SoftwareTimerSetWithPrecision(const TISM_Task *ThisTask, uint8_t TimerID, bool RepetitiveTimer, uint32_t TimerInterval, uint8_t Precision)
+{
+  // A repetitive timer without an interval would expire continuously.
+  if(RepetitiveTimer && TimerInterval==0)
+    return(false);
+
+  if(Precision==TISM_TIMER_PRECISION_USEC)
+    return(TISM_SoftwareTimerSetPrecision(ThisTask->TaskID, TimerID, RepetitiveTimer, TimerInterval));
+
+  // Message contains the interval, specification the timer ID and repetitive flag. The timestamp of the message marks the start.
+  return(TISM_PostmanWriteMessage(ThisTask,TISM_SOFTWARETIMER_TASK_ID,TISM_SET_TIMER,TimerInterval,(uint32_t)TimerID|(RepetitiveTimer?0x100:0)));
+}
+
+
+/*
+  Description
+  Set a new (regular) timer, specified in milliseconds. See TISM_SoftwareTimerSetWithPrecision.
 
   Parameters:
-  TISM_Task ThisTask         - Struct containing all task related information.
+  TISM_Task *ThisTask        - Pointer to struct containing all task related information.
   uint8_t TimerID            - The identifier for this specific timer (unique for this Task ID).
   bool RepetitiveTimer       - Repetitive timer (true/false)
   uint32_t TimerIntervalMsec - Time in milliseconds when timer should expired (measured from 'NOW').
@@ -131,33 +391,31 @@ bool TISM_SoftwareTimerVirtualExpired(uint64_t TimerUsec)
   true                       - Timer set 
   false                      - Error setting the timer
 */
-bool TISM_SoftwareTimerSet(TISM_Task ThisTask,uint8_t TimerID, bool RepetitiveTimer, uint32_t TimerIntervalMsec)
+bool TISM_SoftwareTimerSet(const TISM_Task *ThisTask,uint8_t TimerID, bool RepetitiveTimer, uint32_t TimerIntervalMsec)
 {
-  struct TISM_SoftwareTimerEntry *EntryPointer=malloc(sizeof(struct TISM_SoftwareTimerEntry));
-  EntryPointer->TaskID=ThisTask.TaskID;
-  EntryPointer->TimerID=(uint8_t)TimerID;
-  EntryPointer->RepetitiveTimer=RepetitiveTimer;
-  EntryPointer->TimerIntervalMsec=TimerIntervalMsec;
-  EntryPointer->NextTimerEventUsec=time_us_64()+(TimerIntervalMsec*1000);
-  EntryPointer->NextEvent=NULL;
-  return(TISM_PostmanWriteMessage(ThisTask,System.TISM_SoftwareTimerTaskID,TISM_SET_TIMER,(uint32_t)EntryPointer,0));
+  return(TISM_SoftwareTimerSetWithPrecision(ThisTask, TimerID, RepetitiveTimer, TimerIntervalMsec, TISM_TIMER_PRECISION_MSEC));
 }
 
 
 /*
   Description
-  Cancel a specific timer - erase the entry from the linear list.
+  Cancel a specific timer - remove the entry from the list of active timers. Precision timers are cancelled immediately;
+  for regular timers a request is sent to TISM_SoftwareTimer.
   
   Parameters:
-  uint8_t TaskID  - TaskID for which the timer was set.
-  uint8_t TimerID - ID of the timer to cancel
+  TISM_Task *ThisTask - Pointer to struct containing all task related information.
+  uint8_t TimerID    - ID of the timer to cancel
 
   Return value:
-  none
+  true               - Timer cancelled or cancellation requested.
+  false              - Error sending the request.
 */
-bool TISM_SoftwareTimerCancel(TISM_Task ThisTask, uint8_t TimerID)
+bool TISM_SoftwareTimerCancel(const TISM_Task *ThisTask, uint8_t TimerID)
 {
-  return(TISM_PostmanWriteMessage(ThisTask,System.TISM_SoftwareTimerTaskID,TISM_CANCEL_TIMER,(uint32_t)TimerID,0));
+  // Precision timers are cancelled right away; regular timers by TISM_SoftwareTimer.
+  if(TISM_SoftwareTimerCancelPrecision(ThisTask->TaskID, TimerID))
+    return(true);
+  return(TISM_PostmanWriteMessage(ThisTask,TISM_SOFTWARETIMER_TASK_ID,TISM_CANCEL_TIMER,(uint32_t)TimerID,0));
 }
 
 
@@ -167,30 +425,35 @@ bool TISM_SoftwareTimerCancel(TISM_Task ThisTask, uint8_t TimerID)
   This function is called by TISM_Scheduler.
 
   Parameters:
-  TISM_Task ThisTask      - Struct containing all task related information.
+  TISM_Task *ThisTask     - Pointer to struct containing all task related information.
   
   Return value:
   <non zero value>        - Task returned an error when executing.
   OK                      - Run succesfully completed.
 */
-uint8_t TISM_SoftwareTimer (TISM_Task ThisTask)
+uint8_t TISM_SoftwareTimer (TISM_Task *ThisTask)
 {
-  if (ThisTask.TaskDebug==DEBUG_HIGH) TISM_EventLoggerLogEvent (ThisTask, TISM_LOG_EVENT_NOTIFY, "Run starting.");
+  if (ThisTask->TaskDebug==DEBUG_HIGH) TISM_EventLoggerLogEvent (ThisTask, TISM_LOG_EVENT_NOTIFY, "Run starting.");
   
-  switch(ThisTask.TaskState)   // Unknown states are ignored
+  switch(ThisTask->TaskState)   // Unknown states are ignored
   {
     case INIT:  // Task required to initialize                
-                if (ThisTask.TaskDebug) TISM_EventLoggerLogEvent (ThisTask, TISM_LOG_EVENT_NOTIFY, "Initializing with priority %d.", ThisTask.TaskPriority);
+                if (ThisTask->TaskDebug) TISM_EventLoggerLogEvent (ThisTask, TISM_LOG_EVENT_NOTIFY, "Initializing with priority %d.", ThisTask->TaskPriority);
 				        
-                // Initialize variables
-                TISM_SoftwareTimerData.Entries=NULL;
+                // Initialize variables; all entries are free.
+                for(uint16_t counter=0;counter<MAX_SOFTWARE_TIMERS;counter++)
+                  TISM_SoftwareTimerData.Entry[counter].NextEntry=(counter+1<MAX_SOFTWARE_TIMERS?counter+1:TISM_SOFTWARE_TIMER_NO_ENTRY);
+                for(uint16_t counter=0;counter<MAX_TASKS;counter++)
+                  TISM_SoftwareTimerData.FirstTaskEntry[counter]=TISM_SOFTWARE_TIMER_NO_ENTRY;
+                TISM_SoftwareTimerData.FirstFreeEntry=0;
+                TISM_SoftwareTimerData.NumberOfTimers=0;
                 TISM_SoftwareTimerData.FirstTimerEventUsec=0;
 
                 // Go to sleep; we only wake after incoming messages. 
                 TISM_TaskManagerSetMyTaskAttribute(ThisTask,TISM_SET_TASK_SLEEP,true);
 				        break;
 	  case RUN:   // Do the work						
-		      	    if (ThisTask.TaskDebug==DEBUG_HIGH) TISM_EventLoggerLogEvent (ThisTask, TISM_LOG_EVENT_NOTIFY, "Doing work with priority %d on core %d.", ThisTask.TaskPriority, ThisTask.RunningOnCoreID);
+		      	    if (ThisTask->TaskDebug==DEBUG_HIGH) TISM_EventLoggerLogEvent (ThisTask, TISM_LOG_EVENT_NOTIFY, "Doing work with priority %d on core %d.", ThisTask->TaskPriority, ThisTask->RunningOnCoreID);
 
                 // First check for incoming messages and process these.
                 uint8_t MessageCounter=0;
@@ -199,7 +462,7 @@ uint8_t TISM_SoftwareTimer (TISM_Task ThisTask)
                 {
                   MessageToProcess=TISM_PostmanReadMessage(ThisTask);
 
-                  if (ThisTask.TaskDebug) TISM_EventLoggerLogEvent (ThisTask, TISM_LOG_EVENT_NOTIFY, "Message '%ld' type %d from TaskID %d (%s) received.", MessageToProcess->Message, MessageToProcess->MessageType, MessageToProcess->SenderTaskID, System.Task[MessageToProcess->SenderTaskID].TaskName);
+                  if (ThisTask->TaskDebug) TISM_EventLoggerLogEvent (ThisTask, TISM_LOG_EVENT_NOTIFY, "Message '%ld' type %d from TaskID %d (%s) received.", MessageToProcess->Message, MessageToProcess->MessageType, MessageToProcess->SenderTaskID, System.Task[MessageToProcess->SenderTaskID].TaskName);
 
                   // Processed the message; delete it.
                   switch(MessageToProcess->MessageType)
@@ -208,27 +471,26 @@ uint8_t TISM_SoftwareTimer (TISM_Task ThisTask)
                                             TISM_PostmanWriteMessage(ThisTask,MessageToProcess->SenderTaskID,TISM_ECHO,MessageToProcess->Message,0);
                                             break;
                     case TISM_CANCEL_TIMER: // Cancel an existing timer
-                                            if(ThisTask.TaskDebug) TISM_EventLoggerLogEvent (ThisTask, TISM_LOG_EVENT_NOTIFY, "Cancellation received for software timer %d from task ID %d (%s).", MessageToProcess->Message, MessageToProcess->SenderTaskID, System.Task[MessageToProcess->SenderTaskID].TaskName);
+                                            if(ThisTask->TaskDebug) TISM_EventLoggerLogEvent (ThisTask, TISM_LOG_EVENT_NOTIFY, "Cancellation received for software timer %d from task ID %d (%s).", MessageToProcess->Message, MessageToProcess->SenderTaskID, System.Task[MessageToProcess->SenderTaskID].TaskName);
 
-                                            if(TISM_SoftwareTimerData.Entries!=NULL)
+                                            if(TISM_SoftwareTimerData.NumberOfTimers>0)
                                             {
                                               TISM_SoftwareTimerCancelTimer((uint8_t) MessageToProcess->SenderTaskID, (uint8_t) MessageToProcess->Message);
 
-                                              if(ThisTask.TaskDebug) TISM_EventLoggerLogEvent (ThisTask, TISM_LOG_EVENT_NOTIFY, "Software timer %d from task ID %d removed.", MessageToProcess->Message, MessageToProcess->SenderTaskID);
+                                              if(ThisTask->TaskDebug) TISM_EventLoggerLogEvent (ThisTask, TISM_LOG_EVENT_NOTIFY, "Software timer %d from task ID %d removed.", MessageToProcess->Message, MessageToProcess->SenderTaskID);
                                             }
                                             else
                                             {
                                               // Cancel-timer message received, but list is empty.
-                                              TISM_EventLoggerLogEvent (ThisTask, TISM_LOG_EVENT_ERROR, "Cancellation received for Timer ID %D (Task ID %d, %s) but no timers registered. Ignoring.", MessageToProcess->Message, MessageToProcess->Specification,  System.Task[MessageToProcess->SenderTaskID].TaskName);
+                                              TISM_EventLoggerLogEvent (ThisTask, TISM_LOG_EVENT_ERROR, "Cancellation received for Timer ID %d (Task ID %d, %s) but no timers registered. Ignoring.", MessageToProcess->Message, MessageToProcess->SenderTaskID,  System.Task[MessageToProcess->SenderTaskID].TaskName);
                                             }
                                             break;
-                    case TISM_SET_TIMER:    // Set a new timer. Add the new entry at the beginning of the linear list. 
+                    case TISM_SET_TIMER:    // Set a new timer; take an entry from the pool. The timer starts at the moment the message was sent.
                                             // Warning - no checking for duplicate entries!
-                                            if(ThisTask.TaskDebug) TISM_EventLoggerLogEvent (ThisTask, TISM_LOG_EVENT_NOTIFY, "New software timer entry received from task ID %d (%s).", MessageToProcess->SenderTaskID, System.Task[MessageToProcess->SenderTaskID].TaskName);
+                                            if(ThisTask->TaskDebug) TISM_EventLoggerLogEvent (ThisTask, TISM_LOG_EVENT_NOTIFY, "New software timer entry received from task ID %d (%s).", MessageToProcess->SenderTaskID, System.Task[MessageToProcess->SenderTaskID].TaskName);
 
-                                            struct TISM_SoftwareTimerEntry *SearchPointer=(struct TISM_SoftwareTimerEntry *)MessageToProcess->Message;
-                                            SearchPointer->NextEvent=TISM_SoftwareTimerData.Entries;
-                                            TISM_SoftwareTimerData.Entries=SearchPointer;
+                                            if(!TISM_SoftwareTimerAddTimer(MessageToProcess->SenderTaskID, (uint8_t)MessageToProcess->Specification, (MessageToProcess->Specification&0x100)!=0, MessageToProcess->Message, MessageToProcess->MessageTimestamp+((uint64_t)MessageToProcess->Message*1000)))
+                                              TISM_EventLoggerLogEvent (ThisTask, TISM_LOG_EVENT_ERROR, "Can't set timer ID %d for task ID %d (%s); maximum number of timers (%d) reached.", (uint8_t)MessageToProcess->Specification, MessageToProcess->SenderTaskID, System.Task[MessageToProcess->SenderTaskID].TaskName, MAX_SOFTWARE_TIMERS);
                                             break;
                     default:                // Unknown message type - ignore.
                                             break;
@@ -238,59 +500,58 @@ uint8_t TISM_SoftwareTimer (TISM_Task ThisTask)
                 }
 
                 // Work to do in this state.
-                // Run through the list and check which timers expired and when the next timer expires. 
-                // Set the WakeUpTimer accordingly. Then put the task back to sleep.
-                if(TISM_SoftwareTimerData.Entries!=NULL)
+                // Handle the timers that expired; these are at the top of the heap. The next timer to expire determines
+                // the WakeUpTimer. Then put the task back to sleep.
+                if(TISM_SoftwareTimerData.NumberOfTimers>0)
                 {
                   uint64_t RunTimestamp=time_us_64();
-                  struct TISM_SoftwareTimerEntry *SearchPointer=TISM_SoftwareTimerData.Entries;
-                  TISM_SoftwareTimerData.FirstTimerEventUsec=0xFFFFFFFFFFFFFFFF;
-                  while(SearchPointer!=NULL)
+                  struct TISM_SoftwareTimerEntry *Entry;
+                  while((TISM_SoftwareTimerData.NumberOfTimers>0) && ((Entry=&TISM_SoftwareTimerData.Entry[TISM_SoftwareTimerData.Heap[0]])->NextTimerEventUsec<RunTimestamp))
                   {
-                    // Check if the specific timer is expired.
-                    if(SearchPointer->NextTimerEventUsec<RunTimestamp)
-                    {
-                      // Timer expired, send out notification. If it's not repetitive, remove the entry.
-                      if(ThisTask.TaskDebug==DEBUG_HIGH) TISM_EventLoggerLogEvent (ThisTask, TISM_LOG_EVENT_NOTIFY, "Timer %d expired for task %d, sending message.", SearchPointer->TimerID, SearchPointer->TaskID);                      
+                    // Timer expired, send out notification. If it's not repetitive, remove the entry.
+                    if(ThisTask->TaskDebug==DEBUG_HIGH) TISM_EventLoggerLogEvent (ThisTask, TISM_LOG_EVENT_NOTIFY, "Timer %d expired for task %d, sending message.", Entry->TimerID, Entry->TaskID);                      
                       
-                      TISM_PostmanWriteMessage(ThisTask,SearchPointer->TaskID,SearchPointer->TimerID,0,0);
-                      if(SearchPointer->RepetitiveTimer)
-                      {
-                        // Repetitive timer, reschedule.
-                        SearchPointer->NextTimerEventUsec+=(SearchPointer->TimerIntervalMsec*1000);
-                        if(SearchPointer->NextTimerEventUsec<TISM_SoftwareTimerData.FirstTimerEventUsec)
-                          TISM_SoftwareTimerData.FirstTimerEventUsec=SearchPointer->NextTimerEventUsec;
-
-                        if(ThisTask.TaskDebug==DEBUG_HIGH) TISM_EventLoggerLogEvent (ThisTask, TISM_LOG_EVENT_NOTIFY, "Repetitive timer, rescheduled to %llu.", SearchPointer->NextTimerEventUsec);
-                      }
-                      else
-                      {
-                        // Non-repetitive timer; delete it.
-                        TISM_SoftwareTimerCancelTimer(SearchPointer->TaskID, SearchPointer->TimerID);
-
-                        if(ThisTask.TaskDebug==DEBUG_HIGH) TISM_EventLoggerLogEvent (ThisTask, TISM_LOG_EVENT_NOTIFY, "Non-repetitive timer, requested to be deleted.");
-                      }
+                    if(TRACE_ENABLED) TISM_TraceRecord(TRACE_TIMER_FIRED, Entry->TaskID, (TISM_TIMER_PRECISION_MSEC<<8)|Entry->TimerID);
+                    TISM_PostmanWriteMessage(ThisTask,Entry->TaskID,Entry->TimerID,0,0);
+                    if(Entry->RepetitiveTimer)
+                    {
+                      // Repetitive timer, reschedule. Skip the events we missed, then move it down the heap.
+                      while(Entry->NextTimerEventUsec<RunTimestamp)
+                        Entry->NextTimerEventUsec+=((uint64_t)Entry->TimerIntervalMsec*1000);
+                      TISM_SoftwareTimerHeapRestore(0);
+
+                      if(ThisTask->TaskDebug==DEBUG_HIGH) TISM_EventLoggerLogEvent (ThisTask, TISM_LOG_EVENT_NOTIFY, "Repetitive timer, rescheduled to %llu.", Entry->NextTimerEventUsec);
                     }
                     else
                     {
-                      // When is the next pending event? Search for the lowest (active) event timestamp.
-                      if(SearchPointer->NextTimerEventUsec<TISM_SoftwareTimerData.FirstTimerEventUsec)
-                        TISM_SoftwareTimerData.FirstTimerEventUsec=SearchPointer->NextTimerEventUsec;
+                      // Non-repetitive timer; delete only this entry (the top of the heap).
+                      TISM_SoftwareTimerDeleteEntry(TISM_SoftwareTimerData.Heap[0]);
+
+                      if(ThisTask->TaskDebug==DEBUG_HIGH) TISM_EventLoggerLogEvent (ThisTask, TISM_LOG_EVENT_NOTIFY, "Non-repetitive timer, deleted.");
                     }
-                    SearchPointer=SearchPointer->NextEvent;
                   }
+
                   // Set the next wake-up timer according to the first (next) pending event.
-                  System.Task[ThisTask.TaskID].TaskWakeUpTimer=TISM_SoftwareTimerData.FirstTimerEventUsec;
+                  if(TISM_SoftwareTimerData.NumberOfTimers>0)
+                  {
+                    TISM_SoftwareTimerData.FirstTimerEventUsec=TISM_SoftwareTimerData.Entry[TISM_SoftwareTimerData.Heap[0]].NextTimerEventUsec;
+                    System.Task[ThisTask->TaskID].TaskWakeUpTimer=TISM_SoftwareTimerData.FirstTimerEventUsec;
+
+                    // Requests received in the meantime could be for an earlier timer; process these first.
+                    if(TISM_PostmanMessagesWaiting(ThisTask)>0)
+                      System.Task[ThisTask->TaskID].TaskWakeUpTimer=time_us_64();
+                  }
+                  else
+                    TISM_TaskManagerSetMyTaskAttribute(ThisTask,TISM_SET_TASK_SLEEP,true);
 
-                  if(ThisTask.TaskDebug) 
+                  if(ThisTask->TaskDebug) 
                   {
-                    SearchPointer=TISM_SoftwareTimerData.Entries;
                     TISM_EventLoggerLogEvent (ThisTask, TISM_LOG_EVENT_NOTIFY, "Software timer entries:");
                     TISM_EventLoggerLogEvent (ThisTask, TISM_LOG_EVENT_NOTIFY, "=======================");                                      
-                    while(SearchPointer!=NULL)
+                    for(uint16_t counter=0;counter<TISM_SoftwareTimerData.NumberOfTimers;counter++)
                     {
-                      TISM_EventLoggerLogEvent (ThisTask, TISM_LOG_EVENT_NOTIFY, "Task ID: %d (%s), Timer ID %d, %srepetitive, interval %d msec, next event %ld.", SearchPointer->TaskID, System.Task[SearchPointer->TaskID].TaskName, SearchPointer->TimerID, (SearchPointer->RepetitiveTimer?"":"non-"), SearchPointer->TimerIntervalMsec, SearchPointer->NextTimerEventUsec);
-                      SearchPointer=SearchPointer->NextEvent;
+                      Entry=&TISM_SoftwareTimerData.Entry[TISM_SoftwareTimerData.Heap[counter]];
+                      TISM_EventLoggerLogEvent (ThisTask, TISM_LOG_EVENT_NOTIFY, "Task ID: %d (%s), Timer ID %d, %srepetitive, interval %d msec, next event %llu.", Entry->TaskID, System.Task[Entry->TaskID].TaskName, Entry->TimerID, (Entry->RepetitiveTimer?"":"non-"), Entry->TimerIntervalMsec, Entry->NextTimerEventUsec);
                     }
                     TISM_EventLoggerLogEvent (ThisTask, TISM_LOG_EVENT_NOTIFY, "List complete. Next event: %llu.", TISM_SoftwareTimerData.FirstTimerEventUsec);
                   }
@@ -300,11 +561,11 @@ uint8_t TISM_SoftwareTimer (TISM_Task ThisTask)
                   // No entries - go to sleep.
                   TISM_TaskManagerSetMyTaskAttribute(ThisTask,TISM_SET_TASK_SLEEP,true);
 
-                  if(ThisTask.TaskDebug==DEBUG_HIGH) TISM_EventLoggerLogEvent (ThisTask, TISM_LOG_EVENT_NOTIFY, "No timers set, returning to sleep.");
+                  if(ThisTask->TaskDebug==DEBUG_HIGH) TISM_EventLoggerLogEvent (ThisTask, TISM_LOG_EVENT_NOTIFY, "No timers set, returning to sleep.");
                 }
                 break;
 	  case STOP:  // Task required to stop
-		            if (ThisTask.TaskDebug) TISM_EventLoggerLogEvent (ThisTask, TISM_LOG_EVENT_NOTIFY, "Stopping.");
+		            if (ThisTask->TaskDebug) TISM_EventLoggerLogEvent (ThisTask, TISM_LOG_EVENT_NOTIFY, "Stopping.");
 		        
 				        // Tasks for stopping.
 			          
@@ -314,7 +575,7 @@ uint8_t TISM_SoftwareTimer (TISM_Task ThisTask)
   }
 		
   // All done.
-  if (ThisTask.TaskDebug==DEBUG_HIGH) TISM_EventLoggerLogEvent (ThisTask, TISM_LOG_EVENT_NOTIFY, "Run completed.");
+  if (ThisTask->TaskDebug==DEBUG_HIGH) TISM_EventLoggerLogEvent (ThisTask, TISM_LOG_EVENT_NOTIFY, "Run completed.");
 
   return (OK);
 }
@@ -0,0 +1,426 @@
+/*
+  TISM_Stream.c
+  =============
+  Continuous capture of data by DMA: samples of the ADC (free-running) or words from the RX FIFO of a PIO state machine
+  are written into buffers of the buffer pool, without any task or interrupt handling individual samples. Each filled
+  buffer is sent to the subscribed task as a TISM_BUFFER message.
+
+  How a stream works:
+  - A task starts a stream with TISM_StreamStartADC or TISM_StreamStartPIO and gets the ID of the stream. The stream
+    claims two DMA channels and two buffers of the buffer pool; the channels are chained, so while the first buffer is
+    being filled, the other one is ready to be filled next (double buffering). No samples are lost between buffers.
+  - When a buffer is full, the DMA interrupt handler (TISM_StreamCallback) writes a TISM_BUFFER message straight into
+    the inbound queue of the task and wakes it when it is sleeping, in the same way TISM_IRQHandler delivers GPIO events.
+    Message=buffer ID, Specification=sequence number of the block<<8 | stream ID. The handler claims a fresh buffer from
+    the pool for the DMA channel that just completed; the other channel is already filling its buffer.
+  - The task reads the samples with TISM_BufferPoolGet (Length is the number of bytes; ADC samples are 16 bits, PIO words
+    32 bits) and returns the buffer to the pool by deleting the message. A task that processes the blocks at a lower rate
+    than they are filled runs the pool empty; blocks are then dropped (and counted) instead of being delivered. Gaps in
+    the sequence numbers show where blocks were dropped.
+  - The task stops the stream with TISM_StreamStop, e.g. when its state is set to STOP. The DMA channels and the buffers
+    not delivered yet are released.
+  - Only available with STREAM_ENABLED; the DMA interrupt (STREAM_DMA_IRQ_INDEX) is handled on core 0.
+
+  Copyright (c) 2024 Maarten Klarenbeek (https://github.com/mjklaren)
+  Distributed under the GPLv3 license
+
+*/
+
+#include <stdio.h>
+#include "pico/stdlib.h"
+#include "TISM.h"
+#if STREAM_ENABLED
+#include "hardware/adc.h"
+#include "hardware/dma.h"
+#include "hardware/irq.h"
+#include "hardware/pio.h"
+#endif
+
+#define STREAM_SOURCE_ADC        0       // Source of the data of a stream.
+#define STREAM_SOURCE_PIO        1
+#define STREAM_NO_STREAM         255     // DMA channel isn't used by a stream.
+#define STREAM_ADC_CLOCK         48000000 // Hz - Clock of the ADC; a conversion takes 96 cycles.
+#define STREAM_ADC_MAX_RATE      500000  // Samples per second.
+
+
+// Structure of an entry in the table of streams.
+struct TISM_StreamEntry
+{
+  bool InUse, Active;                  // Active: the interrupt handler processes the completed blocks of this stream.
+  uint8_t TaskID, Source, SampleSize;
+  uint16_t SamplesPerBuffer;
+  int DMAChannel[2], BufferID[2];
+#if STREAM_ENABLED
+  dma_channel_config Config[2];
+#endif
+  uint32_t Sequence, Delivered, Dropped;
+};
+
+
+// The structure containing all data of the streams. The table is shared with the interrupt handler and protected by
+// the spinlock.
+struct TISM_StreamData
+{
+  spin_lock_t *Lock;
+  struct TISM_StreamEntry Stream[MAX_STREAMS];
+  uint8_t ChannelStream[32];           // Stream ID<<1 | half per DMA channel, STREAM_NO_STREAM when not used.
+  uint32_t ChannelMask;                // Bitmask of the DMA channels used by the active streams.
+  int ADCStreamID;                     // Only one stream can use the ADC.
+} TISM_StreamData;
+
+
+#if STREAM_ENABLED
+
+// Internal function - a block of a stream is filled; send the buffer to the task and hand a fresh buffer to the DMA
+// channel. The channel is restarted by the other channel of the stream when that one completes. When no buffer is
+// available, the block is dropped and the channel fills the same buffer again. Runs in interrupt context, with the lock.
+void TISM_IN_RAM(TISM_StreamBlockCompleted)(uint8_t StreamID, uint8_t Half, uint64_t Now)
+{
+  struct TISM_StreamEntry *Stream=&TISM_StreamData.Stream[StreamID];
+  int FilledBufferID=Stream->BufferID[Half];
+  int NextBufferID=TISM_BufferPoolAllocate(Stream->SamplesPerBuffer*Stream->SampleSize);
+  bool Delivered=false;
+  if(NextBufferID==UNDEFINED)
+    NextBufferID=FilledBufferID;
+  else if(TISM_PostmanDeliverAndWake(TISM_IRQHANDLER_TASK_ID, Stream->TaskID, TISM_BUFFER, FilledBufferID, (Stream->Sequence<<8)|StreamID, Now))
+    Delivered=true;
+  else
+    TISM_BufferPoolRelease(FilledBufferID);      // Inbound queue of the task is full; the reference of the stream is dropped.
+  if(Delivered)
+    Stream->Delivered++;
+  else
+    Stream->Dropped++;
+  if(TRACE_ENABLED) TISM_TraceRecord(TRACE_STREAM_BLOCK, Stream->TaskID, (StreamID<<8)|(Delivered?FilledBufferID:0xFF));
+  Stream->Sequence++;
+  Stream->BufferID[Half]=NextBufferID;
+  dma_channel_set_write_addr(Stream->DMAChannel[Half], TISM_BufferPoolGet(NextBufferID)->Data, false);
+  dma_channel_set_trans_count(Stream->DMAChannel[Half], Stream->SamplesPerBuffer, false);
+}
+
+
+//  The interrupt handler for the DMA channels of the streams (shared handler of DMA_IRQ_<STREAM_DMA_IRQ_INDEX>). Runs
+//  in interrupt context.
+void TISM_IN_RAM(TISM_StreamCallback)()
+{
+  uint64_t Now=time_us_64();
+  uint32_t LockState=spin_lock_blocking(TISM_StreamData.Lock);
+  uint32_t Channels=TISM_StreamData.ChannelMask;
+  while(Channels!=0)
+  {
+    uint8_t Channel=__builtin_ctz(Channels);
+    Channels&=Channels-1;
+    if(!dma_irqn_get_channel_status(STREAM_DMA_IRQ_INDEX, Channel))
+      continue;
+    dma_irqn_acknowledge_channel(STREAM_DMA_IRQ_INDEX, Channel);
+    TISM_StreamBlockCompleted(TISM_StreamData.ChannelStream[Channel]>>1, TISM_StreamData.ChannelStream[Channel]&1, Now);
+  }
+  spin_unlock(TISM_StreamData.Lock, LockState);
+
+  // Wake up the other core in case it is idle; this core wakes up by handling the interrupt.
+  __sev();
+}
+
+
+// Internal function - release the DMA channels and buffers of a stream and free the entry.
+void TISM_StreamRelease(uint8_t StreamID)
+{
+  struct TISM_StreamEntry *Stream=&TISM_StreamData.Stream[StreamID];
+  for(uint8_t Half=0;Half<2;Half++)
+  {
+    if(Stream->DMAChannel[Half]!=UNDEFINED)
+    {
+      TISM_StreamData.ChannelStream[Stream->DMAChannel[Half]]=STREAM_NO_STREAM;
+      dma_channel_unclaim(Stream->DMAChannel[Half]);
+    }
+    if(Stream->BufferID[Half]!=UNDEFINED)
+      TISM_BufferPoolRelease(Stream->BufferID[Half]);
+    Stream->DMAChannel[Half]=UNDEFINED;
+    Stream->BufferID[Half]=UNDEFINED;
+  }
+  Stream->InUse=false;
+}
+
+
+// Internal function - claim an entry, two buffers and two DMA channels for a new stream and configure the channels to
+// read from the specified address, paced by the specified DREQ. The channels aren't started yet.
+// Returns the ID of the stream, or UNDEFINED when resources are not available.
+int TISM_StreamSetup(const TISM_Task *ThisTask, uint8_t Source, volatile void *ReadAddress, uint DREQ, enum dma_channel_transfer_size DataSize, uint16_t SamplesPerBuffer)
+{
+  uint8_t StreamID, SampleSize=(DataSize==DMA_SIZE_32?4:(DataSize==DMA_SIZE_16?2:1));
+  if((SamplesPerBuffer==0) || (SamplesPerBuffer*SampleSize>BUFFER_POOL_BLOCK_SIZE))
+  {
+    TISM_EventLoggerLogEvent (ThisTask, TISM_LOG_EVENT_ERROR, "Stream not started; %d samples of %d bytes don't fit in a buffer (%d bytes).", SamplesPerBuffer, SampleSize, BUFFER_POOL_BLOCK_SIZE);
+    return(UNDEFINED);
+  }
+
+  // Claim a free entry in the table.
+  uint32_t LockState=spin_lock_blocking(TISM_StreamData.Lock);
+  for(StreamID=0;(StreamID<MAX_STREAMS) && (TISM_StreamData.Stream[StreamID].InUse);StreamID++);
+  if(StreamID<MAX_STREAMS)
+    TISM_StreamData.Stream[StreamID].InUse=true;
+  spin_unlock(TISM_StreamData.Lock, LockState);
+  if(StreamID==MAX_STREAMS)
+  {
+    TISM_EventLoggerLogEvent (ThisTask, TISM_LOG_EVENT_ERROR, "Stream not started; maximum number of streams (%d) reached.", MAX_STREAMS);
+    return(UNDEFINED);
+  }
+
+  struct TISM_StreamEntry *Stream=&TISM_StreamData.Stream[StreamID];
+  Stream->TaskID=ThisTask->TaskID;
+  Stream->Source=Source;
+  Stream->SampleSize=SampleSize;
+  Stream->SamplesPerBuffer=SamplesPerBuffer;
+  Stream->Sequence=0;
+  Stream->Delivered=0;
+  Stream->Dropped=0;
+  for(uint8_t Half=0;Half<2;Half++)
+  {
+    Stream->BufferID[Half]=TISM_BufferPoolAllocate(SamplesPerBuffer*SampleSize);
+    Stream->DMAChannel[Half]=dma_claim_unused_channel(false);
+  }
+  if((Stream->BufferID[0]==UNDEFINED) || (Stream->BufferID[1]==UNDEFINED) || (Stream->DMAChannel[0]==UNDEFINED) || (Stream->DMAChannel[1]==UNDEFINED))
+  {
+    TISM_EventLoggerLogEvent (ThisTask, TISM_LOG_EVENT_ERROR, "Stream not started; no free %s available.", (Stream->DMAChannel[0]==UNDEFINED || Stream->DMAChannel[1]==UNDEFINED?"DMA channels":"buffers"));
+    TISM_StreamRelease(StreamID);
+    return(UNDEFINED);
+  }
+
+  // Both channels read from the same address into their own buffer, and start the other channel when done.
+  for(uint8_t Half=0;Half<2;Half++)
+  {
+    dma_channel_config *Config=&Stream->Config[Half];
+    *Config=dma_channel_get_default_config(Stream->DMAChannel[Half]);
+    channel_config_set_transfer_data_size(Config, DataSize);
+    channel_config_set_read_increment(Config, false);
+    channel_config_set_write_increment(Config, true);
+    channel_config_set_dreq(Config, DREQ);
+    channel_config_set_chain_to(Config, Stream->DMAChannel[1-Half]);
+    dma_channel_configure(Stream->DMAChannel[Half], Config, TISM_BufferPoolGet(Stream->BufferID[Half])->Data, ReadAddress, SamplesPerBuffer, false);
+    TISM_StreamData.ChannelStream[Stream->DMAChannel[Half]]=(StreamID<<1)|Half;
+  }
+
+  // Hand the channels to the interrupt handler.
+  LockState=spin_lock_blocking(TISM_StreamData.Lock);
+  TISM_StreamData.ChannelMask|=(1u<<Stream->DMAChannel[0])|(1u<<Stream->DMAChannel[1]);
+  Stream->Active=true;
+  spin_unlock(TISM_StreamData.Lock, LockState);
+  for(uint8_t Half=0;Half<2;Half++)
+    dma_irqn_set_channel_enabled(STREAM_DMA_IRQ_INDEX, Stream->DMAChannel[Half], true);
+  return(StreamID);
+}
+
+
+/*
+  Description
+  Start sampling the ADC (free-running) into buffers of the buffer pool. Each filled buffer is sent to the calling task
+  as a TISM_BUFFER message (Message=buffer ID, Specification=sequence number<<8 | stream ID), containing SamplesPerBuffer
+  samples of 16 bits (12 bit values). When multiple inputs are specified, the ADC samples them round robin, starting
+  with the lowest input; the samples are interleaved. Only one ADC stream can be active.
+
+  Parameters:
+  TISM_Task *ThisTask        - Pointer to struct containing all task related information.
+  uint8_t InputMask          - Bitmask of the ADC inputs to sample; bit 0-3 = GPIO 26-29, bit 4 = temperature sensor.
+  uint32_t SampleRate        - Total number of samples per second (all inputs); 733 - 500000.
+  uint16_t SamplesPerBuffer  - Number of samples per buffer (max. BUFFER_POOL_BLOCK_SIZE/2).
+
+  Return value:
+  UNDEFINED                  - Invalid parameters, or no stream entry, DMA channels or buffers available.
+  <value>                    - ID of the stream.
+*/
+int TISM_StreamStartADC(const TISM_Task *ThisTask, uint8_t InputMask, uint32_t SampleRate, uint16_t SamplesPerBuffer)
+{
+  if((InputMask==0) || (InputMask>0x1F) || (SampleRate==0) || (SampleRate>STREAM_ADC_MAX_RATE) || (STREAM_ADC_CLOCK/SampleRate-1>0xFFFF))
+  {
+    TISM_EventLoggerLogEvent (ThisTask, TISM_LOG_EVENT_ERROR, "ADC stream not started; invalid inputs (%d) or sample rate (%lu).", InputMask, SampleRate);
+    return(UNDEFINED);
+  }
+  if(TISM_StreamData.ADCStreamID!=UNDEFINED)
+  {
+    TISM_EventLoggerLogEvent (ThisTask, TISM_LOG_EVENT_ERROR, "ADC stream not started; ADC already in use by stream %d.", TISM_StreamData.ADCStreamID);
+    return(UNDEFINED);
+  }
+
+  adc_init();
+  for(uint8_t Input=0;Input<=STREAM_ADC_TEMPERATURE;Input++)
+    if(InputMask & (1u<<Input))
+    {
+      if(Input==STREAM_ADC_TEMPERATURE)
+        adc_set_temp_sensor_enabled(true);
+      else
+        adc_gpio_init(GPIO_26+Input);
+    }
+  adc_select_input(__builtin_ctz(InputMask));
+  adc_set_round_robin((InputMask & (InputMask-1))!=0?InputMask:0);
+  adc_fifo_setup(true, true, 1, false, false);     // FIFO with DREQ for each sample, no error bit, 16 bit samples.
+  adc_set_clkdiv((float)(STREAM_ADC_CLOCK/SampleRate-1));
+
+  int StreamID=TISM_StreamSetup(ThisTask, STREAM_SOURCE_ADC, &adc_hw->fifo, DREQ_ADC, DMA_SIZE_16, SamplesPerBuffer);
+  if(StreamID==UNDEFINED)
+    return(UNDEFINED);
+  TISM_StreamData.ADCStreamID=StreamID;
+  dma_channel_start(TISM_StreamData.Stream[StreamID].DMAChannel[0]);
+  adc_run(true);
+
+  if (ThisTask->TaskDebug) TISM_EventLoggerLogEvent (ThisTask, TISM_LOG_EVENT_NOTIFY, "ADC stream %d started; inputs %d, %lu samples/sec, %d samples per buffer.", StreamID, InputMask, SampleRate, SamplesPerBuffer);
+  return(StreamID);
+}
+
+
+/*
+  Description
+  Start capturing the RX FIFO of a PIO state machine into buffers of the buffer pool. Each filled buffer is sent to the
+  calling task as a TISM_BUFFER message (Message=buffer ID, Specification=sequence number<<8 | stream ID), containing
+  WordsPerBuffer words of 32 bits. The PIO program and state machine are set up and started by the task itself.
+
+  Parameters:
+  TISM_Task *ThisTask        - Pointer to struct containing all task related information.
+  uint8_t PIONumber          - PIO block of the state machine (0 = pio0, 1 = pio1).
+  uint8_t StateMachine       - State machine of which the RX FIFO is read (0-3).
+  uint16_t WordsPerBuffer    - Number of words per buffer (max. BUFFER_POOL_BLOCK_SIZE/4).
+
+  Return value:
+  UNDEFINED                  - Invalid parameters, or no stream entry, DMA channels or buffers available.
+  <value>                    - ID of the stream.
+*/
+int TISM_StreamStartPIO(const TISM_Task *ThisTask, uint8_t PIONumber, uint8_t StateMachine, uint16_t WordsPerBuffer)
+{
+  if((PIONumber>=NUM_PIOS) || (StateMachine>=NUM_PIO_STATE_MACHINES))
+  {
+    TISM_EventLoggerLogEvent (ThisTask, TISM_LOG_EVENT_ERROR, "PIO stream not started; invalid PIO (%d) or state machine (%d).", PIONumber, StateMachine);
+    return(UNDEFINED);
+  }
+  PIO Pio=pio_get_instance(PIONumber);
+  int StreamID=TISM_StreamSetup(ThisTask, STREAM_SOURCE_PIO, &Pio->rxf[StateMachine], pio_get_dreq(Pio, StateMachine, false), DMA_SIZE_32, WordsPerBuffer);
+  if(StreamID==UNDEFINED)
+    return(UNDEFINED);
+  dma_channel_start(TISM_StreamData.Stream[StreamID].DMAChannel[0]);
+
+  if (ThisTask->TaskDebug) TISM_EventLoggerLogEvent (ThisTask, TISM_LOG_EVENT_NOTIFY, "PIO stream %d started; PIO %d, state machine %d, %d words per buffer.", StreamID, PIONumber, StateMachine, WordsPerBuffer);
+  return(StreamID);
+}
+
+
+/*
+  Description
+  Stop a stream started by the calling task. The DMA channels and the buffers that are not delivered yet are released;
+  buffers already delivered remain valid until their messages are deleted.
+
+  Parameters:
+  TISM_Task *ThisTask        - Pointer to struct containing all task related information.
+  uint8_t StreamID           - ID of the stream.
+
+  Return value:
+  false                      - Invalid ID, or the stream wasn't started by this task.
+  true                       - Stream stopped.
+*/
+bool TISM_StreamStop(const TISM_Task *ThisTask, uint8_t StreamID)
+{
+  if((StreamID>=MAX_STREAMS) || (!TISM_StreamData.Stream[StreamID].Active) || (TISM_StreamData.Stream[StreamID].TaskID!=ThisTask->TaskID))
+    return(false);
+  struct TISM_StreamEntry *Stream=&TISM_StreamData.Stream[StreamID];
+  if(Stream->Source==STREAM_SOURCE_ADC)
+    adc_run(false);
+
+  // Take the channels away from the interrupt handler.
+  uint32_t LockState=spin_lock_blocking(TISM_StreamData.Lock);
+  Stream->Active=false;
+  TISM_StreamData.ChannelMask&=~((1u<<Stream->DMAChannel[0])|(1u<<Stream->DMAChannel[1]));
+  spin_unlock(TISM_StreamData.Lock, LockState);
+
+  // Break the chain first, so an aborted channel can't start the other one again.
+  for(uint8_t Half=0;Half<2;Half++)
+  {
+    dma_irqn_set_channel_enabled(STREAM_DMA_IRQ_INDEX, Stream->DMAChannel[Half], false);
+    channel_config_set_chain_to(&Stream->Config[Half], Stream->DMAChannel[Half]);
+    dma_channel_set_config(Stream->DMAChannel[Half], &Stream->Config[Half], false);
+  }
+  for(uint8_t Half=0;Half<2;Half++)
+  {
+    dma_channel_abort(Stream->DMAChannel[Half]);
+    dma_irqn_acknowledge_channel(STREAM_DMA_IRQ_INDEX, Stream->DMAChannel[Half]);
+  }
+  if(Stream->Source==STREAM_SOURCE_ADC)
+  {
+    adc_fifo_drain();
+    TISM_StreamData.ADCStreamID=UNDEFINED;
+  }
+
+  if (ThisTask->TaskDebug) TISM_EventLoggerLogEvent (ThisTask, TISM_LOG_EVENT_NOTIFY, "Stream %d stopped; %lu blocks delivered, %lu dropped.", StreamID, Stream->Delivered, Stream->Dropped);
+  TISM_StreamRelease(StreamID);
+  return(true);
+}
+
+#else
+
+// Streaming disabled (STREAM_ENABLED); streams can't be started.
+int TISM_StreamStartADC(const TISM_Task *ThisTask, uint8_t InputMask, uint32_t SampleRate, uint16_t SamplesPerBuffer)
+{
+  TISM_EventLoggerLogEvent (ThisTask, TISM_LOG_EVENT_ERROR, "ADC stream not started; streaming is disabled (STREAM_ENABLED).");
+  return(UNDEFINED);
+}
+int TISM_StreamStartPIO(const TISM_Task *ThisTask, uint8_t PIONumber, uint8_t StateMachine, uint16_t WordsPerBuffer)
+{
+  TISM_EventLoggerLogEvent (ThisTask, TISM_LOG_EVENT_ERROR, "PIO stream not started; streaming is disabled (STREAM_ENABLED).");
+  return(UNDEFINED);
+}
+bool TISM_StreamStop(const TISM_Task *ThisTask, uint8_t StreamID) { return(false); }
+
+#endif
+
+
+/*
+  Description
+  Reset the statistics of the streams (number of blocks delivered and dropped).
+
+  Parameters:
+  None
+
+  Return value:
+  None
+*/
+void TISM_StreamResetStatistics()
+{
+  if(!STREAM_ENABLED)
+    return;
+  uint32_t LockState=spin_lock_blocking(TISM_StreamData.Lock);
+  for(uint8_t StreamID=0;StreamID<MAX_STREAMS;StreamID++)
+  {
+    TISM_StreamData.Stream[StreamID].Delivered=0;
+    TISM_StreamData.Stream[StreamID].Dropped=0;
+  }
+  spin_unlock(TISM_StreamData.Lock, LockState);
+}
+
+
+/*
+  Description
+  Initialize the table of streams and install the DMA interrupt handler. Called once by TISM_InitializeSystem, on core 0.
+
+  Parameters:
+  None
+
+  Return value:
+  None
+*/
+void TISM_StreamInit()
+{
+  for(uint8_t StreamID=0;StreamID<MAX_STREAMS;StreamID++)
+  {
+    TISM_StreamData.Stream[StreamID].InUse=false;
+    TISM_StreamData.Stream[StreamID].Active=false;
+    TISM_StreamData.Stream[StreamID].DMAChannel[0]=TISM_StreamData.Stream[StreamID].DMAChannel[1]=UNDEFINED;
+    TISM_StreamData.Stream[StreamID].BufferID[0]=TISM_StreamData.Stream[StreamID].BufferID[1]=UNDEFINED;
+  }
+  for(uint8_t Channel=0;Channel<32;Channel++)
+    TISM_StreamData.ChannelStream[Channel]=STREAM_NO_STREAM;
+  TISM_StreamData.ChannelMask=0;
+  TISM_StreamData.ADCStreamID=UNDEFINED;
+#if STREAM_ENABLED
+  // Only claim a spinlock when streaming is used; the interrupt handler takes other locks while holding it, so it can't
+  // be shared.
+  TISM_StreamData.Lock=spin_lock_instance(spin_lock_claim_unused(true));
+  TISM_StreamResetStatistics();
+  irq_add_shared_handler(DMA_IRQ_0+STREAM_DMA_IRQ_INDEX, TISM_StreamCallback, PICO_SHARED_IRQ_HANDLER_DEFAULT_ORDER_PRIORITY);
+  irq_set_enabled(DMA_IRQ_0+STREAM_DMA_IRQ_INDEX, true);
+#endif
+}
@@ -26,7 +26,7 @@
   Set the specified attribute of a task (see attibutes above).
 
   Parameters:
-  TISM_Task ThisTask         - Struct containing all task related information.
+  TISM_Task *ThisTask        - Pointer to struct containing all task related information.
   uint8_t TargetTaskID       - TaskID of the task to change
   uint8_t AttributeToChange  - Attribute to change (see below)
   uint32_t Setting           - New setting (see below)
@@ -51,8 +51,20 @@
                                Setting: 0
   TISM_DEDICATE_TO_TASK      - Dedicate the whole system to a specific task (use with caution)
                                Setting: 0
+  TISM_SET_TASK_AFFINITY     - Set the core a specific task runs on. Not allowed for system tasks.
+                               Setting: CORE0, CORE1 or CORE_ANY
+  TISM_SET_TASK_DEADLINE     - Set the relative deadline of a specific task (see SCHEDULER_EDF)
+                               Setting: usec after the wake-up time of the task; 0 = the period (priority) of the task
+  TISM_SET_TASK_TIMEOUT      - Set the heartbeat timeout of a specific task (see TISM_Watchdog); tasks with a timeout are critical
+                               Setting: usec; 0 = WATCHDOG_TASK_TIMEOUT, not critical
+  TISM_LOG_STATISTICS        - Log the run and queue statistics of a task; TISM_SCHEDULER_TASK_ID as target logs all tasks, cores and queues.
+                               Setting: 0
+  TISM_RESET_STATISTICS      - Reset the run and queue statistics of a task; TISM_SCHEDULER_TASK_ID as target resets all.
+                               Setting: 0
+  TISM_DUMP_TRACE            - Dump the trace to STDOUT (see TISM_Trace.c); use TISM_SCHEDULER_TASK_ID as target.
+                               Setting: 0
 */
-uint8_t TISM_TaskManagerSetTaskAttribute(struct TISM_Task ThisTask, uint8_t TargetTaskID, uint8_t AttributeToChange, uint32_t Setting)
+uint8_t TISM_TaskManagerSetTaskAttribute(const TISM_Task *ThisTask, uint8_t TargetTaskID, uint8_t AttributeToChange, uint32_t Setting)
 {
   // Check if the specified Task ID is valid and if it's not a TISM-system task.
   if(TISM_IsValidTaskID(TargetTaskID))
@@ -62,25 +74,27 @@ uint8_t TISM_TaskManagerSetTaskAttribute(struct TISM_Task ThisTask, uint8_t Targ
     {
       case TISM_SET_TASK_WAKEUPTIME: // Set the task wakeup timer at utime + the specified usec.
       case TISM_SET_TASK_PRIORITY  :
+      case TISM_SET_TASK_DEADLINE  :
+      case TISM_SET_TASK_TIMEOUT   :
       case TISM_SET_TASK_SLEEP     : // When system tasks; only allowed when requested by other system tasks.
                                      if(TISM_IsSystemTask(TargetTaskID))
                                      {
-                                       if(TISM_IsSystemTask(ThisTask.TaskID))
+                                       if(TISM_IsSystemTask(ThisTask->TaskID))
                                        {
                                          // Compose a message to Task Manager to adjust the attributes.
-                                         TISM_PostmanWriteMessage(ThisTask,System.TISM_TaskManagerTaskID,AttributeToChange,Setting,TargetTaskID);
+                                         TISM_PostmanWriteMessage(ThisTask,TISM_TASKMANAGER_TASK_ID,AttributeToChange,Setting,TargetTaskID);
                                        }
                                        else
                                        {
                                          // Attempt to change priority or sleep state of a system task by a non-system task. 
-                                         TISM_EventLoggerLogEvent (ThisTask, TISM_LOG_EVENT_ERROR, "Attempt to change priority, wakeup time or sleep state of system task by non-system task, which is not allowed.");
+                                         TISM_EventLoggerLogEvent (ThisTask, TISM_LOG_EVENT_ERROR, "Attempt to change priority, deadline, timeout, wakeup time or sleep state of system task by non-system task, which is not allowed.");
                                          return(ERR_INVALID_OPERATION);
                                        }
                                      }
                                      else
                                      {
                                        // Target is not a system task. Forward the requested operation.
-                                       TISM_PostmanWriteMessage(ThisTask,System.TISM_TaskManagerTaskID,AttributeToChange,Setting,TargetTaskID);
+                                       TISM_PostmanWriteMessage(ThisTask,TISM_TASKMANAGER_TASK_ID,AttributeToChange,Setting,TargetTaskID);
                                      }
                                      break;
       case TISM_DEDICATE_TO_TASK   : // Not allowed for system tasks
@@ -92,13 +106,28 @@ uint8_t TISM_TaskManagerSetTaskAttribute(struct TISM_Task ThisTask, uint8_t Targ
                                      else
                                      {
                                        // Compose a message to Task Manager to adjust the attributes.
-                                       TISM_PostmanWriteMessage(ThisTask,System.TISM_TaskManagerTaskID,AttributeToChange,Setting,TargetTaskID);
+                                       TISM_PostmanWriteMessage(ThisTask,TISM_TASKMANAGER_TASK_ID,AttributeToChange,Setting,TargetTaskID);
+                                     }
+                                     break;
+      case TISM_SET_TASK_AFFINITY  : // Not allowed for system tasks; these are run by both cores.
+                                     if(TISM_IsSystemTask(TargetTaskID) || (Setting>CORE_ANY))
+                                     {
+                                       TISM_EventLoggerLogEvent (ThisTask, TISM_LOG_EVENT_ERROR, "Invalid core affinity (%d) requested for task ID %d, or target is a system task.", Setting, TargetTaskID);
+                                       return(ERR_INVALID_OPERATION);
+                                     }
+                                     else
+                                     {
+                                       // Compose a message to Task Manager to adjust the attributes.
+                                       TISM_PostmanWriteMessage(ThisTask,TISM_TASKMANAGER_TASK_ID,AttributeToChange,Setting,TargetTaskID);
                                      }
                                      break;
       case TISM_WAKE_ALL_TASKS     :
       case TISM_SET_TASK_STATE     :
-      case TISM_SET_TASK_DEBUG     : // No checking here.
-                                     TISM_PostmanWriteMessage(ThisTask,System.TISM_TaskManagerTaskID,AttributeToChange,Setting,TargetTaskID);
+      case TISM_SET_TASK_DEBUG     :
+      case TISM_LOG_STATISTICS     :
+      case TISM_RESET_STATISTICS   :
+      case TISM_DUMP_TRACE         : // No checking here.
+                                     TISM_PostmanWriteMessage(ThisTask,TISM_TASKMANAGER_TASK_ID,AttributeToChange,Setting,TargetTaskID);
                                      break;
       default                      : // Unknown action requested; generate error message.
                                      TISM_EventLoggerLogEvent (ThisTask, TISM_LOG_EVENT_ERROR, "Unknown attribute change (%d) requested.", AttributeToChange);
@@ -117,7 +146,7 @@ uint8_t TISM_TaskManagerSetTaskAttribute(struct TISM_Task ThisTask, uint8_t Targ
   Wrapper for TISM_TaskManagerSetTaskAttribute; set the specified attribute for the requesting task itself.
 
   Parameters:
-  TISM_Task ThisTask         - Struct containing all task related information.
+  TISM_Task *ThisTask        - Pointer to struct containing all task related information.
   uint8_t AttributeToChange  - Attribute to change (see below)
   uint32_t Setting           - New setting (see below)
 
@@ -141,10 +170,22 @@ uint8_t TISM_TaskManagerSetTaskAttribute(struct TISM_Task ThisTask, uint8_t Targ
                                Setting: 0
   TISM_DEDICATE_TO_TASK      - Dedicate the whole system to a specific task (use with caution)
                                Setting: 0
+  TISM_SET_TASK_AFFINITY     - Set the core a specific task runs on. Not allowed for system tasks.
+                               Setting: CORE0, CORE1 or CORE_ANY
+  TISM_SET_TASK_DEADLINE     - Set the relative deadline of a specific task (see SCHEDULER_EDF)
+                               Setting: usec after the wake-up time of the task; 0 = the period (priority) of the task
+  TISM_SET_TASK_TIMEOUT      - Set the heartbeat timeout of a specific task (see TISM_Watchdog); tasks with a timeout are critical
+                               Setting: usec; 0 = WATCHDOG_TASK_TIMEOUT, not critical
+  TISM_LOG_STATISTICS        - Log the run and queue statistics of a task; TISM_SCHEDULER_TASK_ID as target logs all tasks, cores and queues.
+                               Setting: 0
+  TISM_RESET_STATISTICS      - Reset the run and queue statistics of a task; TISM_SCHEDULER_TASK_ID as target resets all.
+                               Setting: 0
+  TISM_DUMP_TRACE            - Dump the trace to STDOUT (see TISM_Trace.c); use TISM_SCHEDULER_TASK_ID as target.
+                               Setting: 0
 */
-uint8_t TISM_TaskManagerSetMyTaskAttribute(struct TISM_Task ThisTask, uint8_t AttributeToChange, uint32_t Setting)
+uint8_t TISM_TaskManagerSetMyTaskAttribute(const TISM_Task *ThisTask, uint8_t AttributeToChange, uint32_t Setting)
 {
-  return(TISM_TaskManagerSetTaskAttribute(ThisTask,ThisTask.TaskID,AttributeToChange,Setting)); 
+  return(TISM_TaskManagerSetTaskAttribute(ThisTask,ThisTask->TaskID,AttributeToChange,Setting)); 
 }
 
 
@@ -153,16 +194,49 @@ uint8_t TISM_TaskManagerSetMyTaskAttribute(struct TISM_Task ThisTask, uint8_t At
   Set the state of the entire TISM system. Any task can alter the system state.
 
   Parameters:
-  TISM_Task ThisTask         - Struct containing all task related information.
+  TISM_Task *ThisTask        - Pointer to struct containing all task related information.
   uint8_t SystemState        - System state (see above)
 
   Return value:
   non-zero value             - Error sending the request
   OK                         - Succes
 */
-uint8_t TISM_TaskManagerSetSystemState(struct TISM_Task ThisTask, uint8_t SystemState)
+uint8_t TISM_TaskManagerSetSystemState(const TISM_Task *ThisTask, uint8_t SystemState)
+{
+  return(TISM_PostmanWriteMessage(ThisTask,TISM_TASKMANAGER_TASK_ID,TISM_SET_SYS_STATE,SystemState,0));
+}
+
+
+// Internal function - log the run statistics of a task and the statistics of its inbound queue.
+void TISM_TaskManagerLogTaskStatistics(TISM_Task *ThisTask, uint8_t TaskID)
 {
-  return(TISM_PostmanWriteMessage(ThisTask,System.TISM_TaskManagerTaskID,TISM_SET_SYS_STATE,SystemState,0));
+  TISM_TaskStatistics *Statistics=&System.TaskStatistics[TaskID];
+  TISM_CircularBuffer *Queue=&InboundMessageQueue[TaskID];
+  TISM_EventLoggerLogEvent (ThisTask, TISM_LOG_EVENT_NOTIFY, "Statistics task ID %d (%s): %lu runs, run %llu/%lu, late %llu/%lu usec (avg/max), %lu missed, %lu past deadline; queue %d/%d max, %lu in, %lu dropped.", TaskID, System.Task[TaskID].TaskName, Statistics->Runs, (Statistics->Runs>0?Statistics->TotalRunTime/Statistics->Runs:0), Statistics->MaxRunTime, (Statistics->ScheduledRuns>0?Statistics->TotalLateness/Statistics->ScheduledRuns:0), Statistics->MaxLateness, Statistics->MissedPeriods, Statistics->DeadlineMisses, Queue->HighWaterMark, Queue->Size-1, Queue->Enqueued, Queue->Dropped);
+}
+
+
+// Internal function - log the run statistics of the specified task, or of all tasks and cores (TISM_SCHEDULER_TASK_ID).
+void TISM_TaskManagerLogStatistics(TISM_Task *ThisTask, uint8_t TaskID)
+{
+  if(TaskID!=TISM_SCHEDULER_TASK_ID)
+  {
+    TISM_TaskManagerLogTaskStatistics(ThisTask, TaskID);
+    return;
+  }
+  for(uint8_t TaskCounter=1;TaskCounter<System.NumberOfTasks;TaskCounter++)       // Task ID 0 is the scheduler itself.
+    TISM_TaskManagerLogTaskStatistics(ThisTask, TaskCounter);
+  for(uint8_t CoreCounter=0;CoreCounter<MAX_CORES;CoreCounter++)
+  {
+    TISM_EventLoggerLogEvent (ThisTask, TISM_LOG_EVENT_NOTIFY, "Statistics core #%d: %lu runs, busy %llu usec, idle %llu usec in the last %llu usec.", CoreCounter, System.CoreStatistics[CoreCounter].Runs, System.CoreStatistics[CoreCounter].BusyTime, System.CoreStatistics[CoreCounter].IdleTime, time_us_64()-System.StatisticsTimestamp);
+    TISM_EventLoggerLogEvent (ThisTask, TISM_LOG_EVENT_NOTIFY, "Statistics outbound queue core #%d: %d/%d max, %lu in, %lu dropped.", CoreCounter, OutboundMessageQueue[CoreCounter].HighWaterMark, OutboundMessageQueue[CoreCounter].Size-1, OutboundMessageQueue[CoreCounter].Enqueued, OutboundMessageQueue[CoreCounter].Dropped);
+  }
+  TISM_EventLoggerLogEvent (ThisTask, TISM_LOG_EVENT_NOTIFY, "Statistics IRQs: %lu interrupts, %lu delivered, %lu within anti-bounce timeout, %lu postponed (inbound queue full).", TISM_IRQHandlerData.Interrupts, TISM_IRQHandlerData.Delivered, TISM_IRQHandlerData.Bounced, TISM_IRQHandlerData.Postponed);
+  TISM_EventLoggerLogEvent (ThisTask, TISM_LOG_EVENT_NOTIFY, "Statistics buffer pool: %d/%d used, %d max, %lu allocated, %lu failed.", TISM_BufferPoolData.BuffersUsed, BUFFER_POOL_BLOCKS, TISM_BufferPoolData.HighWaterMark, TISM_BufferPoolData.Allocated, TISM_BufferPoolData.Failed);
+  for(uint8_t StreamID=0;StreamID<MAX_STREAMS;StreamID++)
+    if(TISM_StreamData.Stream[StreamID].Active)
+      TISM_EventLoggerLogEvent (ThisTask, TISM_LOG_EVENT_NOTIFY, "Statistics stream %d (task ID %d, %s): %lu blocks delivered, %lu dropped.", StreamID, TISM_StreamData.Stream[StreamID].TaskID, System.Task[TISM_StreamData.Stream[StreamID].TaskID].TaskName, TISM_StreamData.Stream[StreamID].Delivered, TISM_StreamData.Stream[StreamID].Dropped);
+  TISM_EventLoggerLogStatistics(ThisTask);
 }
 
 
@@ -172,28 +246,35 @@ uint8_t TISM_TaskManagerSetSystemState(struct TISM_Task ThisTask, uint8_t System
   This function is called by TISM_Scheduler.
 
   Parameters:
-  TISM_Task ThisTask      - Struct containing all task related information. 
+  TISM_Task *ThisTask     - Pointer to struct containing all task related information. 
 
   Return value:
   <non zero value>        - Task returned an error when executing.
   OK                      - Run succesfully completed.
 */
-uint8_t TISM_TaskManager (TISM_Task ThisTask)
+uint8_t TISM_TaskManager (TISM_Task *ThisTask)
 {
-  if (ThisTask.TaskDebug==DEBUG_HIGH) TISM_EventLoggerLogEvent (ThisTask, TISM_LOG_EVENT_NOTIFY, "Run starting.");
+  if (ThisTask->TaskDebug==DEBUG_HIGH) TISM_EventLoggerLogEvent (ThisTask, TISM_LOG_EVENT_NOTIFY, "Run starting.");
 
-  switch(ThisTask.TaskState)   // Unknown states are ignored
+  switch(ThisTask->TaskState)   // Unknown states are ignored
   {
     case INIT:  // Task required to initialize                
-                if (ThisTask.TaskDebug) TISM_EventLoggerLogEvent (ThisTask, TISM_LOG_EVENT_NOTIFY, "Initializing with priority %d.", ThisTask.TaskPriority);
+                if (ThisTask->TaskDebug) TISM_EventLoggerLogEvent (ThisTask, TISM_LOG_EVENT_NOTIFY, "Initializing with priority %d.", ThisTask->TaskPriority);
 
                 // Bring tasks TaskManager, Postman, IRQHandler and Watchdog to sleep.
-                System.Task[System.TISM_TaskManagerTaskID].TaskSleeping=true;
-                System.Task[System.TISM_PostmanTaskID].TaskSleeping=true;
-                System.Task[System.TISM_IRQHandlerTaskID].TaskSleeping=true;
+                System.Task[TISM_TASKMANAGER_TASK_ID].TaskSleeping=true;
+                System.Task[TISM_POSTMAN_TASK_ID].TaskSleeping=true;
+                System.Task[TISM_IRQHANDLER_TASK_ID].TaskSleeping=true;
+                TISM_SchedulerUpdateTask(TISM_POSTMAN_TASK_ID);
+                TISM_SchedulerUpdateTask(TISM_IRQHANDLER_TASK_ID);
+
+                // Log the statistics of all tasks periodically, when requested. The timer uses TISM_LOG_STATISTICS as timer ID;
+                // the message it sends has TISM_SCHEDULER_TASK_ID (0) as specification (=all tasks).
+                if(SCHEDULER_STATISTICS && (SCHEDULER_STATISTICS_INTERVAL>0))
+                  TISM_SoftwareTimerSet(ThisTask,TISM_LOG_STATISTICS,true,SCHEDULER_STATISTICS_INTERVAL);
 				        break;
 	  case RUN:   // Do the work
-		      	    if (ThisTask.TaskDebug==DEBUG_HIGH) TISM_EventLoggerLogEvent (ThisTask, TISM_LOG_EVENT_NOTIFY, "Doing work with priority %d on core %d.", ThisTask.TaskPriority, ThisTask.RunningOnCoreID);
+		      	    if (ThisTask->TaskDebug==DEBUG_HIGH) TISM_EventLoggerLogEvent (ThisTask, TISM_LOG_EVENT_NOTIFY, "Doing work with priority %d on core %d.", ThisTask->TaskPriority, ThisTask->RunningOnCoreID);
 				
 				        /*
                   Mapping between messaging structure and TaskManager fields:
@@ -214,7 +295,7 @@ uint8_t TISM_TaskManager (TISM_Task ThisTask)
                                                    TISM_PostmanWriteMessage(ThisTask,MessageToProcess->SenderTaskID,TISM_ECHO,MessageToProcess->Message,0);
                                                    break;
                     case TISM_SET_TASK_SLEEP:      // Change the sleep state of the specified task.
-                                                   if(ThisTask.TaskDebug) TISM_EventLoggerLogEvent (ThisTask, TISM_LOG_EVENT_NOTIFY, "AttributeToChange %d (TISM_SET_TASK_SLEEP) for TargetTaskID %d (%s) with setting %ld received from TaskID %d (%s).", MessageToProcess->MessageType, MessageToProcess->Specification, System.Task[MessageToProcess->Specification].TaskName, MessageToProcess->Message, MessageToProcess->SenderTaskID, System.Task[MessageToProcess->SenderTaskID].TaskName);
+                                                   if(ThisTask->TaskDebug) TISM_EventLoggerLogEvent (ThisTask, TISM_LOG_EVENT_NOTIFY, "AttributeToChange %d (TISM_SET_TASK_SLEEP) for TargetTaskID %d (%s) with setting %ld received from TaskID %d (%s).", MessageToProcess->MessageType, MessageToProcess->Specification, System.Task[MessageToProcess->Specification].TaskName, MessageToProcess->Message, MessageToProcess->SenderTaskID, System.Task[MessageToProcess->SenderTaskID].TaskName);
 
                                                    if(MessageToProcess->Message==0)
                                                    {
@@ -223,36 +304,68 @@ uint8_t TISM_TaskManager (TISM_Task ThisTask)
                                                      {
                                                        System.Task[(uint8_t)MessageToProcess->Specification].TaskSleeping=false;
                                                        System.Task[(uint8_t)MessageToProcess->Specification].TaskWakeUpTimer=time_us_64();
+                                                       TISM_SchedulerUpdateTask((uint8_t)MessageToProcess->Specification);
+                                                     }
+                                                     else if((uint8_t)MessageToProcess->Specification==TISM_SOFTWARETIMER_TASK_ID)
+                                                     {
+                                                       // TISM_SoftwareTimer stays awake while timers are pending, waiting for the first one to expire.
+                                                       // A new request could be for an earlier timer; run it right away.
+                                                       System.Task[TISM_SOFTWARETIMER_TASK_ID].TaskWakeUpTimer=time_us_64();
+                                                       TISM_SchedulerUpdateTask(TISM_SOFTWARETIMER_TASK_ID);
                                                      }
                                                    }
                                                    else
-                                                     System.Task[(uint8_t)MessageToProcess->Specification].TaskSleeping=true;
+                                                   {
+                                                     // Only put the task to sleep when its inbound queue is empty; messages could have been delivered
+                                                     // directly after the request was sent (see TISM_PostmanDeliverAndWake). If so, run it again right away.
+                                                     uint32_t LockState=spin_lock_blocking(System.PostmanDeliveryLock);
+                                                     if(TISM_CircularBufferMessagesWaiting(System.Task[(uint8_t)MessageToProcess->Specification].InboundMessageQueue)==0)
+                                                       System.Task[(uint8_t)MessageToProcess->Specification].TaskSleeping=true;
+                                                     else
+                                                       System.Task[(uint8_t)MessageToProcess->Specification].TaskWakeUpTimer=time_us_64();
+                                                     TISM_SchedulerUpdateTask((uint8_t)MessageToProcess->Specification);
+                                                     spin_unlock(System.PostmanDeliveryLock, LockState);
+                                                   }
                                                    break;
                     case TISM_SET_TASK_WAKEUPTIME: // Change the wake up time for the specified task, in "Now¨ + specified usec.                                                 
-                                                   if(ThisTask.TaskDebug) TISM_EventLoggerLogEvent (ThisTask, TISM_LOG_EVENT_NOTIFY, "AttributeToChange %d (TISM_SET_WAKEUP_TIME) for TargetTaskID %d (%s) with setting utime + %ld received from TaskID %d (%s).", MessageToProcess->MessageType, MessageToProcess->Specification, System.Task[MessageToProcess->Specification].TaskName, MessageToProcess->Message, MessageToProcess->SenderTaskID, System.Task[MessageToProcess->SenderTaskID].TaskName);
+                                                   if(ThisTask->TaskDebug) TISM_EventLoggerLogEvent (ThisTask, TISM_LOG_EVENT_NOTIFY, "AttributeToChange %d (TISM_SET_WAKEUP_TIME) for TargetTaskID %d (%s) with setting utime + %ld received from TaskID %d (%s).", MessageToProcess->MessageType, MessageToProcess->Specification, System.Task[MessageToProcess->Specification].TaskName, MessageToProcess->Message, MessageToProcess->SenderTaskID, System.Task[MessageToProcess->SenderTaskID].TaskName);
 
                                                    System.Task[(uint8_t)MessageToProcess->Specification].TaskWakeUpTimer=time_us_64()+MessageToProcess->Message;
+                                                   TISM_SchedulerUpdateTask((uint8_t)MessageToProcess->Specification);
                                                    break;
                     case TISM_SET_SYS_STATE:       // Change the state of the whole system (aka runlevel).
-                                                   if(ThisTask.TaskDebug) TISM_EventLoggerLogEvent (ThisTask, TISM_LOG_EVENT_NOTIFY, "Set system state (TISM_SET_SYS_STATE) to %d received from TaskID %d (%s).", MessageToProcess->Message, MessageToProcess->SenderTaskID, System.Task[MessageToProcess->SenderTaskID].TaskName);
+                                                   if(ThisTask->TaskDebug) TISM_EventLoggerLogEvent (ThisTask, TISM_LOG_EVENT_NOTIFY, "Set system state (TISM_SET_SYS_STATE) to %d received from TaskID %d (%s).", MessageToProcess->Message, MessageToProcess->SenderTaskID, System.Task[MessageToProcess->SenderTaskID].TaskName);
 
                                                    System.State=(uint8_t)MessageToProcess->Message;
+                                                   __sev();     // Wake up any idle core so it notices the state change.
 
                                                    if(System.SystemDebug) TISM_EventLoggerLogEvent (ThisTask, TISM_LOG_EVENT_NOTIFY, "System state changed to %d.", System.State);
                                                  
                                                    break;
                     case TISM_SET_TASK_STATE:      // Change the state of the specified task. These can be custom values.
-                                                   if(ThisTask.TaskDebug) TISM_EventLoggerLogEvent (ThisTask, TISM_LOG_EVENT_NOTIFY, "AttributeToChange %d (TISM_SET_TASK_STATE) for TargetTaskID %d (%s) with setting %ld received from TaskID %d (%s).", MessageToProcess->MessageType, MessageToProcess->Specification, System.Task[MessageToProcess->Specification].TaskName, MessageToProcess->Message, MessageToProcess->SenderTaskID, System.Task[MessageToProcess->SenderTaskID].TaskName);
+                                                   if(ThisTask->TaskDebug) TISM_EventLoggerLogEvent (ThisTask, TISM_LOG_EVENT_NOTIFY, "AttributeToChange %d (TISM_SET_TASK_STATE) for TargetTaskID %d (%s) with setting %ld received from TaskID %d (%s).", MessageToProcess->MessageType, MessageToProcess->Specification, System.Task[MessageToProcess->Specification].TaskName, MessageToProcess->Message, MessageToProcess->SenderTaskID, System.Task[MessageToProcess->SenderTaskID].TaskName);
 
                                                    System.Task[(uint8_t)MessageToProcess->Specification].TaskState=(uint8_t)MessageToProcess->Message;
                                                    break;
                     case TISM_SET_TASK_PRIORITY:   // Set the priority of a specific task to the specified priority level.
-                                                   if(ThisTask.TaskDebug) TISM_EventLoggerLogEvent (ThisTask, TISM_LOG_EVENT_NOTIFY, "AttributeToChange %d (TISM_SET_TASK_PRIORITY) for TargetTaskID %d (%s) with setting %ld received from TaskID %d (%s).", MessageToProcess->MessageType, MessageToProcess->Specification, System.Task[MessageToProcess->Specification].TaskName, MessageToProcess->Message, MessageToProcess->SenderTaskID, System.Task[MessageToProcess->SenderTaskID].TaskName);
+                                                   if(ThisTask->TaskDebug) TISM_EventLoggerLogEvent (ThisTask, TISM_LOG_EVENT_NOTIFY, "AttributeToChange %d (TISM_SET_TASK_PRIORITY) for TargetTaskID %d (%s) with setting %ld received from TaskID %d (%s).", MessageToProcess->MessageType, MessageToProcess->Specification, System.Task[MessageToProcess->Specification].TaskName, MessageToProcess->Message, MessageToProcess->SenderTaskID, System.Task[MessageToProcess->SenderTaskID].TaskName);
 
                                                    System.Task[(uint8_t)MessageToProcess->Specification].TaskPriority=MessageToProcess->Message;
+                                                   TISM_SchedulerUpdateTask((uint8_t)MessageToProcess->Specification);
+                                                   break;
+                    case TISM_SET_TASK_DEADLINE:   // Set the relative deadline of a specific task.
+                                                   if(ThisTask->TaskDebug) TISM_EventLoggerLogEvent (ThisTask, TISM_LOG_EVENT_NOTIFY, "AttributeToChange %d (TISM_SET_TASK_DEADLINE) for TargetTaskID %d (%s) with setting %ld received from TaskID %d (%s).", MessageToProcess->MessageType, MessageToProcess->Specification, System.Task[MessageToProcess->Specification].TaskName, MessageToProcess->Message, MessageToProcess->SenderTaskID, System.Task[MessageToProcess->SenderTaskID].TaskName);
+
+                                                   System.Task[(uint8_t)MessageToProcess->Specification].TaskDeadline=MessageToProcess->Message;
+                                                   TISM_SchedulerUpdateTask((uint8_t)MessageToProcess->Specification);
+                                                   break;
+                    case TISM_SET_TASK_TIMEOUT:    // Set the heartbeat timeout of a specific task.
+                                                   if(ThisTask->TaskDebug) TISM_EventLoggerLogEvent (ThisTask, TISM_LOG_EVENT_NOTIFY, "AttributeToChange %d (TISM_SET_TASK_TIMEOUT) for TargetTaskID %d (%s) with setting %ld received from TaskID %d (%s).", MessageToProcess->MessageType, MessageToProcess->Specification, System.Task[MessageToProcess->Specification].TaskName, MessageToProcess->Message, MessageToProcess->SenderTaskID, System.Task[MessageToProcess->SenderTaskID].TaskName);
+
+                                                   System.Task[(uint8_t)MessageToProcess->Specification].TaskTimeout=MessageToProcess->Message;
                                                    break;
                     case TISM_WAKE_ALL_TASKS:      // Wake all tasks.
-                                                   if(ThisTask.TaskDebug) TISM_EventLoggerLogEvent (ThisTask, TISM_LOG_EVENT_NOTIFY, "Wake all tasks (TISM_WAKE_ALL_TASKS) received from TaskID %d (%s).", MessageToProcess->SenderTaskID, System.Task[MessageToProcess->SenderTaskID].TaskName);
+                                                   if(ThisTask->TaskDebug) TISM_EventLoggerLogEvent (ThisTask, TISM_LOG_EVENT_NOTIFY, "Wake all tasks (TISM_WAKE_ALL_TASKS) received from TaskID %d (%s).", MessageToProcess->SenderTaskID, System.Task[MessageToProcess->SenderTaskID].TaskName);
 
                                                    for(uint8_t TaskCounter=0;TaskCounter<System.NumberOfTasks;TaskCounter++)
                                                    {
@@ -261,15 +374,16 @@ uint8_t TISM_TaskManager (TISM_Task ThisTask)
                                                      {
                                                        System.Task[TaskCounter].TaskWakeUpTimer=time_us_64();
                                                        System.Task[TaskCounter].TaskSleeping=false;
+                                                       TISM_SchedulerUpdateTask(TaskCounter);
                                                      }
                                                    }
                                                  
-                                                   if(ThisTask.TaskDebug) TISM_EventLoggerLogEvent (ThisTask, TISM_LOG_EVENT_NOTIFY, "All tasks have been woken up.");
+                                                   if(ThisTask->TaskDebug) TISM_EventLoggerLogEvent (ThisTask, TISM_LOG_EVENT_NOTIFY, "All tasks have been woken up.");
                                                         
                                                    break;  
                     case TISM_DEDICATE_TO_TASK:    // Dedicate the whole system to a specific task - use with caution.
                                                    // Check first if the target task is not sleeping.
-                                                   if(ThisTask.TaskDebug) TISM_EventLoggerLogEvent (ThisTask, TISM_LOG_EVENT_NOTIFY, "Dedicate to task (TISM_DEDICATE_TO_TASK) requested for %d (%s) by TaskID %d (%s).", (int)MessageToProcess->Message, System.Task[(int)MessageToProcess->Message].TaskName, MessageToProcess->SenderTaskID, System.Task[MessageToProcess->SenderTaskID].TaskName);
+                                                   if(ThisTask->TaskDebug) TISM_EventLoggerLogEvent (ThisTask, TISM_LOG_EVENT_NOTIFY, "Dedicate to task (TISM_DEDICATE_TO_TASK) requested for %d (%s) by TaskID %d (%s).", (int)MessageToProcess->Message, System.Task[(int)MessageToProcess->Message].TaskName, MessageToProcess->SenderTaskID, System.Task[MessageToProcess->SenderTaskID].TaskName);
 
                                                    if(!System.Task[(uint8_t)MessageToProcess->Message].TaskSleeping)
                                                    {
@@ -278,17 +392,52 @@ uint8_t TISM_TaskManager (TISM_Task ThisTask)
                                                      {
                                                        // Only non-system tasks are put to sleep.
                                                        if((TaskIDCounter!=MessageToProcess->Message) && (!TISM_IsSystemTask(TaskIDCounter)))
+                                                       {
                                                          System.Task[TaskIDCounter].TaskSleeping=true;
+                                                         TISM_SchedulerUpdateTask(TaskIDCounter);
+                                                       }
                                                      }
                                       
-                                                     if(ThisTask.TaskDebug) TISM_EventLoggerLogEvent (ThisTask, TISM_LOG_EVENT_NOTIFY, "Warning - system now dedicated to task ID %d (%s).", (int)MessageToProcess->Message, System.Task[(int)MessageToProcess->Message].TaskName);
+                                                     if(ThisTask->TaskDebug) TISM_EventLoggerLogEvent (ThisTask, TISM_LOG_EVENT_NOTIFY, "Warning - system now dedicated to task ID %d (%s).", (int)MessageToProcess->Message, System.Task[(int)MessageToProcess->Message].TaskName);
                                     
                                                    }
                                                    else
                                                      TISM_EventLoggerLogEvent (ThisTask, TISM_LOG_EVENT_ERROR, "Task to dedicate to (%s,ID %d) is sleeping. Aborting.", System.Task[(int)MessageToProcess->Message].TaskName, (int)MessageToProcess->Message);
                                                    break;
+                    case TISM_SET_TASK_AFFINITY:   // Set the core the task runs on.
+                                                   if(ThisTask->TaskDebug) TISM_EventLoggerLogEvent (ThisTask, TISM_LOG_EVENT_NOTIFY, "AttributeToChange %d (TISM_SET_TASK_AFFINITY) for TargetTaskID %d (%s) with setting %ld received from TaskID %d (%s).", MessageToProcess->MessageType, MessageToProcess->Specification, System.Task[MessageToProcess->Specification].TaskName, MessageToProcess->Message, MessageToProcess->SenderTaskID, System.Task[MessageToProcess->SenderTaskID].TaskName);
+
+                                                   System.Task[(uint8_t)MessageToProcess->Specification].TaskAffinity=(uint8_t)MessageToProcess->Message;
+                                                   TISM_SchedulerUpdateTask((uint8_t)MessageToProcess->Specification);
+                                                   break;
+                    case TISM_LOG_STATISTICS:      // Log the run statistics of the specified task, or of all tasks (also sent by our timer).
+                                                   TISM_TaskManagerLogStatistics(ThisTask, (uint8_t)MessageToProcess->Specification);
+                                                   break;
+                    case TISM_DUMP_TRACE:          // Dump the trace recorded so far; a new trace is started afterwards.
+                                                   if(ThisTask->TaskDebug) TISM_EventLoggerLogEvent (ThisTask, TISM_LOG_EVENT_NOTIFY, "Dump trace (TISM_DUMP_TRACE) received from TaskID %d (%s).", MessageToProcess->SenderTaskID, System.Task[MessageToProcess->SenderTaskID].TaskName);
+
+                                                   TISM_TraceDump(STDOUT);
+                                                   break;
+                    case TISM_RESET_STATISTICS:    // Reset the run statistics of the specified task, or of all tasks.
+                                                   if(ThisTask->TaskDebug) TISM_EventLoggerLogEvent (ThisTask, TISM_LOG_EVENT_NOTIFY, "Reset statistics (TISM_RESET_STATISTICS) for TargetTaskID %d (%s) received from TaskID %d (%s).", MessageToProcess->Specification, System.Task[MessageToProcess->Specification].TaskName, MessageToProcess->SenderTaskID, System.Task[MessageToProcess->SenderTaskID].TaskName);
+
+                                                   TISM_SchedulerResetStatistics((uint8_t)MessageToProcess->Specification);
+                                                   if(MessageToProcess->Specification==TISM_SCHEDULER_TASK_ID)
+                                                   {
+                                                     for(uint8_t TaskCounter=0;TaskCounter<System.NumberOfTasks;TaskCounter++)
+                                                       TISM_CircularBufferResetStatistics(&InboundMessageQueue[TaskCounter]);
+                                                     for(uint8_t CoreCounter=0;CoreCounter<MAX_CORES;CoreCounter++)
+                                                       TISM_CircularBufferResetStatistics(&OutboundMessageQueue[CoreCounter]);
+                                                     TISM_IRQHandlerResetStatistics();
+                                                     TISM_BufferPoolResetStatistics();
+                                                     TISM_StreamResetStatistics();
+                                                     TISM_EventLoggerResetStatistics();
+                                                   }
+                                                   else
+                                                     TISM_CircularBufferResetStatistics(&InboundMessageQueue[(uint8_t)MessageToProcess->Specification]);
+                                                   break;
                     case TISM_SET_TASK_DEBUG:      // Set the debug level for a task to the specified value.
-                                                   if(ThisTask.TaskDebug) TISM_EventLoggerLogEvent (ThisTask, TISM_LOG_EVENT_NOTIFY, "AttributeToChange %d (TISM_SET_TASK_DEBUG) for TargetTaskID %d (%s) with setting %ld received from TaskID %d (%s).", MessageToProcess->MessageType, MessageToProcess->Specification, System.Task[MessageToProcess->Specification].TaskName, MessageToProcess->Message, MessageToProcess->SenderTaskID, System.Task[MessageToProcess->SenderTaskID].TaskName);
+                                                   if(ThisTask->TaskDebug) TISM_EventLoggerLogEvent (ThisTask, TISM_LOG_EVENT_NOTIFY, "AttributeToChange %d (TISM_SET_TASK_DEBUG) for TargetTaskID %d (%s) with setting %ld received from TaskID %d (%s).", MessageToProcess->MessageType, MessageToProcess->Specification, System.Task[MessageToProcess->Specification].TaskName, MessageToProcess->Message, MessageToProcess->SenderTaskID, System.Task[MessageToProcess->SenderTaskID].TaskName);
 
                                                    System.Task[(uint8_t)MessageToProcess->Specification].TaskDebug=(uint8_t)MessageToProcess->Message;
                                                    break;
@@ -301,20 +450,20 @@ uint8_t TISM_TaskManager (TISM_Task ThisTask)
                   MessageCounter++;
                 }
                 // Go to sleep; we only wake on incoming messages (only TaskManager can do this directly).
-                System.Task[ThisTask.TaskID].TaskSleeping=true;
+                System.Task[ThisTask->TaskID].TaskSleeping=true;
 				        break;
 	  case STOP:  // Tasks required to stop
-		            if (ThisTask.TaskDebug) TISM_EventLoggerLogEvent (ThisTask, TISM_LOG_EVENT_NOTIFY, "Stopping.");
+		            if (ThisTask->TaskDebug) TISM_EventLoggerLogEvent (ThisTask, TISM_LOG_EVENT_NOTIFY, "Stopping.");
 		        
 				        // Tasks for stopping
 			          
                 // Set the task state to DOWN (only TaskManager can do this directly).
-                System.Task[ThisTask.TaskID].TaskState=DOWN;
+                System.Task[ThisTask->TaskID].TaskState=DOWN;
 		            break;					
   }
 		
   // All done.
-  if (ThisTask.TaskDebug==DEBUG_HIGH) TISM_EventLoggerLogEvent (ThisTask, TISM_LOG_EVENT_NOTIFY, "Run completed.");
+  if (ThisTask->TaskDebug==DEBUG_HIGH) TISM_EventLoggerLogEvent (ThisTask, TISM_LOG_EVENT_NOTIFY, "Run completed.");
 
   return (OK);
 }
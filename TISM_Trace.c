@@ -0,0 +1,152 @@
+/*
+  TISM_Trace.c
+  ============
+  Recorder of the order of events in the system: which core ran which task when, when messages were sent and delivered,
+  when interrupts were taken and when timers fired. Unlike logging with DEBUG_HIGH, recording an event hardly changes
+  the timing of the system; no text is formatted and nothing is written to STDOUT until the trace is dumped.
+
+  How the trace works:
+  - With TRACE_ENABLED, the scheduler, TISM_Postman, the interrupt handler of TISM_IRQHandler and TISM_SoftwareTimer
+    write a record for every event into a ring buffer in RAM (TRACE_BUFFER_SIZE records). When the ring is full, the
+    oldest records are overwritten; the trace always holds the most recent events.
+  - Each record takes 8 bytes: the time since the previous record (usec), the core and type of the event (TRACE_*), a
+    task ID and a 16 bit argument (see the definitions in TISM.h for the meaning per event type).
+  - Recording takes a hardware spinlock, so records of both cores and interrupt handlers are stored in the order they
+    occurred.
+  - The trace is dumped with TISM_TraceDump, or by sending TISM_DUMP_TRACE to TISM_TaskManager. The dump consists of
+    text lines starting with "TISM_TRACE", so it can be captured from the regular (USB) serial output along with the log.
+    Recording is paused while dumping.
+  - On the host, host/TISM_TraceExport.c converts a captured dump to the Chrome trace format (JSON), which can be
+    opened in Perfetto (ui.perfetto.dev) or chrome://tracing; one track per core.
+
+  Copyright (c) 2024 Maarten Klarenbeek (https://github.com/mjklaren)
+  Distributed under the GPLv3 license
+
+*/
+
+#include <stdio.h>
+#include <string.h>
+#include "pico/stdlib.h"
+#include "TISM.h"
+
+#define TRACE_RECORDS_PER_LINE   8       // Number of records in one line of the dump.
+
+
+// The ring buffer with records. BaseTimestamp is the time the delta of the oldest record is relative to.
+struct TISM_TraceData
+{
+  spin_lock_t *Lock;
+  TISM_TraceEntry Entry[TRACE_ENABLED?TRACE_BUFFER_SIZE:1];
+  uint16_t Head, NumberOfEntries;
+  uint64_t BaseTimestamp, LastTimestamp;
+  uint32_t Overwritten;
+  bool Recording;
+} TISM_TraceData;
+
+
+/*
+  Description:
+  Record an event in the trace. Can be called from interrupt handlers. Only call when TRACE_ENABLED is set; the callers
+  check the flag, so the calls are removed from the code when tracing is disabled.
+
+  Parameters:
+  uint8_t Event           - Type of event (TRACE_TASK_START, TRACE_MESSAGE_SENT etc).
+  uint8_t TaskID          - ID of the task the event applies to.
+  uint16_t Argument       - Argument of the event (see TISM.h).
+
+  Return value:
+  None
+*/
+void TISM_IN_RAM(TISM_TraceRecord)(uint8_t Event, uint8_t TaskID, uint16_t Argument)
+{
+  uint32_t LockState=spin_lock_blocking(TISM_TraceData.Lock);
+  if(TISM_TraceData.Recording)
+  {
+    uint64_t Now=time_us_64();
+    TISM_TraceEntry *Entry=&TISM_TraceData.Entry[TISM_TraceData.Head];
+
+    // Ring is full; the oldest entry is overwritten. The next one becomes the oldest.
+    if(TISM_TraceData.NumberOfEntries==TRACE_BUFFER_SIZE)
+    {
+      TISM_TraceData.BaseTimestamp+=Entry->TimestampDelta;
+      TISM_TraceData.Overwritten++;
+    }
+    else
+      TISM_TraceData.NumberOfEntries++;
+    Entry->TimestampDelta=(Now-TISM_TraceData.LastTimestamp>UINT32_MAX?UINT32_MAX:(uint32_t)(Now-TISM_TraceData.LastTimestamp));
+    Entry->Event=Event|(get_core_num()<<TRACE_CORE_SHIFT);
+    Entry->TaskID=TaskID;
+    Entry->Argument=Argument;
+    TISM_TraceData.LastTimestamp=Now;
+    TISM_TraceData.Head=(TISM_TraceData.Head+1)%TRACE_BUFFER_SIZE;
+  }
+  spin_unlock(TISM_TraceData.Lock, LockState);
+}
+
+
+/*
+  Description:
+  Write the contents of the trace as text lines; the names of the tasks, followed by the records from oldest to newest
+  (in hexadecimal). Recording is paused while dumping; the trace is empty afterwards. Its format:
+    TISM_TRACE_BEGIN <timestamp of oldest record - its delta> <number of records> <number of records overwritten>
+    TISM_TRACE_TASK <task ID> <task name>
+    TISM_TRACE <record> <record> ... (delta 8, event 2, task ID 2 and argument 4 hex digits per record)
+    TISM_TRACE_END
+
+  Parameters:
+  FILE *Output            - Where to write the dump to (e.g. STDOUT).
+
+  Return value:
+  None
+*/
+void TISM_TraceDump(FILE *Output)
+{
+  if(!TRACE_ENABLED)
+    return;
+  uint32_t LockState=spin_lock_blocking(TISM_TraceData.Lock);
+  TISM_TraceData.Recording=false;
+  spin_unlock(TISM_TraceData.Lock, LockState);
+
+  fprintf(Output, "TISM_TRACE_BEGIN %llu %d %lu\n", TISM_TraceData.BaseTimestamp, TISM_TraceData.NumberOfEntries, TISM_TraceData.Overwritten);
+  for(uint8_t TaskID=0;TaskID<System.NumberOfTasks;TaskID++)
+    fprintf(Output, "TISM_TRACE_TASK %d %s\n", TaskID, System.Task[TaskID].TaskName);
+  uint16_t Index=(TISM_TraceData.Head+TRACE_BUFFER_SIZE-TISM_TraceData.NumberOfEntries)%TRACE_BUFFER_SIZE;
+  for(uint16_t counter=0;counter<TISM_TraceData.NumberOfEntries;counter++)
+  {
+    TISM_TraceEntry *Entry=&TISM_TraceData.Entry[(Index+counter)%TRACE_BUFFER_SIZE];
+    fprintf(Output, "%s%08lx%02x%02x%04x", (counter%TRACE_RECORDS_PER_LINE==0?"TISM_TRACE ":" "), Entry->TimestampDelta, Entry->Event, Entry->TaskID, Entry->Argument);
+    if((counter%TRACE_RECORDS_PER_LINE==TRACE_RECORDS_PER_LINE-1) || (counter==TISM_TraceData.NumberOfEntries-1))
+      fprintf(Output, "\n");
+  }
+  fprintf(Output, "TISM_TRACE_END\n");
+
+  // Start a new trace.
+  LockState=spin_lock_blocking(TISM_TraceData.Lock);
+  TISM_TraceData.NumberOfEntries=0;
+  TISM_TraceData.Overwritten=0;
+  TISM_TraceData.BaseTimestamp=TISM_TraceData.LastTimestamp=time_us_64();
+  TISM_TraceData.Recording=true;
+  spin_unlock(TISM_TraceData.Lock, LockState);
+}
+
+
+/*
+  Description:
+  Initialize the trace recorder. Called once by TISM_InitializeSystem.
+
+  Parameters:
+  None
+
+  Return value:
+  None
+*/
+void TISM_TraceInit()
+{
+  TISM_TraceData.Head=0;
+  TISM_TraceData.NumberOfEntries=0;
+  TISM_TraceData.Overwritten=0;
+  TISM_TraceData.BaseTimestamp=TISM_TraceData.LastTimestamp=time_us_64();
+  // Use one of the striped spinlocks of the SDK; the critical sections are very short and never take another lock.
+  TISM_TraceData.Lock=spin_lock_instance(next_striped_spin_lock_num());
+  TISM_TraceData.Recording=TRACE_ENABLED;
+}
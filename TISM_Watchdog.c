@@ -4,8 +4,18 @@
   Task to check if other tasks are still alive. Generate warnings to STDthe EventLogger in case of timeouts.
   This task runs as a 'regular' task in the TISM-system.
 
+  Two modes are available:
+  - PING (default): every WATCHDOG_CHECK_INTERVAL a PING message is sent to all tasks that do not sleep; an ECHO
+    reply later than WATCHDOG_TASK_TIMEOUT generates a warning.
+  - Heartbeat (WATCHDOG_HEARTBEAT): no messages are sent. TISM_Scheduler stores the time each run of a task completes
+    (System.TaskLastRun); every WATCHDOG_HEARTBEAT_INTERVAL this task checks if every task that is due has completed a
+    run within its timeout after its wake-up time (TaskTimeout, or WATCHDOG_TASK_TIMEOUT when not set).
+    With WATCHDOG_HARDWARE the RP2040 hardware watchdog is enabled as well. It is only fed while all critical tasks
+    (tasks with a TaskTimeout set, see TISM_SET_TASK_TIMEOUT) are healthy; when one of them hangs the RP2040 resets
+    after WATCHDOG_HARDWARE_TIMEOUT msec. This also covers a hanging TISM_Watchdog or scheduler.
+
   Parameters:
-  TISM_Task ThisTask      - Struct containing all task related information.
+  TISM_Task *ThisTask     - Pointer to struct containing all task related information.
   
   Return value:
   <non zero value>        - Task returned an error when executing.
@@ -18,6 +28,7 @@
 
 #include <stdio.h>
 #include "pico/stdlib.h"
+#include "hardware/watchdog.h"
 #include "TISM.h"
 
 
@@ -27,41 +38,73 @@ struct TISM_WatchdogData
   uint64_t TimeRequestSent[MAX_TASKS], ResponseDelay, NextPingRound;
   int DataRequestSent[MAX_TASKS];
   int PingMessageCounter;
+  bool Overdue[MAX_TASKS], HardwareEnabled;
 } TISM_WatchdogData;
 
 
+// Internal function - check the heartbeat of all tasks; log tasks that become overdue or recover.
+// Returns true when all critical tasks are healthy.
+bool TISM_WatchdogCheckHeartbeats(TISM_Task *ThisTask)
+{
+  bool CriticalTasksHealthy=true;
+  uint64_t Now=time_us_64();
+  for(uint8_t TaskID=1;TaskID<System.NumberOfTasks;TaskID++)
+  {
+    if((TaskID==ThisTask->TaskID) || (System.Task[TaskID].TaskState==DOWN))
+      continue;
+
+    // A task is overdue when it is due, but hasn't completed a run within its timeout after its wake-up time.
+    uint32_t Timeout=(System.Task[TaskID].TaskTimeout>0?System.Task[TaskID].TaskTimeout:WATCHDOG_TASK_TIMEOUT);
+    uint64_t WakeUpTimer=System.Task[TaskID].TaskWakeUpTimer;
+    bool Overdue=((!System.Task[TaskID].TaskSleeping) && (Now>WakeUpTimer+Timeout) && (System.TaskLastRun[TaskID]<WakeUpTimer));
+    if(Overdue && !TISM_WatchdogData.Overdue[TaskID])
+      TISM_EventLoggerLogEvent (ThisTask, TISM_LOG_EVENT_ERROR, "Task %d (%s) did not complete a run within %lu usec after its wake-up time.", TaskID, System.Task[TaskID].TaskName, Timeout);
+    else if(!Overdue && TISM_WatchdogData.Overdue[TaskID])
+      TISM_EventLoggerLogEvent (ThisTask, TISM_LOG_EVENT_NOTIFY, "Task %d (%s) is running again.", TaskID, System.Task[TaskID].TaskName);
+    TISM_WatchdogData.Overdue[TaskID]=Overdue;
+    if(Overdue && (System.Task[TaskID].TaskTimeout>0))
+      CriticalTasksHealthy=false;
+  }
+  return(CriticalTasksHealthy);
+}
+
+
 /*
   Description:
   This is the function that is registered in the TISM-system.
   This function is called by TISM_Scheduler.
 
   Parameters:
-  TISM_Task ThisTask - Struct containing all relevant information for this task to run.
+  TISM_Task *ThisTask - Pointer to struct containing all relevant information for this task to run.
   
   Return value:
   <non zero value>        - Task returned an error when executing.
   OK                      - Run succesfully completed.
 */	
-uint8_t TISM_Watchdog (TISM_Task ThisTask)
+uint8_t TISM_Watchdog (TISM_Task *ThisTask)
 {
-  if (ThisTask.TaskDebug==DEBUG_HIGH) TISM_EventLoggerLogEvent (ThisTask, TISM_LOG_EVENT_NOTIFY, "Run starting.");
+  if (ThisTask->TaskDebug==DEBUG_HIGH) TISM_EventLoggerLogEvent (ThisTask, TISM_LOG_EVENT_NOTIFY, "Run starting.");
 
-  switch(ThisTask.TaskState)   // Unknown states are ignored
+  switch(ThisTask->TaskState)   // Unknown states are ignored
   {
     case INIT:  // Task required to initialize                
-                if (ThisTask.TaskDebug) TISM_EventLoggerLogEvent (ThisTask, TISM_LOG_EVENT_NOTIFY, "Initializing with priority %d.", ThisTask.TaskPriority);
+                if (ThisTask->TaskDebug) TISM_EventLoggerLogEvent (ThisTask, TISM_LOG_EVENT_NOTIFY, "Initializing with priority %d.", ThisTask->TaskPriority);
 				        
                 TISM_WatchdogData.PingMessageCounter=0;
                 for(int counter=0; counter<MAX_TASKS; counter++)
                 {
                   TISM_WatchdogData.TimeRequestSent[counter]=0;
                   TISM_WatchdogData.DataRequestSent[counter]=-1;
+                  TISM_WatchdogData.Overdue[counter]=false;
                 }
                 TISM_WatchdogData.PingMessageCounter=0;
                 TISM_WatchdogData.NextPingRound=0;
+                TISM_WatchdogData.HardwareEnabled=false;
+                if(WATCHDOG_HARDWARE && watchdog_caused_reboot())
+                  TISM_EventLoggerLogEvent (ThisTask, TISM_LOG_EVENT_ERROR, "System was restarted by the hardware watchdog.");
 				        break;
 	  case RUN:   // Do the work						
-		      	    if (ThisTask.TaskDebug==DEBUG_HIGH) TISM_EventLoggerLogEvent (ThisTask, TISM_LOG_EVENT_NOTIFY, "Doing work with priority %d on core %d.", ThisTask.TaskPriority, ThisTask.RunningOnCoreID);
+		      	    if (ThisTask->TaskDebug==DEBUG_HIGH) TISM_EventLoggerLogEvent (ThisTask, TISM_LOG_EVENT_NOTIFY, "Doing work with priority %d on core %d.", ThisTask->TaskPriority, ThisTask->RunningOnCoreID);
              
                 // First check for incoming messages.
                 int MessageCounter=0;
@@ -70,7 +113,7 @@ uint8_t TISM_Watchdog (TISM_Task ThisTask)
                 {
                   MessageToProcess=TISM_PostmanReadMessage(ThisTask);
 
-                  if (ThisTask.TaskDebug) TISM_EventLoggerLogEvent (ThisTask, TISM_LOG_EVENT_NOTIFY, "Message '%ld' type %d from TaskID %d (%s) received.", MessageToProcess->Message, MessageToProcess->MessageType, MessageToProcess->SenderTaskID, System.Task[MessageToProcess->SenderTaskID].TaskName);
+                  if (ThisTask->TaskDebug) TISM_EventLoggerLogEvent (ThisTask, TISM_LOG_EVENT_NOTIFY, "Message '%ld' type %d from TaskID %d (%s) received.", MessageToProcess->Message, MessageToProcess->MessageType, MessageToProcess->SenderTaskID, System.Task[MessageToProcess->SenderTaskID].TaskName);
 
                   // Processed the message; delete it.
                   switch(MessageToProcess->MessageType)
@@ -79,7 +122,7 @@ uint8_t TISM_Watchdog (TISM_Task ThisTask)
                                     TISM_PostmanWriteMessage(ThisTask,MessageToProcess->SenderTaskID,TISM_ECHO,MessageToProcess->Message,0);
                                     break;
                     case TISM_TEST: // This is mostly used for debugging purposes. Print a text to STDOUT.
-                                    if (ThisTask.TaskDebug) TISM_EventLoggerLogEvent (ThisTask, TISM_LOG_EVENT_NOTIFY, "Test message received from TaskID %d (%s).", MessageToProcess->SenderTaskID, System.Task[MessageToProcess->SenderTaskID].TaskName);
+                                    if (ThisTask->TaskDebug) TISM_EventLoggerLogEvent (ThisTask, TISM_LOG_EVENT_NOTIFY, "Test message received from TaskID %d (%s).", MessageToProcess->SenderTaskID, System.Task[MessageToProcess->SenderTaskID].TaskName);
                                     break;
                     case TISM_ECHO: // Echo reply to our ping request
                                     // Is this the reply to the last message we've sent to this task?
@@ -88,7 +131,7 @@ uint8_t TISM_Watchdog (TISM_Task ThisTask)
                                       // Correct response received; calculate the delay. Did the response exceed the maximum?
                                       TISM_WatchdogData.ResponseDelay=time_us_64()-TISM_WatchdogData.TimeRequestSent[MessageToProcess->SenderTaskID];
 
-                                      if (ThisTask.TaskDebug==DEBUG_HIGH) TISM_EventLoggerLogEvent (ThisTask, TISM_LOG_EVENT_NOTIFY, "Valid ECHO response received from %d (%s), delay %ld.", MessageToProcess->SenderTaskID, System.Task[MessageToProcess->SenderTaskID].TaskName, TISM_WatchdogData.ResponseDelay);
+                                      if (ThisTask->TaskDebug==DEBUG_HIGH) TISM_EventLoggerLogEvent (ThisTask, TISM_LOG_EVENT_NOTIFY, "Valid ECHO response received from %d (%s), delay %ld.", MessageToProcess->SenderTaskID, System.Task[MessageToProcess->SenderTaskID].TaskName, TISM_WatchdogData.ResponseDelay);
 
                                       if(TISM_WatchdogData.ResponseDelay>WATCHDOG_TASK_TIMEOUT)
                                       {
@@ -98,7 +141,7 @@ uint8_t TISM_Watchdog (TISM_Task ThisTask)
                                     }
                                     else
                                     {
-                                      if (ThisTask.TaskDebug) TISM_EventLoggerLogEvent (ThisTask, TISM_LOG_EVENT_ERROR, "Invalid ECHO response received on PING request from %d (%s); expected %ld, received %ld.", MessageToProcess->SenderTaskID, System.Task[MessageToProcess->SenderTaskID].TaskName, TISM_WatchdogData.DataRequestSent[MessageToProcess->SenderTaskID], MessageToProcess->Message);
+                                      if (ThisTask->TaskDebug) TISM_EventLoggerLogEvent (ThisTask, TISM_LOG_EVENT_ERROR, "Invalid ECHO response received on PING request from %d (%s); expected %ld, received %ld.", MessageToProcess->SenderTaskID, System.Task[MessageToProcess->SenderTaskID].TaskName, TISM_WatchdogData.DataRequestSent[MessageToProcess->SenderTaskID], MessageToProcess->Message);
                                     }
                                     break;
                     default:        // Unknown message type - ignore.
@@ -108,19 +151,34 @@ uint8_t TISM_Watchdog (TISM_Task ThisTask)
                   MessageCounter++;
                 }
 
+                if(WATCHDOG_HEARTBEAT)
+                {
+                  // Heartbeat mode. Enable the hardware watchdog on the first run, not during INIT; the tasks start
+                  // running STARTUP_DELAY msec after their initialization.
+                  if(WATCHDOG_HARDWARE && !TISM_WatchdogData.HardwareEnabled)
+                  {
+                    watchdog_enable(WATCHDOG_HARDWARE_TIMEOUT, true);
+                    TISM_WatchdogData.HardwareEnabled=true;
+                    if (ThisTask->TaskDebug) TISM_EventLoggerLogEvent (ThisTask, TISM_LOG_EVENT_NOTIFY, "Hardware watchdog enabled with a timeout of %d msec.", WATCHDOG_HARDWARE_TIMEOUT);
+                  }
+                  if(TISM_WatchdogCheckHeartbeats(ThisTask) && TISM_WatchdogData.HardwareEnabled)
+                    watchdog_update();
+                  ThisTask->TaskWakeUpTimer=time_us_64()+WATCHDOG_HEARTBEAT_INTERVAL;
+                }
                 // Now it's time to send out PING requests to tasks. Did we woke up early (message received)?
                 // If so, then wait - we don't want to flood the system.
-                if(time_us_64()>=TISM_WatchdogData.NextPingRound)
+                else if(time_us_64()>=TISM_WatchdogData.NextPingRound)
                 {
-                  // Send out a PING request to all processes that do not sleep
+                  // Send out a PING request to all processes that do not sleep. Skip the dummy entry of the scheduler; it has
+                  // no function and doesn't receive messages.
                   for(MessageCounter=0;MessageCounter<System.NumberOfTasks;MessageCounter++)
                   {
-                    if((!System.Task[MessageCounter].TaskSleeping) && (System.Task[MessageCounter].TaskID!=ThisTask.TaskID))
+                    if((!System.Task[MessageCounter].TaskSleeping) && (System.Task[MessageCounter].TaskID!=ThisTask->TaskID) && (System.Task[MessageCounter].TaskFunction!=NULL))
                     {
                       // Send the PING message; store the time of sending and message, so we can check when we get a reply.
                       TISM_PostmanWriteMessage(ThisTask,MessageCounter,TISM_PING,TISM_WatchdogData.PingMessageCounter,0);
 
-                      if (ThisTask.TaskDebug) TISM_EventLoggerLogEvent (ThisTask, TISM_LOG_EVENT_NOTIFY, "Sent PING request to %d.", MessageCounter);
+                      if (ThisTask->TaskDebug) TISM_EventLoggerLogEvent (ThisTask, TISM_LOG_EVENT_NOTIFY, "Sent PING request to %d.", MessageCounter);
   
                       TISM_WatchdogData.TimeRequestSent[MessageCounter]=time_us_64();
                       TISM_WatchdogData.DataRequestSent[MessageCounter]=TISM_WatchdogData.PingMessageCounter;
@@ -134,9 +192,11 @@ uint8_t TISM_Watchdog (TISM_Task ThisTask)
                 }
 				        break;
 	  case STOP:  // Task required to stop
-		            if (ThisTask.TaskDebug) TISM_EventLoggerLogEvent (ThisTask, TISM_LOG_EVENT_NOTIFY, "Stopping.");
+		            if (ThisTask->TaskDebug) TISM_EventLoggerLogEvent (ThisTask, TISM_LOG_EVENT_NOTIFY, "Stopping.");
 		        
 				        // Tasks for stopping
+                if(TISM_WatchdogData.HardwareEnabled)
+                  watchdog_disable();
 			          
                 // Set the task state to DOWN. 
                 TISM_TaskManagerSetMyTaskAttribute(ThisTask,TISM_SET_TASK_STATE,DOWN);
@@ -144,7 +204,7 @@ uint8_t TISM_Watchdog (TISM_Task ThisTask)
   }
 		
   // All done.
-  if (ThisTask.TaskDebug==DEBUG_HIGH) TISM_EventLoggerLogEvent (ThisTask, TISM_LOG_EVENT_NOTIFY, "Run completed.");
+  if (ThisTask->TaskDebug==DEBUG_HIGH) TISM_EventLoggerLogEvent (ThisTask, TISM_LOG_EVENT_NOTIFY, "Run completed.");
 
   return (OK);
 }
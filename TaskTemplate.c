@@ -27,15 +27,15 @@ struct TaskTemplateData
   For debugging purposes the TISM_EventLoggerLogEvent-function is used (not mandatory).
 
   Parameters:
-  TISM_Task ThisTask - Struct containing all relevant information for this task to run. This is provided by the scheduler.
+  TISM_Task *ThisTask - Pointer to struct containing all relevant information for this task to run. This is provided by the scheduler.
   
   Return value:
   <non-zero value>        - Task returned an error when executing. A non-zero value will stop the system.
   OK                      - Run succesfully completed.
 */
-uint8_t TaskTemplate (TISM_Task ThisTask)
+uint8_t TaskTemplate (TISM_Task *ThisTask)
 {
-  if (ThisTask.TaskDebug==DEBUG_HIGH) TISM_EventLoggerLogEvent (ThisTask, TISM_LOG_EVENT_NOTIFY, "Run starting.");
+  if (ThisTask->TaskDebug==DEBUG_HIGH) TISM_EventLoggerLogEvent (ThisTask, TISM_LOG_EVENT_NOTIFY, "Run starting.");
   
   /*
     The scheduler maintains the state of the task and the system. Specify here the actions per state.
@@ -45,10 +45,10 @@ uint8_t TaskTemplate (TISM_Task ThisTask)
     Once the system is in this state the task can then switch to custom states. When the system stops all tasks are switched
     to the STOP-state. Remember to always check for incoming messages in custom states.
   */
-  switch(ThisTask.TaskState)   
+  switch(ThisTask->TaskState)   
   {
     case INIT:  // Activities to initialize this task (e.g. initialize ports or peripherals).
-                if (ThisTask.TaskDebug) TISM_EventLoggerLogEvent (ThisTask, TISM_LOG_EVENT_NOTIFY, "Initializing with priority %d.", ThisTask.TaskPriority);
+                if (ThisTask->TaskDebug) TISM_EventLoggerLogEvent (ThisTask, TISM_LOG_EVENT_NOTIFY, "Initializing with priority %d.", ThisTask->TaskPriority);
 				        
                 // Give your variables an initial value.
                 TaskTemplateData.YourVariable1=11;
@@ -58,7 +58,7 @@ uint8_t TaskTemplate (TISM_Task ThisTask)
                 // TISM_TaskManagerSetMyTaskAttribute(ThisTask,TISM_SET_TASK_SLEEP,true);
 				        break;
 	  case RUN:   // Do the work.						
-		      	    if (ThisTask.TaskDebug==DEBUG_HIGH) TISM_EventLoggerLogEvent (ThisTask, TISM_LOG_EVENT_NOTIFY, "Doing work with priority %d on core %d.", ThisTask.TaskPriority, ThisTask.RunningOnCoreID);
+		      	    if (ThisTask->TaskDebug==DEBUG_HIGH) TISM_EventLoggerLogEvent (ThisTask, TISM_LOG_EVENT_NOTIFY, "Doing work with priority %d on core %d.", ThisTask->TaskPriority, ThisTask->RunningOnCoreID);
 
                 // First check for incoming messages and process them.
                 uint8_t MessageCounter=0;
@@ -67,7 +67,7 @@ uint8_t TaskTemplate (TISM_Task ThisTask)
                 {
                   MessageToProcess=TISM_PostmanReadMessage(ThisTask);
 
-                  if (ThisTask.TaskDebug) TISM_EventLoggerLogEvent (ThisTask, TISM_LOG_EVENT_NOTIFY, "Message '%ld' type %d from TaskID %d (%s) received.", MessageToProcess->Message, MessageToProcess->MessageType, MessageToProcess->SenderTaskID, System.Task[MessageToProcess->SenderTaskID].TaskName);
+                  if (ThisTask->TaskDebug) TISM_EventLoggerLogEvent (ThisTask, TISM_LOG_EVENT_NOTIFY, "Message '%ld' type %d from TaskID %d (%s) received.", MessageToProcess->Message, MessageToProcess->MessageType, MessageToProcess->SenderTaskID, System.Task[MessageToProcess->SenderTaskID].TaskName);
 
                   // Processed the message; delete it.
                   switch(MessageToProcess->MessageType)
@@ -84,9 +84,24 @@ uint8_t TaskTemplate (TISM_Task ThisTask)
 
                 // Other work to do in this state.
 
+                // Event driven tasks can sleep until the next message arrives (of a specific type, or TISM_ANY_MESSAGE),
+                // optionally with a timeout in usec. The task is woken directly when the message is delivered.
+                // TISM_PostmanWaitForMessage(ThisTask,TISM_ANY_MESSAGE,TISM_WAIT_FOREVER);
+
+                // Long operations can be split over multiple runs with the TISM_COROUTINE macros (see TISM.h) instead of
+                // extra task states. Variables that have to survive a yield must be kept in TaskTemplateData.
+                // TISM_COROUTINE_BEGIN(ThisTask);
+                // for(TaskTemplateData.YourVariable1=0;TaskTemplateData.YourVariable1<1000;TaskTemplateData.YourVariable1++)
+                // {
+                //   ... one step of the operation ...
+                //   if(TaskTemplateData.YourVariable1%100==99)
+                //     TISM_COROUTINE_YIELD(ThisTask);
+                // }
+                // TISM_COROUTINE_END(ThisTask);
+
 				        break;
 	  case STOP:  // Task required to stop this task.
-		            if (ThisTask.TaskDebug) TISM_EventLoggerLogEvent (ThisTask, TISM_LOG_EVENT_NOTIFY, "Stopping.");
+		            if (ThisTask->TaskDebug) TISM_EventLoggerLogEvent (ThisTask, TISM_LOG_EVENT_NOTIFY, "Stopping.");
 		          
                 // Set the task state to DOWN. 
                 TISM_TaskManagerSetMyTaskAttribute(ThisTask,TISM_SET_TASK_STATE,DOWN);
@@ -94,7 +109,7 @@ uint8_t TaskTemplate (TISM_Task ThisTask)
   }
 		
   // Run completed.
-  if (ThisTask.TaskDebug==DEBUG_HIGH) TISM_EventLoggerLogEvent (ThisTask, TISM_LOG_EVENT_NOTIFY, "Run completed.");
+  if (ThisTask->TaskDebug==DEBUG_HIGH) TISM_EventLoggerLogEvent (ThisTask, TISM_LOG_EVENT_NOTIFY, "Run completed.");
 
   return (OK);
 }
@@ -0,0 +1,409 @@
+/*
+
+  TISM_Host.h
+  ===========
+  Platform shim to build and run TISM on a Linux host (host simulation build, TISM_HOST_BUILD). It provides the subset
+  of the Pico SDK used by TISM and the tasks, on top of POSIX threads:
+  - Each core is a thread; main() runs on core 0, multicore_launch_core1 starts a second thread for core 1.
+    get_core_num returns the core of the calling thread.
+  - time_us_64 is the monotonic clock of the host in microseconds. sleep_ms/sleep_us sleep, busy_wait_us spins.
+  - Hardware spinlocks are mutexes. As on the RP2040 there are 32 of them; 16-23 are used for striping (see
+    next_striped_spin_lock_num) and spin_lock_claim_unused hands out 24 and up.
+  - The alarm pool is a separate thread that calls the alarm callbacks in order of expiry, standing in for the timer
+    interrupt on core 0. Up to TISM_HOST_MAX_ALARMS alarms can be active at the same time.
+  - The hardware watchdog (watchdog_enable/update/disable) is checked by the alarm thread; when it isn't updated in
+    time the process exits, as the RP2040 would reset. watchdog_caused_reboot always returns false.
+  - The memory placement macros (__not_in_flash_func, __scratch_x, __scratch_y) have no effect.
+  - __sev wakes both cores; best_effort_wfe_or_timeout waits for an event or the timeout on a condition variable.
+  - GPIOs only keep their level. Writing an output (gpio_put) that has edge interrupts enabled calls the GPIO interrupt
+    callback right away in the calling thread, so interrupt handling can be tested without any wiring. Use
+    TISM_HostSetGpio to simulate external inputs.
+
+  These headers are found before the SDK headers by adding the "host" folder to the include path; the source files of
+  TISM and the tasks are compiled unchanged. See the TISM_HOST_BUILD option in CMakeLists.txt.
+
+  Copyright (c) 2024 Maarten Klarenbeek (https://github.com/mjklaren)
+  Distributed under the GPLv3 license
+
+*/
+
+#ifndef TISM_HOST
+#define TISM_HOST
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+
+#define TISM_HOST_MAX_CORES      2
+#define TISM_HOST_MAX_GPIOS      30
+#define TISM_HOST_SPIN_LOCKS     32
+#define TISM_HOST_STRIPED_LOCKS  16      // First spinlock used for striping; 8 locks in total (as PICO_SPINLOCK_ID_STRIPED_FIRST).
+#define TISM_HOST_CLAIMED_LOCKS  24      // First spinlock handed out by spin_lock_claim_unused (as PICO_SPINLOCK_ID_CLAIM_FREE_FIRST).
+#define TISM_HOST_MAX_ALARMS     16      // Maximum number of active alarms (as PICO_TIME_DEFAULT_ALARM_POOL_MAX_TIMERS).
+#define TISM_HOST_ALARM_POLL_USEC 200    // Microseconds - Maximum time the alarm thread sleeps before checking the alarms again.
+#define TISM_HOST_WATCHDOG_POLL_USEC 1000 // Microseconds - Interval at which the alarm thread checks the hardware watchdog.
+
+// Types and definitions of the Pico SDK.
+typedef unsigned int uint;
+typedef uint64_t absolute_time_t;
+typedef int32_t alarm_id_t;
+typedef int64_t (*alarm_callback_t)(alarm_id_t id, void *user_data);
+typedef void (*gpio_irq_callback_t)(uint gpio, uint32_t event_mask);
+typedef pthread_mutex_t spin_lock_t;
+
+// Memory placement (pico/platform.h); the host has a single memory.
+#define __not_in_flash_func(Function) Function
+#define __scratch_x(Section)
+#define __scratch_y(Section)
+
+enum gpio_irq_level { GPIO_IRQ_LEVEL_LOW=0x1u, GPIO_IRQ_LEVEL_HIGH=0x2u, GPIO_IRQ_EDGE_FALL=0x4u, GPIO_IRQ_EDGE_RISE=0x8u };
+enum gpio_function { GPIO_FUNC_SIO=5 };
+#define GPIO_OUT                 1
+#define GPIO_IN                  0
+
+
+// All data of the simulated hardware.
+static struct TISM_HostData
+{
+  pthread_mutex_t SpinLock[TISM_HOST_SPIN_LOCKS];
+  uint NextStripedLock, NextClaimedLock;
+  pthread_mutex_t EventLock;
+  pthread_cond_t EventCondition;
+  bool Event[TISM_HOST_MAX_CORES];
+  gpio_irq_callback_t GpioCallback;
+  uint32_t GpioEventMask[TISM_HOST_MAX_GPIOS];
+  bool GpioLevel[TISM_HOST_MAX_GPIOS];
+  pthread_mutex_t AlarmLock;
+  pthread_t AlarmThread;
+  bool AlarmThreadRunning;
+  alarm_id_t NextAlarmID;
+  alarm_id_t WatchdogAlarmID;
+  uint64_t WatchdogTimeout, WatchdogDeadline;
+  struct
+  {
+    alarm_id_t AlarmID;                  // 0 = entry is free.
+    uint64_t Target;
+    alarm_callback_t Callback;
+    void *UserData;
+  } Alarm[TISM_HOST_MAX_ALARMS];
+} TISM_HostData={ .SpinLock={[0 ... TISM_HOST_SPIN_LOCKS-1]=PTHREAD_MUTEX_INITIALIZER},
+                  .NextClaimedLock=TISM_HOST_CLAIMED_LOCKS,
+                  .EventLock=PTHREAD_MUTEX_INITIALIZER,
+                  .EventCondition=PTHREAD_COND_INITIALIZER,
+                  .AlarmLock=PTHREAD_MUTEX_INITIALIZER,
+                  .NextAlarmID=1 };
+
+// The core the calling thread simulates.
+static __thread uint TISM_HostCoreID=0;
+
+
+/*
+
+  Time
+
+*/
+
+static inline uint64_t time_us_64(void)
+{
+  struct timespec Now;
+  clock_gettime(CLOCK_MONOTONIC, &Now);
+  return((uint64_t)Now.tv_sec*1000000+Now.tv_nsec/1000);
+}
+
+static inline absolute_time_t get_absolute_time(void) { return(time_us_64()); }
+static inline absolute_time_t from_us_since_boot(uint64_t Usec) { return(Usec); }
+static inline uint64_t to_us_since_boot(absolute_time_t Timestamp) { return(Timestamp); }
+
+static inline void sleep_us(uint64_t Usec)
+{
+  struct timespec Delay={ .tv_sec=Usec/1000000, .tv_nsec=(Usec%1000000)*1000 };
+  nanosleep(&Delay, NULL);
+}
+
+static inline void sleep_ms(uint32_t Msec) { sleep_us((uint64_t)Msec*1000); }
+
+static inline void busy_wait_us(uint64_t Usec)
+{
+  uint64_t Deadline=time_us_64()+Usec;
+  while(time_us_64()<Deadline);
+}
+
+static inline void tight_loop_contents(void) {}
+
+
+/*
+
+  Standard I/O and cores
+
+*/
+
+static inline bool stdio_init_all(void)
+{
+  // Line buffering, like the USB stdio of the SDK; otherwise output is lost when the simulation is interrupted.
+  setvbuf(stdout, NULL, _IOLBF, 0);
+  return(true);
+}
+
+static inline uint get_core_num(void) { return(TISM_HostCoreID); }
+
+// Internal function - thread of core 1.
+static void *TISM_HostCore1(void *Entry)
+{
+  TISM_HostCoreID=1;
+  ((void (*)(void))Entry)();
+  return(NULL);
+}
+
+static inline void multicore_launch_core1(void (*Entry)(void))
+{
+  pthread_t Core1Thread;
+  if(pthread_create(&Core1Thread, NULL, TISM_HostCore1, (void *)Entry)!=0)
+  {
+    fprintf(stderr, "TISM_Host: Can't start the thread for core 1.\n");
+    exit(EXIT_FAILURE);
+  }
+  pthread_detach(Core1Thread);
+}
+
+
+/*
+
+  Spinlocks, memory barriers and events
+
+*/
+
+static inline spin_lock_t *spin_lock_instance(uint LockNumber) { return(&TISM_HostData.SpinLock[LockNumber]); }
+
+static inline uint next_striped_spin_lock_num(void)
+{
+  return(TISM_HOST_STRIPED_LOCKS+(__atomic_fetch_add(&TISM_HostData.NextStripedLock, 1, __ATOMIC_RELAXED)%8));
+}
+
+static inline int spin_lock_claim_unused(bool Required)
+{
+  uint LockNumber=__atomic_fetch_add(&TISM_HostData.NextClaimedLock, 1, __ATOMIC_RELAXED);
+  if(LockNumber<TISM_HOST_SPIN_LOCKS)
+    return(LockNumber);
+  if(Required)
+  {
+    fprintf(stderr, "TISM_Host: No spinlocks are available.\n");
+    exit(EXIT_FAILURE);
+  }
+  return(-1);
+}
+
+static inline uint32_t spin_lock_blocking(spin_lock_t *Lock)
+{
+  pthread_mutex_lock(Lock);
+  return(0);
+}
+
+static inline void spin_unlock(spin_lock_t *Lock, uint32_t SavedInterrupts) { pthread_mutex_unlock(Lock); }
+
+static inline void __mem_fence_acquire(void) { __atomic_thread_fence(__ATOMIC_ACQUIRE); }
+static inline void __mem_fence_release(void) { __atomic_thread_fence(__ATOMIC_RELEASE); }
+
+// Send an event to all cores.
+static inline void __sev(void)
+{
+  pthread_mutex_lock(&TISM_HostData.EventLock);
+  for(uint CoreCounter=0; CoreCounter<TISM_HOST_MAX_CORES; CoreCounter++)
+    TISM_HostData.Event[CoreCounter]=true;
+  pthread_cond_broadcast(&TISM_HostData.EventCondition);
+  pthread_mutex_unlock(&TISM_HostData.EventLock);
+}
+
+// Wait for an event or until the timeout expires. Returns true when the timeout expired.
+static inline bool best_effort_wfe_or_timeout(absolute_time_t Timeout)
+{
+  uint64_t Now=time_us_64();
+  if(Timeout<=Now)
+    return(true);
+
+  // The condition variable uses the realtime clock; convert the timeout.
+  struct timespec Deadline;
+  clock_gettime(CLOCK_REALTIME, &Deadline);
+  uint64_t DeadlineNsec=(uint64_t)Deadline.tv_sec*1000000000+Deadline.tv_nsec+(Timeout-Now)*1000;
+  Deadline.tv_sec=DeadlineNsec/1000000000;
+  Deadline.tv_nsec=DeadlineNsec%1000000000;
+
+  int Result=0;
+  pthread_mutex_lock(&TISM_HostData.EventLock);
+  while(!TISM_HostData.Event[TISM_HostCoreID] && Result==0)
+    Result=pthread_cond_timedwait(&TISM_HostData.EventCondition, &TISM_HostData.EventLock, &Deadline);
+  TISM_HostData.Event[TISM_HostCoreID]=false;
+  pthread_mutex_unlock(&TISM_HostData.EventLock);
+  return(Result!=0);
+}
+
+
+/*
+
+  GPIO
+
+*/
+
+static inline void gpio_init(uint Gpio) {}
+static inline void gpio_set_dir(uint Gpio, bool Out) {}
+static inline void gpio_set_function(uint Gpio, enum gpio_function Function) {}
+static inline void gpio_pull_up(uint Gpio) {}
+static inline void gpio_pull_down(uint Gpio) {}
+static inline void gpio_acknowledge_irq(uint Gpio, uint32_t EventMask) {}
+static inline bool gpio_get(uint Gpio) { return(TISM_HostData.GpioLevel[Gpio]); }
+
+static inline void gpio_set_irq_enabled_with_callback(uint Gpio, uint32_t EventMask, bool Enabled, gpio_irq_callback_t Callback)
+{
+  TISM_HostData.GpioCallback=Callback;
+  if(Enabled)
+    TISM_HostData.GpioEventMask[Gpio]|=EventMask;
+  else
+    TISM_HostData.GpioEventMask[Gpio]&=~EventMask;
+}
+
+// Set the level of a GPIO; simulates an external input. The interrupt callback is called for enabled edges.
+static inline void TISM_HostSetGpio(uint Gpio, bool Level)
+{
+  if(TISM_HostData.GpioLevel[Gpio]==Level)
+    return;
+  TISM_HostData.GpioLevel[Gpio]=Level;
+  uint32_t Events=(Level?GPIO_IRQ_EDGE_RISE:GPIO_IRQ_EDGE_FALL)&TISM_HostData.GpioEventMask[Gpio];
+  if(Events!=0 && TISM_HostData.GpioCallback!=NULL)
+    TISM_HostData.GpioCallback(Gpio, Events);
+}
+
+static inline void gpio_put(uint Gpio, bool Level) { TISM_HostSetGpio(Gpio, Level); }
+
+
+/*
+
+  Alarm pool
+
+*/
+
+// Internal function - thread of the alarm pool; call the callback of the first alarm that expires. The return value of
+// the callback tells when to call it again: <0 relative to the previous target, >0 relative to now, 0 = don't repeat.
+static void *TISM_HostAlarmPool(void *Unused)
+{
+  while(true)
+  {
+    pthread_mutex_lock(&TISM_HostData.AlarmLock);
+    int First=-1;
+    for(int AlarmCounter=0; AlarmCounter<TISM_HOST_MAX_ALARMS; AlarmCounter++)
+      if(TISM_HostData.Alarm[AlarmCounter].AlarmID!=0 && (First<0 || TISM_HostData.Alarm[AlarmCounter].Target<TISM_HostData.Alarm[First].Target))
+        First=AlarmCounter;
+    uint64_t Now=time_us_64();
+    if(First<0 || TISM_HostData.Alarm[First].Target>Now)
+    {
+      uint64_t Delay=(First<0?TISM_HOST_ALARM_POLL_USEC:TISM_HostData.Alarm[First].Target-Now);
+      pthread_mutex_unlock(&TISM_HostData.AlarmLock);
+      sleep_us(Delay<TISM_HOST_ALARM_POLL_USEC?Delay:TISM_HOST_ALARM_POLL_USEC);
+      continue;
+    }
+
+    // Call the callback without holding the lock; it may add or cancel alarms.
+    alarm_id_t AlarmID=TISM_HostData.Alarm[First].AlarmID;
+    uint64_t Target=TISM_HostData.Alarm[First].Target;
+    alarm_callback_t Callback=TISM_HostData.Alarm[First].Callback;
+    void *UserData=TISM_HostData.Alarm[First].UserData;
+    pthread_mutex_unlock(&TISM_HostData.AlarmLock);
+    int64_t Repeat=Callback(AlarmID, UserData);
+
+    pthread_mutex_lock(&TISM_HostData.AlarmLock);
+    if(TISM_HostData.Alarm[First].AlarmID==AlarmID)
+    {
+      if(Repeat==0)
+        TISM_HostData.Alarm[First].AlarmID=0;
+      else
+        TISM_HostData.Alarm[First].Target=(Repeat<0?Target-Repeat:time_us_64()+Repeat);
+    }
+    pthread_mutex_unlock(&TISM_HostData.AlarmLock);
+  }
+  return(NULL);
+}
+
+static inline alarm_id_t add_alarm_at(absolute_time_t Target, alarm_callback_t Callback, void *UserData, bool FireIfPast)
+{
+  if(Target<=time_us_64())
+  {
+    // Already expired; as the SDK, call the callback right away (once) or don't set the alarm at all.
+    if(FireIfPast)
+      Callback(0, UserData);
+    return(0);
+  }
+
+  alarm_id_t AlarmID=-1;
+  pthread_mutex_lock(&TISM_HostData.AlarmLock);
+  if(!TISM_HostData.AlarmThreadRunning)
+    TISM_HostData.AlarmThreadRunning=(pthread_create(&TISM_HostData.AlarmThread, NULL, TISM_HostAlarmPool, NULL)==0);
+  for(int AlarmCounter=0; AlarmCounter<TISM_HOST_MAX_ALARMS; AlarmCounter++)
+    if(TISM_HostData.Alarm[AlarmCounter].AlarmID==0)
+    {
+      AlarmID=TISM_HostData.NextAlarmID++;
+      TISM_HostData.Alarm[AlarmCounter].AlarmID=AlarmID;
+      TISM_HostData.Alarm[AlarmCounter].Target=Target;
+      TISM_HostData.Alarm[AlarmCounter].Callback=Callback;
+      TISM_HostData.Alarm[AlarmCounter].UserData=UserData;
+      break;
+    }
+  pthread_mutex_unlock(&TISM_HostData.AlarmLock);
+  return(AlarmID);
+}
+
+static inline alarm_id_t add_alarm_in_us(uint64_t Usec, alarm_callback_t Callback, void *UserData, bool FireIfPast)
+{
+  return(add_alarm_at(time_us_64()+Usec, Callback, UserData, FireIfPast));
+}
+
+static inline bool cancel_alarm(alarm_id_t AlarmID)
+{
+  bool Cancelled=false;
+  pthread_mutex_lock(&TISM_HostData.AlarmLock);
+  for(int AlarmCounter=0; AlarmCounter<TISM_HOST_MAX_ALARMS; AlarmCounter++)
+    if(AlarmID>0 && TISM_HostData.Alarm[AlarmCounter].AlarmID==AlarmID)
+    {
+      TISM_HostData.Alarm[AlarmCounter].AlarmID=0;
+      Cancelled=true;
+    }
+  pthread_mutex_unlock(&TISM_HostData.AlarmLock);
+  return(Cancelled);
+}
+
+
+// Hardware watchdog (hardware/watchdog.h).
+static inline int64_t TISM_HostWatchdogCheck(alarm_id_t AlarmID, void *UserData)
+{
+  uint64_t Timeout=__atomic_load_n(&TISM_HostData.WatchdogTimeout, __ATOMIC_ACQUIRE);
+  if(Timeout==0)
+  {
+    TISM_HostData.WatchdogAlarmID=0;
+    return(0);
+  }
+  if(time_us_64()>__atomic_load_n(&TISM_HostData.WatchdogDeadline, __ATOMIC_ACQUIRE))
+  {
+    fprintf(stderr, "TISM_Host: hardware watchdog not updated within %llu msec; resetting.\n", (unsigned long long)Timeout/1000);
+    exit(EXIT_FAILURE);
+  }
+  return(-TISM_HOST_WATCHDOG_POLL_USEC);
+}
+
+static inline void watchdog_update(void)
+{
+  __atomic_store_n(&TISM_HostData.WatchdogDeadline, time_us_64()+__atomic_load_n(&TISM_HostData.WatchdogTimeout, __ATOMIC_ACQUIRE), __ATOMIC_RELEASE);
+}
+
+static inline void watchdog_enable(uint32_t DelayMsec, bool PauseOnDebug)
+{
+  __atomic_store_n(&TISM_HostData.WatchdogTimeout, (uint64_t)DelayMsec*1000, __ATOMIC_RELEASE);
+  watchdog_update();
+  if(TISM_HostData.WatchdogAlarmID<=0)
+    TISM_HostData.WatchdogAlarmID=add_alarm_in_us(TISM_HOST_WATCHDOG_POLL_USEC, TISM_HostWatchdogCheck, NULL, true);
+}
+
+static inline void watchdog_disable(void) { __atomic_store_n(&TISM_HostData.WatchdogTimeout, 0, __ATOMIC_RELEASE); }
+static inline bool watchdog_caused_reboot(void) { return(false); }
+
+#endif
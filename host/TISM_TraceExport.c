@@ -0,0 +1,243 @@
+/*
+
+  TISM_TraceExport.c
+  ==================
+  Host tool that converts a dump of the TISM trace (see TISM_Trace.c) to the Chrome trace format (JSON), to be opened
+  in Perfetto (https://ui.perfetto.dev) or chrome://tracing.
+  - Reads a capture of the serial output (e.g. from minicom or "cat /dev/ttyACM0"); all lines that are not part of a
+    dump are skipped, so the log can stay in. A capture of multiple dumps gives one timeline.
+  - Each core gets a track with the runs of the tasks (slices named after the task) and its idle periods.
+  - Messages sent and delivered, interrupts and expired timers are instant events on the track of the core they
+    occurred on. A message sent by a task is linked (an arrow) to its delivery in the inbound queue of the recipient.
+
+  Usage: TISM_TraceExport [capture] > trace.json   (reads STDIN without a file name)
+  Build: part of the host simulation build (TISM_HOST_BUILD), or "gcc -O2 -o TISM_TraceExport TISM_TraceExport.c".
+
+  Copyright (c) 2024 Maarten Klarenbeek (https://github.com/mjklaren)
+  Distributed under the GPLv3 license
+
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdarg.h>
+#include <string.h>
+#include <inttypes.h>
+
+// Types of events; these have to match the TRACE_* definitions in TISM.h.
+#define TRACE_CORE_SHIFT         7
+#define TRACE_TASK_START         1
+#define TRACE_TASK_END           2
+#define TRACE_CORE_IDLE          3
+#define TRACE_CORE_WAKE          4
+#define TRACE_MESSAGE_SENT       5
+#define TRACE_MESSAGE_DELIVERED  6
+#define TRACE_IRQ                7
+#define TRACE_TIMER_FIRED        8
+#define TRACE_STREAM_BLOCK       9
+#define TISM_TOPIC_RECIPIENT     255
+
+#define MAX_TASKS                256
+#define MAX_TASK_NAME_LENGTH     30
+#define MAX_LINE_LENGTH          1024
+#define MAX_PENDING_MESSAGES     4096    // Messages sent but not delivered (yet) that can be linked to their delivery.
+
+
+struct TISM_TraceExportData
+{
+  char TaskName[MAX_TASKS][2*MAX_TASK_NAME_LENGTH+1];          // Escaped for JSON.
+  uint64_t Timestamp;
+  bool FirstEvent;
+  uint32_t NextFlowID;
+  struct
+  {
+    uint8_t SenderTaskID, RecipientTaskID, MessageType;
+    uint32_t FlowID;
+  } Pending[MAX_PENDING_MESSAGES];
+  uint16_t FirstPending, NumberOfPending;
+} TISM_TraceExportData;
+
+
+// Internal function - copy a task name, escaped for use in a JSON string.
+void TISM_TraceExportSetTaskName(uint8_t TaskID, const char *Name)
+{
+  char *Target=TISM_TraceExportData.TaskName[TaskID];
+  for(uint8_t counter=0;(*Name!='\0') && (*Name!='\n') && (*Name!='\r') && (counter<MAX_TASK_NAME_LENGTH);Name++,counter++)
+  {
+    if((*Name=='"') || (*Name=='\\'))
+      *Target++='\\';
+    *Target++=(*Name<' '?'?':*Name);
+  }
+  *Target='\0';
+}
+
+
+// Internal function - write one event; the part within the braces after the common fields.
+void TISM_TraceExportEvent(FILE *Output, const char *Phase, uint8_t CoreID, const char *Format, ...)
+{
+  va_list Arguments;
+  fprintf(Output, "%s\n{\"ph\":\"%s\",\"pid\":0,\"tid\":%d,\"ts\":%" PRIu64, (TISM_TraceExportData.FirstEvent?"":","), Phase, CoreID, TISM_TraceExportData.Timestamp);
+  TISM_TraceExportData.FirstEvent=false;
+  va_start(Arguments, Format);
+  vfprintf(Output, Format, Arguments);
+  va_end(Arguments);
+  fprintf(Output, "}");
+}
+
+
+// Internal function - remember a message that was sent, so it can be linked to its delivery. Returns the ID of the link.
+uint32_t TISM_TraceExportAddPending(uint8_t SenderTaskID, uint8_t RecipientTaskID, uint8_t MessageType)
+{
+  // Too many messages that weren't delivered (e.g. dropped); forget the oldest.
+  if(TISM_TraceExportData.NumberOfPending==MAX_PENDING_MESSAGES)
+  {
+    TISM_TraceExportData.FirstPending=(TISM_TraceExportData.FirstPending+1)%MAX_PENDING_MESSAGES;
+    TISM_TraceExportData.NumberOfPending--;
+  }
+  uint16_t Index=(TISM_TraceExportData.FirstPending+TISM_TraceExportData.NumberOfPending)%MAX_PENDING_MESSAGES;
+  TISM_TraceExportData.Pending[Index].SenderTaskID=SenderTaskID;
+  TISM_TraceExportData.Pending[Index].RecipientTaskID=RecipientTaskID;
+  TISM_TraceExportData.Pending[Index].MessageType=MessageType;
+  TISM_TraceExportData.Pending[Index].FlowID=++TISM_TraceExportData.NextFlowID;
+  TISM_TraceExportData.NumberOfPending++;
+  return(TISM_TraceExportData.NextFlowID);
+}
+
+
+// Internal function - find (and remove) the oldest message sent that matches a delivery. Messages between two tasks are
+// delivered in order. Returns 0 when none is found (e.g. sent by an interrupt handler, or before the trace started).
+uint32_t TISM_TraceExportTakePending(uint8_t SenderTaskID, uint8_t RecipientTaskID, uint8_t MessageType)
+{
+  for(uint16_t counter=0;counter<TISM_TraceExportData.NumberOfPending;counter++)
+  {
+    uint16_t Index=(TISM_TraceExportData.FirstPending+counter)%MAX_PENDING_MESSAGES;
+    if((TISM_TraceExportData.Pending[Index].SenderTaskID==SenderTaskID) && (TISM_TraceExportData.Pending[Index].RecipientTaskID==RecipientTaskID) &&
+       (TISM_TraceExportData.Pending[Index].MessageType==MessageType))
+    {
+      uint32_t FlowID=TISM_TraceExportData.Pending[Index].FlowID;
+
+      // Close the gap by moving the older entries up one position.
+      for(;counter>0;counter--)
+      {
+        uint16_t Previous=(Index+MAX_PENDING_MESSAGES-1)%MAX_PENDING_MESSAGES;
+        TISM_TraceExportData.Pending[Index]=TISM_TraceExportData.Pending[Previous];
+        Index=Previous;
+      }
+      TISM_TraceExportData.FirstPending=(TISM_TraceExportData.FirstPending+1)%MAX_PENDING_MESSAGES;
+      TISM_TraceExportData.NumberOfPending--;
+      return(FlowID);
+    }
+  }
+  return(0);
+}
+
+
+// Internal function - convert one record of the dump.
+void TISM_TraceExportRecord(FILE *Output, uint32_t TimestampDelta, uint8_t Event, uint8_t TaskID, uint16_t Argument)
+{
+  uint8_t CoreID=Event>>TRACE_CORE_SHIFT, Other=Argument>>8, Low=Argument&0xFF;
+  uint32_t FlowID;
+  const char *Name=TISM_TraceExportData.TaskName[TaskID];
+  TISM_TraceExportData.Timestamp+=TimestampDelta;
+  switch(Event&((1<<TRACE_CORE_SHIFT)-1))
+  {
+    case TRACE_TASK_START:        TISM_TraceExportEvent(Output, "B", CoreID, ",\"name\":\"%s\",\"cat\":\"task\",\"args\":{\"task\":%d}", Name, TaskID);
+                                  break;
+    case TRACE_TASK_END:          TISM_TraceExportEvent(Output, "E", CoreID, ",\"name\":\"%s\",\"cat\":\"task\",\"args\":{\"return\":%d}", Name, Argument);
+                                  break;
+    case TRACE_CORE_IDLE:         TISM_TraceExportEvent(Output, "B", CoreID, ",\"name\":\"Idle\",\"cat\":\"idle\"");
+                                  break;
+    case TRACE_CORE_WAKE:         TISM_TraceExportEvent(Output, "E", CoreID, ",\"name\":\"Idle\",\"cat\":\"idle\"");
+                                  break;
+    case TRACE_MESSAGE_SENT:      if(Other==TISM_TOPIC_RECIPIENT)
+                                  {
+                                    TISM_TraceExportEvent(Output, "i", CoreID, ",\"s\":\"t\",\"name\":\"Publish %d\",\"cat\":\"message\",\"args\":{\"sender\":\"%s\",\"type\":%d}", Low, Name, Low);
+                                    break;
+                                  }
+                                  TISM_TraceExportEvent(Output, "i", CoreID, ",\"s\":\"t\",\"name\":\"Send %d\",\"cat\":\"message\",\"args\":{\"sender\":\"%s\",\"recipient\":\"%s\",\"type\":%d}", Low, Name, TISM_TraceExportData.TaskName[Other], Low);
+                                  FlowID=TISM_TraceExportAddPending(TaskID, Other, Low);
+                                  TISM_TraceExportEvent(Output, "s", CoreID, ",\"name\":\"Message %d\",\"cat\":\"message\",\"id\":%u", Low, FlowID);
+                                  break;
+    case TRACE_MESSAGE_DELIVERED: TISM_TraceExportEvent(Output, "i", CoreID, ",\"s\":\"t\",\"name\":\"Deliver %d\",\"cat\":\"message\",\"args\":{\"sender\":\"%s\",\"recipient\":\"%s\",\"type\":%d}", Low, TISM_TraceExportData.TaskName[Other], Name, Low);
+                                  if((FlowID=TISM_TraceExportTakePending(Other, TaskID, Low))!=0)
+                                    TISM_TraceExportEvent(Output, "f", CoreID, ",\"bp\":\"e\",\"name\":\"Message %d\",\"cat\":\"message\",\"id\":%u", Low, FlowID);
+                                  break;
+    case TRACE_IRQ:               TISM_TraceExportEvent(Output, "i", CoreID, ",\"s\":\"t\",\"name\":\"IRQ GPIO %d\",\"cat\":\"irq\",\"args\":{\"gpio\":%d,\"events\":%d}", Other, Other, Low);
+                                  break;
+    case TRACE_TIMER_FIRED:       TISM_TraceExportEvent(Output, "i", CoreID, ",\"s\":\"t\",\"name\":\"Timer %d\",\"cat\":\"timer\",\"args\":{\"task\":\"%s\",\"timer\":%d,\"precision\":%d}", Low, Name, Low, Other);
+                                  break;
+    case TRACE_STREAM_BLOCK:      TISM_TraceExportEvent(Output, "i", CoreID, ",\"s\":\"t\",\"name\":\"Stream %d %s\",\"cat\":\"stream\",\"args\":{\"task\":\"%s\",\"stream\":%d,\"buffer\":%d}", Other, (Low==0xFF?"dropped":"block"), Name, Other, Low);
+                                  break;
+    default:                      fprintf(stderr, "TISM_TraceExport: unknown event type %d skipped.\n", Event);
+                                  break;
+  }
+}
+
+
+int main(int argc, char *argv[])
+{
+  FILE *Input=stdin, *Output=stdout;
+  if((argc>1) && ((Input=fopen(argv[1], "r"))==NULL))
+  {
+    fprintf(stderr, "TISM_TraceExport: can't open %s.\n", argv[1]);
+    return(EXIT_FAILURE);
+  }
+  TISM_TraceExportData.FirstEvent=true;
+  for(uint16_t TaskID=0;TaskID<MAX_TASKS;TaskID++)
+    sprintf(TISM_TraceExportData.TaskName[TaskID], "Task %d", TaskID);
+
+  fprintf(Output, "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[");
+  TISM_TraceExportEvent(Output, "M", 0, ",\"name\":\"process_name\",\"args\":{\"name\":\"TISM\"}");
+  for(uint8_t CoreID=0;CoreID<2;CoreID++)
+    TISM_TraceExportEvent(Output, "M", CoreID, ",\"name\":\"thread_name\",\"args\":{\"name\":\"Core %d\"}", CoreID);
+
+  // Process the lines of the dumps; skip everything else.
+  char Line[MAX_LINE_LENGTH], *Position;
+  uint32_t Dumps=0, Records=0, Overwritten=0;
+  bool InDump=false;
+  while(fgets(Line, sizeof(Line), Input)!=NULL)
+  {
+    unsigned long long Timestamp;
+    unsigned int Count, Lost, TaskID;
+    if((Position=strstr(Line, "TISM_TRACE_BEGIN"))!=NULL)
+    {
+      if(sscanf(Position, "TISM_TRACE_BEGIN %llu %u %u", &Timestamp, &Count, &Lost)==3)
+      {
+        TISM_TraceExportData.Timestamp=Timestamp;
+        TISM_TraceExportData.NumberOfPending=0;
+        Overwritten+=Lost;
+        Dumps++;
+        InDump=true;
+      }
+    }
+    else if((Position=strstr(Line, "TISM_TRACE_TASK"))!=NULL)
+    {
+      int Offset=0;
+      if((sscanf(Position, "TISM_TRACE_TASK %u %n", &TaskID, &Offset)==1) && (Offset>0) && (TaskID<MAX_TASKS))
+        TISM_TraceExportSetTaskName(TaskID, Position+Offset);
+    }
+    else if((Position=strstr(Line, "TISM_TRACE_END"))!=NULL)
+      InDump=false;
+    else if(InDump && ((Position=strstr(Line, "TISM_TRACE "))!=NULL))
+    {
+      // Records of 16 hexadecimal digits, separated by spaces.
+      Position+=strlen("TISM_TRACE ");
+      uint32_t TimestampDelta;
+      unsigned int Event, Task, Argument;
+      int Length;
+      while(sscanf(Position, " %8" SCNx32 "%2x%2x%4x%n", &TimestampDelta, &Event, &Task, &Argument, &Length)==4)
+      {
+        TISM_TraceExportRecord(Output, TimestampDelta, (uint8_t)Event, (uint8_t)Task, (uint16_t)Argument);
+        Position+=Length;
+        Records++;
+      }
+    }
+  }
+  fprintf(Output, "\n]}\n");
+  if(Input!=stdin)
+    fclose(Input);
+  fprintf(stderr, "TISM_TraceExport: %u dump(s), %u records converted, %u records were overwritten before dumping.\n", Dumps, Records, Overwritten);
+  return(Dumps>0?EXIT_SUCCESS:EXIT_FAILURE);
+}
@@ -0,0 +1,2 @@
+// Host simulation build - see TISM_Host.h.
+#include "../TISM_Host.h"
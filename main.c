@@ -64,5 +64,5 @@ void main(void)
     fprintf(STDERR, "TISM: TISM Scheduler for CORE0 exited with error.\n");
   
   printf("TISM: Program completed.\n");
-  sleep_ms(STARTUP_DELAY);
+  sleep_ms(SHUTDOWN_DELAY);
 }
\ No newline at end of file